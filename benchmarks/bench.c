@@ -0,0 +1,118 @@
+/**
+ * bench.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Needed for clock_gettime.
+#define _POSIX_C_SOURCE 199309L
+
+#include "bench.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static volatile uint64_t sink;
+
+uint64_t bench_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void bench_report(const char *name, size_t ops, uint64_t ns) {
+  double ns_per_op = ops ? (double)ns / ops : 0;
+  double ops_per_sec = ns ? ops * 1e9 / ns : 0;
+
+  printf("{\"name\":\"%s\",\"ops\":%zu,\"ns\":%llu,\"ns_per_op\":%.2f,"
+         "\"ops_per_sec\":%.0f}\n",
+         name, ops, (unsigned long long)ns, ns_per_op, ops_per_sec);
+}
+
+void bench_report_bytes(const char *name, size_t ops, uint64_t ns,
+                        size_t bytes) {
+  double ns_per_op = ops ? (double)ns / ops : 0;
+  double ops_per_sec = ns ? ops * 1e9 / ns : 0;
+  double bytes_per_sec = ns ? bytes * 1e9 / ns : 0;
+
+  printf("{\"name\":\"%s\",\"ops\":%zu,\"ns\":%llu,\"ns_per_op\":%.2f,"
+         "\"ops_per_sec\":%.0f,\"bytes_per_sec\":%.0f}\n",
+         name, ops, (unsigned long long)ns, ns_per_op, ops_per_sec,
+         bytes_per_sec);
+}
+
+void bench_consume(uint64_t value) { sink += value; }
+
+void bench_check(int ok, const char *what) {
+  if (ok)
+    return;
+
+  fprintf(stderr, "%s failed\n", what);
+  exit(EXIT_FAILURE);
+}
+
+BenchRng bench_rng_init(uint64_t seed) {
+  // The state must never be zero.
+  return (BenchRng){seed ? seed : 0x9E3779B97F4A7C15ULL};
+}
+
+uint64_t bench_rng_next(BenchRng *rng) {
+  rng->state ^= rng->state >> 12;
+  rng->state ^= rng->state << 25;
+  rng->state ^= rng->state >> 27;
+  return rng->state * 0x2545F4914F6CDD1DULL;
+}
+
+int bench_zipf_init(BenchZipf *result, size_t n, double skew) {
+  *result = (BenchZipf){0};
+
+  if (!(result->cdf = malloc(n * sizeof(double))))
+    return EXIT_FAILURE;
+
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += 1.0 / pow(i + 1, skew);
+    result->cdf[i] = sum;
+  }
+  for (size_t i = 0; i < n; i++)
+    result->cdf[i] /= sum;
+
+  result->n = n;
+
+  return EXIT_SUCCESS;
+}
+
+void bench_zipf_deinit(BenchZipf *zipf) { free(zipf->cdf); }
+
+size_t bench_zipf_next(const BenchZipf *zipf, BenchRng *rng) {
+  double u = (bench_rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+
+  // Binary search for the first value whose cumulative probability is >= u.
+  size_t lo = 0, hi = zipf->n - 1;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (zipf->cdf[mid] < u)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
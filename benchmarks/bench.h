@@ -0,0 +1,70 @@
+/**
+ * bench.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_BENCH_H
+#define MYLIB_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Helpers shared by the benchmarks. Each result is printed as a single line of
+// JSON so that runs can be collected and compared by other tools:
+//
+//   {"name":"vector/append","ops":1000000,"ns":3024110,"ns_per_op":3.02,...}
+
+// Monotonic time in nanoseconds.
+uint64_t bench_now();
+
+// Prints the result of running `ops` operations in `ns` nanoseconds.
+void bench_report(const char *name, size_t ops, uint64_t ns);
+
+// Same as above, also reporting throughput for `bytes` bytes processed.
+void bench_report_bytes(const char *name, size_t ops, uint64_t ns,
+                        size_t bytes);
+
+// Keeps a value alive so that the compiler can't optimize the work away.
+void bench_consume(uint64_t value);
+
+// Exits with an error naming `what` unless `ok`. Unlike assert it still runs
+// under NDEBUG, so setup and timed calls can go inside it.
+void bench_check(int ok, const char *what);
+
+// xorshift64*, seeded so that every run sees the same keys.
+typedef struct BenchRng {
+  uint64_t state;
+} BenchRng;
+
+BenchRng bench_rng_init(uint64_t seed);
+uint64_t bench_rng_next(BenchRng *rng);
+
+// Draws from [0, n) with a Zipfian distribution, small values are the most
+// frequent.
+typedef struct BenchZipf {
+  double *cdf;
+  size_t n;
+} BenchZipf;
+
+int bench_zipf_init(BenchZipf *result, size_t n, double skew);
+void bench_zipf_deinit(BenchZipf *zipf);
+size_t bench_zipf_next(const BenchZipf *zipf, BenchRng *rng);
+
+#endif
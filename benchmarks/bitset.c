@@ -0,0 +1,105 @@
+/**
+ * bitset.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/bitset.h"
+#include <stdio.h>
+
+#define MAX_BIT (1 << 20)
+#define LOOKUPS 1000000
+
+// Fills `bs` so that roughly `percent` of its bits are set.
+static void fill(Bitset *bs, unsigned percent, uint64_t seed) {
+  BenchRng rng = bench_rng_init(seed);
+  for (size_t i = 0; i <= MAX_BIT; i++)
+    if (bench_rng_next(&rng) % 100 < percent)
+      bitset_incl(bs, i);
+}
+
+static void run(unsigned percent) {
+  char name[64];
+
+  Bitset a, b;
+  bench_check(!bitset_init(&a, MAX_BIT), "bitset_init");
+  bench_check(!bitset_init(&b, MAX_BIT), "bitset_init");
+
+  uint64_t start = bench_now();
+  fill(&a, percent, 1);
+  snprintf(name, sizeof(name), "bitset/incl/%u%%", percent);
+  bench_report(name, MAX_BIT + 1, bench_now() - start);
+
+  fill(&b, percent, 2);
+
+  {
+    BenchRng rng = bench_rng_init(3);
+    uint64_t hits = 0;
+    start = bench_now();
+    for (size_t i = 0; i < LOOKUPS; i++)
+      hits += bitset_has(&a, bench_rng_next(&rng) % MAX_BIT) != 0;
+    snprintf(name, sizeof(name), "bitset/has/%u%%", percent);
+    bench_report(name, LOOKUPS, bench_now() - start);
+    bench_consume(hits);
+  }
+
+  start = bench_now();
+  bench_consume(bitset_count(&a));
+  snprintf(name, sizeof(name), "bitset/count/%u%%", percent);
+  bench_report(name, 1, bench_now() - start);
+
+  {
+    size_t count = 0;
+    start = bench_now();
+    for (size_t i = 0; bitset_next(&a, &i); i++)
+      count++;
+    snprintf(name, sizeof(name), "bitset/iterate/%u%%", percent);
+    bench_report(name, count, bench_now() - start);
+  }
+
+  Bitset result;
+
+  start = bench_now();
+  bench_check(!bitset_union(&a, &b, &result), "bitset_union");
+  snprintf(name, sizeof(name), "bitset/union/%u%%", percent);
+  bench_report(name, 1, bench_now() - start);
+  bitset_deinit(&result);
+
+  start = bench_now();
+  bench_check(!bitset_intersect(&a, &b, &result), "bitset_intersect");
+  snprintf(name, sizeof(name), "bitset/intersect/%u%%", percent);
+  bench_report(name, 1, bench_now() - start);
+  bitset_deinit(&result);
+
+  start = bench_now();
+  bench_check(!bitset_difference(&a, &b, &result), "bitset_difference");
+  snprintf(name, sizeof(name), "bitset/difference/%u%%", percent);
+  bench_report(name, 1, bench_now() - start);
+  bitset_deinit(&result);
+
+  bitset_deinit(&a);
+  bitset_deinit(&b);
+}
+
+int main() {
+  unsigned densities[] = {1, 10, 50};
+  for (size_t i = 0; i < 3; i++)
+    run(densities[i]);
+}
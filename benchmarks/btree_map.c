@@ -0,0 +1,113 @@
+/**
+ * btree_map.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/btree_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N 1000000
+#define LOOKUPS 1000000
+#define SCANS 10000
+#define SCAN_LENGTH 100
+
+static int32_t cmp_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Timestamps a few ticks apart, as in a time-series index.
+static void run(const char *prefix, BTreeMapCmpFn cmp, const uint64_t *keys,
+                const uint64_t *shuffled) {
+  char name[96];
+  BTreeMap map;
+
+  bench_check(!btree_map_init(&map, cmp, sizeof(uint64_t), sizeof(uint64_t), 0),
+              "btree_map_init");
+  uint64_t start = bench_now();
+  for (size_t i = 0; i < N; i++)
+    btree_map_put(&map, &shuffled[i], &shuffled[i]);
+  snprintf(name, sizeof(name), "%s/put/random", prefix);
+  bench_report(name, N, bench_now() - start);
+  btree_map_deinit(&map);
+
+  bench_check(!btree_map_init(&map, cmp, sizeof(uint64_t), sizeof(uint64_t), 0),
+              "btree_map_init");
+  start = bench_now();
+  for (size_t i = 0; i < N; i++)
+    btree_map_put(&map, &keys[i], &keys[i]);
+  snprintf(name, sizeof(name), "%s/put/ascending", prefix);
+  bench_report(name, N, bench_now() - start);
+  btree_map_deinit(&map);
+
+  bench_check(!btree_map_init(&map, cmp, sizeof(uint64_t), sizeof(uint64_t), 0),
+              "btree_map_init");
+  start = bench_now();
+  bench_check(!btree_map_bulk_load(&map, keys, keys, N), "btree_map_bulk_load");
+  snprintf(name, sizeof(name), "%s/bulk_load", prefix);
+  bench_report(name, N, bench_now() - start);
+
+  uint64_t sum = 0;
+  start = bench_now();
+  for (size_t i = 0; i < LOOKUPS; i++)
+    sum += *(uint64_t *)btree_map_get(&map, &shuffled[i % N]);
+  snprintf(name, sizeof(name), "%s/get", prefix);
+  bench_report(name, LOOKUPS, bench_now() - start);
+
+  start = bench_now();
+  for (size_t i = 0; i < SCANS; i++) {
+    BTreeMapIterator iter = btree_map_seek(&map, &shuffled[i]);
+    const BTreeMapEntry *entry;
+    for (size_t j = 0; j < SCAN_LENGTH && (entry = btree_map_next(&iter)); j++)
+      sum += *(uint64_t *)entry->value;
+  }
+  snprintf(name, sizeof(name), "%s/scan/%d", prefix, SCAN_LENGTH);
+  bench_report(name, (size_t)SCANS * SCAN_LENGTH, bench_now() - start);
+  bench_consume(sum);
+
+  btree_map_deinit(&map);
+}
+
+int main() {
+  uint64_t *keys = malloc(N * sizeof(uint64_t));
+  uint64_t *shuffled = malloc(N * sizeof(uint64_t));
+  bench_check(keys && shuffled, "malloc");
+
+  BenchRng rng = bench_rng_init(3);
+  uint64_t time = 1600000000000ULL;
+  for (size_t i = 0; i < N; i++) {
+    time += 1 + bench_rng_next(&rng) % 16;
+    keys[i] = shuffled[i] = time;
+  }
+  for (size_t i = N - 1; i > 0; i--) {
+    size_t j = bench_rng_next(&rng) % (i + 1);
+    uint64_t tmp = shuffled[i];
+    shuffled[i] = shuffled[j];
+    shuffled[j] = tmp;
+  }
+
+  run("btree_map/u64", NULL, keys, shuffled);
+  run("btree_map/cmp", cmp_u64, keys, shuffled);
+
+  free(shuffled);
+  free(keys);
+}
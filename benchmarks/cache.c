@@ -0,0 +1,107 @@
+/**
+ * cache.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/cache.h"
+#include "mylib/hash.h"
+#include <stdio.h>
+
+#define KEYS 100000
+#define CAPACITY 10000
+#define OPS 1000000
+
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+// Read through a cache holding a tenth of the keys, putting on every miss.
+static void run(const char *prefix, CachePolicy policy, const uint64_t *keys) {
+  Cache cache;
+  CacheOptions options = {.policy = policy, .max_entries = CAPACITY};
+  bench_check(!cache_init(&cache, hash_u64, eql_u64, sizeof(uint64_t),
+                          sizeof(uint64_t), &options), "cache_init");
+
+  uint64_t sum = 0;
+  uint64_t start = bench_now();
+  for (size_t i = 0; i < OPS; i++) {
+    uint64_t *value = cache_get(&cache, &keys[i]);
+    if (value)
+      sum += *value;
+    else
+      cache_put(&cache, &keys[i], &keys[i]);
+  }
+  char name[64];
+  snprintf(name, sizeof(name), "cache/%s/zipf", prefix);
+  bench_report(name, OPS, bench_now() - start);
+  bench_consume(sum);
+
+  CacheStats stats;
+  cache_stats(&cache, &stats);
+  printf("{\"name\":\"cache/%s/hit_ratio\",\"ratio\":%.4f}\n", prefix,
+         (double)stats.hits / (stats.hits + stats.misses));
+
+  cache_deinit(&cache);
+}
+
+int main() {
+  BenchZipf zipf;
+  bench_check(!bench_zipf_init(&zipf, KEYS, 0.99), "bench_zipf_init");
+  BenchRng rng = bench_rng_init(1);
+
+  uint64_t *keys = malloc(OPS * sizeof(uint64_t));
+  bench_check(keys != NULL, "malloc");
+  for (size_t i = 0; i < OPS; i++)
+    keys[i] = bench_zipf_next(&zipf, &rng);
+
+  run("lru", CACHE_POLICY_LRU, keys);
+  run("clock", CACHE_POLICY_CLOCK, keys);
+
+  // The same workload through one shard of a sharded cache, the difference is
+  // the cost of hashing twice and taking the lock.
+  {
+    ShardedCache cache;
+    CacheOptions options = {.max_entries = CAPACITY};
+    bench_check(!sharded_cache_init(&cache, hash_u64, eql_u64, sizeof(uint64_t),
+                                    sizeof(uint64_t), 1, &options),
+                "sharded_cache_init");
+
+    uint64_t sum = 0, value;
+    uint64_t start = bench_now();
+    for (size_t i = 0; i < OPS; i++) {
+      if (sharded_cache_get(&cache, &keys[i], &value))
+        sum += value;
+      else
+        sharded_cache_put(&cache, &keys[i], &keys[i]);
+    }
+    bench_report("cache/sharded/zipf", OPS, bench_now() - start);
+    bench_consume(sum);
+
+    sharded_cache_deinit(&cache);
+  }
+
+  free(keys);
+  bench_zipf_deinit(&zipf);
+}
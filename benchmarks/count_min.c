@@ -0,0 +1,73 @@
+/**
+ * count_min.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/count_min.h"
+
+#define N 1000000
+
+static void run(CountMinKind kind, const char *add, const char *add_many,
+                const char *estimate, const uint64_t *keys) {
+  CountMin cm;
+
+  // 1 MiB of counters per row, more than fits in the L2 cache.
+  bench_check(!count_min_init(&cm, 1 << 17, 5, kind), "count_min_init");
+  uint64_t start = bench_now();
+  for (size_t i = 0; i < N; i++)
+    count_min_add(&cm, &keys[i], sizeof(uint64_t), 1);
+  bench_report(add, N, bench_now() - start);
+
+  count_min_clear(&cm);
+  start = bench_now();
+  count_min_add_many(&cm, keys, sizeof(uint64_t), N);
+  bench_report(add_many, N, bench_now() - start);
+
+  int64_t sum = 0;
+  start = bench_now();
+  for (size_t i = 0; i < N; i++)
+    sum += count_min_estimate(&cm, &keys[i], sizeof(uint64_t));
+  bench_report(estimate, N, bench_now() - start);
+  bench_consume(sum);
+
+  count_min_deinit(&cm);
+}
+
+int main() {
+  uint64_t *keys = malloc(N * sizeof(uint64_t));
+  bench_check(keys != NULL, "malloc");
+
+  // Skewed like the heavy hitters the sketch is meant to find.
+  BenchZipf zipf;
+  bench_check(!bench_zipf_init(&zipf, N, 1.0), "bench_zipf_init");
+  BenchRng rng = bench_rng_init(1);
+  for (size_t i = 0; i < N; i++)
+    keys[i] = bench_zipf_next(&zipf, &rng);
+  bench_zipf_deinit(&zipf);
+
+  run(COUNT_MIN_SKETCH, "count_min/add", "count_min/add_many",
+      "count_min/estimate", keys);
+  run(COUNT_MIN_COUNT_SKETCH, "count_min/count_sketch/add",
+      "count_min/count_sketch/add_many", "count_min/count_sketch/estimate",
+      keys);
+
+  free(keys);
+}
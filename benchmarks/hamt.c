@@ -0,0 +1,89 @@
+/**
+ * hamt.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/hamt.h"
+#include "mylib/hash.h"
+#include <stdio.h>
+
+#define N 1000000
+
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+int main() {
+  Hamt map, snapshot;
+  bench_check(!hamt_init64(&map, hash_u64, eql_u64, sizeof(uint64_t),
+                           sizeof(uint64_t)), "hamt_init64");
+
+  // Nothing is shared, so every node is changed in place.
+  uint64_t start = bench_now();
+  for (uint64_t key = 0; key < N; key++)
+    hamt_put(&map, &key, &key);
+  bench_report("hamt/put", N, bench_now() - start);
+  printf("{\"name\":\"hamt/bytes\",\"bytes\":%zu}\n", hamt_memory_usage(&map));
+
+  BenchRng rng = bench_rng_init(1);
+  uint64_t sum = 0;
+  start = bench_now();
+  for (size_t i = 0; i < N; i++) {
+    uint64_t key = bench_rng_next(&rng) % N;
+    sum += *(const uint64_t *)hamt_get(&map, &key);
+  }
+  bench_report("hamt/get", N, bench_now() - start);
+  bench_consume(sum);
+
+  // A snapshot before every put, the worst case for path copying.
+  start = bench_now();
+  for (size_t i = 0; i < N / 10; i++) {
+    uint64_t key = bench_rng_next(&rng) % N, value = i;
+    hamt_snapshot(&map, &snapshot);
+    hamt_put(&map, &key, &value);
+    hamt_deinit(&snapshot);
+  }
+  bench_report("hamt/snapshot_put", N / 10, bench_now() - start);
+
+  // A snapshot every 1000 puts, the rest of the batch is in place.
+  start = bench_now();
+  for (size_t i = 0; i < N; i++) {
+    uint64_t key = bench_rng_next(&rng) % N, value = i;
+    if (i % 1000 == 0) {
+      hamt_deinit(&snapshot);
+      hamt_snapshot(&map, &snapshot);
+    }
+    hamt_put(&map, &key, &value);
+  }
+  hamt_deinit(&snapshot);
+  bench_report("hamt/batched_put", N, bench_now() - start);
+
+  start = bench_now();
+  for (uint64_t key = 0; key < N; key++)
+    hamt_delete(&map, &key);
+  bench_report("hamt/delete", N, bench_now() - start);
+
+  hamt_deinit(&map);
+}
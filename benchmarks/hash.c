@@ -0,0 +1,80 @@
+/**
+ * hash.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/hash.h"
+#include <assert.h>
+#include <stdio.h>
+
+#define SHORT_KEY_SIZE 16
+#define SHORT_KEYS 1000000
+#define LONG_KEY_SIZE 4096
+#define LONG_KEYS (SHORT_KEYS * SHORT_KEY_SIZE / LONG_KEY_SIZE)
+
+static uint8_t keys[SHORT_KEYS * SHORT_KEY_SIZE];
+static uint32_t hashes[SHORT_KEYS];
+
+// Hashes `count` keys of `key_size` bytes with each hash function.
+static void run(const char *size_name, size_t key_size, size_t count) {
+  char name[64];
+  uint64_t start, sum;
+  size_t bytes = key_size * count;
+
+  sum = 0;
+  start = bench_now();
+  for (size_t i = 0; i < count; i++)
+    sum += fnv1a_32_hash(keys + i * key_size, key_size);
+  snprintf(name, sizeof(name), "hash/fnv1a_32/%s", size_name);
+  bench_report_bytes(name, count, bench_now() - start, bytes);
+  bench_consume(sum);
+
+  sum = 0;
+  start = bench_now();
+  for (size_t i = 0; i < count; i++)
+    sum += fnv1a_64_hash(keys + i * key_size, key_size);
+  snprintf(name, sizeof(name), "hash/fnv1a_64/%s", size_name);
+  bench_report_bytes(name, count, bench_now() - start, bytes);
+  bench_consume(sum);
+
+  sum = 0;
+  start = bench_now();
+  for (size_t i = 0; i < count; i++)
+    sum += xxh64_hash(keys + i * key_size, key_size, 0);
+  snprintf(name, sizeof(name), "hash/xxh64/%s", size_name);
+  bench_report_bytes(name, count, bench_now() - start, bytes);
+  bench_consume(sum);
+
+  start = bench_now();
+  fnv1a_32_hash_batch(keys, key_size, count, hashes);
+  snprintf(name, sizeof(name), "hash/fnv1a_32_batch/%s", size_name);
+  bench_report_bytes(name, count, bench_now() - start, bytes);
+  bench_consume(hashes[count - 1]);
+}
+
+int main() {
+  BenchRng rng = bench_rng_init(1);
+  for (size_t i = 0; i < sizeof(keys); i++)
+    keys[i] = bench_rng_next(&rng);
+
+  run("16B", SHORT_KEY_SIZE, SHORT_KEYS);
+  run("4KiB", LONG_KEY_SIZE, LONG_KEYS);
+}
@@ -0,0 +1,183 @@
+/**
+ * hash_map.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/hash.h"
+#include "mylib/hash_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N 100000
+#define LOOKUPS 1000000
+#define ZIPF_SKEW 0.99
+#define LARGE_VALUES 10000
+#define LARGE_VALUE_SIZE 1024
+
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+// Looks up LOOKUPS keys, `hit_percent` of them are in the map. Keys that are
+// hits are picked uniformly or from a Zipfian distribution.
+static void lookups(const HashMap *map, const char *prefix, const char *kind,
+                    const uint64_t *keys, const BenchZipf *zipf,
+                    unsigned hit_percent) {
+  char name[96];
+  BenchRng rng = bench_rng_init(hit_percent + 1);
+
+  // Generate the keys up front so that only the lookups are timed.
+  uint64_t *queries = malloc(LOOKUPS * sizeof(uint64_t));
+  bench_check(queries != NULL, "malloc");
+  for (size_t i = 0; i < LOOKUPS; i++) {
+    if (bench_rng_next(&rng) % 100 < hit_percent) {
+      size_t idx = zipf ? bench_zipf_next(zipf, &rng)
+                        : bench_rng_next(&rng) % N;
+      queries[i] = keys[idx];
+    } else {
+      // Keys are all odd, even keys are never in the map.
+      queries[i] = bench_rng_next(&rng) << 1;
+    }
+  }
+
+  uint64_t found = 0;
+  uint64_t start = bench_now();
+  for (size_t i = 0; i < LOOKUPS; i++)
+    found += hash_map_get(map, &queries[i]) != NULL;
+  uint64_t ns = bench_now() - start;
+
+  snprintf(name, sizeof(name), "%s/get/%s/%u%%_hit", prefix, kind,
+           hit_percent);
+  bench_report(name, LOOKUPS, ns);
+  bench_consume(found);
+
+  free(queries);
+}
+
+static void run(const char *prefix, const HashMapOptions *options,
+                const uint64_t *keys, const BenchZipf *zipf) {
+  char name[96];
+
+  HashMap map;
+  bench_check(!hash_map_init_with_options(&map, hash_u64, eql_u64,
+                                          sizeof(uint64_t), sizeof(uint64_t),
+                                          options),
+              "hash_map_init_with_options");
+
+  uint64_t start = bench_now();
+  for (size_t i = 0; i < N; i++)
+    hash_map_put(&map, (void *)&keys[i], (void *)&keys[i]);
+  snprintf(name, sizeof(name), "%s/put", prefix);
+  bench_report(name, N, bench_now() - start);
+
+  unsigned hit_percents[] = {100, 90, 50, 0};
+  for (size_t i = 0; i < 4; i++)
+    lookups(&map, prefix, "uniform", keys, NULL, hit_percents[i]);
+  lookups(&map, prefix, "zipf", keys, zipf, 100);
+  lookups(&map, prefix, "zipf", keys, zipf, 90);
+
+  // Mixed workload, 80% gets, 10% puts and 10% deletes.
+  {
+    BenchRng rng = bench_rng_init(7);
+    uint64_t found = 0;
+    start = bench_now();
+    for (size_t i = 0; i < LOOKUPS; i++) {
+      uint64_t r = bench_rng_next(&rng);
+      const uint64_t *key = &keys[bench_zipf_next(zipf, &rng)];
+      if (r % 10 == 0)
+        hash_map_put(&map, (void *)key, (void *)key);
+      else if (r % 10 == 1)
+        hash_map_delete(&map, key);
+      else
+        found += hash_map_get(&map, key) != NULL;
+    }
+    snprintf(name, sizeof(name), "%s/mixed/zipf", prefix);
+    bench_report(name, LOOKUPS, bench_now() - start);
+    bench_consume(found);
+  }
+
+  start = bench_now();
+  for (size_t i = 0; i < N; i++)
+    hash_map_delete(&map, &keys[i]);
+  snprintf(name, sizeof(name), "%s/delete", prefix);
+  bench_report(name, N, bench_now() - start);
+
+  hash_map_deinit(&map);
+}
+
+// Puts and then replaces LARGE_VALUE_SIZE byte values, which copying pays for
+// on every put and borrowing doesn't.
+static void large_values(const char *prefix, HashMapStorage storage,
+                         const uint64_t *keys) {
+  char name[96];
+
+  uint8_t *values = calloc(LARGE_VALUES, LARGE_VALUE_SIZE);
+  bench_check(values != NULL, "calloc");
+
+  HashMap map;
+  HashMapOptions options = {.storage = storage};
+  bench_check(!hash_map_init_with_options(&map, hash_u64, eql_u64,
+                                          sizeof(uint64_t), LARGE_VALUE_SIZE,
+                                          &options),
+              "hash_map_init_with_options");
+
+  uint64_t start = bench_now();
+  for (size_t round = 0; round < 2; round++)
+    for (size_t i = 0; i < LARGE_VALUES; i++)
+      hash_map_put(&map, (void *)&keys[i], values + i * LARGE_VALUE_SIZE);
+  snprintf(name, sizeof(name), "%s/put/%dB_values", prefix, LARGE_VALUE_SIZE);
+  bench_report(name, 2 * LARGE_VALUES, bench_now() - start);
+
+  hash_map_deinit(&map);
+  free(values);
+}
+
+int main() {
+  // Random odd keys, so that even keys can be used for misses.
+  uint64_t *keys = malloc(N * sizeof(uint64_t));
+  bench_check(keys != NULL, "malloc");
+
+  BenchRng rng = bench_rng_init(42);
+  for (size_t i = 0; i < N; i++)
+    keys[i] = bench_rng_next(&rng) | 1;
+
+  BenchZipf zipf;
+  bench_check(!bench_zipf_init(&zipf, N, ZIPF_SKEW), "bench_zipf_init");
+
+  HashMapOptions fastrange = {.indexing = HASH_MAP_INDEX_FASTRANGE};
+  HashMapOptions mask = {.indexing = HASH_MAP_INDEX_MASK};
+  HashMapOptions borrow = {.storage = HASH_MAP_STORE_BORROW};
+  HashMapOptions inline_ = {.storage = HASH_MAP_STORE_INLINE};
+  run("hash_map/fastrange", &fastrange, keys, &zipf);
+  run("hash_map/mask", &mask, keys, &zipf);
+  run("hash_map/borrow", &borrow, keys, &zipf);
+  run("hash_map/inline", &inline_, keys, &zipf);
+
+  large_values("hash_map/copy", HASH_MAP_STORE_COPY, keys);
+  large_values("hash_map/borrow", HASH_MAP_STORE_BORROW, keys);
+
+  bench_zipf_deinit(&zipf);
+  free(keys);
+}
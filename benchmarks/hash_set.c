@@ -0,0 +1,109 @@
+/**
+ * hash_set.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/hash.h"
+#include "mylib/hash_map.h"
+#include "mylib/hash_set.h"
+#include <stdio.h>
+
+#define N 1000000
+
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+int main() {
+  // Random keys with some duplicates, as a dedup stage would see them.
+  uint64_t *keys = malloc(N * sizeof(uint64_t));
+  bench_check(keys != NULL, "malloc");
+  BenchRng rng = bench_rng_init(1);
+  for (size_t i = 0; i < N; i++)
+    keys[i] = bench_rng_next(&rng) % (N * 2);
+
+  // A HashMap with no value, the way a set was built before.
+  {
+    HashMap map;
+    bench_check(!hash_map_init64(&map, hash_u64, eql_u64, sizeof(uint64_t), 0),
+                "hash_map_init64");
+
+    uint64_t start = bench_now();
+    for (size_t i = 0; i < N; i++) {
+      int has_existing;
+      hash_map_get_or_put(&map, &keys[i], &has_existing);
+    }
+    bench_report("hash_set/hash_map/insert", N, bench_now() - start);
+
+    uint64_t hits = 0;
+    start = bench_now();
+    for (size_t i = 0; i < N; i++)
+      hits += hash_map_has(&map, &i);
+    bench_report("hash_set/hash_map/contains", N, bench_now() - start);
+    bench_consume(hits);
+
+    printf("{\"name\":\"hash_set/hash_map/memory\",\"bytes\":%zu}\n",
+           hash_map_memory_usage(&map));
+    hash_map_deinit(&map);
+  }
+
+  {
+    HashSet set;
+    bench_check(!hash_set_init64(&set, hash_u64, eql_u64, sizeof(uint64_t)),
+                "hash_set_init64");
+
+    uint64_t start = bench_now();
+    for (size_t i = 0; i < N; i++)
+      hash_set_insert(&set, &keys[i], NULL);
+    bench_report("hash_set/insert", N, bench_now() - start);
+
+    uint64_t hits = 0;
+    start = bench_now();
+    for (size_t i = 0; i < N; i++)
+      hits += hash_set_contains(&set, &i);
+    bench_report("hash_set/contains", N, bench_now() - start);
+    bench_consume(hits);
+
+    printf("{\"name\":\"hash_set/memory\",\"bytes\":%zu}\n",
+           hash_set_memory_usage(&set));
+
+    HashSet other, result;
+    bench_check(!hash_set_init64(&other, hash_u64, eql_u64, sizeof(uint64_t)),
+                "hash_set_init64");
+    for (uint64_t key = 0; key < N; key++)
+      hash_set_insert(&other, &key, NULL);
+
+    start = bench_now();
+    bench_check(!hash_set_intersect(&set, &other, &result),
+                "hash_set_intersect");
+    bench_report("hash_set/intersect", N, bench_now() - start);
+    hash_set_deinit(&result);
+
+    hash_set_deinit(&other);
+    hash_set_deinit(&set);
+  }
+
+  free(keys);
+}
@@ -0,0 +1,92 @@
+/**
+ * heap.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/heap.h"
+#include <stdio.h>
+#include <string.h>
+
+#define N 1000000
+
+static int32_t cmp_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static int qsort_cmp(const void *a, const void *b) { return cmp_u64(a, b); }
+
+static void run(size_t arity, const uint64_t *values) {
+  Heap heap;
+  bench_check(!heap_init(&heap, sizeof(uint64_t), cmp_u64, arity), "heap_init");
+  char name[64];
+
+  uint64_t start = bench_now();
+  for (size_t i = 0; i < N; i++)
+    heap_push(&heap, &values[i]);
+  snprintf(name, sizeof(name), "heap/%zu_ary/push", arity);
+  bench_report(name, N, bench_now() - start);
+
+  uint64_t sum = 0, value;
+  start = bench_now();
+  while (!heap_pop(&heap, &value))
+    sum += value;
+  snprintf(name, sizeof(name), "heap/%zu_ary/pop", arity);
+  bench_report(name, N, bench_now() - start);
+  bench_consume(sum);
+
+  heap_deinit(&heap);
+
+  Vector vec;
+  bench_check(!vector_init_with_capacity(&vec, sizeof(uint64_t), N),
+              "vector_init_with_capacity");
+  vector_append_many(&vec, values, N);
+  start = bench_now();
+  bench_check(!heap_init_from_vector(&heap, &vec, cmp_u64, arity),
+              "heap_init_from_vector");
+  snprintf(name, sizeof(name), "heap/%zu_ary/heapify", arity);
+  bench_report(name, N, bench_now() - start);
+  heap_deinit(&heap);
+}
+
+int main() {
+  uint64_t *values = malloc(N * sizeof(uint64_t));
+  bench_check(values != NULL, "malloc");
+  BenchRng rng = bench_rng_init(1);
+  for (size_t i = 0; i < N; i++)
+    values[i] = bench_rng_next(&rng);
+
+  run(2, values);
+  run(4, values);
+  run(8, values);
+
+  // What the heap replaces, sorting everything up front.
+  uint64_t *sorted = malloc(N * sizeof(uint64_t));
+  bench_check(sorted != NULL, "malloc");
+  memcpy(sorted, values, N * sizeof(uint64_t));
+  uint64_t start = bench_now();
+  qsort(sorted, N, sizeof(uint64_t), qsort_cmp);
+  bench_report("heap/qsort", N, bench_now() - start);
+  bench_consume(sorted[N / 2]);
+
+  free(sorted);
+  free(values);
+}
@@ -0,0 +1,82 @@
+/**
+ * hyperloglog.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/hash.h"
+#include "mylib/hash_set.h"
+#include "mylib/hyperloglog.h"
+#include <stdio.h>
+
+#define N 1000000
+
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+int main() {
+  uint64_t *keys = malloc(N * sizeof(uint64_t));
+  bench_check(keys != NULL, "malloc");
+  BenchRng rng = bench_rng_init(1);
+  for (size_t i = 0; i < N; i++)
+    keys[i] = bench_rng_next(&rng);
+
+  HyperLogLog hll;
+  bench_check(!hyperloglog_init(&hll, 14), "hyperloglog_init");
+  uint64_t start = bench_now();
+  for (size_t i = 0; i < N; i++)
+    hyperloglog_add(&hll, &keys[i], sizeof(uint64_t));
+  bench_report("hyperloglog/add", N, bench_now() - start);
+  hyperloglog_deinit(&hll);
+
+  bench_check(!hyperloglog_init(&hll, 14), "hyperloglog_init");
+  start = bench_now();
+  hyperloglog_add_many(&hll, keys, sizeof(uint64_t), N);
+  bench_report("hyperloglog/add_many", N, bench_now() - start);
+
+  start = bench_now();
+  uint64_t estimate = hyperloglog_estimate(&hll);
+  bench_report("hyperloglog/estimate", 1, bench_now() - start);
+  printf("{\"name\":\"hyperloglog/error\",\"value\":%f}\n",
+         ((double)estimate - N) / N);
+
+  // What it replaces, counting exactly with a set.
+  HashSet set;
+  bench_check(!hash_set_init64(&set, hash_u64, eql_u64, sizeof(uint64_t)),
+              "hash_set_init64");
+  start = bench_now();
+  for (size_t i = 0; i < N; i++)
+    hash_set_insert(&set, &keys[i], NULL);
+  bench_report("hyperloglog/hash_set_insert", N, bench_now() - start);
+
+  printf("{\"name\":\"hyperloglog/bytes\",\"bytes\":%zu}\n",
+         hyperloglog_memory_usage(&hll));
+  printf("{\"name\":\"hyperloglog/hash_set_bytes\",\"bytes\":%zu}\n",
+         hash_set_memory_usage(&set));
+
+  hash_set_deinit(&set);
+  hyperloglog_deinit(&hll);
+  free(keys);
+}
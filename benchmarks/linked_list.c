@@ -0,0 +1,56 @@
+/**
+ * linked_list.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/linked_list.h"
+#include <assert.h>
+
+#define N 1000000
+#define PASSES 10
+
+int main() {
+  LinkedList list = linked_list_init();
+
+  uint64_t start = bench_now();
+  for (uint64_t i = 0; i < N; i++)
+    linked_list_prepend(&list, &i, sizeof(uint64_t));
+  bench_report("linked_list/prepend", N, bench_now() - start);
+
+  {
+    uint64_t sum = 0;
+    start = bench_now();
+    for (size_t pass = 0; pass < PASSES; pass++)
+      for (LinkedListNode *node = list.first; node; node = node->next)
+        sum += *(uint64_t *)node->data;
+    bench_report("linked_list/traverse", (size_t)N * PASSES,
+                 bench_now() - start);
+    bench_consume(sum);
+  }
+
+  start = bench_now();
+  LinkedListNode *node;
+  while ((node = linked_list_pop_first(&list)))
+    linked_list_node_deinit(node);
+  bench_report("linked_list/pop_first", N, bench_now() - start);
+
+  linked_list_deinit(&list);
+}
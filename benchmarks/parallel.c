@@ -0,0 +1,109 @@
+/**
+ * parallel.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/parallel.h"
+#include <stdio.h>
+
+#define N 10000000
+#define BITS (1 << 28)
+
+static void accumulate(void *ctx, void *result, const void *element) {
+  *(uint64_t *)result += *(const uint32_t *)element;
+}
+
+static void add(void *ctx, void *result, const void *partial) {
+  *(uint64_t *)result += *(const uint64_t *)partial;
+}
+
+static void square(void *ctx, const void *element, void *result) {
+  uint32_t value = *(const uint32_t *)element;
+  *(uint64_t *)result = (uint64_t)value * value;
+}
+
+// Each run doubles the workers up to twice the number of CPUs, against the
+// single threaded loop over the same data.
+int main() {
+  Vector vec;
+  bench_check(!vector_init_with_capacity(&vec, sizeof(uint32_t), N),
+              "vector_init_with_capacity");
+  BenchRng rng = bench_rng_init(1);
+  for (size_t i = 0; i < N; i++) {
+    uint32_t value = bench_rng_next(&rng);
+    vector_append(&vec, &value);
+  }
+
+  Bitset bs;
+  bench_check(!bitset_init(&bs, BITS), "bitset_init");
+  for (size_t i = 0; i < BITS; i += 3)
+    bitset_incl(&bs, i);
+
+  {
+    uint64_t sum = 0;
+    uint64_t start = bench_now();
+    for (size_t i = 0; i < N; i++)
+      sum += *(const uint32_t *)vector_get_const(&vec, i);
+    bench_report("parallel/vector_reduce/serial", N, bench_now() - start);
+    bench_consume(sum);
+
+    start = bench_now();
+    bench_consume(bitset_count(&bs));
+    bench_report("parallel/bitset_count/serial", BITS, bench_now() - start);
+  }
+
+  ThreadPool pool;
+  bench_check(!thread_pool_init(&pool, 0), "thread_pool_init");
+  size_t max_workers = thread_pool_worker_count(&pool) * 2;
+  thread_pool_deinit(&pool);
+
+  for (size_t workers = 1; workers <= max_workers; workers *= 2) {
+    bench_check(!thread_pool_init(&pool, workers), "thread_pool_init");
+    char name[64];
+
+    uint64_t zero = 0, sum;
+    uint64_t start = bench_now();
+    bench_check(!parallel_vector_reduce(&pool, &vec, accumulate, add, NULL,
+                                        &zero, &sum, sizeof(uint64_t)),
+                "parallel_vector_reduce");
+    snprintf(name, sizeof(name), "parallel/vector_reduce/%zu", workers);
+    bench_report(name, N, bench_now() - start);
+    bench_consume(sum);
+
+    Vector squares;
+    start = bench_now();
+    bench_check(!parallel_vector_map(&pool, &vec, &squares, sizeof(uint64_t),
+                                     square, NULL), "parallel_vector_map");
+    snprintf(name, sizeof(name), "parallel/vector_map/%zu", workers);
+    bench_report(name, N, bench_now() - start);
+    vector_deinit(&squares);
+
+    start = bench_now();
+    bench_consume(parallel_bitset_count(&pool, &bs));
+    snprintf(name, sizeof(name), "parallel/bitset_count/%zu", workers);
+    bench_report(name, BITS, bench_now() - start);
+
+    thread_pool_deinit(&pool);
+  }
+
+  bitset_deinit(&bs);
+  vector_deinit(&vec);
+}
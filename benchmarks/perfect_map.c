@@ -0,0 +1,93 @@
+/**
+ * perfect_map.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/hash.h"
+#include "mylib/hash_map.h"
+#include "mylib/perfect_map.h"
+#include <stdio.h>
+
+#define N 1000000
+#define LOOKUPS 1000000
+
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+int main() {
+  uint64_t *keys = malloc(N * sizeof(uint64_t));
+  uint64_t *values = malloc(N * sizeof(uint64_t));
+  size_t *queries = malloc(LOOKUPS * sizeof(size_t));
+  bench_check(keys && values && queries, "malloc");
+
+  BenchRng rng = bench_rng_init(1);
+  for (size_t i = 0; i < N; i++) {
+    keys[i] = bench_rng_next(&rng);
+    values[i] = i;
+  }
+  for (size_t i = 0; i < LOOKUPS; i++)
+    queries[i] = bench_rng_next(&rng) % N;
+
+  HashMap map;
+  bench_check(!hash_map_init64(&map, hash_u64, eql_u64, sizeof(uint64_t),
+                               sizeof(uint64_t)), "hash_map_init64");
+  for (size_t i = 0; i < N; i++)
+    hash_map_put(&map, &keys[i], &values[i]);
+
+  uint64_t sum = 0;
+  uint64_t start = bench_now();
+  for (size_t i = 0; i < LOOKUPS; i++)
+    sum += *(uint64_t *)hash_map_get_value(&map, &keys[queries[i]]);
+  bench_report("perfect_map/hash_map/get", LOOKUPS, bench_now() - start);
+  bench_consume(sum);
+
+  PerfectMap perfect;
+  start = bench_now();
+  bench_check(!perfect_map_build_from_hash_map(&perfect, &map),
+              "perfect_map_build_from_hash_map");
+  bench_report("perfect_map/build", N, bench_now() - start);
+
+  sum = 0;
+  start = bench_now();
+  for (size_t i = 0; i < LOOKUPS; i++)
+    sum += *(const uint64_t *)perfect_map_get(&perfect, &keys[queries[i]]);
+  bench_report("perfect_map/get", LOOKUPS, bench_now() - start);
+  bench_consume(sum);
+
+  size_t index_bytes = perfect.bucket_count * sizeof(uint16_t) +
+                       (perfect.table_size - perfect.count) * sizeof(uint32_t);
+  printf("{\"name\":\"perfect_map/index\",\"bits_per_key\":%.2f}\n",
+         index_bytes * 8.0 / N);
+  printf("{\"name\":\"perfect_map/memory\",\"bytes\":%zu,"
+         "\"hash_map_bytes\":%zu}\n",
+         perfect_map_memory_usage(&perfect), hash_map_memory_usage(&map));
+
+  perfect_map_deinit(&perfect);
+  hash_map_deinit(&map);
+  free(queries);
+  free(values);
+  free(keys);
+}
@@ -0,0 +1,124 @@
+/**
+ * string_map.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/hash.h"
+#include "mylib/hash_map.h"
+#include "mylib/string_map.h"
+#include <stdio.h>
+#include <string.h>
+
+#define N 10000
+#define LOOKUPS 1000000
+#define KEY_SIZE 32
+
+// The generic map with C string keys, as in tests/hash_map.c.
+static uint32_t hash_str(const void *key) {
+  const char *str = *(const char *const *)key;
+  return fnv1a_32_hash((const uint8_t *)str, strlen(str));
+}
+
+static int eql_str(const void *a, const void *b) {
+  return strcmp(*(const char *const *)a, *(const char *const *)b) == 0;
+}
+
+int main() {
+  // Label-like keys that share a long prefix.
+  char *keys = malloc(N * KEY_SIZE);
+  size_t *lengths = malloc(N * sizeof(size_t));
+  bench_check(keys && lengths, "malloc");
+  for (size_t i = 0; i < N; i++)
+    lengths[i] = snprintf(keys + i * KEY_SIZE, KEY_SIZE,
+                          "service.requests.latency.%zu", i);
+
+  size_t *queries = malloc(LOOKUPS * sizeof(size_t));
+  bench_check(queries != NULL, "malloc");
+  BenchRng rng = bench_rng_init(1);
+  for (size_t i = 0; i < LOOKUPS; i++)
+    queries[i] = bench_rng_next(&rng) % N;
+
+  {
+    HashMap map;
+    bench_check(!hash_map_init(&map, hash_str, eql_str, sizeof(char *),
+                               sizeof(size_t)), "hash_map_init");
+
+    uint64_t start = bench_now();
+    for (size_t i = 0; i < N; i++) {
+      char *key = keys + i * KEY_SIZE;
+      hash_map_put(&map, &key, &i);
+    }
+    bench_report("string_map/hash_map/put", N, bench_now() - start);
+
+    uint64_t sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < LOOKUPS; i++) {
+      char *key = keys + queries[i] * KEY_SIZE;
+      sum += *(size_t *)hash_map_get_value(&map, &key);
+    }
+    bench_report("string_map/hash_map/get", LOOKUPS, bench_now() - start);
+    bench_consume(sum);
+
+    hash_map_deinit(&map);
+  }
+
+  {
+    StringMap map;
+    bench_check(!string_map_init(&map, sizeof(size_t)), "string_map_init");
+
+    uint64_t start = bench_now();
+    for (size_t i = 0; i < N; i++)
+      string_map_put(&map, keys + i * KEY_SIZE, lengths[i], &i);
+    bench_report("string_map/put", N, bench_now() - start);
+
+    uint64_t sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < LOOKUPS; i++) {
+      size_t idx = queries[i];
+      sum += *(size_t *)string_map_get(&map, keys + idx * KEY_SIZE,
+                                       lengths[idx]);
+    }
+    bench_report("string_map/get", LOOKUPS, bench_now() - start);
+    bench_consume(sum);
+
+    string_map_deinit(&map);
+  }
+
+  {
+    StringInterner interner;
+    bench_check(!string_interner_init(&interner), "string_interner_init");
+
+    uint64_t start = bench_now();
+    for (size_t i = 0; i < LOOKUPS; i++) {
+      size_t idx = queries[i];
+      uint32_t id;
+      string_interner_intern(&interner, keys + idx * KEY_SIZE, lengths[idx],
+                             &id);
+    }
+    bench_report("string_map/intern", LOOKUPS, bench_now() - start);
+
+    string_interner_deinit(&interner);
+  }
+
+  free(queries);
+  free(lengths);
+  free(keys);
+}
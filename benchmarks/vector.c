@@ -0,0 +1,136 @@
+/**
+ * vector.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench.h"
+#include "mylib/vector.h"
+
+#define N 1000000
+#define N_SHIFTING 20000 // Inserting and deleting at the front is O(n).
+#define N_LARGE (1 << 23) // Big enough for random reads to miss the TLB.
+
+// Random reads over a large vector allocated with each policy.
+static void random_reads(AllocPolicy policy, const char *name) {
+  Vector vec;
+  bench_check(!vector_init_with_policy(&vec, sizeof(uint64_t), N_LARGE, policy),
+              "vector_init_with_policy");
+  for (uint64_t i = 0; i < N_LARGE; i++)
+    vector_append(&vec, &i);
+
+  BenchRng rng = bench_rng_init(3);
+  uint64_t sum = 0;
+  uint64_t start = bench_now();
+  for (size_t i = 0; i < N_LARGE; i++) {
+    size_t idx = bench_rng_next(&rng) % N_LARGE;
+    sum += *(const uint64_t *)vector_get_const(&vec, idx);
+  }
+  bench_report(name, N_LARGE, bench_now() - start);
+  bench_consume(sum);
+
+  vector_deinit(&vec);
+}
+
+int main() {
+  Vector vec;
+  bench_check(!vector_init(&vec, sizeof(uint64_t)), "vector_init");
+
+  uint64_t start = bench_now();
+  for (uint64_t i = 0; i < N; i++)
+    vector_append(&vec, &i);
+  bench_report("vector/append", N, bench_now() - start);
+
+  {
+    uint64_t sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < N; i++)
+      sum += *(const uint64_t *)vector_get_const(&vec, i);
+    bench_report("vector/get/sequential", N, bench_now() - start);
+    bench_consume(sum);
+  }
+
+  {
+    BenchRng rng = bench_rng_init(1);
+    uint64_t sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < N; i++) {
+      size_t idx = bench_rng_next(&rng) % N;
+      sum += *(const uint64_t *)vector_get_const(&vec, idx);
+    }
+    bench_report("vector/get/random", N, bench_now() - start);
+    bench_consume(sum);
+  }
+
+  // Cloning a shared baseline then changing a few elements, copying it up
+  // front against sharing it until the first change.
+  {
+    Vector clone;
+    start = bench_now();
+    for (size_t i = 0; i < 100; i++) {
+      vector_clone(&vec, &clone);
+      vector_deinit(&clone);
+    }
+    bench_report("vector/clone", 100, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < 100; i++) {
+      vector_clone_cow(&vec, &clone);
+      vector_deinit(&clone);
+    }
+    bench_report("vector/clone_cow", 100, bench_now() - start);
+
+    uint64_t value = 0;
+    start = bench_now();
+    for (size_t i = 0; i < 100; i++) {
+      vector_clone_cow(&vec, &clone);
+      vector_assign(&clone, i, &value);
+      vector_deinit(&clone);
+    }
+    bench_report("vector/clone_cow/assign", 100, bench_now() - start);
+  }
+
+  {
+    BenchRng rng = bench_rng_init(2);
+    start = bench_now();
+    for (size_t i = 0; i < N / 2; i++)
+      vector_swap_delete(&vec, bench_rng_next(&rng) % vector_len(&vec));
+    bench_report("vector/swap_delete/random", N / 2, bench_now() - start);
+  }
+
+  start = bench_now();
+  while (vector_len(&vec))
+    vector_delete(&vec, vector_len(&vec) - 1);
+  bench_report("vector/delete/back", N / 2, bench_now() - start);
+
+  start = bench_now();
+  for (uint64_t i = 0; i < N_SHIFTING; i++)
+    vector_insert(&vec, 0, &i);
+  bench_report("vector/insert/front", N_SHIFTING, bench_now() - start);
+
+  start = bench_now();
+  while (vector_len(&vec))
+    vector_delete(&vec, 0);
+  bench_report("vector/delete/front", N_SHIFTING, bench_now() - start);
+
+  vector_deinit(&vec);
+
+  random_reads(ALLOC_POLICY_DEFAULT, "vector/get/large/default");
+  random_reads(ALLOC_POLICY_HUGE, "vector/get/large/huge");
+}
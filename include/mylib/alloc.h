@@ -0,0 +1,83 @@
+/**
+ * mylib/alloc.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_ALLOC_H
+#define MYLIB_ALLOC_H
+
+#include <stdlib.h>
+
+// Every allocation the library makes goes through these functions. When the
+// library is built with the `enable-alloc-stats` option they also keep global
+// counters, memory from them must then only be released with alloc_free.
+typedef struct AllocStats {
+  size_t allocs; // Calls to alloc_malloc, alloc_calloc and alloc_realloc.
+  size_t frees;  // Calls to alloc_free with a pointer that wasn't NULL.
+  size_t bytes;  // Bytes currently allocated.
+  size_t peak;   // The highest `bytes` has been.
+  size_t total;  // Bytes allocated over all time.
+} AllocStats;
+
+void *alloc_malloc(size_t size);
+void *alloc_calloc(size_t count, size_t size);
+
+// Unlike realloc a `size` of 0 always frees `ptr` and returns NULL.
+void *alloc_realloc(void *ptr, size_t size);
+
+void alloc_free(void *ptr);
+
+// Containers whose storage is one large array, Vector, Bitset and the HashMap
+// buckets, can be given a policy for how that array is allocated. Big tables
+// that are read at random spend much of their time on TLB misses, which huge
+// pages cut down.
+typedef enum AllocPolicy {
+  // alloc_malloc and friends, no more than the alignment malloc gives.
+  ALLOC_POLICY_DEFAULT,
+  // Aligned to ALLOC_ALIGNMENT, a cache line, for SIMD loads.
+  ALLOC_POLICY_ALIGNED,
+  // Aligned, and from ALLOC_HUGE_THRESHOLD bytes up mapped on its own at a
+  // huge page boundary and advised to use transparent huge pages.
+  ALLOC_POLICY_HUGE,
+  // As ALLOC_POLICY_HUGE but first tries explicit pages from hugetlbfs, which
+  // must have been reserved through vm.nr_hugepages.
+  ALLOC_POLICY_HUGETLB,
+} AllocPolicy;
+
+#define ALLOC_ALIGNMENT 64
+#define ALLOC_HUGE_THRESHOLD (2 * 1024 * 1024)
+
+// Memory from these must be released with alloc_policy_free and the same
+// policy. Each huge policy falls back to the one before it when the system
+// has no huge pages to give. Mappings are counted in the stats too.
+void *alloc_policy_malloc(AllocPolicy policy, size_t size);
+void *alloc_policy_calloc(AllocPolicy policy, size_t count, size_t size);
+
+// As alloc_realloc, a `size` of 0 frees `ptr` and returns NULL.
+void *alloc_policy_realloc(AllocPolicy policy, void *ptr, size_t size);
+void alloc_policy_free(AllocPolicy policy, void *ptr);
+
+// Returns EXIT_FAILURE if the library was built without the counters.
+int alloc_stats(AllocStats *result);
+
+// Zeroes the counters apart from `bytes`, `peak` starts again from `bytes`.
+void alloc_stats_reset(void);
+
+#endif
@@ -23,19 +23,35 @@
 #ifndef MYLIB_BITSET_H
 #define MYLIB_BITSET_H
 
+#include "alloc.h"
 #include <stdint.h>
 #include <stdlib.h>
 
 typedef struct Bitset {
   uint8_t *bytes; // Allocated bytes.
   size_t max;
+  size_t *refs; // Set while `bytes` is shared with copy-on-write clones.
+  AllocPolicy policy; // How `bytes` is allocated.
 } Bitset;
 
 int bitset_init(Bitset *result, size_t max);
+
+// Allocates the bytes with `policy`, clones of the set keep it.
+int bitset_init_with_policy(Bitset *result, size_t max, AllocPolicy policy);
 void bitset_deinit(Bitset *bs);
 int bitset_clone(const Bitset *src, Bitset *result);
+
+// Shares the bytes of `src` with `result` in O(1), the first of the two to be
+// modified takes a copy of them.
+int bitset_clone_cow(Bitset *src, Bitset *result);
+
+// Gives `bs` its own copy of its bytes if they are shared with a clone. Every
+// function that modifies the set calls it, code that writes through `bytes`
+// directly must call it first.
+int bitset_unshare(Bitset *bs);
 size_t bitset_count(const Bitset *bs);
 size_t bitset_size_in_bytes(const Bitset *bs);
+size_t bitset_memory_usage(const Bitset *bs);
 void bitset_clear(Bitset *bs);
 int bitset_has(const Bitset *bs, size_t bit);
 int bitset_incl(Bitset *bs, size_t bit);
@@ -62,5 +78,6 @@ int bitset_intersects(const Bitset *a, const Bitset *b);
 int bitset_union(const Bitset *a, const Bitset *b, Bitset *result);
 int bitset_difference(const Bitset *a, const Bitset *b, Bitset *result);
 uint32_t bitset_hash(const void *bs);
+uint64_t bitset_hash64(const void *bs);
 
 #endif
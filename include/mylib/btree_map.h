@@ -0,0 +1,106 @@
+/**
+ * mylib/btree_map.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_BTREE_MAP_H
+#define MYLIB_BTREE_MAP_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Returns < 0, 0 or > 0 if `a` is less than, equal to or greater than `b`.
+typedef int32_t (*BTreeMapCmpFn)(const void *a, const void *b);
+
+// An ordered map stored as a B+ tree. Each node keeps its keys next to each
+// other so a search only touches a few cache lines, and the entries live in
+// the leaves, which are linked together for ordered iteration and range scans.
+// Keys and values are copied into the nodes.
+typedef struct BTreeMap {
+  size_t size;       // How many entries are in the map.
+  size_t key_size;   // Byte size of the key.
+  size_t value_size; // Byte size of the value, may be 0.
+  size_t order;      // The most keys a node holds.
+  size_t height;     // How many levels of branches are above the leaves.
+
+  struct BTreeNode *root;
+  struct BTreeNode *first; // The leftmost leaf.
+  struct BTreeNode *last;  // The rightmost leaf.
+
+  BTreeMapCmpFn cmp; // The comparator, NULL for uint64_t keys.
+} BTreeMap;
+
+typedef struct BTreeMapEntry {
+  const void *key;
+  void *value;
+} BTreeMapEntry;
+
+typedef struct BTreeMapIterator {
+  const BTreeMap *map;
+  struct BTreeNode *leaf; // Leaf of the next entry, NULL once done.
+  size_t idx;             // Index of the next entry in `leaf`.
+  const void *end;        // The iterator stops before this key if not NULL.
+  BTreeMapEntry entry;    // The entry last returned by btree_map_next.
+} BTreeMapIterator;
+
+// A NULL `cmp` compares the keys as uint64_t, which lets the search within a
+// node be a branchless scan the compiler can vectorise. `order` is the most
+// keys a node holds, 0 picks one that fills about 256 bytes with keys.
+int btree_map_init(BTreeMap *result, BTreeMapCmpFn cmp, size_t key_size,
+                   size_t value_size, size_t order);
+void btree_map_deinit(BTreeMap *map);
+void btree_map_clear(BTreeMap *map);
+size_t btree_map_count(const BTreeMap *map);
+
+// Inserts `key` or replaces its value. A NULL `value` leaves a new value
+// zeroed and an existing one unchanged.
+int btree_map_put(BTreeMap *map, const void *key, const void *value);
+void *btree_map_get(const BTreeMap *map, const void *key);
+int btree_map_has(const BTreeMap *map, const void *key);
+void btree_map_delete(BTreeMap *map, const void *key);
+
+// Builds the map from `count` keys in strictly ascending order, much faster
+// than putting them one at a time. `values` may be NULL to zero them. Fails if
+// the map isn't empty or the keys aren't sorted.
+int btree_map_bulk_load(BTreeMap *map, const void *keys, const void *values,
+                        size_t count);
+
+// The entry with the greatest key less than or equal to `key`. Returns
+// EXIT_FAILURE if there is none.
+int btree_map_floor(const BTreeMap *map, const void *key,
+                    BTreeMapEntry *result);
+
+// Iterators visit the entries in ascending order and are invalidated by any
+// change to the map.
+BTreeMapIterator btree_map_iter(const BTreeMap *map);
+
+// Starts at the first key greater than or equal to `key`.
+BTreeMapIterator btree_map_seek(const BTreeMap *map, const void *key);
+
+// Visits the keys from `start` up to but not including `end`. Either may be
+// NULL for no bound, `end` must stay valid while iterating.
+BTreeMapIterator btree_map_range(const BTreeMap *map, const void *start,
+                                 const void *end);
+
+const BTreeMapEntry *btree_map_next(BTreeMapIterator *iterator);
+
+size_t btree_map_memory_usage(const BTreeMap *map);
+
+#endif
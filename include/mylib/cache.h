@@ -0,0 +1,170 @@
+/**
+ * mylib/cache.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_CACHE_H
+#define MYLIB_CACHE_H
+
+#include "hash_map.h"
+#include "intrusive_list.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Passed as a TTL for an entry that never expires.
+#define CACHE_NO_TTL UINT64_MAX
+
+// Which entry is evicted when the cache is full.
+typedef enum CachePolicy {
+  // Least recently used, every get moves the entry to the front of a list.
+  CACHE_POLICY_LRU,
+  // CLOCK, a get only sets a referenced bit and eviction sweeps a hand around
+  // the entries clearing bits until it finds one that is unset. Close to LRU
+  // with cheaper hits.
+  CACHE_POLICY_CLOCK,
+} CachePolicy;
+
+typedef enum CacheEvictReason {
+  CACHE_EVICT_CAPACITY, // Removed to make room.
+  CACHE_EVICT_EXPIRED,  // Its TTL passed.
+} CacheEvictReason;
+
+// Called with an entry just before it is freed. `value` may be changed, e.g.
+// to free what it points to.
+typedef void (*CacheEvictFn)(const void *key, void *value,
+                             CacheEvictReason reason, void *ctx);
+
+// Nanoseconds from any fixed point, used for TTLs.
+typedef uint64_t (*CacheClockFn)(void);
+
+typedef struct CacheOptions {
+  CachePolicy policy;
+  size_t max_entries; // 0 for no limit on the number of entries.
+  size_t max_bytes;   // 0 for no limit on the total charge of the entries.
+  uint64_t ttl_ns;    // TTL for cache_put, 0 for no TTL.
+  CacheEvictFn on_evict; // May be NULL.
+  void *ctx;             // Passed to on_evict.
+  CacheClockFn now;      // NULL uses CLOCK_MONOTONIC.
+  int measure_latency;   // Time every get and put, costs two clock reads.
+} CacheOptions;
+
+typedef struct CacheStats {
+  // Filled in by cache_stats from the current state of the cache.
+  size_t size;
+  size_t bytes;
+
+  // The hit ratio is hits / (hits + misses).
+  size_t hits;
+  size_t misses; // Including gets of expired entries.
+  size_t inserts;
+  size_t evictions;
+  size_t expirations;
+  // Total time spent in get and put, only with measure_latency.
+  uint64_t get_ns;
+  uint64_t put_ns;
+} CacheStats;
+
+// A bounded map from keys to fixed size values with O(1) get, put and
+// eviction. Each entry is a single allocation holding the list link, key and
+// value, indexed by a HashMap that borrows the key and entry. Not thread safe,
+// see ShardedCache.
+typedef struct Cache {
+  size_t key_size;
+  size_t value_size;
+  size_t bytes; // Total charge of the entries.
+  CacheOptions options;
+
+  HashMap map;          // Key to entry.
+  IntrusiveList list;   // LRU, most recent first. CLOCK, the ring of entries.
+  IntrusiveListLink *hand; // CLOCK, the next entry to look at or NULL.
+  CacheStats stats;     // Only the counters are kept up to date.
+} Cache;
+
+// The cache points to itself so it can't be moved once initialized. `options`
+// may be NULL for an unbounded LRU cache with no TTL.
+int cache_init(Cache *result, HashMapHash64Fn hash, HashMapEqlFn eql,
+               size_t key_size, size_t value_size,
+               const CacheOptions *options);
+
+// Frees every entry without calling on_evict.
+void cache_deinit(Cache *cache);
+void cache_clear(Cache *cache);
+
+size_t cache_count(const Cache *cache);
+
+// Returns the value of `key` and marks it as used, or NULL if it is missing or
+// has expired. The pointer is valid until the next put, delete or get.
+void *cache_get(Cache *cache, const void *key);
+
+// Inserts `key` or replaces its value, with the default TTL and a charge of
+// key_size + value_size bytes. May evict other entries.
+int cache_put(Cache *cache, const void *key, const void *value);
+
+// Same as above with a TTL of its own, 0 for the default or CACHE_NO_TTL, and
+// a charge counted against max_bytes, 0 for the default. An entry charged more
+// than max_bytes fails without changing the cache, a value already stored for
+// the key is kept.
+int cache_put_with(Cache *cache, const void *key, const void *value,
+                   uint64_t ttl_ns, size_t charge);
+
+// Removes `key` without calling on_evict.
+void cache_delete(Cache *cache, const void *key);
+
+int cache_stats(const Cache *cache, CacheStats *result);
+void cache_stats_reset(Cache *cache);
+
+size_t cache_memory_usage(const Cache *cache);
+
+typedef struct CacheShard {
+  pthread_mutex_t lock;
+  Cache cache;
+} CacheShard;
+
+// A Cache split into shards by hash, each behind its own mutex, so threads
+// touching different keys rarely wait on each other. The limits in the
+// options are divided between the shards, on_evict is called with the
+// shard's lock held.
+typedef struct ShardedCache {
+  size_t shard_count; // Always a power of two.
+  CacheShard *shards;
+  HashMapHash64Fn hash;
+} ShardedCache;
+
+// `shard_count` is rounded up to a power of two, 0 for 16 shards.
+int sharded_cache_init(ShardedCache *result, HashMapHash64Fn hash,
+                       HashMapEqlFn eql, size_t key_size, size_t value_size,
+                       size_t shard_count, const CacheOptions *options);
+void sharded_cache_deinit(ShardedCache *cache);
+
+size_t sharded_cache_count(ShardedCache *cache);
+
+// Copies the value of `key` into `value` and returns 1, or returns 0 if it is
+// missing or has expired.
+int sharded_cache_get(ShardedCache *cache, const void *key, void *value);
+int sharded_cache_put(ShardedCache *cache, const void *key, const void *value);
+int sharded_cache_put_with(ShardedCache *cache, const void *key,
+                           const void *value, uint64_t ttl_ns, size_t charge);
+void sharded_cache_delete(ShardedCache *cache, const void *key);
+
+// The sum of the stats of every shard.
+int sharded_cache_stats(ShardedCache *cache, CacheStats *result);
+
+#endif
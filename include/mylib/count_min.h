@@ -0,0 +1,95 @@
+/**
+ * mylib/count_min.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_COUNT_MIN_H
+#define MYLIB_COUNT_MIN_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define COUNT_MIN_MAX_DEPTH 32
+
+typedef enum CountMinKind {
+  // Each row adds to one counter and an estimate is the smallest of them. With
+  // only positive counts it never under-estimates, and over-estimates by at
+  // most epsilon * total with probability 1 - delta.
+  COUNT_MIN_SKETCH,
+  // The Count sketch, each row adds or subtracts by a sign picked by the hash
+  // and an estimate is the median. The estimate is unbiased and counts may be
+  // negative, but it can be too low as well as too high.
+  COUNT_MIN_COUNT_SKETCH,
+} CountMinKind;
+
+// Estimates how often each key was added in `depth` rows of `width` counters,
+// a fixed amount of memory however many keys there are. The heavy hitters are
+// the keys whose estimate is a large part of the total.
+typedef struct CountMin {
+  size_t width;
+  size_t depth;
+  CountMinKind kind;
+  int64_t total;     // Sum of every count added.
+  int64_t *counters; // `depth` rows of `width` counters.
+} CountMin;
+
+// Fails if `depth` is more than COUNT_MIN_MAX_DEPTH.
+int count_min_init(CountMin *result, size_t width, size_t depth,
+                   CountMinKind kind);
+
+// Picks a width of e / epsilon and a depth of ln(1 / delta), the standard
+// bounds for COUNT_MIN_SKETCH.
+int count_min_init_with_error(CountMin *result, double epsilon, double delta,
+                              CountMinKind kind);
+
+void count_min_deinit(CountMin *cm);
+void count_min_clear(CountMin *cm);
+
+// Keys are hashed with xxh64_hash and a seed of 0. Any other good 64-bit hash
+// can be used directly, as long as every sketch to be merged uses the same.
+void count_min_add(CountMin *cm, const void *key, size_t size, int64_t count);
+void count_min_add_hash(CountMin *cm, uint64_t hash, int64_t count);
+
+// Adds `count` keys of `key_size` bytes each, stored back to back in `keys`,
+// once each. The counters for a batch are prefetched before they're updated.
+void count_min_add_many(CountMin *cm, const void *keys, size_t key_size,
+                        size_t count);
+void count_min_add_hashes(CountMin *cm, const uint64_t *hashes, size_t count);
+
+int64_t count_min_estimate(const CountMin *cm, const void *key, size_t size);
+int64_t count_min_estimate_hash(const CountMin *cm, uint64_t hash);
+
+// Adds every count of `src` to `dst`. Fails unless both have the same width,
+// depth and kind.
+int count_min_merge(CountMin *dst, const CountMin *src);
+
+size_t count_min_memory_usage(const CountMin *cm);
+
+// The sketch is written as a header and then its counters, in the byte order
+// of the machine.
+size_t count_min_serialized_size(const CountMin *cm);
+
+// Fails if `size` is less than count_min_serialized_size.
+int count_min_serialize(const CountMin *cm, void *buffer, size_t size);
+
+// Fails if `buffer` doesn't hold a valid sketch of exactly `size` bytes.
+int count_min_deserialize(CountMin *result, const void *buffer, size_t size);
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * mylib/deque.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_DEQUE_H
+#define MYLIB_DEQUE_H
+
+#include <stdlib.h>
+
+// A growable ring buffer, elements are stored inline in `data` the same way as
+// they are in a Vector. The capacity is always a power of two so that indices
+// can wrap with a mask instead of a division.
+typedef struct Deque {
+  size_t head;     // Index in `data` of the first element.
+  size_t size;     // How many elements are in the deque.
+  size_t capacity; // How many elements fit in `data`, always a power of two.
+  size_t element_size;
+
+  void *data;
+} Deque;
+
+int deque_init_with_capacity(Deque *result, size_t element_size,
+                             size_t capacity);
+int deque_init(Deque *result, size_t element_size);
+void deque_deinit(Deque *deque);
+size_t deque_len(const Deque *deque);
+size_t deque_memory_usage(const Deque *deque);
+int deque_push_back(Deque *deque, void *element);
+int deque_push_front(Deque *deque, void *element);
+
+// Removes the last element, copying it into `result` if it is not NULL.
+// Returns EXIT_FAILURE if the deque is empty.
+int deque_pop_back(Deque *deque, void *result);
+
+// Removes the first element, copying it into `result` if it is not NULL.
+// Returns EXIT_FAILURE if the deque is empty.
+int deque_pop_front(Deque *deque, void *result);
+
+int deque_assign(Deque *deque, size_t idx, void *element);
+void *deque_get(Deque *deque, size_t idx);
+const void *deque_get_const(const Deque *deque, size_t idx);
+void deque_clear(Deque *deque);
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * mylib/doubly_linked_list.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_DOUBLY_LINKED_LIST_H
+#define MYLIB_DOUBLY_LINKED_LIST_H
+
+#include <stdlib.h>
+
+typedef struct DoublyLinkedListNode {
+  void *data;
+  struct DoublyLinkedListNode *prev;
+  struct DoublyLinkedListNode *next;
+} DoublyLinkedListNode;
+
+typedef struct DoublyLinkedList {
+  DoublyLinkedListNode *first; // Pointer to the first node in the list.
+  DoublyLinkedListNode *last;  // Pointer to the last node in the list.
+  size_t size;                 // How many nodes are in the list.
+} DoublyLinkedList;
+
+DoublyLinkedListNode *doubly_linked_list_node_init(void *data,
+                                                   size_t element_size);
+
+void doubly_linked_list_node_deinit(DoublyLinkedListNode *node);
+
+DoublyLinkedList doubly_linked_list_init();
+
+size_t doubly_linked_list_len(const DoublyLinkedList *list);
+
+// Assumes every node was allocated with `element_size` bytes of data.
+size_t doubly_linked_list_memory_usage(const DoublyLinkedList *list,
+                                       size_t element_size);
+
+DoublyLinkedListNode *doubly_linked_list_pop_first(DoublyLinkedList *list);
+
+DoublyLinkedListNode *doubly_linked_list_pop_last(DoublyLinkedList *list);
+
+void doubly_linked_list_clear(DoublyLinkedList *list);
+
+void doubly_linked_list_deinit(DoublyLinkedList *list);
+
+int doubly_linked_list_prepend_node(DoublyLinkedList *list,
+                                    DoublyLinkedListNode *node);
+
+int doubly_linked_list_prepend(DoublyLinkedList *list, void *data,
+                               size_t element_size);
+
+int doubly_linked_list_append_node(DoublyLinkedList *list,
+                                   DoublyLinkedListNode *node);
+
+int doubly_linked_list_append(DoublyLinkedList *list, void *data,
+                              size_t element_size);
+
+int doubly_linked_list_insert_node_after(DoublyLinkedList *list,
+                                         DoublyLinkedListNode *node,
+                                         DoublyLinkedListNode *new_node);
+
+int doubly_linked_list_insert_after(DoublyLinkedList *list,
+                                    DoublyLinkedListNode *node, void *data,
+                                    size_t element_size);
+
+// Unlinks `node` from the list without deinitializing it.
+void doubly_linked_list_unlink(DoublyLinkedList *list,
+                               DoublyLinkedListNode *node);
+
+// Unlinks and deinitializes `node`.
+void doubly_linked_list_delete(DoublyLinkedList *list,
+                               DoublyLinkedListNode *node);
+
+// Moves every node in `other` to the end of `list`, leaving `other` empty.
+void doubly_linked_list_splice(DoublyLinkedList *list,
+                               DoublyLinkedList *other);
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * mylib/hamt.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_HAMT_H
+#define MYLIB_HAMT_H
+
+#include "hash_map.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// A persistent map stored as a hash array mapped trie, in the CHAMP layout:
+// each node has a 32-bit bitmap of entries stored inline and one of children,
+// indexed by 5 bits of the key's hash per level.
+//
+// Nodes are reference counted and shared between maps. A snapshot only takes
+// another reference to the root, so it is O(1), and a put or delete copies the
+// O(log32 n) nodes on the path to the key that are shared with a snapshot.
+// Nodes that aren't shared are changed in place, so a batch of edits between
+// snapshots costs about the same as on a mutable map.
+//
+// A map may only be used by one thread at a time, but every snapshot is a map
+// of its own that can be handed to another thread and read, or changed, while
+// the original keeps changing.
+typedef struct Hamt {
+  size_t size;       // How many entries are in the map.
+  size_t key_size;   // Byte size of the key.
+  size_t value_size; // Byte size of the value.
+  size_t entry_size; // Byte size of a hash, key and value inline in a node.
+  struct HamtNode *root;
+
+  HashMapHashFn hash;     // The 32-bit hash function, or NULL.
+  HashMapHash64Fn hash64; // The 64-bit hash function, or NULL.
+  HashMapEqlFn eql;       // The eql function.
+} Hamt;
+
+typedef struct HamtEntry {
+  const void *key;
+  const void *value;
+} HamtEntry;
+
+// Deep enough for every level of a 64-bit hash and a collision node.
+#define HAMT_MAX_DEPTH 16
+
+typedef struct HamtIterator {
+  const Hamt *map;
+  const struct HamtNode *nodes[HAMT_MAX_DEPTH];
+  uint32_t idx[HAMT_MAX_DEPTH]; // The next entry or child in each node.
+  int depth;                    // -1 once the iterator is done.
+  HamtEntry entry;              // The entry last returned by hamt_next.
+} HamtIterator;
+
+int hamt_init(Hamt *result, HashMapHashFn hash, HashMapEqlFn eql,
+              size_t key_size, size_t value_size);
+int hamt_init64(Hamt *result, HashMapHash64Fn hash, HashMapEqlFn eql,
+                size_t key_size, size_t value_size);
+
+// Drops this map's reference to its nodes, freeing those no snapshot shares.
+void hamt_deinit(Hamt *map);
+void hamt_clear(Hamt *map);
+
+// Initializes `result` as a map with the same entries as `map` in O(1). Either
+// map can be changed afterwards without affecting the other.
+void hamt_snapshot(const Hamt *map, Hamt *result);
+
+size_t hamt_count(const Hamt *map);
+
+// The value is shared with snapshots, so it must not be written through.
+const void *hamt_get(const Hamt *map, const void *key);
+int hamt_has(const Hamt *map, const void *key);
+
+// Inserts `key` or replaces its value.
+int hamt_put(Hamt *map, const void *key, const void *value);
+
+// Can fail as removing a key may copy nodes shared with a snapshot.
+int hamt_delete(Hamt *map, const void *key);
+
+// Bytes of every node reachable from the map, including ones shared with
+// snapshots.
+size_t hamt_memory_usage(const Hamt *map);
+
+HamtIterator hamt_iter(const Hamt *map);
+const HamtEntry *hamt_next(HamtIterator *iterator);
+
+#endif
@@ -23,11 +23,48 @@
 #ifndef MYLIB_HASH_H
 #define MYLIB_HASH_H
 
+#include "vector.h"
 #include <stddef.h>
 #include <stdint.h>
 
+// FNV-1a, one byte per step. Simple and fine for short keys.
+
 uint32_t fnv1a_32_init();
 void fnv1a_32_update(uint32_t *val, const uint8_t *arr, size_t size);
 uint32_t fnv1a_32_hash(const uint8_t *arr, size_t size);
 
+// Hashes `count` keys of `key_size` bytes each, stored back to back in `keys`,
+// into the `result` array. The results are the same as calling fnv1a_32_hash on
+// each key, on x86-64 CPUs with AVX2 8 keys are hashed at once.
+void fnv1a_32_hash_batch(const uint8_t *keys, size_t key_size, size_t count,
+                         uint32_t *result);
+
+// Same as above for every element of `keys`.
+void fnv1a_32_hash_vector(const Vector *keys, uint32_t *result);
+
+uint64_t fnv1a_64_init();
+void fnv1a_64_update(uint64_t *val, const uint8_t *arr, size_t size);
+uint64_t fnv1a_64_hash(const uint8_t *arr, size_t size);
+
+// Seeded variants mix the seed into the initial state. They make collisions
+// harder to precompute, but for keys chosen by an attacker prefer xxh64 with a
+// secret seed.
+uint32_t fnv1a_32_init_seeded(uint32_t seed);
+uint64_t fnv1a_64_init_seeded(uint64_t seed);
+
+// xxHash64, consumes 32 bytes per step and is much faster than FNV-1a for
+// anything but the shortest keys. Hashes are stable across platforms.
+typedef struct Xxh64State {
+  uint64_t acc[4];     // Accumulators for each 8 byte lane of a stripe.
+  uint64_t seed;
+  uint64_t total_size; // How many bytes have been hashed.
+  uint8_t buffer[32];  // Bytes that don't yet fill a stripe.
+  size_t buffer_size;
+} Xxh64State;
+
+Xxh64State xxh64_init(uint64_t seed);
+void xxh64_update(Xxh64State *state, const uint8_t *arr, size_t size);
+uint64_t xxh64_final(const Xxh64State *state);
+uint64_t xxh64_hash(const uint8_t *arr, size_t size, uint64_t seed);
+
 #endif
@@ -23,27 +23,91 @@
 #ifndef MYLIB_HASHMAP_H
 #define MYLIB_HASHMAP_H
 
+#include "alloc.h"
 #include "linked_list.h"
 #include <stdint.h>
 #include <stdlib.h>
 
 typedef uint32_t (*HashMapHashFn)(const void *key);
+typedef uint64_t (*HashMapHash64Fn)(const void *key);
 typedef int32_t (*HashMapEqlFn)(const void *a, const void *b);
 
+// How a hash is turned into a bucket index.
+typedef enum HashMapIndexing {
+  // Lemire's fastrange, the high bits of `hash * capacity`. One multiply and
+  // any capacity, but it relies on the high bits of the hash being good.
+  HASH_MAP_INDEX_FASTRANGE,
+  // Mixes the hash with a finalizer and masks the low bits. Costs a little
+  // more but copes with weak hashes, the capacity is a power of two.
+  HASH_MAP_INDEX_MASK,
+} HashMapIndexing;
+
+// Where the map keeps keys and values, and who owns them.
+typedef enum HashMapStorage {
+  // Keys and values are copied into allocations of their own, which the map
+  // owns and frees. The caller's key and value may be reused straight away.
+  HASH_MAP_STORE_COPY,
+  // Only the caller's pointers are stored, nothing is copied or freed. The
+  // key and value must stay valid, and the key unchanged, for as long as they
+  // are in the map. key_size and value_size are ignored.
+  HASH_MAP_STORE_BORROW,
+  // Keys and values are copied into the same allocation as the kv, saving two
+  // allocations per entry, each aligned to 16 bytes. The map owns them, as
+  // with HASH_MAP_STORE_COPY.
+  HASH_MAP_STORE_INLINE,
+} HashMapStorage;
+
+typedef struct HashMapOptions {
+  HashMapIndexing indexing;
+  HashMapStorage storage;
+  size_t initial_capacity; // 0 uses the default capacity.
+  AllocPolicy bucket_policy; // How the array of buckets is allocated.
+} HashMapOptions;
+
 typedef struct HashMapKV {
   void *key;
   void *value;
+  uint64_t hash; // Hash of the key, compared before calling eql.
 } HashMapKV;
 
+// Chains of this many nodes or more share the last slot of a histogram.
+#define HASH_MAP_STATS_HISTOGRAM_SIZE 16
+
+typedef struct HashMapStats {
+  // Filled in by hash_map_stats from the current state of the map.
+  size_t size;
+  size_t capacity;
+  size_t max_chain; // Length of the longest bucket.
+  // How many buckets hold each number of nodes, index 0 is the empty buckets.
+  size_t chain_histogram[HASH_MAP_STATS_HISTOGRAM_SIZE];
+
+  // Counters, these are only recorded when the library is built with
+  // MYLIB_HASH_MAP_STATS defined and are zero otherwise.
+  size_t lookups;   // Every get, has, put, get_or_put and delete.
+  size_t eql_calls; // Divide by lookups for the eql calls per lookup.
+  // How many lookups walked each number of nodes before finishing.
+  size_t probe_histogram[HASH_MAP_STATS_HISTOGRAM_SIZE];
+  size_t resizes;
+  uint64_t resize_ns;     // Total time spent in resize.
+  size_t bytes_allocated; // Total bytes ever allocated by the map.
+  size_t bytes_in_use;    // Bytes currently allocated by the map.
+} HashMapStats;
+
 typedef struct HashMap {
   size_t size;         // How many entries are in the map.
   size_t capacity;     // How many buckets are allocated.
   size_t key_size;     // Byte size of the key.
   size_t value_size;   // Byte size of the value.
   LinkedList *buckets; // Array of linked_list to avoid collisions.
+  HashMapOptions options;
+
+  HashMapHashFn hash;     // The 32-bit hash function, or NULL.
+  HashMapHash64Fn hash64; // The 64-bit hash function, or NULL.
+  HashMapEqlFn eql;       // The eql function.
 
-  HashMapHashFn hash; // The hash function.
-  HashMapEqlFn eql;   // The eql function.
+#ifdef MYLIB_HASH_MAP_STATS
+  HashMapStats stats; // Only the counters are kept up to date.
+#endif
 } HashMap;
 
 typedef struct HashMapIterator {
@@ -55,12 +119,30 @@ typedef struct HashMapIterator {
 int hash_map_init(HashMap *result, HashMapHashFn hash, HashMapEqlFn eql,
                   size_t key_size, size_t value_size);
 
+// Prefer a 64-bit hash for large maps so that the hash has enough bits to
+// spread the keys over the buckets.
+int hash_map_init64(HashMap *result, HashMapHash64Fn hash, HashMapEqlFn eql,
+                    size_t key_size, size_t value_size);
+
+// `options` may be NULL to use the defaults, which are what the other init
+// functions use.
+int hash_map_init_with_options(HashMap *result, HashMapHash64Fn hash,
+                               HashMapEqlFn eql, size_t key_size,
+                               size_t value_size,
+                               const HashMapOptions *options);
+
 void hash_map_deinit(HashMap *map);
 
 void hash_map_clear(HashMap *map);
 
 size_t hash_map_count(const HashMap *map);
 
+// The buckets array plus, for every entry, its node, kv, key and value.
+size_t hash_map_memory_usage(const HashMap *map);
+
+// Inserts `key` or, if it is already in the map, replaces its value. Copied
+// values are written over the old value in place, borrowed ones replace the
+// stored pointer and the key the map was first given is kept.
 int hash_map_put(HashMap *map, void *key, void *value);
 
 const HashMapKV *hash_map_get_or_put(HashMap *map, void *key,
@@ -73,8 +155,17 @@ int hash_map_has(const HashMap *map, const void *key);
 
 void hash_map_delete(HashMap *map, const void *key);
 
+// Copies `value` into the kv, or stores the pointer when values are borrowed.
 void hash_map_kv_assign(HashMap *map, const HashMapKV *kv, void *value);
 
+// Fills `result` with the shape of the map and, when the library was built
+// with the `enable-hash-map-stats` option, the counters recorded since init or
+// the last reset. Walks every bucket so it is O(capacity + size).
+int hash_map_stats(const HashMap *map, HashMapStats *result);
+
+// Zeroes the counters, bytes_in_use is kept as it describes the current map.
+void hash_map_stats_reset(HashMap *map);
+
 HashMapIterator hash_map_iter(const HashMap *map);
 
 HashMapKV *hash_map_next(HashMapIterator *iterator);
@@ -0,0 +1,81 @@
+/**
+ * mylib/hash_set.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_HASH_SET_H
+#define MYLIB_HASH_SET_H
+
+#include "hash_map.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// A set of keys stored by value in one flat array of slots, with a control
+// byte per slot holding 7 bits of the key's hash so most probes are rejected
+// without calling eql. There are no per-key allocations. Takes the same hash
+// and eql callbacks as HashMap.
+typedef struct HashSet {
+  size_t size;       // How many keys are in the set.
+  size_t capacity;   // How many slots there are, always a power of two.
+  size_t tombstones; // How many slots are deleted.
+  size_t key_size;   // Byte size of the key.
+  uint8_t *ctrl;     // A control byte for each slot.
+  void *keys;        // `capacity` keys.
+
+  HashMapHashFn hash;     // The 32-bit hash function, or NULL.
+  HashMapHash64Fn hash64; // The 64-bit hash function, or NULL.
+  HashMapEqlFn eql;       // The eql function.
+} HashSet;
+
+typedef struct HashSetIterator {
+  const HashSet *set;
+  size_t idx; // The next slot to look at.
+} HashSetIterator;
+
+int hash_set_init(HashSet *result, HashMapHashFn hash, HashMapEqlFn eql,
+                  size_t key_size);
+int hash_set_init64(HashSet *result, HashMapHash64Fn hash, HashMapEqlFn eql,
+                    size_t key_size);
+int hash_set_clone(const HashSet *src, HashSet *result);
+void hash_set_deinit(HashSet *set);
+void hash_set_clear(HashSet *set);
+size_t hash_set_count(const HashSet *set);
+
+// Makes room for `count` keys in total without growing again.
+int hash_set_reserve(HashSet *set, size_t count);
+
+// Copies `key` into the set. `has_existing` may be NULL, otherwise it is set
+// to whether the key was already in the set.
+int hash_set_insert(HashSet *set, const void *key, int *has_existing);
+int hash_set_contains(const HashSet *set, const void *key);
+void hash_set_remove(HashSet *set, const void *key);
+
+// Each of these initializes `result`, both sets must hold the same kind of key
+// with the same callbacks.
+int hash_set_union(const HashSet *a, const HashSet *b, HashSet *result);
+int hash_set_intersect(const HashSet *a, const HashSet *b, HashSet *result);
+int hash_set_difference(const HashSet *a, const HashSet *b, HashSet *result);
+
+HashSetIterator hash_set_iter(const HashSet *set);
+const void *hash_set_next(HashSetIterator *iterator);
+
+size_t hash_set_memory_usage(const HashSet *set);
+
+#endif
@@ -0,0 +1,111 @@
+/**
+ * mylib/heap.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_HEAP_H
+#define MYLIB_HEAP_H
+
+#include "vector.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// Returns < 0 if `a` should come out of the heap before `b`, so comparing in
+// ascending order gives a min-heap.
+typedef int32_t (*HeapCmpFn)(const void *a, const void *b);
+
+// A d-ary heap stored in a Vector. With 4 children a node's children usually
+// share a cache line and the tree is half as deep as a binary heap, so pops
+// touch fewer lines at the cost of a few more compares per level. Elements are
+// moved into a hole rather than swapped.
+typedef struct Heap {
+  Vector vec;
+  size_t arity; // Children per node.
+  HeapCmpFn cmp;
+  void *tmp; // One element, holds the element being moved.
+} Heap;
+
+// `arity` is the number of children per node, 0 for 4.
+int heap_init(Heap *result, size_t element_size, HeapCmpFn cmp, size_t arity);
+
+// Takes over the storage of `vec` and orders it into a heap in O(n), `vec`
+// must not be used afterwards.
+int heap_init_from_vector(Heap *result, Vector *vec, HeapCmpFn cmp,
+                          size_t arity);
+
+void heap_deinit(Heap *heap);
+void heap_clear(Heap *heap);
+size_t heap_len(const Heap *heap);
+size_t heap_memory_usage(const Heap *heap);
+
+int heap_push(Heap *heap, const void *element);
+
+// Returns NULL when the heap is empty.
+const void *heap_peek(const Heap *heap);
+
+// Returns EXIT_FAILURE if the heap is empty.
+int heap_pop(Heap *heap, void *result);
+
+// Pops the top into `result` and pushes `element` with a single sift, e.g. to
+// keep the K largest values in a min-heap of K. Returns EXIT_FAILURE if the
+// heap is empty.
+int heap_replace(Heap *heap, const void *element, void *result);
+
+// A d-ary heap whose elements are known by an id, so their priority can be
+// changed or they can be removed while in the heap. Ids index an array of
+// positions, so they should be small and dense, e.g. task or vertex numbers.
+typedef struct IndexedHeap {
+  Vector slots;     // Each slot is a size_t id followed by the element.
+  Vector positions; // The slot of each id, or SIZE_MAX if it isn't in the heap.
+  size_t element_size;
+  size_t arity;
+  HeapCmpFn cmp;
+  void *tmp; // One slot.
+} IndexedHeap;
+
+int indexed_heap_init(IndexedHeap *result, size_t element_size, HeapCmpFn cmp,
+                      size_t arity);
+void indexed_heap_deinit(IndexedHeap *heap);
+void indexed_heap_clear(IndexedHeap *heap);
+size_t indexed_heap_len(const IndexedHeap *heap);
+size_t indexed_heap_memory_usage(const IndexedHeap *heap);
+
+// Returns EXIT_FAILURE if `id` is already in the heap.
+int indexed_heap_push(IndexedHeap *heap, size_t id, const void *element);
+
+int indexed_heap_contains(const IndexedHeap *heap, size_t id);
+
+// Returns the element of `id`, or NULL if it isn't in the heap.
+const void *indexed_heap_get(const IndexedHeap *heap, size_t id);
+
+// Replaces the element of `id` and moves it up or down to match, so this is
+// both decrease-key and increase-key. Returns EXIT_FAILURE if `id` isn't in the
+// heap.
+int indexed_heap_update(IndexedHeap *heap, size_t id, const void *element);
+
+// Returns NULL when the heap is empty, `id` may be NULL.
+const void *indexed_heap_peek(const IndexedHeap *heap, size_t *id);
+
+// Returns EXIT_FAILURE if the heap is empty, `id` and `result` may be NULL.
+int indexed_heap_pop(IndexedHeap *heap, size_t *id, void *result);
+
+void indexed_heap_remove(IndexedHeap *heap, size_t id);
+
+#endif
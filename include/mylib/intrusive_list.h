@@ -0,0 +1,83 @@
+/**
+ * mylib/intrusive_list.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_INTRUSIVE_LIST_H
+#define MYLIB_INTRUSIVE_LIST_H
+
+#include <stddef.h>
+
+// A doubly linked list of links embedded in the caller's own structs, the list
+// never allocates and never copies data. Get back to the containing struct of a
+// link with `intrusive_list_entry`:
+//
+//   typedef struct Job {
+//     int id;
+//     IntrusiveListLink link;
+//   } Job;
+//
+//   Job *job = intrusive_list_entry(intrusive_list_first(&list), Job, link);
+typedef struct IntrusiveListLink {
+  struct IntrusiveListLink *prev;
+  struct IntrusiveListLink *next;
+} IntrusiveListLink;
+
+typedef struct IntrusiveList {
+  // Sentinel link, `head.next` is the first link and `head.prev` is the last.
+  IntrusiveListLink head;
+  size_t size; // How many links are in the list.
+} IntrusiveList;
+
+#define intrusive_list_entry(link, type, member)                               \
+  ((type *)((char *)(link)-offsetof(type, member)))
+
+// The list points to itself so it can't be returned by value.
+void intrusive_list_init(IntrusiveList *list);
+
+size_t intrusive_list_len(const IntrusiveList *list);
+
+// Return NULL when the list is empty.
+IntrusiveListLink *intrusive_list_first(const IntrusiveList *list);
+IntrusiveListLink *intrusive_list_last(const IntrusiveList *list);
+
+// Return NULL at the end of the list.
+IntrusiveListLink *intrusive_list_next(const IntrusiveList *list,
+                                       const IntrusiveListLink *link);
+IntrusiveListLink *intrusive_list_prev(const IntrusiveList *list,
+                                       const IntrusiveListLink *link);
+
+void intrusive_list_prepend(IntrusiveList *list, IntrusiveListLink *link);
+void intrusive_list_append(IntrusiveList *list, IntrusiveListLink *link);
+void intrusive_list_insert_after(IntrusiveList *list, IntrusiveListLink *link,
+                                 IntrusiveListLink *new_link);
+void intrusive_list_insert_before(IntrusiveList *list, IntrusiveListLink *link,
+                                  IntrusiveListLink *new_link);
+
+// Unlinks `link`, which must be in `list`.
+void intrusive_list_remove(IntrusiveList *list, IntrusiveListLink *link);
+
+// Unlinks `link` and links it again as the first link in `list`.
+void intrusive_list_move_to_front(IntrusiveList *list, IntrusiveListLink *link);
+
+IntrusiveListLink *intrusive_list_pop_first(IntrusiveList *list);
+IntrusiveListLink *intrusive_list_pop_last(IntrusiveList *list);
+
+#endif
@@ -46,6 +46,10 @@ void linked_list_clear(LinkedList *list);
 
 void linked_list_deinit(LinkedList *list);
 
+// The list doesn't keep the size of its elements so it has to be passed in,
+// this walks every node.
+size_t linked_list_memory_usage(const LinkedList *list, size_t element_size);
+
 int linked_list_prepend_node(LinkedList *list, LinkedListNode *node);
 
 int linked_list_prepend(LinkedList *list, void *data, size_t element_size);
@@ -58,4 +62,8 @@ int linked_list_insert_after(LinkedList *list, LinkedListNode *node, void *data,
 
 void linked_list_delete(LinkedList *list, LinkedListNode *node);
 
+// Deletes the node after `prev`, or the first node if `prev` is NULL. Unlike
+// linked_list_delete this doesn't need to walk the list.
+void linked_list_delete_next(LinkedList *list, LinkedListNode *prev);
+
 #endif
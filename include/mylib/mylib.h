@@ -20,8 +20,25 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  */
+#include "alloc.h"
 #include "bitset.h"
+#include "btree_map.h"
+#include "cache.h"
+#include "count_min.h"
+#include "deque.h"
+#include "doubly_linked_list.h"
+#include "hamt.h"
 #include "hash.h"
 #include "hash_map.h"
+#include "hash_set.h"
+#include "heap.h"
+#include "hyperloglog.h"
+#include "intrusive_list.h"
 #include "linked_list.h"
+#include "parallel.h"
+#include "perfect_map.h"
+#include "queue.h"
+#include "string_map.h"
+#include "thread_pool.h"
+#include "unrolled_list.h"
 #include "vector.h"
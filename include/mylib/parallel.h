@@ -0,0 +1,93 @@
+/**
+ * mylib/parallel.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_PARALLEL_H
+#define MYLIB_PARALLEL_H
+
+#include "bitset.h"
+#include "hash_map.h"
+#include "thread_pool.h"
+#include "vector.h"
+#include <stdlib.h>
+
+// Data parallel loops on a ThreadPool. Ranges are split in half recursively,
+// one half spawned and the other kept, until they are no bigger than `grain`,
+// so idle workers steal the biggest pieces of work first. A grain of 0 picks
+// one that gives each worker about 8 pieces. The calling thread helps run the
+// loop and each call returns once every piece has finished.
+
+typedef void (*ParallelForFn)(void *ctx, size_t begin, size_t end);
+
+// Folds the indices in [begin, end) into `result`, which starts as a copy of
+// the identity.
+typedef void (*ParallelReduceFn)(void *ctx, size_t begin, size_t end,
+                                 void *result);
+
+// Folds `partial` into `result`. Partials are combined in index order, so it
+// only needs to be associative.
+typedef void (*ParallelCombineFn)(void *ctx, void *result, const void *partial);
+
+void parallel_for(ThreadPool *pool, size_t begin, size_t end, size_t grain,
+                  ParallelForFn fn, void *ctx);
+
+// Reduces each piece of [begin, end) on its own and then combines the results
+// into `result`, which is `result_size` bytes.
+int parallel_reduce(ThreadPool *pool, size_t begin, size_t end, size_t grain,
+                    ParallelReduceFn reduce, ParallelCombineFn combine,
+                    void *ctx, const void *identity, void *result,
+                    size_t result_size);
+
+typedef void (*ParallelMapFn)(void *ctx, const void *element, void *result);
+typedef int (*ParallelPredicateFn)(void *ctx, const void *element);
+typedef void (*ParallelAccumulateFn)(void *ctx, void *result,
+                                     const void *element);
+typedef void (*ParallelKVFn)(void *ctx, HashMapKV *kv);
+
+// Initializes `result` with `element_size` elements, one for each element of
+// `src` mapped by `fn`.
+int parallel_vector_map(ThreadPool *pool, const Vector *src, Vector *result,
+                        size_t element_size, ParallelMapFn fn, void *ctx);
+
+// Initializes `result` with the elements of `src` that `fn` returns nonzero
+// for, in the same order.
+int parallel_vector_filter(ThreadPool *pool, const Vector *src, Vector *result,
+                           ParallelPredicateFn fn, void *ctx);
+
+// Accumulates every element into a result per piece, then combines them.
+int parallel_vector_reduce(ThreadPool *pool, const Vector *vec,
+                           ParallelAccumulateFn accumulate,
+                           ParallelCombineFn combine, void *ctx,
+                           const void *identity, void *result,
+                           size_t result_size);
+
+size_t parallel_bitset_count(ThreadPool *pool, const Bitset *bs);
+
+// Initializes `result` the same as bitset_union.
+int parallel_bitset_union(ThreadPool *pool, const Bitset *a, const Bitset *b,
+                          Bitset *result);
+
+// Calls `fn` with every kv, split over the buckets. `fn` may change values but
+// not add or delete entries.
+void parallel_hash_map_for_each(ThreadPool *pool, const HashMap *map,
+                                ParallelKVFn fn, void *ctx);
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * mylib/perfect_map.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_PERFECT_MAP_H
+#define MYLIB_PERFECT_MAP_H
+
+#include "hash_map.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// An immutable map built once from a fixed set of keys, using a minimal
+// perfect hash in the style of PTHash. Keys are split into buckets and each
+// bucket stores a 16-bit pilot that moves its keys to slots no other key uses,
+// about 3 bits per key. A lookup hashes the key, reads one pilot and compares
+// the one key in its slot, there are no chains and no eql calls.
+//
+// Keys are hashed and compared by their `key_size` bytes, so they must not
+// contain pointers or padding that differs between equal keys.
+//
+// The whole map is one contiguous block in the same layout as its file, so a
+// written map is opened with mmap and used straight from the page cache.
+typedef struct PerfectMap {
+  size_t count;
+  size_t key_size;
+  size_t value_size;
+  size_t table_size;   // Slots the pilots can send a key to, at least count.
+  size_t bucket_count; // One pilot per bucket.
+  uint64_t seed;
+
+  const uint16_t *pilots;
+  const uint32_t *remap; // Slots past `count` moved to a free slot below it.
+  const uint8_t *keys;   // In slot order.
+  const uint8_t *values; // In slot order.
+
+  void *data;    // The block holding the header and every array.
+  size_t length; // Byte length of `data`.
+  int mapped;    // Whether `data` is a mapping of a file.
+} PerfectMap;
+
+// Builds the map from `count` keys and values laid out one after another.
+// Fails if a key is repeated or there are more than UINT32_MAX keys.
+int perfect_map_build(PerfectMap *result, const void *keys, const void *values,
+                      size_t count, size_t key_size, size_t value_size);
+
+// Builds the map from every entry of `map`, copying `map->key_size` bytes of
+// each key and `map->value_size` bytes of each value. Fails for a map in
+// HASH_MAP_STORE_BORROW mode, whose entries need not be that size.
+int perfect_map_build_from_hash_map(PerfectMap *result, const HashMap *map);
+
+void perfect_map_deinit(PerfectMap *map);
+
+size_t perfect_map_count(const PerfectMap *map);
+
+// Returns NULL if the key isn't in the map.
+const void *perfect_map_get(const PerfectMap *map, const void *key);
+int perfect_map_has(const PerfectMap *map, const void *key);
+
+// Writes the map to the file at `path`, creating or truncating it.
+int perfect_map_write(const PerfectMap *map, const char *path);
+
+// Maps a file written by perfect_map_write read-only without copying it. Fails
+// if the file isn't a map written on a machine with the same byte order.
+int perfect_map_open(PerfectMap *result, const char *path);
+
+// The bytes of the block, for a mapped map this is the length of the file.
+size_t perfect_map_memory_usage(const PerfectMap *map);
+
+#endif
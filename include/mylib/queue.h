@@ -0,0 +1,99 @@
+/**
+ * mylib/queue.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_QUEUE_H
+#define MYLIB_QUEUE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Bounded lock-free queues, elements are stored inline the same way as they
+// are in a Vector. Both queues round their capacity up to a power of two.
+
+#define QUEUE_CACHE_LINE_SIZE 64
+
+// Single-producer/single-consumer queue. Exactly one thread may push and
+// exactly one thread may pop at any time.
+typedef struct SpscQueue {
+  // Written by the consumer.
+  size_t head;        // Index of the next element to pop.
+  size_t cached_tail; // Consumer's last seen value of `tail`.
+  // Keep the consumer and producer fields on separate cache lines.
+  uint8_t pad0[QUEUE_CACHE_LINE_SIZE - 2 * sizeof(size_t)];
+
+  // Written by the producer.
+  size_t tail;        // Index one past the last published element.
+  size_t cached_head; // Producer's last seen value of `head`.
+  uint8_t pad1[QUEUE_CACHE_LINE_SIZE - 2 * sizeof(size_t)];
+
+  size_t capacity;
+  size_t element_size;
+  void *data;
+} SpscQueue;
+
+int spsc_queue_init(SpscQueue *result, size_t element_size, size_t capacity);
+void spsc_queue_deinit(SpscQueue *queue);
+size_t spsc_queue_memory_usage(const SpscQueue *queue);
+
+// Returns EXIT_FAILURE if the queue is full.
+int spsc_queue_push(SpscQueue *queue, const void *element);
+
+// Pushes up to `count` elements from the `elements` array, publishing them to
+// the consumer all at once. Returns how many elements were pushed.
+size_t spsc_queue_push_batch(SpscQueue *queue, const void *elements,
+                             size_t count);
+
+// Returns EXIT_FAILURE if the queue is empty.
+int spsc_queue_pop(SpscQueue *queue, void *result);
+
+// Pops up to `count` elements into the `result` array, releasing their slots
+// to the producer all at once. Returns how many elements were popped.
+size_t spsc_queue_pop_batch(SpscQueue *queue, void *result, size_t count);
+
+// Bounded multi-producer/multi-consumer queue using per-slot sequence numbers,
+// as described by Dmitry Vyukov.
+typedef struct MpmcQueue {
+  size_t enqueue_pos;
+  uint8_t pad0[QUEUE_CACHE_LINE_SIZE - sizeof(size_t)];
+
+  size_t dequeue_pos;
+  uint8_t pad1[QUEUE_CACHE_LINE_SIZE - sizeof(size_t)];
+
+  size_t capacity;
+  size_t element_size;
+  size_t slot_size; // Byte size of a sequence number and element.
+  void *slots;
+} MpmcQueue;
+
+int mpmc_queue_init(MpmcQueue *result, size_t element_size, size_t capacity);
+void mpmc_queue_deinit(MpmcQueue *queue);
+
+// Each slot holds a sequence number as well as the element.
+size_t mpmc_queue_memory_usage(const MpmcQueue *queue);
+
+// Returns EXIT_FAILURE if the queue is full.
+int mpmc_queue_push(MpmcQueue *queue, const void *element);
+
+// Returns EXIT_FAILURE if the queue is empty.
+int mpmc_queue_pop(MpmcQueue *queue, void *result);
+
+#endif
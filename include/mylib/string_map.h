@@ -0,0 +1,97 @@
+/**
+ * mylib/string_map.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_STRING_MAP_H
+#define MYLIB_STRING_MAP_H
+
+#include "vector.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// A map specialised for string keys. Each key is stored once in a contiguous
+// arena along with its length and hash, so lookups compare the hash and length
+// before touching any bytes and never call strlen. Entries are kept densely in
+// insertion order, deleting one moves the last entry into its place.
+typedef struct StringMapEntry {
+  uint64_t hash;
+  size_t offset; // Offset of the key in the arena.
+  size_t length; // Length of the key, not counting the NUL after it.
+} StringMapEntry;
+
+typedef struct StringMap {
+  size_t value_size; // Byte size of the value, may be 0.
+  size_t capacity;   // How many slots there are, always a power of two.
+  size_t tombstones; // How many slots are deleted.
+  uint32_t *slots;   // Index of an entry plus one, 0 when the slot is empty.
+
+  Vector entries; // StringMapEntry for each key.
+  Vector values;  // Values in the same order as `entries`.
+  Vector arena;   // NUL terminated key bytes.
+  size_t garbage; // Bytes of deleted keys still in the arena.
+} StringMap;
+
+int string_map_init(StringMap *result, size_t value_size);
+void string_map_deinit(StringMap *map);
+void string_map_clear(StringMap *map);
+size_t string_map_count(const StringMap *map);
+
+// Keys are `length` bytes and need not be NUL terminated. The value is copied,
+// it may be NULL to leave the value uninitialized.
+int string_map_put(StringMap *map, const char *key, size_t length,
+                   const void *value);
+
+// Returns NULL if the key is missing. With a value size of 0 the pointer is
+// only good for that test and must not be written through.
+void *string_map_get(const StringMap *map, const char *key, size_t length);
+int string_map_has(const StringMap *map, const char *key, size_t length);
+void string_map_delete(StringMap *map, const char *key, size_t length);
+
+// Entries can be visited by index, from 0 to string_map_count. The key is NUL
+// terminated, its pointer is valid until the map is next modified.
+const char *string_map_key(const StringMap *map, size_t idx, size_t *length);
+void *string_map_value(const StringMap *map, size_t idx);
+
+size_t string_map_memory_usage(const StringMap *map);
+
+// Interns strings, handing out ids that stay the same for the life of the
+// interner. Strings are never removed, so ids are dense from 0.
+typedef struct StringInterner {
+  StringMap map;
+} StringInterner;
+
+int string_interner_init(StringInterner *result);
+void string_interner_deinit(StringInterner *interner);
+size_t string_interner_count(const StringInterner *interner);
+
+// Sets `id` to the id of the string, adding it if it is new.
+int string_interner_intern(StringInterner *interner, const char *str,
+                           size_t length, uint32_t *id);
+
+// Returns EXIT_FAILURE if the string has not been interned.
+int string_interner_find(const StringInterner *interner, const char *str,
+                         size_t length, uint32_t *id);
+
+// The pointer is valid until the next string is interned.
+const char *string_interner_get(const StringInterner *interner, uint32_t id,
+                                size_t *length);
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * mylib/thread_pool.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_THREAD_POOL_H
+#define MYLIB_THREAD_POOL_H
+
+#include "deque.h"
+#include "queue.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// How many tasks each worker's deque holds, a worker that spawns more than
+// this without any being stolen runs the rest itself.
+#define THREAD_POOL_DEQUE_CAPACITY 4096
+
+typedef void (*ThreadPoolTaskFn)(void *arg);
+
+typedef struct ThreadPoolTask ThreadPoolTask;
+typedef struct ThreadPool ThreadPool;
+
+// A Chase-Lev work-stealing deque of tasks. The owning worker pushes and takes
+// at the bottom, other threads steal from the top.
+typedef struct ThreadPoolWorker {
+  int64_t top;
+  uint8_t pad0[QUEUE_CACHE_LINE_SIZE - sizeof(int64_t)];
+  int64_t bottom;
+  uint8_t pad1[QUEUE_CACHE_LINE_SIZE - sizeof(int64_t)];
+
+  ThreadPoolTask **tasks; // THREAD_POOL_DEQUE_CAPACITY slots.
+  ThreadPool *pool;
+  pthread_t thread;
+} ThreadPoolWorker;
+
+// A fixed set of worker threads, each with its own deque. Idle workers steal
+// from the others and then sleep until more work is spawned.
+struct ThreadPool {
+  size_t worker_count;
+  ThreadPoolWorker *workers;
+
+  // Tasks spawned by threads outside of the pool.
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  Deque injected;
+  size_t injected_count; // Read without the lock.
+
+  size_t sleeping; // How many workers are waiting on `wake`.
+  int shutdown;
+};
+
+// Counts the tasks spawned into it that haven't finished, wait on it to join
+// them. Zero initialize it before the first spawn.
+typedef struct ThreadPoolGroup {
+  size_t pending;
+} ThreadPoolGroup;
+
+// Starts `worker_count` threads, 0 for one per online CPU.
+int thread_pool_init(ThreadPool *result, size_t worker_count);
+
+// Waits for the workers to finish what they are running and joins them, tasks
+// that haven't started may be dropped.
+void thread_pool_deinit(ThreadPool *pool);
+
+size_t thread_pool_worker_count(const ThreadPool *pool);
+
+// Runs `fn` on a copy of the `arg_size` bytes at `arg`. Spawns from a worker go
+// on its own deque, spawns from other threads are queued for any worker. If the
+// task can't be allocated or queued it runs on the calling thread.
+void thread_pool_spawn(ThreadPool *pool, ThreadPoolGroup *group,
+                       ThreadPoolTaskFn fn, const void *arg, size_t arg_size);
+
+// Runs tasks on the calling thread until every task in `group` has finished,
+// so it may be called from inside a task.
+void thread_pool_wait(ThreadPool *pool, ThreadPoolGroup *group);
+
+#endif
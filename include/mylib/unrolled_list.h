@@ -0,0 +1,83 @@
+/**
+ * mylib/unrolled_list.h
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MYLIB_UNROLLED_LIST_H
+#define MYLIB_UNROLLED_LIST_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// A linked list of blocks, each block holds up to `block_capacity` elements
+// inline so that iterating touches one pointer per block rather than two per
+// element. Full blocks are split in half on insert and sparse blocks are merged
+// with their neighbour on delete.
+typedef struct UnrolledListBlock {
+  struct UnrolledListBlock *prev;
+  struct UnrolledListBlock *next;
+  size_t count;   // How many elements are in this block.
+  uint8_t data[]; // `block_capacity` elements.
+} UnrolledListBlock;
+
+typedef struct UnrolledList {
+  UnrolledListBlock *first;
+  UnrolledListBlock *last;
+  size_t size;           // How many elements are in the list.
+  size_t element_size;   // Byte size of an element.
+  size_t block_capacity; // How many elements fit in a block.
+} UnrolledList;
+
+typedef struct UnrolledListIterator {
+  UnrolledList *list;
+  UnrolledListBlock *block; // Block of the current element, NULL before the
+                            // first element.
+  size_t idx;               // Index of the current element in `block`.
+} UnrolledListIterator;
+
+// A `block_capacity` of 0 picks one that fits roughly 512 bytes of elements.
+int unrolled_list_init(UnrolledList *result, size_t element_size,
+                       size_t block_capacity);
+void unrolled_list_deinit(UnrolledList *list);
+void unrolled_list_clear(UnrolledList *list);
+size_t unrolled_list_len(const UnrolledList *list);
+
+// Counts whole blocks, so it includes the free space inside of them.
+size_t unrolled_list_memory_usage(const UnrolledList *list);
+int unrolled_list_append(UnrolledList *list, void *element);
+
+// Returns NULL if `idx` is out of bounds, walks one block at a time.
+void *unrolled_list_get(const UnrolledList *list, size_t idx);
+
+UnrolledListIterator unrolled_list_iter(UnrolledList *list);
+
+// Advances to and returns the next element, NULL at the end of the list.
+void *unrolled_list_next(UnrolledListIterator *iterator);
+
+// Inserts after the current element, or at the front of the list if next has
+// not been called yet, or at the back once next has returned NULL. The
+// inserted element becomes the current element.
+int unrolled_list_insert_after(UnrolledListIterator *iterator, void *element);
+
+// Deletes the current element, the following call to next returns the element
+// that came after it.
+void unrolled_list_delete(UnrolledListIterator *iterator);
+
+#endif
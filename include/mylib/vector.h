@@ -23,6 +23,7 @@
 #ifndef MYLIB_VECTOR_H
 #define MYLIB_VECTOR_H
 
+#include "alloc.h"
 #include <stdlib.h>
 
 typedef struct Vector {
@@ -31,19 +32,47 @@ typedef struct Vector {
   size_t element_size;
 
   void *data;
+  struct VectorMapping *mapping; // Set when `data` lives in a mapped file.
+  size_t *refs; // Set while `data` is shared with copy-on-write clones.
+  AllocPolicy policy; // How `data` is allocated.
 } Vector;
 
 int vector_init_with_capacity(Vector *result, size_t element_size,
                               size_t capacity);
+
+// Allocates the elements with `policy`, clones of the vector keep it.
+int vector_init_with_policy(Vector *result, size_t element_size,
+                            size_t capacity, AllocPolicy policy);
 int vector_init(Vector *result, size_t element_size);
 int vector_clone(const Vector *src, Vector *result);
+
+// Shares the elements of `src` with `result` in O(1), the first of the two to
+// be modified takes a copy of them. File-backed vectors are cloned instead.
+int vector_clone_cow(Vector *src, Vector *result);
+
+// Gives `vec` its own copy of its elements if they are shared with a clone.
+// Every function that modifies the vector calls it, code that writes through
+// `data` directly must call it first.
+int vector_unshare(Vector *vec);
 void vector_deinit(Vector *vec);
 int vector_resize(Vector *vec, size_t new_capacity);
 size_t vector_len(const Vector *vec);
 size_t vector_size_in_bytes(const Vector *vec);
+
+// Bytes allocated for the vector, including unused capacity. For a mapped
+// vector this is the length of the mapping.
+size_t vector_memory_usage(const Vector *vec);
+
 int vector_assign(Vector *vec, size_t idx, void *element);
 int vector_append(Vector *vec, void *element);
+
+// Appends `count` elements from the `elements` array, growing at most once.
+int vector_append_many(Vector *vec, const void *elements, size_t count);
 int vector_insert(Vector *vec, size_t idx, void *element);
+
+// The caller may write through the pointer, so elements shared with a clone
+// are copied first and NULL is returned if that fails. Use vector_get_const to
+// read without copying.
 void *vector_get(Vector *vec, size_t idx);
 const void *vector_get_const(const Vector *vec, size_t idx);
 void vector_delete(Vector *vec, size_t idx);
@@ -51,4 +80,22 @@ void vector_swap_delete(Vector *vec, size_t idx);
 void vector_clear(Vector *vec);
 void vector_shrink_to_fit(Vector *vec);
 
+// File-backed vectors store `data` in a memory-mapped file behind a small
+// header (element size, count and format version). The file grows and shrinks
+// with the capacity, the count in the header is only updated by vector_flush
+// and vector_deinit.
+
+// Creates or truncates the file at `path` and maps it as the vector's storage.
+int vector_init_mapped(Vector *result, size_t element_size, size_t capacity,
+                       const char *path);
+
+// Maps a file previously written by a file-backed vector without copying it.
+// A read-only vector fails every operation that would modify it, writing
+// through a pointer from vector_get is not allowed.
+int vector_open_mapped(Vector *result, const char *path, int read_only);
+
+// Writes the count to the header and synchronously flushes the mapping to the
+// file. Does nothing for vectors that are not file-backed.
+int vector_flush(Vector *vec);
+
 #endif
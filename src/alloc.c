@@ -0,0 +1,332 @@
+/**
+ * alloc.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Needed for MAP_ANONYMOUS, MAP_HUGETLB and MADV_HUGEPAGE.
+#define _GNU_SOURCE
+
+#include "mylib/alloc.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifdef MYLIB_ALLOC_STATS
+// Each allocation is prefixed with its size so that alloc_free knows how many
+// bytes it releases, the prefix keeps the alignment malloc gives.
+#define HEADER_SIZE 16
+
+static AllocStats stats;
+
+#define ADD(field, n) __atomic_add_fetch(&stats.field, (n), __ATOMIC_RELAXED)
+#define SUB(field, n) __atomic_sub_fetch(&stats.field, (n), __ATOMIC_RELAXED)
+
+static void record_alloc(size_t size) {
+  ADD(allocs, 1);
+  ADD(total, size);
+
+  size_t bytes = ADD(bytes, size);
+  size_t peak = __atomic_load_n(&stats.peak, __ATOMIC_RELAXED);
+  while (bytes > peak &&
+         !__atomic_compare_exchange_n(&stats.peak, &peak, bytes, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+static void record_mapping(size_t length) { record_alloc(length); }
+
+static void record_unmapping(size_t length) {
+  SUB(bytes, length);
+  ADD(frees, 1);
+}
+
+static void *to_user(void *header, size_t size) {
+  *(size_t *)header = size;
+  return (uint8_t *)header + HEADER_SIZE;
+}
+
+static void *to_header(void *ptr) { return (uint8_t *)ptr - HEADER_SIZE; }
+
+void *alloc_malloc(size_t size) {
+  if (size > SIZE_MAX - HEADER_SIZE)
+    return NULL;
+
+  void *header = malloc(HEADER_SIZE + size);
+  if (!header)
+    return NULL;
+
+  record_alloc(size);
+  return to_user(header, size);
+}
+
+void *alloc_calloc(size_t count, size_t size) {
+  if (size && count > (SIZE_MAX - HEADER_SIZE) / size)
+    return NULL;
+
+  void *result = alloc_malloc(count * size);
+  if (result)
+    memset(result, 0, count * size);
+
+  return result;
+}
+
+void *alloc_realloc(void *ptr, size_t size) {
+  if (!ptr)
+    return alloc_malloc(size);
+
+  if (size == 0) {
+    alloc_free(ptr);
+    return NULL;
+  }
+
+  if (size > SIZE_MAX - HEADER_SIZE)
+    return NULL;
+
+  void *header = to_header(ptr);
+  size_t old_size = *(size_t *)header;
+
+  header = realloc(header, HEADER_SIZE + size);
+  if (!header)
+    return NULL;
+
+  // Count a realloc as freeing the old block and allocating the new one.
+  SUB(bytes, old_size);
+  ADD(frees, 1);
+  record_alloc(size);
+
+  return to_user(header, size);
+}
+
+void alloc_free(void *ptr) {
+  if (!ptr)
+    return;
+
+  void *header = to_header(ptr);
+  SUB(bytes, *(size_t *)header);
+  ADD(frees, 1);
+
+  free(header);
+}
+
+int alloc_stats(AllocStats *result) {
+  assert(result != NULL);
+
+  result->allocs = __atomic_load_n(&stats.allocs, __ATOMIC_RELAXED);
+  result->frees = __atomic_load_n(&stats.frees, __ATOMIC_RELAXED);
+  result->bytes = __atomic_load_n(&stats.bytes, __ATOMIC_RELAXED);
+  result->peak = __atomic_load_n(&stats.peak, __ATOMIC_RELAXED);
+  result->total = __atomic_load_n(&stats.total, __ATOMIC_RELAXED);
+
+  return EXIT_SUCCESS;
+}
+
+void alloc_stats_reset(void) {
+  size_t bytes = __atomic_load_n(&stats.bytes, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&stats.allocs, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats.frees, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats.total, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats.peak, bytes, __ATOMIC_RELAXED);
+}
+#else
+void *alloc_malloc(size_t size) { return malloc(size); }
+
+void *alloc_calloc(size_t count, size_t size) { return calloc(count, size); }
+
+void *alloc_realloc(void *ptr, size_t size) {
+  if (size == 0) {
+    free(ptr);
+    return NULL;
+  }
+
+  return realloc(ptr, size);
+}
+
+void alloc_free(void *ptr) { free(ptr); }
+
+int alloc_stats(AllocStats *result) {
+  assert(result != NULL);
+
+  *result = (AllocStats){0};
+  return EXIT_FAILURE;
+}
+
+void alloc_stats_reset(void) {}
+
+static void record_mapping(size_t length) { (void)length; }
+
+static void record_unmapping(size_t length) { (void)length; }
+#endif
+
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+// Sits just before every allocation made by a policy other than the default.
+typedef struct PolicyHeader {
+  void *base;    // What was returned by alloc_malloc or mmap.
+  size_t length; // Length of the mapping, 0 if it came from alloc_malloc.
+  size_t size;   // The size asked for.
+  size_t pad;
+} PolicyHeader;
+
+static PolicyHeader *header_of(void *ptr) { return (PolicyHeader *)ptr - 1; }
+
+static void *with_header(void *base, void *ptr, size_t length, size_t size) {
+  *header_of(ptr) = (PolicyHeader){base, length, size, 0};
+  return ptr;
+}
+
+static void *aligned_malloc(size_t size) {
+  if (size > SIZE_MAX - ALLOC_ALIGNMENT - sizeof(PolicyHeader))
+    return NULL;
+
+  uint8_t *base = alloc_malloc(size + ALLOC_ALIGNMENT + sizeof(PolicyHeader));
+  if (!base)
+    return NULL;
+
+  uintptr_t ptr = (uintptr_t)(base + sizeof(PolicyHeader));
+  ptr = (ptr + ALLOC_ALIGNMENT - 1) & ~(uintptr_t)(ALLOC_ALIGNMENT - 1);
+
+  return with_header(base, (void *)ptr, 0, size);
+}
+
+// Maps `length` bytes starting at a huge page boundary, so that the kernel can
+// back all of them with huge pages. Returns NULL if the mapping failed.
+static void *map_huge(size_t length, int hugetlb) {
+  void *base = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+  if (hugetlb)
+    base = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+  if (base == MAP_FAILED) {
+    // Map a huge page more than needed then trim either side to align it.
+    uint8_t *raw = mmap(NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+      return NULL;
+
+    uintptr_t start = ((uintptr_t)raw + HUGE_PAGE_SIZE - 1) &
+                      ~(uintptr_t)(HUGE_PAGE_SIZE - 1);
+    size_t head = start - (uintptr_t)raw;
+    if (head)
+      munmap(raw, head);
+    munmap((uint8_t *)start + length, HUGE_PAGE_SIZE - head);
+    base = (void *)start;
+
+#ifdef MADV_HUGEPAGE
+    // Only advice, the mapping works the same without huge pages.
+    madvise(base, length, MADV_HUGEPAGE);
+#endif
+  }
+
+  record_mapping(length);
+  return base;
+}
+
+static void *policy_malloc(AllocPolicy policy, size_t size) {
+  if (policy >= ALLOC_POLICY_HUGE && size >= ALLOC_HUGE_THRESHOLD &&
+      size <= SIZE_MAX - 2 * HUGE_PAGE_SIZE) {
+    // The header takes the first cache line, the rest is rounded up to whole
+    // huge pages.
+    size_t length = (size + ALLOC_ALIGNMENT + HUGE_PAGE_SIZE - 1) &
+                    ~(HUGE_PAGE_SIZE - 1);
+
+    uint8_t *base = map_huge(length, policy == ALLOC_POLICY_HUGETLB);
+    if (base)
+      return with_header(base, base + ALLOC_ALIGNMENT, length, size);
+  }
+
+  return aligned_malloc(size);
+}
+
+void *alloc_policy_malloc(AllocPolicy policy, size_t size) {
+  if (policy == ALLOC_POLICY_DEFAULT)
+    return alloc_malloc(size);
+
+  return policy_malloc(policy, size);
+}
+
+void *alloc_policy_calloc(AllocPolicy policy, size_t count, size_t size) {
+  if (policy == ALLOC_POLICY_DEFAULT)
+    return alloc_calloc(count, size);
+
+  if (size && count > SIZE_MAX / size)
+    return NULL;
+
+  void *result = policy_malloc(policy, count * size);
+
+  // Fresh anonymous mappings are already zeroed.
+  if (result && !header_of(result)->length)
+    memset(result, 0, count * size);
+
+  return result;
+}
+
+void *alloc_policy_realloc(AllocPolicy policy, void *ptr, size_t size) {
+  if (policy == ALLOC_POLICY_DEFAULT)
+    return alloc_realloc(ptr, size);
+
+  if (!ptr)
+    return policy_malloc(policy, size);
+
+  if (size == 0) {
+    alloc_policy_free(policy, ptr);
+    return NULL;
+  }
+
+  // A mapping has room to grow up to its whole huge pages, and shrinking it a
+  // little isn't worth a copy.
+  PolicyHeader *header = header_of(ptr);
+  if (header->length && size <= header->length - ALLOC_ALIGNMENT &&
+      size >= header->length / 4) {
+    header->size = size;
+    return ptr;
+  }
+
+  void *result = policy_malloc(policy, size);
+  if (!result)
+    return NULL;
+
+  memcpy(result, ptr, header->size < size ? header->size : size);
+  alloc_policy_free(policy, ptr);
+
+  return result;
+}
+
+void alloc_policy_free(AllocPolicy policy, void *ptr) {
+  if (policy == ALLOC_POLICY_DEFAULT) {
+    alloc_free(ptr);
+    return;
+  }
+
+  if (!ptr)
+    return;
+
+  PolicyHeader header = *header_of(ptr);
+  if (header.length) {
+    munmap(header.base, header.length);
+    record_unmapping(header.length);
+  } else {
+    alloc_free(header.base);
+  }
+}
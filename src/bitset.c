@@ -21,6 +21,7 @@
  * SOFTWARE.
  */
 #include "mylib/bitset.h"
+#include "mylib/alloc.h"
 #include "mylib/hash.h"
 #include <assert.h>
 #include <string.h>
@@ -31,17 +32,32 @@ static size_t byte_count(size_t bit) { return get_byte(bit) + 1; }
 
 static uint8_t get_bit_offset(size_t bit) { return 7 - (bit % 8); }
 
+// Drops this set's reference to shared bytes, the last one frees them.
+static void release_shared(Bitset *bs) {
+  if (__atomic_sub_fetch(bs->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    alloc_free(bs->refs);
+    alloc_policy_free(bs->policy, bs->bytes);
+  }
+  bs->refs = NULL;
+}
+
 int bitset_init(Bitset *result, size_t max) {
+  return bitset_init_with_policy(result, max, ALLOC_POLICY_DEFAULT);
+}
+
+int bitset_init_with_policy(Bitset *result, size_t max, AllocPolicy policy) {
   assert(result != NULL);
 
   *result = (Bitset){0};
 
   size_t required_bytes = byte_count(max);
 
-  if (!(result->bytes = calloc(required_bytes, sizeof(uint8_t))))
+  result->bytes = alloc_policy_calloc(policy, required_bytes, sizeof(uint8_t));
+  if (!result->bytes)
     return EXIT_FAILURE;
 
   result->max = max;
+  result->policy = policy;
 
   return EXIT_SUCCESS;
 }
@@ -49,13 +65,16 @@ int bitset_init(Bitset *result, size_t max) {
 void bitset_deinit(Bitset *bs) {
   assert(bs != NULL);
 
-  free(bs->bytes);
+  if (bs->refs)
+    release_shared(bs);
+  else
+    alloc_policy_free(bs->policy, bs->bytes);
 }
 
 int bitset_clone(const Bitset *src, Bitset *result) {
   assert(src != NULL);
 
-  if (bitset_init(result, src->max))
+  if (bitset_init_with_policy(result, src->max, src->policy))
     return EXIT_FAILURE;
 
   size_t bytes_to_copy = byte_count(src->max);
@@ -64,6 +83,47 @@ int bitset_clone(const Bitset *src, Bitset *result) {
   return EXIT_SUCCESS;
 }
 
+int bitset_clone_cow(Bitset *src, Bitset *result) {
+  assert(src != NULL);
+  assert(result != NULL);
+
+  if (!src->refs) {
+    if (!(src->refs = alloc_malloc(sizeof(size_t))))
+      return EXIT_FAILURE;
+    *src->refs = 1;
+  }
+
+  __atomic_add_fetch(src->refs, 1, __ATOMIC_RELAXED);
+  *result = *src;
+
+  return EXIT_SUCCESS;
+}
+
+int bitset_unshare(Bitset *bs) {
+  assert(bs != NULL);
+
+  if (!bs->refs)
+    return EXIT_SUCCESS;
+
+  // Every clone has since been modified or freed, so the bytes are ours.
+  if (__atomic_load_n(bs->refs, __ATOMIC_ACQUIRE) == 1) {
+    alloc_free(bs->refs);
+    bs->refs = NULL;
+    return EXIT_SUCCESS;
+  }
+
+  size_t bytes_to_copy = byte_count(bs->max);
+  uint8_t *bytes = alloc_policy_malloc(bs->policy, bytes_to_copy);
+  if (!bytes)
+    return EXIT_FAILURE;
+
+  memcpy(bytes, bs->bytes, bytes_to_copy);
+  release_shared(bs);
+  bs->bytes = bytes;
+
+  return EXIT_SUCCESS;
+}
+
 // Adapted for uint8_t from Hacker's Delight, p. 66, Figure 5-2.
 static uint8_t popcount(uint8_t byte) {
   byte = byte - ((byte >> 1) & 0x55);
@@ -91,9 +151,18 @@ size_t bitset_size_in_bytes(const Bitset *bs) {
   return byte_count(bs->max);
 }
 
+size_t bitset_memory_usage(const Bitset *bs) {
+  assert(bs != NULL);
+
+  return bs->bytes ? byte_count(bs->max) : 0;
+}
+
 void bitset_clear(Bitset *bs) {
   assert(bs != NULL);
 
+  if (bitset_unshare(bs))
+    return;
+
   size_t bytes_to_clear = byte_count(bs->max);
   memset(bs->bytes, 0, sizeof(uint8_t) * bytes_to_clear);
 }
@@ -112,7 +181,7 @@ int bitset_has(const Bitset *bs, size_t bit) {
 int bitset_incl(Bitset *bs, size_t bit) {
   assert(bs != NULL);
 
-  if (bit > bs->max)
+  if (bit > bs->max || bitset_unshare(bs))
     return EXIT_FAILURE;
 
   size_t byte = get_byte(bit);
@@ -125,7 +194,7 @@ int bitset_incl(Bitset *bs, size_t bit) {
 void bitset_excl(Bitset *bs, size_t bit) {
   assert(bs != NULL);
 
-  if (bit > bs->max)
+  if (bit > bs->max || bitset_unshare(bs))
     return;
 
   size_t byte = get_byte(bit);
@@ -264,3 +333,10 @@ uint32_t bitset_hash(const void *bs) {
 
   return fnv1a_32_hash(casted->bytes, byte_count(casted->max));
 }
+
+uint64_t bitset_hash64(const void *bs) {
+  const Bitset *casted = bs;
+  assert(casted != NULL);
+
+  return xxh64_hash(casted->bytes, byte_count(casted->max), 0);
+}
@@ -0,0 +1,737 @@
+/**
+ * btree_map.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/btree_map.h"
+#include "mylib/alloc.h"
+#include <assert.h>
+#include <string.h>
+
+// Keys per node default to filling this many bytes.
+#define DEFAULT_NODE_KEY_BYTES 256
+#define MIN_ORDER 4
+
+// An insert splits at most one node per level plus the root. With at least
+// three children per branch no tree fits more levels than this in memory.
+#define MAX_HEIGHT 64
+
+#define ALIGN 16
+#define ALIGN_UP(n) (((n) + ALIGN - 1) & ~(size_t)(ALIGN - 1))
+
+// Every node has the same layout and size, the header is followed by room for
+// order + 1 keys and then by either the values or the children. The extra
+// slot lets a key go in before the node is split.
+typedef struct BTreeNode {
+  size_t count; // How many keys are in the node.
+  int leaf;
+  struct BTreeNode *prev; // Neighbouring leaves, unused by branches.
+  struct BTreeNode *next;
+} BTreeNode;
+
+// Nodes allocated before an insert starts, so that running out of memory
+// can't leave the tree half split.
+typedef struct Spares {
+  BTreeNode *nodes[MAX_HEIGHT + 1];
+  size_t count;
+} Spares;
+
+static size_t key_slots(const BTreeMap *map) { return map->order + 1; }
+
+static size_t keys_offset(void) { return ALIGN_UP(sizeof(BTreeNode)); }
+
+static size_t items_offset(const BTreeMap *map) {
+  return keys_offset() + ALIGN_UP(key_slots(map) * map->key_size);
+}
+
+static size_t node_bytes(const BTreeMap *map) {
+  size_t values = key_slots(map) * map->value_size;
+  size_t children = (key_slots(map) + 1) * sizeof(BTreeNode *);
+  return items_offset(map) + (values > children ? values : children);
+}
+
+static uint8_t *key_at(const BTreeMap *map, const BTreeNode *node, size_t i) {
+  return (uint8_t *)node + keys_offset() + i * map->key_size;
+}
+
+static uint8_t *value_at(const BTreeMap *map, const BTreeNode *node,
+                         size_t i) {
+  return (uint8_t *)node + items_offset(map) + i * map->value_size;
+}
+
+static BTreeNode **children(const BTreeMap *map, const BTreeNode *node) {
+  return (BTreeNode **)((uint8_t *)node + items_offset(map));
+}
+
+// Moving `n` keys, values or children from index `from` to `to`, the nodes
+// may be the same.
+static void move_keys(const BTreeMap *map, BTreeNode *dest, size_t to,
+                      const BTreeNode *src, size_t from, size_t n) {
+  memmove(key_at(map, dest, to), key_at(map, src, from), n * map->key_size);
+}
+
+static void move_values(const BTreeMap *map, BTreeNode *dest, size_t to,
+                        const BTreeNode *src, size_t from, size_t n) {
+  memmove(value_at(map, dest, to), value_at(map, src, from),
+          n * map->value_size);
+}
+
+static void move_children(const BTreeMap *map, BTreeNode *dest, size_t to,
+                          const BTreeNode *src, size_t from, size_t n) {
+  memmove(children(map, dest) + to, children(map, src) + from,
+          n * sizeof(BTreeNode *));
+}
+
+static int32_t compare(const BTreeMap *map, const void *a, const void *b) {
+  if (map->cmp)
+    return map->cmp(a, b);
+
+  uint64_t x, y;
+  memcpy(&x, a, sizeof(uint64_t));
+  memcpy(&y, b, sizeof(uint64_t));
+  return (x > y) - (x < y);
+}
+
+// Index of the first key in `node` greater than `key`, or greater or equal to
+// it if not `upper`.
+static size_t search(const BTreeMap *map, const BTreeNode *node,
+                     const void *key, int upper) {
+  if (!map->cmp) {
+    uint64_t k;
+    memcpy(&k, key, sizeof(uint64_t));
+    const uint64_t *keys = (const uint64_t *)key_at(map, node, 0);
+
+    // The keys are sorted so counting the smaller ones gives the index, a
+    // branchless scan of one node beats a binary search.
+    size_t result = 0;
+    if (upper) {
+      for (size_t i = 0; i < node->count; i++)
+        result += keys[i] <= k;
+    } else {
+      for (size_t i = 0; i < node->count; i++)
+        result += keys[i] < k;
+    }
+    return result;
+  }
+
+  size_t lo = 0, hi = node->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    int32_t cmp = map->cmp(key_at(map, node, mid), key);
+    if (cmp < 0 || (upper && cmp == 0))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+static BTreeNode *node_init(const BTreeMap *map, int leaf) {
+  BTreeNode *node = alloc_malloc(node_bytes(map));
+  if (!node)
+    return NULL;
+
+  *node = (BTreeNode){0};
+  node->leaf = leaf;
+
+  return node;
+}
+
+static void node_deinit(const BTreeMap *map, BTreeNode *node) {
+  if (!node->leaf)
+    for (size_t i = 0; i <= node->count; i++)
+      node_deinit(map, children(map, node)[i]);
+
+  alloc_free(node);
+}
+
+static BTreeNode *take_spare(Spares *spares, int leaf) {
+  assert(spares->count > 0);
+
+  BTreeNode *node = spares->nodes[--spares->count];
+  *node = (BTreeNode){0};
+  node->leaf = leaf;
+
+  return node;
+}
+
+// Descends to the leaf that would hold `key`.
+static BTreeNode *find_leaf(const BTreeMap *map, const void *key) {
+  BTreeNode *node = map->root;
+  while (node && !node->leaf)
+    node = children(map, node)[search(map, node, key, 1)];
+
+  return node;
+}
+
+// Moves the upper half of a full leaf into a new leaf to its right.
+static BTreeNode *split_leaf(BTreeMap *map, BTreeNode *node, Spares *spares) {
+  BTreeNode *right = take_spare(spares, 1);
+  size_t mid = node->count / 2;
+
+  right->count = node->count - mid;
+  move_keys(map, right, 0, node, mid, right->count);
+  move_values(map, right, 0, node, mid, right->count);
+  node->count = mid;
+
+  right->prev = node;
+  right->next = node->next;
+  if (node->next)
+    node->next->prev = right;
+  else
+    map->last = right;
+  node->next = right;
+
+  return right;
+}
+
+// Moves the keys and children above the middle key into a new branch, the
+// middle key is left just past the end of `node` for the parent to copy.
+static BTreeNode *split_branch(BTreeMap *map, BTreeNode *node,
+                               Spares *spares) {
+  BTreeNode *right = take_spare(spares, 0);
+  size_t mid = node->count / 2;
+
+  right->count = node->count - mid - 1;
+  move_keys(map, right, 0, node, mid + 1, right->count);
+  move_children(map, right, 0, node, mid + 1, right->count + 1);
+  node->count = mid;
+
+  return right;
+}
+
+// Inserts into the subtree at `node`. If the node split, `*right` is set to
+// the new node and `*separator` to the first key of its subtree.
+static void insert(BTreeMap *map, BTreeNode *node, const void *key,
+                   const void *value, Spares *spares, BTreeNode **right,
+                   const void **separator) {
+  *right = NULL;
+
+  if (node->leaf) {
+    size_t i = search(map, node, key, 0);
+
+    // The key exists, replace the value.
+    if (i < node->count && compare(map, key_at(map, node, i), key) == 0) {
+      if (value)
+        memcpy(value_at(map, node, i), value, map->value_size);
+      return;
+    }
+
+    move_keys(map, node, i + 1, node, i, node->count - i);
+    move_values(map, node, i + 1, node, i, node->count - i);
+    memcpy(key_at(map, node, i), key, map->key_size);
+    if (value)
+      memcpy(value_at(map, node, i), value, map->value_size);
+    else
+      memset(value_at(map, node, i), 0, map->value_size);
+    node->count++;
+    map->size++;
+
+    if (node->count > map->order) {
+      *right = split_leaf(map, node, spares);
+      *separator = key_at(map, *right, 0);
+    }
+    return;
+  }
+
+  size_t i = search(map, node, key, 1);
+
+  BTreeNode *child_right;
+  const void *child_separator;
+  insert(map, children(map, node)[i], key, value, spares, &child_right,
+         &child_separator);
+  if (!child_right)
+    return;
+
+  // The child split, add the new child to the right of it.
+  move_keys(map, node, i + 1, node, i, node->count - i);
+  move_children(map, node, i + 2, node, i + 1, node->count - i);
+  memcpy(key_at(map, node, i), child_separator, map->key_size);
+  children(map, node)[i + 1] = child_right;
+  node->count++;
+
+  if (node->count > map->order) {
+    *right = split_branch(map, node, spares);
+    *separator = key_at(map, node, node->count);
+  }
+}
+
+static void rebalance(BTreeMap *map, BTreeNode *parent, size_t i);
+
+// Removes `key` from the subtree at `node`, returns 1 if it was found.
+static int remove_key(BTreeMap *map, BTreeNode *node, const void *key) {
+  if (node->leaf) {
+    size_t i = search(map, node, key, 0);
+    if (i >= node->count || compare(map, key_at(map, node, i), key) != 0)
+      return 0;
+
+    move_keys(map, node, i, node, i + 1, node->count - i - 1);
+    move_values(map, node, i, node, i + 1, node->count - i - 1);
+    node->count--;
+    map->size--;
+
+    return 1;
+  }
+
+  size_t i = search(map, node, key, 1);
+  BTreeNode *child = children(map, node)[i];
+  if (!remove_key(map, child, key))
+    return 0;
+
+  if (child->count < map->order / 2)
+    rebalance(map, node, i);
+
+  return 1;
+}
+
+// Moves the last entry of the left sibling into `children[i]`.
+static void borrow_left(BTreeMap *map, BTreeNode *parent, size_t i) {
+  BTreeNode *child = children(map, parent)[i];
+  BTreeNode *left = children(map, parent)[i - 1];
+
+  move_keys(map, child, 1, child, 0, child->count);
+
+  if (child->leaf) {
+    move_values(map, child, 1, child, 0, child->count);
+    move_keys(map, child, 0, left, left->count - 1, 1);
+    move_values(map, child, 0, left, left->count - 1, 1);
+    move_keys(map, parent, i - 1, child, 0, 1);
+  } else {
+    // The separator comes down and the left sibling's last key goes up.
+    move_children(map, child, 1, child, 0, child->count + 1);
+    move_keys(map, child, 0, parent, i - 1, 1);
+    children(map, child)[0] = children(map, left)[left->count];
+    move_keys(map, parent, i - 1, left, left->count - 1, 1);
+  }
+
+  left->count--;
+  child->count++;
+}
+
+// Moves the first entry of the right sibling into `children[i]`.
+static void borrow_right(BTreeMap *map, BTreeNode *parent, size_t i) {
+  BTreeNode *child = children(map, parent)[i];
+  BTreeNode *right = children(map, parent)[i + 1];
+
+  if (child->leaf) {
+    move_keys(map, child, child->count, right, 0, 1);
+    move_values(map, child, child->count, right, 0, 1);
+    move_keys(map, right, 0, right, 1, right->count - 1);
+    move_values(map, right, 0, right, 1, right->count - 1);
+    move_keys(map, parent, i, right, 0, 1);
+  } else {
+    move_keys(map, child, child->count, parent, i, 1);
+    children(map, child)[child->count + 1] = children(map, right)[0];
+    move_keys(map, parent, i, right, 0, 1);
+    move_keys(map, right, 0, right, 1, right->count - 1);
+    move_children(map, right, 0, right, 1, right->count);
+  }
+
+  right->count--;
+  child->count++;
+}
+
+// Merges `children[i + 1]` into `children[i]` and removes it from `parent`.
+static void merge(BTreeMap *map, BTreeNode *parent, size_t i) {
+  BTreeNode *left = children(map, parent)[i];
+  BTreeNode *right = children(map, parent)[i + 1];
+
+  if (left->leaf) {
+    move_keys(map, left, left->count, right, 0, right->count);
+    move_values(map, left, left->count, right, 0, right->count);
+    left->count += right->count;
+
+    left->next = right->next;
+    if (right->next)
+      right->next->prev = left;
+    else
+      map->last = left;
+  } else {
+    // The separator comes down between the two halves.
+    move_keys(map, left, left->count, parent, i, 1);
+    move_keys(map, left, left->count + 1, right, 0, right->count);
+    move_children(map, left, left->count + 1, right, 0, right->count + 1);
+    left->count += right->count + 1;
+  }
+
+  move_keys(map, parent, i, parent, i + 1, parent->count - i - 1);
+  move_children(map, parent, i + 1, parent, i + 2, parent->count - i - 1);
+  parent->count--;
+
+  alloc_free(right);
+}
+
+// Refills `children[i]` after it fell below half full, borrowing from a
+// sibling that can spare an entry or else merging with one.
+static void rebalance(BTreeMap *map, BTreeNode *parent, size_t i) {
+  size_t min = map->order / 2;
+  BTreeNode *left = i > 0 ? children(map, parent)[i - 1] : NULL;
+  BTreeNode *right = i < parent->count ? children(map, parent)[i + 1] : NULL;
+
+  if (left && left->count > min)
+    borrow_left(map, parent, i);
+  else if (right && right->count > min)
+    borrow_right(map, parent, i);
+  else if (left)
+    merge(map, parent, i - 1);
+  else
+    merge(map, parent, i);
+}
+
+int btree_map_init(BTreeMap *result, BTreeMapCmpFn cmp, size_t key_size,
+                   size_t value_size, size_t order) {
+  assert(result != NULL);
+  assert(key_size > 0);
+  assert(cmp != NULL || key_size == sizeof(uint64_t));
+
+  *result = (BTreeMap){0};
+
+  if (order == 0)
+    order = DEFAULT_NODE_KEY_BYTES / key_size;
+  if (order < MIN_ORDER)
+    order = MIN_ORDER;
+
+  result->key_size = key_size;
+  result->value_size = value_size;
+  result->order = order;
+  result->cmp = cmp;
+
+  return EXIT_SUCCESS;
+}
+
+void btree_map_deinit(BTreeMap *map) { btree_map_clear(map); }
+
+void btree_map_clear(BTreeMap *map) {
+  assert(map != NULL);
+
+  if (map->root)
+    node_deinit(map, map->root);
+
+  map->root = map->first = map->last = NULL;
+  map->size = 0;
+  map->height = 0;
+}
+
+size_t btree_map_count(const BTreeMap *map) {
+  assert(map != NULL);
+  return map->size;
+}
+
+int btree_map_put(BTreeMap *map, const void *key, const void *value) {
+  assert(map != NULL);
+  assert(key != NULL);
+
+  if (!map->root) {
+    if (!(map->root = node_init(map, 1)))
+      return EXIT_FAILURE;
+    map->first = map->last = map->root;
+  }
+
+  // A split only carries on up the tree through full nodes, count how many
+  // there are above the leaf and allocate a node for each of them.
+  size_t needed = 0;
+  size_t levels = 0;
+  for (BTreeNode *node = map->root;;
+       node = children(map, node)[search(map, node, key, 1)]) {
+    needed = node->count == map->order ? needed + 1 : 0;
+    levels++;
+    if (node->leaf)
+      break;
+  }
+  // Splitting the root adds a new root.
+  if (needed == levels)
+    needed++;
+
+  Spares spares = {0};
+  for (; spares.count < needed; spares.count++) {
+    if (!(spares.nodes[spares.count] = node_init(map, 1))) {
+      while (spares.count > 0)
+        alloc_free(spares.nodes[--spares.count]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  BTreeNode *right;
+  const void *separator;
+  insert(map, map->root, key, value, &spares, &right, &separator);
+
+  if (right) {
+    BTreeNode *root = take_spare(&spares, 0);
+    root->count = 1;
+    memcpy(key_at(map, root, 0), separator, map->key_size);
+    children(map, root)[0] = map->root;
+    children(map, root)[1] = right;
+    map->root = root;
+    map->height++;
+  }
+
+  // The key may have already been in the map.
+  while (spares.count > 0)
+    alloc_free(spares.nodes[--spares.count]);
+
+  return EXIT_SUCCESS;
+}
+
+void *btree_map_get(const BTreeMap *map, const void *key) {
+  assert(map != NULL);
+  assert(key != NULL);
+
+  BTreeNode *leaf = find_leaf(map, key);
+  if (!leaf)
+    return NULL;
+
+  size_t i = search(map, leaf, key, 0);
+  if (i >= leaf->count || compare(map, key_at(map, leaf, i), key) != 0)
+    return NULL;
+
+  return value_at(map, leaf, i);
+}
+
+int btree_map_has(const BTreeMap *map, const void *key) {
+  return btree_map_get(map, key) != NULL;
+}
+
+void btree_map_delete(BTreeMap *map, const void *key) {
+  assert(map != NULL);
+  assert(key != NULL);
+
+  if (!map->root || !remove_key(map, map->root, key))
+    return;
+
+  BTreeNode *root = map->root;
+  if (root->leaf && root->count == 0) {
+    alloc_free(root);
+    map->root = map->first = map->last = NULL;
+  } else if (!root->leaf && root->count == 0) {
+    // The root's children were merged into one, which becomes the root.
+    map->root = children(map, root)[0];
+    map->height--;
+    alloc_free(root);
+  }
+}
+
+// A node of the level being built, with the first key of its subtree.
+typedef struct LevelNode {
+  BTreeNode *node;
+  const void *min;
+} LevelNode;
+
+int btree_map_bulk_load(BTreeMap *map, const void *keys, const void *values,
+                        size_t count) {
+  assert(map != NULL);
+  assert(keys != NULL || count == 0);
+
+  if (map->root)
+    return EXIT_FAILURE;
+
+  const uint8_t *key_bytes = keys;
+  for (size_t i = 1; i < count; i++)
+    if (compare(map, key_bytes + (i - 1) * map->key_size,
+                key_bytes + i * map->key_size) >= 0)
+      return EXIT_FAILURE;
+
+  if (count == 0)
+    return EXIT_SUCCESS;
+
+  // Spreading the entries evenly keeps every node at least half full.
+  size_t leaves = (count + map->order - 1) / map->order;
+  LevelNode *level = alloc_malloc(leaves * sizeof(LevelNode));
+  if (!level)
+    return EXIT_FAILURE;
+
+  size_t done = 0;
+  for (size_t i = 0; i < leaves; i++) {
+    BTreeNode *leaf = node_init(map, 1);
+    if (!leaf) {
+      while (i > 0)
+        alloc_free(level[--i].node);
+      alloc_free(level);
+      return EXIT_FAILURE;
+    }
+
+    leaf->count = count / leaves + (i < count % leaves);
+    memcpy(key_at(map, leaf, 0), key_bytes + done * map->key_size,
+           leaf->count * map->key_size);
+    if (values)
+      memcpy(value_at(map, leaf, 0),
+             (const uint8_t *)values + done * map->value_size,
+             leaf->count * map->value_size);
+    else
+      memset(value_at(map, leaf, 0), 0, leaf->count * map->value_size);
+    done += leaf->count;
+
+    leaf->prev = i > 0 ? level[i - 1].node : NULL;
+    if (leaf->prev)
+      leaf->prev->next = leaf;
+
+    level[i].node = leaf;
+    level[i].min = key_at(map, leaf, 0);
+  }
+
+  map->first = level[0].node;
+  map->last = level[leaves - 1].node;
+  map->size = count;
+
+  // Build each level of branches from the one below, in place.
+  size_t nodes = leaves;
+  while (nodes > 1) {
+    size_t fanout = map->order + 1;
+    size_t branches = (nodes + fanout - 1) / fanout;
+
+    size_t child = 0;
+    for (size_t i = 0; i < branches; i++) {
+      BTreeNode *branch = node_init(map, 0);
+      if (!branch) {
+        // Free the branches built so far on this level and the whole level
+        // below, which holds the rest of the tree.
+        for (size_t j = 0; j < i; j++)
+          node_deinit(map, level[j].node);
+        for (size_t j = child; j < nodes; j++)
+          node_deinit(map, level[j].node);
+        alloc_free(level);
+        map->root = map->first = map->last = NULL;
+        map->size = 0;
+        map->height = 0;
+        return EXIT_FAILURE;
+      }
+
+      size_t n = nodes / branches + (i < nodes % branches);
+      branch->count = n - 1;
+      for (size_t j = 0; j < n; j++) {
+        children(map, branch)[j] = level[child + j].node;
+        if (j > 0)
+          memcpy(key_at(map, branch, j - 1), level[child + j].min,
+                 map->key_size);
+      }
+
+      const void *min = level[child].min;
+      child += n;
+      level[i].node = branch;
+      level[i].min = min;
+    }
+
+    nodes = branches;
+    map->height++;
+  }
+
+  map->root = level[0].node;
+  alloc_free(level);
+
+  return EXIT_SUCCESS;
+}
+
+int btree_map_floor(const BTreeMap *map, const void *key,
+                    BTreeMapEntry *result) {
+  assert(map != NULL);
+  assert(key != NULL);
+  assert(result != NULL);
+
+  BTreeNode *leaf = find_leaf(map, key);
+  if (!leaf)
+    return EXIT_FAILURE;
+
+  // Every key in the leaf may be greater, then it's the last of the previous.
+  size_t i = search(map, leaf, key, 1);
+  if (i == 0) {
+    leaf = leaf->prev;
+    if (!leaf)
+      return EXIT_FAILURE;
+    i = leaf->count;
+  }
+
+  result->key = key_at(map, leaf, i - 1);
+  result->value = value_at(map, leaf, i - 1);
+
+  return EXIT_SUCCESS;
+}
+
+BTreeMapIterator btree_map_iter(const BTreeMap *map) {
+  return btree_map_range(map, NULL, NULL);
+}
+
+BTreeMapIterator btree_map_seek(const BTreeMap *map, const void *key) {
+  return btree_map_range(map, key, NULL);
+}
+
+BTreeMapIterator btree_map_range(const BTreeMap *map, const void *start,
+                                 const void *end) {
+  assert(map != NULL);
+
+  BTreeMapIterator result = {0};
+  result.map = map;
+  result.end = end;
+
+  if (start) {
+    result.leaf = find_leaf(map, start);
+    if (result.leaf)
+      result.idx = search(map, result.leaf, start, 0);
+  } else {
+    result.leaf = map->first;
+  }
+
+  return result;
+}
+
+const BTreeMapEntry *btree_map_next(BTreeMapIterator *iterator) {
+  assert(iterator != NULL);
+
+  const BTreeMap *map = iterator->map;
+
+  // Move on to the next leaf, the seek may also have left the index at the
+  // end of a leaf.
+  if (iterator->leaf && iterator->idx >= iterator->leaf->count) {
+    iterator->leaf = iterator->leaf->next;
+    iterator->idx = 0;
+  }
+
+  if (!iterator->leaf)
+    return NULL;
+
+  const void *key = key_at(map, iterator->leaf, iterator->idx);
+  if (iterator->end && compare(map, key, iterator->end) >= 0) {
+    iterator->leaf = NULL;
+    return NULL;
+  }
+
+  iterator->entry.key = key;
+  iterator->entry.value = value_at(map, iterator->leaf, iterator->idx);
+  iterator->idx++;
+
+  return &iterator->entry;
+}
+
+static size_t count_nodes(const BTreeMap *map, const BTreeNode *node) {
+  size_t result = 1;
+  if (!node->leaf)
+    for (size_t i = 0; i <= node->count; i++)
+      result += count_nodes(map, children(map, node)[i]);
+
+  return result;
+}
+
+size_t btree_map_memory_usage(const BTreeMap *map) {
+  assert(map != NULL);
+
+  if (!map->root)
+    return 0;
+
+  return count_nodes(map, map->root) * node_bytes(map);
+}
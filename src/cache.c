@@ -0,0 +1,472 @@
+/**
+ * cache.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _POSIX_C_SOURCE 199309L
+
+#include "mylib/cache.h"
+#include "mylib/alloc.h"
+
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_SHARD_COUNT 16
+
+// The key and value follow the entry in the same allocation, each starting on
+// this alignment.
+#define ENTRY_ALIGN 16
+#define ALIGN_UP(n) (((n) + ENTRY_ALIGN - 1) & ~(size_t)(ENTRY_ALIGN - 1))
+
+typedef struct CacheEntry {
+  IntrusiveListLink link;
+  uint64_t expires_at; // 0 if it never expires.
+  size_t charge;
+  int referenced; // CLOCK only.
+} CacheEntry;
+
+static uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t now(const Cache *cache) {
+  return cache->options.now ? cache->options.now() : monotonic_ns();
+}
+
+static void *entry_key(CacheEntry *entry) {
+  return (uint8_t *)entry + ALIGN_UP(sizeof(CacheEntry));
+}
+
+static void *entry_value(const Cache *cache, CacheEntry *entry) {
+  return (uint8_t *)entry_key(entry) + ALIGN_UP(cache->key_size);
+}
+
+static size_t entry_bytes(const Cache *cache) {
+  return ALIGN_UP(sizeof(CacheEntry)) + ALIGN_UP(cache->key_size) +
+         cache->value_size;
+}
+
+static CacheEntry *link_entry(IntrusiveListLink *link) {
+  return intrusive_list_entry(link, CacheEntry, link);
+}
+
+static int expired(const CacheEntry *entry, uint64_t time) {
+  return entry->expires_at && entry->expires_at <= time;
+}
+
+// Unlinks and frees `entry`, keeping the CLOCK hand off of it.
+static void remove_entry(Cache *cache, CacheEntry *entry) {
+  if (cache->hand == &entry->link)
+    cache->hand = intrusive_list_next(&cache->list, &entry->link);
+
+  hash_map_delete(&cache->map, entry_key(entry));
+  intrusive_list_remove(&cache->list, &entry->link);
+  cache->bytes -= entry->charge;
+  alloc_free(entry);
+}
+
+static void evict_entry(Cache *cache, CacheEntry *entry,
+                        CacheEvictReason reason) {
+  if (reason == CACHE_EVICT_EXPIRED)
+    cache->stats.expirations++;
+  else
+    cache->stats.evictions++;
+
+  if (cache->options.on_evict)
+    cache->options.on_evict(entry_key(entry), entry_value(cache, entry), reason,
+                            cache->options.ctx);
+
+  remove_entry(cache, entry);
+}
+
+// Picks the entry to evict next, other than `keep`.
+static CacheEntry *victim(Cache *cache, const CacheEntry *keep) {
+  if (cache->options.policy == CACHE_POLICY_LRU)
+    return link_entry(intrusive_list_last(&cache->list));
+
+  // Give every referenced entry a second chance, at worst this clears every
+  // bit and comes back around to where it started. The entry being put is
+  // passed over, or a sweep that cleared every other bit would evict it.
+  for (;;) {
+    if (!cache->hand)
+      cache->hand = intrusive_list_first(&cache->list);
+
+    CacheEntry *entry = link_entry(cache->hand);
+    if (entry != keep) {
+      if (!entry->referenced)
+        return entry;
+      entry->referenced = 0;
+    }
+
+    cache->hand = intrusive_list_next(&cache->list, cache->hand);
+  }
+}
+
+static int over_limit(const Cache *cache) {
+  return (cache->options.max_entries &&
+          cache->list.size > cache->options.max_entries) ||
+         (cache->options.max_bytes && cache->bytes > cache->options.max_bytes);
+}
+
+// Evicts until the cache is within its limits. `keep` fits on its own, so it
+// is never the last entry left over the limit.
+static void evict(Cache *cache, uint64_t time, const CacheEntry *keep) {
+  while (cache->list.size && over_limit(cache)) {
+    CacheEntry *entry = victim(cache, keep);
+    evict_entry(cache, entry,
+                expired(entry, time) ? CACHE_EVICT_EXPIRED
+                                     : CACHE_EVICT_CAPACITY);
+  }
+}
+
+// Marks `entry` as just used.
+static void touch(Cache *cache, CacheEntry *entry) {
+  if (cache->options.policy == CACHE_POLICY_LRU)
+    intrusive_list_move_to_front(&cache->list, &entry->link);
+  else
+    entry->referenced = 1;
+}
+
+int cache_init(Cache *result, HashMapHash64Fn hash, HashMapEqlFn eql,
+               size_t key_size, size_t value_size,
+               const CacheOptions *options) {
+  assert(result != NULL);
+  assert(hash != NULL);
+  assert(eql != NULL);
+
+  *result = (Cache){0};
+  result->key_size = key_size;
+  result->value_size = value_size;
+  if (options)
+    result->options = *options;
+
+  HashMapOptions map_options = {.storage = HASH_MAP_STORE_BORROW};
+  if (hash_map_init_with_options(&result->map, hash, eql, key_size,
+                                 sizeof(CacheEntry), &map_options))
+    return EXIT_FAILURE;
+
+  intrusive_list_init(&result->list);
+
+  return EXIT_SUCCESS;
+}
+
+void cache_deinit(Cache *cache) {
+  assert(cache != NULL);
+
+  cache_clear(cache);
+  hash_map_deinit(&cache->map);
+}
+
+void cache_clear(Cache *cache) {
+  assert(cache != NULL);
+
+  IntrusiveListLink *link;
+  while ((link = intrusive_list_pop_first(&cache->list)))
+    alloc_free(link_entry(link));
+
+  hash_map_clear(&cache->map);
+  cache->hand = NULL;
+  cache->bytes = 0;
+}
+
+size_t cache_count(const Cache *cache) {
+  assert(cache != NULL);
+  return cache->list.size;
+}
+
+void *cache_get(Cache *cache, const void *key) {
+  assert(cache != NULL);
+  assert(key != NULL);
+
+  uint64_t start = cache->options.measure_latency ? monotonic_ns() : 0;
+  void *result = NULL;
+
+  CacheEntry *entry = hash_map_get_value(&cache->map, key);
+  if (entry && entry->expires_at && expired(entry, now(cache))) {
+    evict_entry(cache, entry, CACHE_EVICT_EXPIRED);
+    entry = NULL;
+  }
+
+  if (entry) {
+    touch(cache, entry);
+    result = entry_value(cache, entry);
+    cache->stats.hits++;
+  } else {
+    cache->stats.misses++;
+  }
+
+  if (cache->options.measure_latency)
+    cache->stats.get_ns += monotonic_ns() - start;
+
+  return result;
+}
+
+int cache_put(Cache *cache, const void *key, const void *value) {
+  return cache_put_with(cache, key, value, 0, 0);
+}
+
+int cache_put_with(Cache *cache, const void *key, const void *value,
+                   uint64_t ttl_ns, size_t charge) {
+  assert(cache != NULL);
+  assert(key != NULL);
+
+  uint64_t start = cache->options.measure_latency ? monotonic_ns() : 0;
+
+  if (!ttl_ns)
+    ttl_ns = cache->options.ttl_ns ? cache->options.ttl_ns : CACHE_NO_TTL;
+  if (!charge)
+    charge = cache->key_size + cache->value_size;
+
+  // It could never fit, and evicting for it would empty the cache first.
+  if (cache->options.max_bytes && charge > cache->options.max_bytes)
+    return EXIT_FAILURE;
+
+  // Only read the clock when there is something that can expire.
+  uint64_t time = 0;
+  if (ttl_ns != CACHE_NO_TTL || cache->options.ttl_ns)
+    time = now(cache);
+
+  CacheEntry *entry = hash_map_get_value(&cache->map, key);
+  if (entry) {
+    cache->bytes -= entry->charge;
+    touch(cache, entry);
+  } else {
+    entry = alloc_malloc(entry_bytes(cache));
+    if (!entry)
+      return EXIT_FAILURE;
+
+    memcpy(entry_key(entry), key, cache->key_size);
+    if (hash_map_put(&cache->map, entry_key(entry), entry)) {
+      alloc_free(entry);
+      return EXIT_FAILURE;
+    }
+
+    // New CLOCK entries go just behind the hand so they are looked at last, a
+    // NULL hand starts again from the first entry.
+    if (cache->options.policy == CACHE_POLICY_LRU)
+      intrusive_list_prepend(&cache->list, &entry->link);
+    else if (cache->hand)
+      intrusive_list_insert_before(&cache->list, cache->hand, &entry->link);
+    else
+      intrusive_list_append(&cache->list, &entry->link);
+    entry->referenced = 0;
+    cache->stats.inserts++;
+  }
+
+  memcpy(entry_value(cache, entry), value, cache->value_size);
+  entry->expires_at = ttl_ns == CACHE_NO_TTL ? 0 : time + ttl_ns;
+  entry->charge = charge;
+  cache->bytes += charge;
+
+  evict(cache, time, entry);
+
+  if (cache->options.measure_latency)
+    cache->stats.put_ns += monotonic_ns() - start;
+
+  return EXIT_SUCCESS;
+}
+
+void cache_delete(Cache *cache, const void *key) {
+  assert(cache != NULL);
+  assert(key != NULL);
+
+  CacheEntry *entry = hash_map_get_value(&cache->map, key);
+  if (entry)
+    remove_entry(cache, entry);
+}
+
+int cache_stats(const Cache *cache, CacheStats *result) {
+  assert(cache != NULL);
+  assert(result != NULL);
+
+  *result = cache->stats;
+  result->size = cache->list.size;
+  result->bytes = cache->bytes;
+
+  return EXIT_SUCCESS;
+}
+
+void cache_stats_reset(Cache *cache) {
+  assert(cache != NULL);
+  cache->stats = (CacheStats){0};
+}
+
+// The HashMap index plus one allocation per entry.
+size_t cache_memory_usage(const Cache *cache) {
+  assert(cache != NULL);
+
+  return hash_map_memory_usage(&cache->map) +
+         cache->list.size * entry_bytes(cache);
+}
+
+static CacheShard *shard_of(ShardedCache *cache, const void *key) {
+  // The HashMap inside each shard indexes by the high bits of the hash, so
+  // pick the shard with the low bits.
+  return &cache->shards[cache->hash(key) & (cache->shard_count - 1)];
+}
+
+// Divides a limit between `shards`, rounding up so the sum is at least the
+// limit.
+static size_t share(size_t limit, size_t shards) {
+  return limit ? (limit + shards - 1) / shards : 0;
+}
+
+int sharded_cache_init(ShardedCache *result, HashMapHash64Fn hash,
+                       HashMapEqlFn eql, size_t key_size, size_t value_size,
+                       size_t shard_count, const CacheOptions *options) {
+  assert(result != NULL);
+  assert(hash != NULL);
+
+  *result = (ShardedCache){0};
+  result->hash = hash;
+
+  if (!shard_count)
+    shard_count = DEFAULT_SHARD_COUNT;
+  size_t count = 1;
+  while (count < shard_count)
+    count *= 2;
+
+  CacheOptions shard_options = {0};
+  if (options)
+    shard_options = *options;
+  shard_options.max_entries = share(shard_options.max_entries, count);
+  shard_options.max_bytes = share(shard_options.max_bytes, count);
+
+  result->shards = alloc_calloc(count, sizeof(CacheShard));
+  if (!result->shards)
+    return EXIT_FAILURE;
+
+  for (; result->shard_count < count; result->shard_count++) {
+    CacheShard *shard = &result->shards[result->shard_count];
+    if (cache_init(&shard->cache, hash, eql, key_size, value_size,
+                   &shard_options))
+      goto err;
+
+    if (pthread_mutex_init(&shard->lock, NULL)) {
+      cache_deinit(&shard->cache);
+      goto err;
+    }
+  }
+
+  return EXIT_SUCCESS;
+
+err:
+  sharded_cache_deinit(result);
+
+  return EXIT_FAILURE;
+}
+
+void sharded_cache_deinit(ShardedCache *cache) {
+  assert(cache != NULL);
+
+  for (size_t i = 0; i < cache->shard_count; i++) {
+    cache_deinit(&cache->shards[i].cache);
+    pthread_mutex_destroy(&cache->shards[i].lock);
+  }
+
+  alloc_free(cache->shards);
+  cache->shards = NULL;
+  cache->shard_count = 0;
+}
+
+size_t sharded_cache_count(ShardedCache *cache) {
+  assert(cache != NULL);
+
+  size_t count = 0;
+  for (size_t i = 0; i < cache->shard_count; i++) {
+    CacheShard *shard = &cache->shards[i];
+    pthread_mutex_lock(&shard->lock);
+    count += cache_count(&shard->cache);
+    pthread_mutex_unlock(&shard->lock);
+  }
+
+  return count;
+}
+
+int sharded_cache_get(ShardedCache *cache, const void *key, void *value) {
+  assert(cache != NULL);
+  assert(value != NULL);
+
+  CacheShard *shard = shard_of(cache, key);
+  pthread_mutex_lock(&shard->lock);
+
+  void *found = cache_get(&shard->cache, key);
+  if (found)
+    memcpy(value, found, shard->cache.value_size);
+
+  pthread_mutex_unlock(&shard->lock);
+
+  return found != NULL;
+}
+
+int sharded_cache_put(ShardedCache *cache, const void *key, const void *value) {
+  return sharded_cache_put_with(cache, key, value, 0, 0);
+}
+
+int sharded_cache_put_with(ShardedCache *cache, const void *key,
+                           const void *value, uint64_t ttl_ns, size_t charge) {
+  assert(cache != NULL);
+
+  CacheShard *shard = shard_of(cache, key);
+  pthread_mutex_lock(&shard->lock);
+  int result = cache_put_with(&shard->cache, key, value, ttl_ns, charge);
+  pthread_mutex_unlock(&shard->lock);
+
+  return result;
+}
+
+void sharded_cache_delete(ShardedCache *cache, const void *key) {
+  assert(cache != NULL);
+
+  CacheShard *shard = shard_of(cache, key);
+  pthread_mutex_lock(&shard->lock);
+  cache_delete(&shard->cache, key);
+  pthread_mutex_unlock(&shard->lock);
+}
+
+int sharded_cache_stats(ShardedCache *cache, CacheStats *result) {
+  assert(cache != NULL);
+  assert(result != NULL);
+
+  *result = (CacheStats){0};
+  for (size_t i = 0; i < cache->shard_count; i++) {
+    CacheShard *shard = &cache->shards[i];
+    CacheStats stats;
+
+    pthread_mutex_lock(&shard->lock);
+    cache_stats(&shard->cache, &stats);
+    pthread_mutex_unlock(&shard->lock);
+
+    result->size += stats.size;
+    result->bytes += stats.bytes;
+    result->hits += stats.hits;
+    result->misses += stats.misses;
+    result->inserts += stats.inserts;
+    result->evictions += stats.evictions;
+    result->expirations += stats.expirations;
+    result->get_ns += stats.get_ns;
+    result->put_ns += stats.put_ns;
+  }
+
+  return EXIT_SUCCESS;
+}
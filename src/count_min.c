@@ -0,0 +1,313 @@
+/**
+ * count_min.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/count_min.h"
+#include "mylib/alloc.h"
+#include "mylib/hash.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#define MAGIC 0x544B534D434C594DULL // "MYLCMSKT"
+#define VERSION 1
+
+// Hashes added at once by the batch functions, enough for the prefetches of
+// one row to be in flight together.
+#define BATCH 16
+
+// See hash_map.c, spreads a 64-bit hash into one for each row.
+#define FIBONACCI_64 0x9E3779B97F4A7C15ULL
+
+typedef struct CountMinHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t kind;
+  uint64_t width;
+  uint64_t depth;
+  int64_t total;
+} CountMinHeader;
+
+// The MurmurHash3 finalizer.
+static uint64_t finalize(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// An independent-looking hash for each row.
+static uint64_t row_hash(uint64_t hash, size_t row) {
+  return finalize(hash + (row + 1) * FIBONACCI_64);
+}
+
+// Lemire's fastrange, the high bits pick the counter.
+static size_t column_of(const CountMin *cm, uint64_t hash) {
+#ifdef __SIZEOF_INT128__
+  return (unsigned __int128)hash * cm->width >> 64;
+#else
+  return hash % cm->width;
+#endif
+}
+
+// The low bit picks the sign in a Count sketch, independent of the column.
+static int64_t signed_count(const CountMin *cm, uint64_t hash, int64_t count) {
+  if (cm->kind == COUNT_MIN_COUNT_SKETCH && !(hash & 1))
+    return -count;
+  return count;
+}
+
+static int64_t *row_of(const CountMin *cm, size_t row) {
+  return cm->counters + row * cm->width;
+}
+
+static size_t counter_count(const CountMin *cm) {
+  return cm->width * cm->depth;
+}
+
+int count_min_init(CountMin *result, size_t width, size_t depth,
+                   CountMinKind kind) {
+  assert(result != NULL);
+
+  *result = (CountMin){0};
+
+  if (!width || !depth || depth > COUNT_MIN_MAX_DEPTH)
+    return EXIT_FAILURE;
+
+  if (!(result->counters = alloc_calloc(width * depth, sizeof(int64_t))))
+    return EXIT_FAILURE;
+
+  result->width = width;
+  result->depth = depth;
+  result->kind = kind;
+
+  return EXIT_SUCCESS;
+}
+
+int count_min_init_with_error(CountMin *result, double epsilon, double delta,
+                              CountMinKind kind) {
+  assert(result != NULL);
+
+  *result = (CountMin){0};
+
+  if (!(epsilon > 0 && epsilon < 1 && delta > 0 && delta < 1))
+    return EXIT_FAILURE;
+
+  size_t width = (size_t)ceil(exp(1) / epsilon);
+  size_t depth = (size_t)ceil(log(1 / delta));
+
+  return count_min_init(result, width, depth, kind);
+}
+
+void count_min_deinit(CountMin *cm) {
+  assert(cm != NULL);
+
+  alloc_free(cm->counters);
+  cm->counters = NULL;
+}
+
+void count_min_clear(CountMin *cm) {
+  assert(cm != NULL);
+
+  memset(cm->counters, 0, counter_count(cm) * sizeof(int64_t));
+  cm->total = 0;
+}
+
+void count_min_add_hash(CountMin *cm, uint64_t hash, int64_t count) {
+  assert(cm != NULL);
+
+  for (size_t row = 0; row < cm->depth; row++) {
+    uint64_t h = row_hash(hash, row);
+    row_of(cm, row)[column_of(cm, h)] += signed_count(cm, h, count);
+  }
+
+  cm->total += count;
+}
+
+void count_min_add(CountMin *cm, const void *key, size_t size, int64_t count) {
+  count_min_add_hash(cm, xxh64_hash(key, size, 0), count);
+}
+
+void count_min_add_hashes(CountMin *cm, const uint64_t *hashes, size_t count) {
+  assert(cm != NULL);
+  assert(hashes != NULL || count == 0);
+
+  size_t columns[BATCH];
+  int64_t deltas[BATCH];
+
+  for (size_t start = 0; start < count; start += BATCH) {
+    size_t n = count - start < BATCH ? count - start : BATCH;
+
+    // Every counter of a batch is touched at random, so fetch a row's worth
+    // before updating any of them rather than missing the cache one by one.
+    for (size_t row = 0; row < cm->depth; row++) {
+      int64_t *counters = row_of(cm, row);
+
+      for (size_t i = 0; i < n; i++) {
+        uint64_t h = row_hash(hashes[start + i], row);
+        columns[i] = column_of(cm, h);
+        deltas[i] = signed_count(cm, h, 1);
+        __builtin_prefetch(&counters[columns[i]], 1);
+      }
+
+      for (size_t i = 0; i < n; i++)
+        counters[columns[i]] += deltas[i];
+    }
+  }
+
+  cm->total += count;
+}
+
+void count_min_add_many(CountMin *cm, const void *keys, size_t key_size,
+                        size_t count) {
+  assert(keys != NULL || count == 0);
+
+  const uint8_t *key = keys;
+  uint64_t hashes[BATCH];
+
+  for (size_t start = 0; start < count; start += BATCH) {
+    size_t n = count - start < BATCH ? count - start : BATCH;
+    for (size_t i = 0; i < n; i++, key += key_size)
+      hashes[i] = xxh64_hash(key, key_size, 0);
+
+    count_min_add_hashes(cm, hashes, n);
+  }
+}
+
+// An insertion sort, there are only a few rows.
+static void sort_estimates(int64_t *estimates, size_t count) {
+  for (size_t i = 1; i < count; i++) {
+    int64_t value = estimates[i];
+    size_t j = i;
+    for (; j > 0 && estimates[j - 1] > value; j--)
+      estimates[j] = estimates[j - 1];
+    estimates[j] = value;
+  }
+}
+
+int64_t count_min_estimate_hash(const CountMin *cm, uint64_t hash) {
+  assert(cm != NULL);
+
+  int64_t estimates[COUNT_MIN_MAX_DEPTH];
+  for (size_t row = 0; row < cm->depth; row++) {
+    uint64_t h = row_hash(hash, row);
+    estimates[row] = signed_count(cm, h, row_of(cm, row)[column_of(cm, h)]);
+  }
+
+  if (cm->kind == COUNT_MIN_SKETCH) {
+    int64_t min = INT64_MAX;
+    for (size_t row = 0; row < cm->depth; row++) {
+      if (estimates[row] < min)
+        min = estimates[row];
+    }
+    return min;
+  }
+
+  sort_estimates(estimates, cm->depth);
+
+  size_t mid = cm->depth / 2;
+  if (cm->depth % 2)
+    return estimates[mid];
+  return (estimates[mid - 1] + estimates[mid]) / 2;
+}
+
+int64_t count_min_estimate(const CountMin *cm, const void *key, size_t size) {
+  return count_min_estimate_hash(cm, xxh64_hash(key, size, 0));
+}
+
+int count_min_merge(CountMin *dst, const CountMin *src) {
+  assert(dst != NULL);
+  assert(src != NULL);
+
+  if (dst->width != src->width || dst->depth != src->depth ||
+      dst->kind != src->kind)
+    return EXIT_FAILURE;
+
+  for (size_t i = 0; i < counter_count(dst); i++)
+    dst->counters[i] += src->counters[i];
+  dst->total += src->total;
+
+  return EXIT_SUCCESS;
+}
+
+size_t count_min_memory_usage(const CountMin *cm) {
+  assert(cm != NULL);
+  return counter_count(cm) * sizeof(int64_t);
+}
+
+size_t count_min_serialized_size(const CountMin *cm) {
+  assert(cm != NULL);
+  return sizeof(CountMinHeader) + counter_count(cm) * sizeof(int64_t);
+}
+
+int count_min_serialize(const CountMin *cm, void *buffer, size_t size) {
+  assert(cm != NULL);
+  assert(buffer != NULL);
+
+  if (size < count_min_serialized_size(cm))
+    return EXIT_FAILURE;
+
+  CountMinHeader header = {0};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.kind = cm->kind;
+  header.width = cm->width;
+  header.depth = cm->depth;
+  header.total = cm->total;
+
+  uint8_t *out = buffer;
+  memcpy(out, &header, sizeof(header));
+  memcpy(out + sizeof(header), cm->counters,
+         counter_count(cm) * sizeof(int64_t));
+
+  return EXIT_SUCCESS;
+}
+
+int count_min_deserialize(CountMin *result, const void *buffer, size_t size) {
+  assert(result != NULL);
+  assert(buffer != NULL);
+
+  *result = (CountMin){0};
+
+  CountMinHeader header;
+  if (size < sizeof(header))
+    return EXIT_FAILURE;
+  memcpy(&header, buffer, sizeof(header));
+
+  // Checked before multiplying so that a bad header can't overflow.
+  size_t max_width = (SIZE_MAX / sizeof(int64_t)) / COUNT_MIN_MAX_DEPTH;
+  if (header.magic != MAGIC || header.version != VERSION ||
+      header.kind > COUNT_MIN_COUNT_SKETCH || header.width > max_width ||
+      header.depth > COUNT_MIN_MAX_DEPTH ||
+      size - sizeof(header) != header.width * header.depth * sizeof(int64_t))
+    return EXIT_FAILURE;
+
+  if (count_min_init(result, header.width, header.depth, header.kind))
+    return EXIT_FAILURE;
+
+  memcpy(result->counters, (const uint8_t *)buffer + sizeof(header),
+         counter_count(result) * sizeof(int64_t));
+  result->total = header.total;
+
+  return EXIT_SUCCESS;
+}
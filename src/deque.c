@@ -0,0 +1,204 @@
+/**
+ * deque.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/deque.h"
+#include "mylib/alloc.h"
+#include <assert.h>
+#include <string.h>
+
+#define DEFAULT_INIT_CAPACITY 4
+
+// Round up to the next power of two, 0 becomes 1.
+static size_t round_up_pow2(size_t n) {
+  size_t result = 1;
+  while (result < n)
+    result <<= 1;
+  return result;
+}
+
+static size_t wrap(const Deque *deque, size_t idx) {
+  return idx & (deque->capacity - 1);
+}
+
+static void *get_offset(Deque *deque, size_t idx) {
+  return deque->data + (wrap(deque, deque->head + idx) * deque->element_size);
+}
+
+static const void *get_offset_const(const Deque *deque, size_t idx) {
+  return deque->data + (wrap(deque, deque->head + idx) * deque->element_size);
+}
+
+static int grow(Deque *deque) {
+  size_t old_capacity = deque->capacity;
+  size_t new_capacity = old_capacity * 2;
+
+  void *data = alloc_realloc(deque->data, new_capacity * deque->element_size);
+  if (!data)
+    return EXIT_FAILURE;
+  deque->data = data;
+  deque->capacity = new_capacity;
+
+  // If the elements wrapped around the end of the old buffer, move the
+  // wrapped part to the newly allocated space directly after the old end so
+  // that they are contiguous again.
+  if (deque->head + deque->size > old_capacity) {
+    size_t wrapped = deque->head + deque->size - old_capacity;
+    memcpy(deque->data + old_capacity * deque->element_size, deque->data,
+           wrapped * deque->element_size);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+static int try_grow(Deque *deque) {
+  return deque->size >= deque->capacity ? grow(deque) : EXIT_SUCCESS;
+}
+
+int deque_init_with_capacity(Deque *result, size_t element_size,
+                             size_t capacity) {
+  assert(result != NULL);
+
+  *result = (Deque){0};
+
+  capacity = round_up_pow2(capacity);
+
+  result->data = alloc_malloc(capacity * element_size);
+  if (!result->data)
+    return EXIT_FAILURE;
+
+  result->capacity = capacity;
+  result->element_size = element_size;
+
+  return EXIT_SUCCESS;
+}
+
+int deque_init(Deque *result, size_t element_size) {
+  return deque_init_with_capacity(result, element_size, DEFAULT_INIT_CAPACITY);
+}
+
+void deque_deinit(Deque *deque) {
+  assert(deque != NULL);
+
+  alloc_free(deque->data);
+}
+
+size_t deque_len(const Deque *deque) {
+  assert(deque != NULL);
+  return deque->size;
+}
+
+size_t deque_memory_usage(const Deque *deque) {
+  assert(deque != NULL);
+  return deque->capacity * deque->element_size;
+}
+
+int deque_push_back(Deque *deque, void *element) {
+  assert(deque != NULL);
+  assert(element != NULL);
+
+  if (try_grow(deque))
+    return EXIT_FAILURE;
+
+  memcpy(get_offset(deque, deque->size), element, deque->element_size);
+  deque->size++;
+
+  return EXIT_SUCCESS;
+}
+
+int deque_push_front(Deque *deque, void *element) {
+  assert(deque != NULL);
+  assert(element != NULL);
+
+  if (try_grow(deque))
+    return EXIT_FAILURE;
+
+  // Step the head back one, wrapping to the end of the buffer.
+  deque->head = wrap(deque, deque->head - 1);
+  memcpy(get_offset(deque, 0), element, deque->element_size);
+  deque->size++;
+
+  return EXIT_SUCCESS;
+}
+
+int deque_pop_back(Deque *deque, void *result) {
+  assert(deque != NULL);
+
+  if (deque->size == 0)
+    return EXIT_FAILURE;
+
+  deque->size--;
+  if (result)
+    memcpy(result, get_offset(deque, deque->size), deque->element_size);
+
+  return EXIT_SUCCESS;
+}
+
+int deque_pop_front(Deque *deque, void *result) {
+  assert(deque != NULL);
+
+  if (deque->size == 0)
+    return EXIT_FAILURE;
+
+  if (result)
+    memcpy(result, get_offset(deque, 0), deque->element_size);
+  deque->head = wrap(deque, deque->head + 1);
+  deque->size--;
+
+  return EXIT_SUCCESS;
+}
+
+int deque_assign(Deque *deque, size_t idx, void *element) {
+  assert(deque != NULL);
+  assert(element != NULL);
+
+  if (idx >= deque->size)
+    return EXIT_FAILURE;
+
+  memcpy(get_offset(deque, idx), element, deque->element_size);
+
+  return EXIT_SUCCESS;
+}
+
+void *deque_get(Deque *deque, size_t idx) {
+  assert(deque != NULL);
+
+  if (idx >= deque->size)
+    return NULL;
+
+  return get_offset(deque, idx);
+}
+
+const void *deque_get_const(const Deque *deque, size_t idx) {
+  assert(deque != NULL);
+
+  if (idx >= deque->size)
+    return NULL;
+
+  return get_offset_const(deque, idx);
+}
+
+void deque_clear(Deque *deque) {
+  assert(deque != NULL);
+
+  deque->head = 0;
+  deque->size = 0;
+}
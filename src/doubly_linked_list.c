@@ -0,0 +1,241 @@
+/**
+ * doubly_linked_list.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/doubly_linked_list.h"
+#include "mylib/alloc.h"
+#include <assert.h>
+#include <string.h>
+
+DoublyLinkedListNode *doubly_linked_list_node_init(void *data,
+                                                   size_t element_size) {
+  assert(data != NULL);
+
+  DoublyLinkedListNode *result = alloc_calloc(1, sizeof(DoublyLinkedListNode));
+  if (!result)
+    return NULL;
+
+  result->data = alloc_malloc(element_size);
+  if (!result->data) {
+    alloc_free(result);
+    return NULL;
+  }
+
+  memcpy(result->data, data, element_size);
+
+  return result;
+}
+
+void doubly_linked_list_node_deinit(DoublyLinkedListNode *node) {
+  assert(node != NULL);
+
+  alloc_free(node->data);
+  alloc_free(node);
+}
+
+DoublyLinkedList doubly_linked_list_init() { return (DoublyLinkedList){0}; }
+
+size_t doubly_linked_list_len(const DoublyLinkedList *list) {
+  assert(list != NULL);
+  return list->size;
+}
+
+size_t doubly_linked_list_memory_usage(const DoublyLinkedList *list,
+                                       size_t element_size) {
+  assert(list != NULL);
+  return list->size * (sizeof(DoublyLinkedListNode) + element_size);
+}
+
+DoublyLinkedListNode *doubly_linked_list_pop_first(DoublyLinkedList *list) {
+  assert(list != NULL);
+
+  DoublyLinkedListNode *first;
+  if (!(first = list->first))
+    return NULL;
+
+  doubly_linked_list_unlink(list, first);
+
+  return first;
+}
+
+DoublyLinkedListNode *doubly_linked_list_pop_last(DoublyLinkedList *list) {
+  assert(list != NULL);
+
+  DoublyLinkedListNode *last;
+  if (!(last = list->last))
+    return NULL;
+
+  doubly_linked_list_unlink(list, last);
+
+  return last;
+}
+
+void doubly_linked_list_clear(DoublyLinkedList *list) {
+  assert(list != NULL);
+
+  DoublyLinkedListNode *node = list->first;
+  while (node) {
+    DoublyLinkedListNode *next = node->next;
+    doubly_linked_list_node_deinit(node);
+    node = next;
+  }
+
+  *list = doubly_linked_list_init();
+}
+
+void doubly_linked_list_deinit(DoublyLinkedList *list) {
+  doubly_linked_list_clear(list);
+}
+
+int doubly_linked_list_prepend_node(DoublyLinkedList *list,
+                                    DoublyLinkedListNode *node) {
+  assert(list != NULL);
+  assert(node != NULL);
+
+  node->prev = NULL;
+  node->next = list->first;
+
+  if (list->first)
+    list->first->prev = node;
+  else
+    list->last = node;
+
+  list->first = node;
+  list->size++;
+
+  return EXIT_SUCCESS;
+}
+
+int doubly_linked_list_prepend(DoublyLinkedList *list, void *data,
+                               size_t element_size) {
+  assert(list != NULL);
+
+  DoublyLinkedListNode *node = doubly_linked_list_node_init(data, element_size);
+  if (!node)
+    return EXIT_FAILURE;
+
+  return doubly_linked_list_prepend_node(list, node);
+}
+
+int doubly_linked_list_append_node(DoublyLinkedList *list,
+                                   DoublyLinkedListNode *node) {
+  assert(list != NULL);
+  assert(node != NULL);
+
+  // Appending to an empty list is the same as prepending.
+  if (!list->last)
+    return doubly_linked_list_prepend_node(list, node);
+
+  return doubly_linked_list_insert_node_after(list, list->last, node);
+}
+
+int doubly_linked_list_append(DoublyLinkedList *list, void *data,
+                              size_t element_size) {
+  assert(list != NULL);
+
+  DoublyLinkedListNode *node = doubly_linked_list_node_init(data, element_size);
+  if (!node)
+    return EXIT_FAILURE;
+
+  return doubly_linked_list_append_node(list, node);
+}
+
+int doubly_linked_list_insert_node_after(DoublyLinkedList *list,
+                                         DoublyLinkedListNode *node,
+                                         DoublyLinkedListNode *new_node) {
+  assert(list != NULL);
+  assert(node != NULL);
+  assert(new_node != NULL);
+
+  new_node->prev = node;
+  new_node->next = node->next;
+
+  if (node->next)
+    node->next->prev = new_node;
+  else
+    list->last = new_node;
+
+  node->next = new_node;
+  list->size++;
+
+  return EXIT_SUCCESS;
+}
+
+int doubly_linked_list_insert_after(DoublyLinkedList *list,
+                                    DoublyLinkedListNode *node, void *data,
+                                    size_t element_size) {
+  assert(list != NULL);
+
+  DoublyLinkedListNode *new_node =
+      doubly_linked_list_node_init(data, element_size);
+  if (!new_node)
+    return EXIT_FAILURE;
+
+  return doubly_linked_list_insert_node_after(list, node, new_node);
+}
+
+void doubly_linked_list_unlink(DoublyLinkedList *list,
+                               DoublyLinkedListNode *node) {
+  assert(list != NULL);
+  assert(node != NULL);
+
+  // Relink the neighbours, or the ends of the list if there are none.
+  if (node->prev)
+    node->prev->next = node->next;
+  else
+    list->first = node->next;
+
+  if (node->next)
+    node->next->prev = node->prev;
+  else
+    list->last = node->prev;
+
+  node->prev = NULL;
+  node->next = NULL;
+  list->size--;
+}
+
+void doubly_linked_list_delete(DoublyLinkedList *list,
+                               DoublyLinkedListNode *node) {
+  doubly_linked_list_unlink(list, node);
+  doubly_linked_list_node_deinit(node);
+}
+
+void doubly_linked_list_splice(DoublyLinkedList *list,
+                               DoublyLinkedList *other) {
+  assert(list != NULL);
+  assert(other != NULL);
+
+  if (!other->first)
+    return;
+
+  if (list->last) {
+    list->last->next = other->first;
+    other->first->prev = list->last;
+  } else {
+    list->first = other->first;
+  }
+
+  list->last = other->last;
+  list->size += other->size;
+
+  *other = doubly_linked_list_init();
+}
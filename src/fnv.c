@@ -22,16 +22,26 @@
  */
 #include "mylib/bitset.h"
 #include "mylib/hash.h"
+#include <assert.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FNV_AVX2
+#include <immintrin.h>
+#endif
 
 const uint32_t PRIME_32 = 16777619;
 const uint32_t OFFSET_32 = 2166136261;
 
+const uint64_t PRIME_64 = 1099511628211ULL;
+const uint64_t OFFSET_64 = 14695981039346656037ULL;
+
 uint32_t fnv1a_32_init() { return OFFSET_32; }
 
 void fnv1a_32_update(uint32_t *val, const uint8_t *arr, size_t size) {
   for (size_t i = 0; i < size; i++) {
-    *val *= PRIME_32;
     *val ^= arr[i];
+    *val *= PRIME_32;
   }
 }
 
@@ -40,3 +50,108 @@ uint32_t fnv1a_32_hash(const uint8_t *arr, size_t size) {
   fnv1a_32_update(&val, arr, size);
   return val;
 }
+
+#ifdef FNV_AVX2
+// Hashes groups of 8 keys with one AVX2 lane per key. Bytes are fetched with
+// gathers of 4 bytes so the last group is left to the scalar loop if a gather
+// would read past the end of `keys`. Returns how many keys were hashed.
+__attribute__((target("avx2"))) static size_t
+hash_batch_avx2(const uint8_t *keys, size_t key_size, size_t count,
+                uint32_t *result) {
+  // The gather offsets are 32-bit.
+  if (key_size > INT32_MAX / 8)
+    return 0;
+
+  const __m256i offsets = _mm256_mullo_epi32(
+      _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(key_size));
+  const __m256i prime = _mm256_set1_epi32(PRIME_32);
+  const __m256i low_byte = _mm256_set1_epi32(0xFF);
+
+  size_t k = 0;
+  for (; (k + 8) * key_size + 3 <= count * key_size; k += 8) {
+    const uint8_t *group = keys + k * key_size;
+    __m256i val = _mm256_set1_epi32(OFFSET_32);
+
+    size_t j = 0;
+    for (; j + 4 <= key_size; j += 4) {
+      __m256i bytes =
+          _mm256_i32gather_epi32((const int *)(group + j), offsets, 1);
+      for (int shift = 0; shift < 32; shift += 8) {
+        __m256i byte = _mm256_and_si256(
+            _mm256_srli_epi32(bytes, shift), low_byte);
+        val = _mm256_mullo_epi32(_mm256_xor_si256(val, byte), prime);
+      }
+    }
+
+    for (; j < key_size; j++) {
+      __m256i bytes =
+          _mm256_i32gather_epi32((const int *)(group + j), offsets, 1);
+      __m256i byte = _mm256_and_si256(bytes, low_byte);
+      val = _mm256_mullo_epi32(_mm256_xor_si256(val, byte), prime);
+    }
+
+    _mm256_storeu_si256((__m256i *)(result + k), val);
+  }
+
+  return k;
+}
+#endif
+
+void fnv1a_32_hash_batch(const uint8_t *keys, size_t key_size, size_t count,
+                         uint32_t *result) {
+  assert(keys != NULL || count == 0);
+  assert(result != NULL || count == 0);
+
+  size_t k = 0;
+
+#ifdef FNV_AVX2
+  if (__builtin_cpu_supports("avx2"))
+    k = hash_batch_avx2(keys, key_size, count, result);
+#endif
+
+  for (; k < count; k++)
+    result[k] = fnv1a_32_hash(keys + k * key_size, key_size);
+}
+
+void fnv1a_32_hash_vector(const Vector *keys, uint32_t *result) {
+  assert(keys != NULL);
+
+  fnv1a_32_hash_batch(keys->data, keys->element_size, keys->size, result);
+}
+
+uint64_t fnv1a_64_init() { return OFFSET_64; }
+
+void fnv1a_64_update(uint64_t *val, const uint8_t *arr, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    *val ^= arr[i];
+    *val *= PRIME_64;
+  }
+}
+
+uint64_t fnv1a_64_hash(const uint8_t *arr, size_t size) {
+  uint64_t val = fnv1a_64_init();
+  fnv1a_64_update(&val, arr, size);
+  return val;
+}
+
+// Hash the little-endian bytes of the seed so that the result doesn't depend on
+// the platform.
+uint32_t fnv1a_32_init_seeded(uint32_t seed) {
+  uint8_t bytes[4];
+  for (size_t i = 0; i < sizeof(bytes); i++)
+    bytes[i] = seed >> (i * 8);
+
+  uint32_t val = fnv1a_32_init();
+  fnv1a_32_update(&val, bytes, sizeof(bytes));
+  return val;
+}
+
+uint64_t fnv1a_64_init_seeded(uint64_t seed) {
+  uint8_t bytes[8];
+  for (size_t i = 0; i < sizeof(bytes); i++)
+    bytes[i] = seed >> (i * 8);
+
+  uint64_t val = fnv1a_64_init();
+  fnv1a_64_update(&val, bytes, sizeof(bytes));
+  return val;
+}
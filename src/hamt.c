@@ -0,0 +1,619 @@
+/**
+ * hamt.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/hamt.h"
+#include "mylib/alloc.h"
+#include <assert.h>
+#include <string.h>
+
+#define BITS_PER_LEVEL 5
+#define LEVEL_MASK 31
+
+// See hash_map.c, spreads a 32-bit hash over a 64-bit one.
+#define FIBONACCI_64 0x9E3779B97F4A7C15ULL
+
+#define ALIGN8(x) (((x) + 7) & ~(size_t)7)
+
+// A node is followed by its children then its entries. Every entry is the
+// key's 64-bit hash then the key and value, padded to 8 bytes.
+//
+// Once all 64 bits of the hash have been used, keys with the same hash go in a
+// collision node, which has no bitmaps and a list of `collisions` entries.
+typedef struct HamtNode {
+  size_t refs;
+  uint32_t datamap;    // Slots holding an entry.
+  uint32_t nodemap;    // Slots holding a child.
+  uint32_t collisions; // Entries in a collision node, 0 in any other node.
+} HamtNode;
+
+static size_t popcount(uint32_t bits) { return __builtin_popcount(bits); }
+
+// The position among the set bits of `bitmap` of the slot for `bit`.
+static size_t index_of(uint32_t bitmap, uint32_t bit) {
+  return popcount(bitmap & (bit - 1));
+}
+
+static uint32_t bit_at(uint64_t hash, size_t shift) {
+  return 1u << ((hash >> shift) & LEVEL_MASK);
+}
+
+static size_t data_count(const HamtNode *node) {
+  return node->collisions ? node->collisions : popcount(node->datamap);
+}
+
+static size_t node_count(const HamtNode *node) {
+  return popcount(node->nodemap);
+}
+
+static HamtNode **children(const HamtNode *node) {
+  return (HamtNode **)(node + 1);
+}
+
+static uint8_t *entry_at(const Hamt *map, const HamtNode *node, size_t i) {
+  return (uint8_t *)(children(node) + node_count(node)) + i * map->entry_size;
+}
+
+static uint64_t entry_hash(const uint8_t *entry) {
+  uint64_t hash;
+  memcpy(&hash, entry, sizeof(hash));
+  return hash;
+}
+
+static void *entry_key(const uint8_t *entry) {
+  return (void *)(entry + sizeof(uint64_t));
+}
+
+static void *entry_value(const Hamt *map, const uint8_t *entry) {
+  return (void *)(entry + sizeof(uint64_t) + ALIGN8(map->key_size));
+}
+
+static void write_entry(const Hamt *map, uint8_t *entry, uint64_t hash,
+                        const void *key, const void *value) {
+  memcpy(entry, &hash, sizeof(hash));
+  memcpy(entry_key(entry), key, map->key_size);
+  memcpy(entry_value(map, entry), value, map->value_size);
+}
+
+static int entry_matches(const Hamt *map, const uint8_t *entry, uint64_t hash,
+                         const void *key) {
+  return entry_hash(entry) == hash && map->eql(key, entry_key(entry));
+}
+
+static uint64_t hash_key(const Hamt *map, const void *key) {
+  uint64_t hash =
+      map->hash64 ? map->hash64(key) : map->hash(key) * FIBONACCI_64;
+
+  // The MurmurHash3 finalizer, so that every level of the trie depends on
+  // every bit of the hash.
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+
+  return hash;
+}
+
+static size_t node_bytes(const Hamt *map, size_t entries, size_t nodes) {
+  return sizeof(HamtNode) + nodes * sizeof(HamtNode *) +
+         entries * map->entry_size;
+}
+
+static HamtNode *node_alloc(const Hamt *map, uint32_t datamap, uint32_t nodemap,
+                            uint32_t collisions) {
+  size_t entries = collisions ? collisions : popcount(datamap);
+  HamtNode *node = alloc_malloc(node_bytes(map, entries, popcount(nodemap)));
+  if (!node)
+    return NULL;
+
+  node->refs = 1;
+  node->datamap = datamap;
+  node->nodemap = nodemap;
+  node->collisions = collisions;
+  return node;
+}
+
+static void retain(HamtNode *node) {
+  __atomic_add_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+}
+
+// Drops a reference, freeing the node and releasing its children if it was
+// the last one. Snapshots may be released from any thread.
+static void release(HamtNode *node) {
+  if (!node || __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL))
+    return;
+
+  for (size_t i = 0; i < node_count(node); i++)
+    release(children(node)[i]);
+  alloc_free(node);
+}
+
+// Only the map holding the one reference can reach the node, so it can be
+// changed in place.
+static int owned(const HamtNode *node) {
+  return __atomic_load_n(&node->refs, __ATOMIC_ACQUIRE) == 1;
+}
+
+// Gives up the reference to `old` once `node` has been built from it. An
+// owned node's children are moved over and only `dropped`, which `node` no
+// longer points to, is released. Otherwise both nodes keep the children so
+// each is retained, apart from `fresh` which is new to `node`.
+static void consume(HamtNode *old, HamtNode *node, HamtNode *fresh,
+                    HamtNode *dropped) {
+  if (owned(old)) {
+    alloc_free(old);
+    release(dropped);
+    return;
+  }
+
+  for (size_t i = 0; i < node_count(node); i++) {
+    if (children(node)[i] != fresh)
+      retain(children(node)[i]);
+  }
+  release(old);
+}
+
+// Makes sure `*ref` is owned before it's changed in place, copying it if it's
+// shared with a snapshot.
+static int make_owned(const Hamt *map, HamtNode **ref) {
+  HamtNode *node = *ref;
+  if (owned(node))
+    return EXIT_SUCCESS;
+
+  HamtNode *copy =
+      node_alloc(map, node->datamap, node->nodemap, node->collisions);
+  if (!copy)
+    return EXIT_FAILURE;
+
+  // Everything but the count, which snapshots may be changing.
+  size_t bytes = node_bytes(map, data_count(node), node_count(node));
+  memcpy(copy + 1, node + 1, bytes - sizeof(HamtNode));
+  for (size_t i = 0; i < node_count(copy); i++)
+    retain(children(copy)[i]);
+  release(node);
+
+  *ref = copy;
+  return EXIT_SUCCESS;
+}
+
+// A node with the entry at `entry` and the new one, split apart at `shift`.
+static HamtNode *merge(const Hamt *map, const uint8_t *entry, uint64_t hash,
+                       const void *key, const void *value, size_t shift) {
+  uint64_t other = entry_hash(entry);
+  HamtNode *node;
+
+  if (shift >= 64) {
+    if (!(node = node_alloc(map, 0, 0, 2)))
+      return NULL;
+    memcpy(entry_at(map, node, 0), entry, map->entry_size);
+    write_entry(map, entry_at(map, node, 1), hash, key, value);
+    return node;
+  }
+
+  uint32_t bit = bit_at(hash, shift), other_bit = bit_at(other, shift);
+  if (bit != other_bit) {
+    if (!(node = node_alloc(map, bit | other_bit, 0, 0)))
+      return NULL;
+    size_t i = bit > other_bit;
+    write_entry(map, entry_at(map, node, i), hash, key, value);
+    memcpy(entry_at(map, node, !i), entry, map->entry_size);
+    return node;
+  }
+
+  HamtNode *child = merge(map, entry, hash, key, value, shift + BITS_PER_LEVEL);
+  if (!child)
+    return NULL;
+
+  if (!(node = node_alloc(map, 0, bit, 0))) {
+    release(child);
+    return NULL;
+  }
+  children(node)[0] = child;
+  return node;
+}
+
+// Copies the children of `old` into `node`, leaving a gap at `insert` or
+// skipping `remove`. Either can be SIZE_MAX.
+static void copy_children(const HamtNode *old, HamtNode *node, size_t insert,
+                          size_t remove) {
+  HamtNode **src = children(old), **dst = children(node);
+  for (size_t i = 0, j = 0; i < node_count(old); i++) {
+    if (j == insert)
+      j++;
+    if (i != remove)
+      dst[j++] = src[i];
+  }
+}
+
+static void copy_entries(const Hamt *map, const HamtNode *old, HamtNode *node,
+                         size_t insert, size_t remove) {
+  for (size_t i = 0, j = 0; i < data_count(old); i++) {
+    if (j == insert)
+      j++;
+    if (i != remove)
+      memcpy(entry_at(map, node, j++), entry_at(map, old, i), map->entry_size);
+  }
+}
+
+// Rebuilds `old` with its slot for `bit` changed to hold an entry, a child or
+// neither. An entry is copied from `entry` unless it's NULL, in which case the
+// caller writes it.
+static HamtNode *reshape(const Hamt *map, HamtNode *old, uint32_t bit,
+                         int has_entry, const uint8_t *entry,
+                         HamtNode *child) {
+  uint32_t datamap = has_entry ? old->datamap | bit : old->datamap & ~bit;
+  uint32_t nodemap = child ? old->nodemap | bit : old->nodemap & ~bit;
+
+  HamtNode *node = node_alloc(map, datamap, nodemap, 0);
+  if (!node)
+    return NULL;
+
+  size_t had_entry = old->datamap & bit, had_child = old->nodemap & bit;
+  copy_children(old, node, child ? index_of(nodemap, bit) : SIZE_MAX,
+                had_child ? index_of(old->nodemap, bit) : SIZE_MAX);
+  copy_entries(map, old, node, has_entry ? index_of(datamap, bit) : SIZE_MAX,
+               had_entry ? index_of(old->datamap, bit) : SIZE_MAX);
+
+  if (child)
+    children(node)[index_of(nodemap, bit)] = child;
+  if (entry)
+    memcpy(entry_at(map, node, index_of(datamap, bit)), entry,
+           map->entry_size);
+
+  HamtNode *dropped =
+      had_child ? children(old)[index_of(old->nodemap, bit)] : NULL;
+  consume(old, node, child, dropped);
+  return node;
+}
+
+// Rebuilds a collision node with the entry `remove` dropped, or with a slot
+// for the caller to write appended if `remove` is SIZE_MAX.
+static HamtNode *reshape_collisions(const Hamt *map, HamtNode *old,
+                                    size_t remove) {
+  uint32_t collisions = old->collisions + (remove == SIZE_MAX ? 1 : -1);
+  HamtNode *node = node_alloc(map, 0, 0, collisions);
+  if (!node)
+    return NULL;
+
+  copy_entries(map, old, node, SIZE_MAX, remove);
+
+  consume(old, node, NULL, NULL);
+  return node;
+}
+
+static int put(Hamt *map, HamtNode **ref, uint64_t hash, size_t shift,
+               const void *key, const void *value, int *added) {
+  HamtNode *node = *ref;
+  *added = 0;
+
+  if (node->collisions) {
+    for (size_t i = 0; i < node->collisions; i++) {
+      if (!entry_matches(map, entry_at(map, node, i), hash, key))
+        continue;
+
+      if (make_owned(map, ref))
+        return EXIT_FAILURE;
+      memcpy(entry_value(map, entry_at(map, *ref, i)), value,
+             map->value_size);
+      return EXIT_SUCCESS;
+    }
+
+    if (!(node = reshape_collisions(map, node, SIZE_MAX)))
+      return EXIT_FAILURE;
+
+    write_entry(map, entry_at(map, node, node->collisions - 1), hash, key,
+                value);
+    *ref = node;
+    *added = 1;
+    return EXIT_SUCCESS;
+  }
+
+  uint32_t bit = bit_at(hash, shift);
+
+  if (node->nodemap & bit) {
+    if (make_owned(map, ref))
+      return EXIT_FAILURE;
+
+    HamtNode **child = &children(*ref)[index_of((*ref)->nodemap, bit)];
+    return put(map, child, hash, shift + BITS_PER_LEVEL, key, value, added);
+  }
+
+  if (node->datamap & bit) {
+    size_t i = index_of(node->datamap, bit);
+    const uint8_t *entry = entry_at(map, node, i);
+
+    if (entry_matches(map, entry, hash, key)) {
+      if (make_owned(map, ref))
+        return EXIT_FAILURE;
+      memcpy(entry_value(map, entry_at(map, *ref, i)), value,
+             map->value_size);
+      return EXIT_SUCCESS;
+    }
+
+    // Both keys move down into a new child.
+    HamtNode *child =
+        merge(map, entry, hash, key, value, shift + BITS_PER_LEVEL);
+    if (!child)
+      return EXIT_FAILURE;
+
+    if (!(node = reshape(map, node, bit, 0, NULL, child))) {
+      release(child);
+      return EXIT_FAILURE;
+    }
+  } else {
+    if (!(node = reshape(map, node, bit, 1, NULL, NULL)))
+      return EXIT_FAILURE;
+    write_entry(map, entry_at(map, node, index_of(node->datamap, bit)), hash,
+                key, value);
+  }
+
+  *ref = node;
+  *added = 1;
+  return EXIT_SUCCESS;
+}
+
+// Removes `key` from the subtree at `*ref`. A child left with a single entry
+// is folded into its parent, so the trie keeps one shape for a set of keys.
+static int delete(Hamt *map, HamtNode **ref, uint64_t hash, size_t shift,
+                  const void *key, int *removed) {
+  HamtNode *node = *ref;
+  *removed = 0;
+
+  if (node->collisions) {
+    for (size_t i = 0; i < node->collisions; i++) {
+      if (!entry_matches(map, entry_at(map, node, i), hash, key))
+        continue;
+
+      if (!(node = reshape_collisions(map, node, i)))
+        return EXIT_FAILURE;
+
+      *ref = node;
+      *removed = 1;
+      return EXIT_SUCCESS;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  uint32_t bit = bit_at(hash, shift);
+
+  if (node->nodemap & bit) {
+    if (make_owned(map, ref))
+      return EXIT_FAILURE;
+
+    node = *ref;
+    HamtNode **child = &children(node)[index_of(node->nodemap, bit)];
+    if (delete(map, child, hash, shift + BITS_PER_LEVEL, key, removed))
+      return EXIT_FAILURE;
+
+    if (!*removed || node_count(*child) || data_count(*child) != 1)
+      return EXIT_SUCCESS;
+
+    // The entry is copied into this node before the child is released.
+    if (!(node = reshape(map, node, bit, 1, entry_at(map, *child, 0), NULL)))
+      return EXIT_FAILURE;
+
+    *ref = node;
+    return EXIT_SUCCESS;
+  }
+
+  if (!(node->datamap & bit) ||
+      !entry_matches(map, entry_at(map, node, index_of(node->datamap, bit)),
+                     hash, key))
+    return EXIT_SUCCESS;
+
+  if (data_count(node) == 1 && !node_count(node)) {
+    // Only the root can be left empty.
+    release(node);
+    *ref = NULL;
+  } else if (!(*ref = reshape(map, node, bit, 0, NULL, NULL))) {
+    *ref = node;
+    return EXIT_FAILURE;
+  }
+
+  *removed = 1;
+  return EXIT_SUCCESS;
+}
+
+static int init(Hamt *result, HashMapHashFn hash, HashMapHash64Fn hash64,
+                HashMapEqlFn eql, size_t key_size, size_t value_size) {
+  assert(result != NULL);
+  assert(eql != NULL);
+  assert(key_size > 0);
+
+  *result = (Hamt){0};
+  result->key_size = key_size;
+  result->value_size = value_size;
+  result->entry_size =
+      ALIGN8(sizeof(uint64_t) + ALIGN8(key_size) + value_size);
+  result->hash = hash;
+  result->hash64 = hash64;
+  result->eql = eql;
+
+  return EXIT_SUCCESS;
+}
+
+int hamt_init(Hamt *result, HashMapHashFn hash, HashMapEqlFn eql,
+              size_t key_size, size_t value_size) {
+  assert(hash != NULL);
+
+  return init(result, hash, NULL, eql, key_size, value_size);
+}
+
+int hamt_init64(Hamt *result, HashMapHash64Fn hash, HashMapEqlFn eql,
+                size_t key_size, size_t value_size) {
+  assert(hash != NULL);
+
+  return init(result, NULL, hash, eql, key_size, value_size);
+}
+
+void hamt_deinit(Hamt *map) {
+  assert(map != NULL);
+
+  release(map->root);
+  map->root = NULL;
+  map->size = 0;
+}
+
+void hamt_clear(Hamt *map) { hamt_deinit(map); }
+
+void hamt_snapshot(const Hamt *map, Hamt *result) {
+  assert(map != NULL);
+  assert(result != NULL);
+
+  *result = *map;
+  if (map->root)
+    retain(map->root);
+}
+
+size_t hamt_count(const Hamt *map) {
+  assert(map != NULL);
+  return map->size;
+}
+
+const void *hamt_get(const Hamt *map, const void *key) {
+  assert(map != NULL);
+
+  if (!map->root)
+    return NULL;
+
+  uint64_t hash = hash_key(map, key);
+  const HamtNode *node = map->root;
+
+  for (size_t shift = 0;; shift += BITS_PER_LEVEL) {
+    if (node->collisions) {
+      for (size_t i = 0; i < node->collisions; i++) {
+        const uint8_t *entry = entry_at(map, node, i);
+        if (entry_matches(map, entry, hash, key))
+          return entry_value(map, entry);
+      }
+      return NULL;
+    }
+
+    uint32_t bit = bit_at(hash, shift);
+    if (node->nodemap & bit) {
+      node = children(node)[index_of(node->nodemap, bit)];
+    } else if (node->datamap & bit) {
+      const uint8_t *entry =
+          entry_at(map, node, index_of(node->datamap, bit));
+      return entry_matches(map, entry, hash, key) ? entry_value(map, entry)
+                                                  : NULL;
+    } else {
+      return NULL;
+    }
+  }
+}
+
+int hamt_has(const Hamt *map, const void *key) {
+  return hamt_get(map, key) != NULL;
+}
+
+int hamt_put(Hamt *map, const void *key, const void *value) {
+  assert(map != NULL);
+
+  uint64_t hash = hash_key(map, key);
+
+  if (!map->root) {
+    uint32_t bit = bit_at(hash, 0);
+    if (!(map->root = node_alloc(map, bit, 0, 0)))
+      return EXIT_FAILURE;
+
+    write_entry(map, entry_at(map, map->root, 0), hash, key, value);
+    map->size = 1;
+    return EXIT_SUCCESS;
+  }
+
+  int added;
+  if (put(map, &map->root, hash, 0, key, value, &added))
+    return EXIT_FAILURE;
+
+  map->size += added;
+  return EXIT_SUCCESS;
+}
+
+int hamt_delete(Hamt *map, const void *key) {
+  assert(map != NULL);
+
+  // A missing key shouldn't copy the nodes on its path.
+  if (!hamt_has(map, key))
+    return EXIT_SUCCESS;
+
+  int removed;
+  if (delete(map, &map->root, hash_key(map, key), 0, key, &removed))
+    return EXIT_FAILURE;
+
+  map->size -= removed;
+  return EXIT_SUCCESS;
+}
+
+static size_t subtree_bytes(const Hamt *map, const HamtNode *node) {
+  size_t bytes = node_bytes(map, data_count(node), node_count(node));
+  for (size_t i = 0; i < node_count(node); i++)
+    bytes += subtree_bytes(map, children(node)[i]);
+  return bytes;
+}
+
+size_t hamt_memory_usage(const Hamt *map) {
+  assert(map != NULL);
+
+  size_t bytes = sizeof(Hamt);
+  if (map->root)
+    bytes += subtree_bytes(map, map->root);
+  return bytes;
+}
+
+HamtIterator hamt_iter(const Hamt *map) {
+  assert(map != NULL);
+
+  HamtIterator iterator = {.depth = map->root ? 0 : -1};
+  iterator.nodes[0] = map->root;
+  iterator.map = map;
+  return iterator;
+}
+
+const HamtEntry *hamt_next(HamtIterator *iterator) {
+  assert(iterator != NULL);
+
+  const Hamt *map = iterator->map;
+  while (iterator->depth >= 0) {
+    int depth = iterator->depth;
+    const HamtNode *node = iterator->nodes[depth];
+    size_t i = iterator->idx[depth]++;
+
+    if (i < data_count(node)) {
+      const uint8_t *entry = entry_at(map, node, i);
+      iterator->entry.key = entry_key(entry);
+      iterator->entry.value = entry_value(map, entry);
+      return &iterator->entry;
+    }
+
+    i -= data_count(node);
+    if (i < node_count(node)) {
+      iterator->depth++;
+      iterator->nodes[depth + 1] = children(node)[i];
+      iterator->idx[depth + 1] = 0;
+    } else {
+      iterator->depth--;
+    }
+  }
+
+  return NULL;
+}
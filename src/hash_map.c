@@ -20,14 +20,93 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  */
+#ifdef MYLIB_HASH_MAP_STATS
+#define _POSIX_C_SOURCE 199309L
+#endif
+
 #include "mylib/hash_map.h"
+#include "mylib/alloc.h"
 #include "mylib/linked_list.h"
 
 #include <assert.h>
 #include <string.h>
 
+#ifdef MYLIB_HASH_MAP_STATS
+#include <time.h>
+#endif
+
 #define HASHMAP_DEFAULT_INIT_CAPACITY 16
 
+// 2^64 divided by the golden ratio, multiplying by it spreads a 32-bit hash
+// over the high bits of a 64-bit one.
+#define FIBONACCI_64 0x9E3779B97F4A7C15ULL
+
+#ifdef MYLIB_HASH_MAP_STATS
+// Lookups only have a const map and may run on several threads at once, so the
+// counters are updated with relaxed atomics through a cast.
+#define STATS_ADD(map, field, n)                                               \
+  __atomic_fetch_add(&((HashMap *)(map))->stats.field, (n), __ATOMIC_RELAXED)
+#define STATS_SUB(map, field, n)                                               \
+  __atomic_fetch_sub(&((HashMap *)(map))->stats.field, (n), __ATOMIC_RELAXED)
+
+static void record_lookup(const HashMap *map, size_t probes) {
+  if (probes >= HASH_MAP_STATS_HISTOGRAM_SIZE)
+    probes = HASH_MAP_STATS_HISTOGRAM_SIZE - 1;
+
+  STATS_ADD(map, lookups, 1);
+  STATS_ADD(map, probe_histogram[probes], 1);
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void record_alloc(HashMap *map, size_t bytes) {
+  map->stats.bytes_allocated += bytes;
+  map->stats.bytes_in_use += bytes;
+}
+#else
+#define STATS_ADD(map, field, n) ((void)0)
+#define STATS_SUB(map, field, n) ((void)0)
+#define record_lookup(map, probes) ((void)0)
+#define record_alloc(map, bytes) ((void)0)
+#endif
+
+// Inline keys and values follow the kv, each starting on this alignment.
+#define INLINE_ALIGN 16
+#define ALIGN_UP(n) (((n) + INLINE_ALIGN - 1) & ~(size_t)(INLINE_ALIGN - 1))
+
+static size_t inline_key_offset(void) { return ALIGN_UP(sizeof(HashMapKV)); }
+
+static size_t inline_value_offset(const HashMap *map) {
+  return inline_key_offset() + ALIGN_UP(map->key_size);
+}
+
+// Bytes allocated for each entry, the node plus whatever the storage mode
+// allocates for the kv, key and value.
+static size_t entry_bytes(const HashMap *map) {
+  switch (map->options.storage) {
+  case HASH_MAP_STORE_BORROW:
+    return sizeof(LinkedListNode) + sizeof(HashMapKV);
+  case HASH_MAP_STORE_INLINE:
+    return sizeof(LinkedListNode) + inline_value_offset(map) + map->value_size;
+  default:
+    return sizeof(LinkedListNode) + sizeof(HashMapKV) + map->key_size +
+           map->value_size;
+  }
+}
+
+// Only copied keys and values have allocations of their own.
+static void free_kv(const HashMap *map, HashMapKV *kv) {
+  if (map->options.storage != HASH_MAP_STORE_COPY)
+    return;
+
+  alloc_free(kv->key);
+  alloc_free(kv->value);
+}
+
 static int init_buckets(LinkedList *buckets, size_t count) {
   for (size_t i = 0; i < count; i++)
     buckets[i] = linked_list_init();
@@ -35,7 +114,8 @@ static int init_buckets(LinkedList *buckets, size_t count) {
   return EXIT_SUCCESS;
 }
 
-static void deinit_buckets(LinkedList *buckets, size_t count) {
+static void deinit_buckets(const HashMap *map, LinkedList *buckets,
+                           size_t count) {
   // Just return if buckets is NULL.
   if (buckets == NULL)
     return;
@@ -44,9 +124,7 @@ static void deinit_buckets(LinkedList *buckets, size_t count) {
     LinkedListNode *node = buckets[i].first;
     if (node) {
       do {
-        HashMapKV *kv = node->data;
-        free(kv->key);
-        free(kv->value);
+        free_kv(map, node->data);
       } while ((node = node->next));
     }
   }
@@ -56,18 +134,88 @@ static void deinit_buckets(LinkedList *buckets, size_t count) {
   }
 }
 
-static LinkedList *get_bucket(const HashMap *map, const void *key) {
-  return &map->buckets[map->hash(key) % map->capacity];
+static uint64_t hash_key(const HashMap *map, const void *key) {
+  if (map->hash64)
+    return map->hash64(key);
+
+  return map->hash(key) * FIBONACCI_64;
+}
+
+// The high 64 bits of `a * b`.
+static uint64_t mul_high64(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+  return ((unsigned __int128)a * b) >> 64;
+#else
+  uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+  uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+
+  uint64_t lo_lo = a_lo * b_lo;
+  uint64_t hi_lo = a_hi * b_lo;
+  uint64_t lo_hi = a_lo * b_hi;
+  uint64_t hi_hi = a_hi * b_hi;
+
+  uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+  return hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+// The MurmurHash3 64-bit finalizer, every input bit affects every output bit.
+static uint64_t finalize(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// Neither way of indexing needs a division.
+static LinkedList *get_bucket(const HashMap *map, uint64_t hash) {
+  if (map->options.indexing == HASH_MAP_INDEX_MASK)
+    return &map->buckets[finalize(hash) & (map->capacity - 1)];
+
+  return &map->buckets[mul_high64(hash, map->capacity)];
+}
+
+// The kv, key and value share one allocation, which becomes the node's data.
+static int prepend_inline(HashMap *map, LinkedList *bucket, void *key,
+                          void *value, uint64_t hash) {
+  LinkedListNode *node = alloc_calloc(1, sizeof(LinkedListNode));
+  if (!node)
+    return EXIT_FAILURE;
+
+  uint8_t *data = alloc_malloc(inline_value_offset(map) + map->value_size);
+  if (!data) {
+    alloc_free(node);
+    return EXIT_FAILURE;
+  }
+
+  HashMapKV *kv = (HashMapKV *)data;
+  kv->hash = hash;
+  kv->key = data + inline_key_offset();
+  kv->value = data + inline_value_offset(map);
+
+  memcpy(kv->key, key, map->key_size);
+  if (value)
+    memcpy(kv->value, value, map->value_size);
+
+  node->data = kv;
+  linked_list_prepend_node(bucket, node);
+
+  return EXIT_SUCCESS;
 }
 
-static int prepend(HashMap *map, LinkedList *bucket, void *key, void *value) {
+// The key and value each get an allocation of their own.
+static int prepend_copy(HashMap *map, LinkedList *bucket, void *key,
+                        void *value, uint64_t hash) {
   HashMapKV kv;
+  kv.hash = hash;
 
   // Allocate memory for the key and value.
-  kv.key = malloc(map->key_size);
+  kv.key = alloc_malloc(map->key_size);
   if (!kv.key)
     return EXIT_FAILURE;
-  kv.value = malloc(map->value_size);
+  kv.value = alloc_malloc(map->value_size);
   if (!kv.value)
     goto err;
 
@@ -80,31 +228,87 @@ static int prepend(HashMap *map, LinkedList *bucket, void *key, void *value) {
   if (linked_list_prepend(bucket, &kv, sizeof(HashMapKV)))
     goto err;
 
-  map->size++;
-
   return EXIT_SUCCESS;
 
 err:
-  free(kv.value);
-  free(kv.key);
+  alloc_free(kv.value);
+  alloc_free(kv.key);
 
   return EXIT_FAILURE;
 }
 
+static int prepend(HashMap *map, LinkedList *bucket, void *key, void *value,
+                   uint64_t hash) {
+  int err;
+
+  switch (map->options.storage) {
+  case HASH_MAP_STORE_BORROW: {
+    // Borrowed pointers are stored as they are.
+    HashMapKV kv = {.key = key, .value = value, .hash = hash};
+    err = linked_list_prepend(bucket, &kv, sizeof(HashMapKV));
+    break;
+  }
+  case HASH_MAP_STORE_INLINE:
+    err = prepend_inline(map, bucket, key, value, hash);
+    break;
+  default:
+    err = prepend_copy(map, bucket, key, value, hash);
+    break;
+  }
+
+  if (err)
+    return EXIT_FAILURE;
+
+  map->size++;
+  record_alloc(map, entry_bytes(map));
+
+  return EXIT_SUCCESS;
+}
+
 static int resize(HashMap *map, size_t new_capacity) {
-  LinkedList *new_buckets =
-      realloc(map->buckets, new_capacity * sizeof(LinkedList));
+  assert(map->options.indexing != HASH_MAP_INDEX_MASK ||
+         (new_capacity & (new_capacity - 1)) == 0);
+
+#ifdef MYLIB_HASH_MAP_STATS
+  uint64_t start = now_ns();
+#endif
+
+  LinkedList *new_buckets = alloc_policy_malloc(
+      map->options.bucket_policy, new_capacity * sizeof(LinkedList));
   if (!new_buckets)
     return EXIT_FAILURE;
 
-  map->buckets = new_buckets;
+  init_buckets(new_buckets, new_capacity);
 
-  // Initialize the new buckets.
-  init_buckets(map->buckets + map->capacity, new_capacity - map->capacity);
+  LinkedList *old_buckets = map->buckets;
+  size_t old_capacity = map->capacity;
 
-  // Assign the new capacity.
+  map->buckets = new_buckets;
   map->capacity = new_capacity;
 
+  // Move every node over to its new bucket using the stored hash, the nodes
+  // themselves are relinked rather than reallocated.
+  for (size_t i = 0; i < old_capacity; i++) {
+    LinkedListNode *node;
+    while ((node = linked_list_pop_first(&old_buckets[i]))) {
+      HashMapKV *kv = node->data;
+      linked_list_prepend_node(get_bucket(map, kv->hash), node);
+    }
+  }
+
+  alloc_policy_free(map->options.bucket_policy, old_buckets);
+
+  record_alloc(map, new_capacity * sizeof(LinkedList));
+  STATS_SUB(map, bytes_in_use, old_capacity * sizeof(LinkedList));
+
+#ifdef MYLIB_HASH_MAP_STATS
+  // The first allocation of the buckets is not counted as a resize.
+  if (old_capacity > 0) {
+    map->stats.resizes++;
+    map->stats.resize_ns += now_ns() - start;
+  }
+#endif
+
   return EXIT_SUCCESS;
 }
 
@@ -112,23 +316,38 @@ static int ensure_capacity(HashMap *map) {
   if (map->capacity > 0 && map->size <= map->capacity)
     return EXIT_SUCCESS;
 
-  // We use the default init capacity or double the current capacity.
-  size_t new_capacity =
-      map->capacity == 0 ? HASHMAP_DEFAULT_INIT_CAPACITY : map->capacity * 2;
+  // We use the init capacity or double the current capacity.
+  size_t new_capacity = map->capacity == 0 ? map->options.initial_capacity
+                                           : map->capacity * 2;
   if (resize(map, new_capacity))
     return EXIT_FAILURE;
 
   return EXIT_SUCCESS;
 }
 
-int hash_map_init(HashMap *result, HashMapHashFn hash, HashMapEqlFn eql,
-                  size_t key_size, size_t value_size) {
+static int init(HashMap *result, HashMapHashFn hash, HashMapHash64Fn hash64,
+                HashMapEqlFn eql, size_t key_size, size_t value_size,
+                const HashMapOptions *options) {
   assert(result != NULL);
-  assert(hash != NULL);
   assert(eql != NULL);
 
   *result = (HashMap){0};
 
+  if (options)
+    result->options = *options;
+
+  size_t *capacity = &result->options.initial_capacity;
+  if (*capacity == 0)
+    *capacity = HASHMAP_DEFAULT_INIT_CAPACITY;
+
+  // Masking needs a power of two.
+  if (result->options.indexing == HASH_MAP_INDEX_MASK) {
+    size_t pow2 = 1;
+    while (pow2 < *capacity)
+      pow2 <<= 1;
+    *capacity = pow2;
+  }
+
   if (ensure_capacity(result))
     return EXIT_FAILURE;
 
@@ -136,16 +355,46 @@ int hash_map_init(HashMap *result, HashMapHashFn hash, HashMapEqlFn eql,
   result->key_size = key_size;
   result->value_size = value_size;
   result->hash = hash;
+  result->hash64 = hash64;
   result->eql = eql;
 
   return EXIT_SUCCESS;
 }
 
-// Just clears all of the buckets and sets the size to zero.
+int hash_map_init(HashMap *result, HashMapHashFn hash, HashMapEqlFn eql,
+                  size_t key_size, size_t value_size) {
+  assert(hash != NULL);
+
+  return init(result, hash, NULL, eql, key_size, value_size, NULL);
+}
+
+int hash_map_init64(HashMap *result, HashMapHash64Fn hash, HashMapEqlFn eql,
+                    size_t key_size, size_t value_size) {
+  assert(hash != NULL);
+
+  return init(result, NULL, hash, eql, key_size, value_size, NULL);
+}
+
+int hash_map_init_with_options(HashMap *result, HashMapHash64Fn hash,
+                               HashMapEqlFn eql, size_t key_size,
+                               size_t value_size,
+                               const HashMapOptions *options) {
+  assert(hash != NULL);
+
+  return init(result, NULL, hash, eql, key_size, value_size, options);
+}
+
+// Clears and frees all of the buckets and sets the size to zero, the next put
+// allocates the initial capacity again.
 void hash_map_clear(HashMap *map) {
   assert(map != NULL);
 
-  deinit_buckets(map->buckets, map->capacity);
+  STATS_SUB(map, bytes_in_use,
+            map->size * entry_bytes(map) + map->capacity * sizeof(LinkedList));
+
+  deinit_buckets(map, map->buckets, map->capacity);
+  alloc_policy_free(map->options.bucket_policy, map->buckets);
+  map->buckets = NULL;
   map->size = 0;
   map->capacity = 0;
 }
@@ -154,9 +403,8 @@ void hash_map_clear(HashMap *map) {
 void hash_map_deinit(HashMap *map) {
   assert(map != NULL);
 
-  // We also ensure is not NULL inside hash_map_clear.
+  // hash_map_clear also frees the buckets array.
   hash_map_clear(map);
-  free(map->buckets);
 }
 
 size_t hash_map_count(const HashMap *map) {
@@ -164,15 +412,34 @@ size_t hash_map_count(const HashMap *map) {
   return map->size;
 }
 
-static HashMapKV *find_key(LinkedListNode *node, const void *key,
-                           HashMapEqlFn eql) {
-  do {
+size_t hash_map_memory_usage(const HashMap *map) {
+  assert(map != NULL);
+  return map->capacity * sizeof(LinkedList) + map->size * entry_bytes(map);
+}
+
+// Walks the bucket starting at `node`, which may be NULL for an empty bucket.
+static HashMapKV *find_key(const HashMap *map, LinkedListNode *node,
+                           const void *key, uint64_t hash) {
+  HashMapKV *result = NULL;
+  size_t probes = 0;
+
+  for (; node; node = node->next) {
+    probes++;
+
     HashMapKV *kv = node->data;
-    if (eql(key, kv->key))
-      return kv;
-  } while ((node = node->next));
+    if (kv->hash != hash)
+      continue;
 
-  return NULL;
+    STATS_ADD(map, eql_calls, 1);
+    if (map->eql(key, kv->key)) {
+      result = kv;
+      break;
+    }
+  }
+
+  record_lookup(map, probes);
+
+  return result;
 }
 
 int hash_map_put(HashMap *map, void *key, void *value) {
@@ -184,27 +451,22 @@ int hash_map_put(HashMap *map, void *key, void *value) {
     return EXIT_FAILURE;
 
   // Get the bucket.
-  LinkedList *bucket = get_bucket(map, key);
-  LinkedListNode *node = bucket->first;
+  uint64_t hash = hash_key(map, key);
+  LinkedList *bucket = get_bucket(map, hash);
 
-  if (!node) {
-    // Construct the kv and try to prepend it to the bucket.
-    if (prepend(map, bucket, key, value))
-      return EXIT_FAILURE;
-  } else {
-    HashMapKV *kv = find_key(node, key, map->eql);
-    if (kv) {
-      // Assign the new value.
-      kv->value = value;
-
-      return EXIT_SUCCESS;
-    }
+  HashMapKV *kv = find_key(map, bucket->first, key, hash);
+  if (kv) {
+    // Assign the new value, copying it unless it is borrowed.
+    if (value || map->options.storage == HASH_MAP_STORE_BORROW)
+      hash_map_kv_assign(map, kv, value);
 
-    // The bucket does not contain the key so we can prepend a new node.
-    if (prepend(map, bucket, key, value))
-      return EXIT_FAILURE;
+    return EXIT_SUCCESS;
   }
 
+  // The bucket does not contain the key so we can prepend a new node.
+  if (prepend(map, bucket, key, value, hash))
+    return EXIT_FAILURE;
+
   return EXIT_SUCCESS;
 }
 
@@ -213,23 +475,25 @@ const HashMapKV *hash_map_get_or_put(HashMap *map, void *key,
   assert(map != NULL);
   assert(key != NULL);
 
-  LinkedList *bucket = get_bucket(map, key);
-  LinkedListNode *node = bucket->first;
+  // Ensure that the map has enough capacity for a new kv.
+  if (ensure_capacity(map))
+    return NULL;
 
-  if (!node) {
-    if (prepend(map, bucket, key, NULL))
-      return NULL;
-  } else {
-    HashMapKV *kv = find_key(node, key, map->eql);
-    // The key exists, return it now.
-    if (kv) {
-      if (has_existing)
-        *has_existing = 1;
-      return kv;
-    } else if (prepend(map, bucket, key, NULL)) // Else we prepend the kv.
-      return NULL;
+  uint64_t hash = hash_key(map, key);
+  LinkedList *bucket = get_bucket(map, hash);
+
+  HashMapKV *kv = find_key(map, bucket->first, key, hash);
+  // The key exists, return it now.
+  if (kv) {
+    if (has_existing)
+      *has_existing = 1;
+    return kv;
   }
 
+  // Else we prepend the kv.
+  if (prepend(map, bucket, key, NULL, hash))
+    return NULL;
+
   if (has_existing)
     *has_existing = 0;
 
@@ -241,15 +505,14 @@ HashMapKV *hash_map_get(const HashMap *map, const void *key) {
   assert(key != NULL);
 
   // HashMap contains no entries, quick exit.
-  if (map->size == 0)
+  if (map->size == 0) {
+    record_lookup(map, 0);
     return NULL;
+  }
 
-  LinkedListNode *node = get_bucket(map, key)->first;
+  uint64_t hash = hash_key(map, key);
 
-  if (!node)
-    return NULL;
-
-  return find_key(node, key, map->eql);
+  return find_key(map, get_bucket(map, hash)->first, key, hash);
 }
 
 void *hash_map_get_value(const HashMap *map, const void *key) {
@@ -266,35 +529,102 @@ void hash_map_delete(HashMap *map, const void *key) {
   assert(key != NULL);
 
   // HashMap is empty, quick exit.
-  if (map->size == 0)
+  if (map->size == 0) {
+    record_lookup(map, 0);
     return;
+  }
 
-  LinkedList *bucket = get_bucket(map, key);
-  LinkedListNode *node = bucket->first;
+  uint64_t hash = hash_key(map, key);
+  LinkedList *bucket = get_bucket(map, hash);
 
-  if (!node)
-    return;
+  // Find the node that contains the key, keeping track of the previous node so
+  // that it can be unlinked without walking the bucket again.
+  LinkedListNode *prev = NULL;
+  size_t probes = 0;
+  for (LinkedListNode *node = bucket->first; node;
+       prev = node, node = node->next) {
+    probes++;
+
+    HashMapKV *kv = node->data;
+    if (kv->hash != hash)
+      continue;
 
-  // Find the node that contains the key then call linked_list_delete.
-  HashMapKV *kv = find_key(node, key, map->eql);
+    STATS_ADD(map, eql_calls, 1);
+    if (map->eql(key, kv->key)) {
+      free_kv(map, kv);
 
-  free(kv->key);
-  free(kv->value);
+      linked_list_delete_next(bucket, prev);
+      map->size--;
+      STATS_SUB(map, bytes_in_use, entry_bytes(map));
+      break;
+    }
+  }
 
-  linked_list_delete(bucket, node);
+  record_lookup(map, probes);
 }
 
 void hash_map_kv_assign(HashMap *map, const HashMapKV *kv, void *value) {
   assert(map != NULL);
   assert(kv != NULL);
-  assert(value != NULL);
 
+  if (map->options.storage == HASH_MAP_STORE_BORROW) {
+    ((HashMapKV *)kv)->value = value;
+    return;
+  }
+
+  assert(value != NULL);
   memcpy(kv->value, value, map->value_size);
 }
 
+int hash_map_stats(const HashMap *map, HashMapStats *result) {
+  assert(map != NULL);
+  assert(result != NULL);
+
+#ifdef MYLIB_HASH_MAP_STATS
+  *result = map->stats;
+  memset(result->chain_histogram, 0, sizeof(result->chain_histogram));
+#else
+  *result = (HashMapStats){0};
+#endif
+
+  result->size = map->size;
+  result->capacity = map->capacity;
+  result->max_chain = 0;
+
+  for (size_t i = 0; i < map->capacity; i++) {
+    size_t length = 0;
+    for (LinkedListNode *node = map->buckets[i].first; node; node = node->next)
+      length++;
+
+    if (length > result->max_chain)
+      result->max_chain = length;
+
+    if (length >= HASH_MAP_STATS_HISTOGRAM_SIZE)
+      length = HASH_MAP_STATS_HISTOGRAM_SIZE - 1;
+    result->chain_histogram[length]++;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+void hash_map_stats_reset(HashMap *map) {
+  assert(map != NULL);
+
+#ifdef MYLIB_HASH_MAP_STATS
+  size_t bytes_in_use = map->stats.bytes_in_use;
+  map->stats = (HashMapStats){0};
+  map->stats.bytes_in_use = bytes_in_use;
+#else
+  (void)map;
+#endif
+}
+
 HashMapIterator hash_map_iter(const HashMap *map) {
   HashMapIterator result = {0};
   result.map = map;
+  // hash_map_next increments the index before reading a bucket, start one
+  // before the first bucket so that it wraps around to it.
+  result.bucket_idx = (size_t)-1;
 
   return result;
 }
@@ -0,0 +1,388 @@
+/**
+ * hash_set.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/hash_set.h"
+#include "mylib/alloc.h"
+#include <assert.h>
+#include <string.h>
+
+#define DEFAULT_INIT_CAPACITY 16
+
+// Control bytes, a full slot has the top bit set and 7 bits of the hash.
+#define EMPTY 0x00
+#define DELETED 0x01
+#define FULL 0x80
+
+// See hash_map.c, spreads a 32-bit hash over a 64-bit one.
+#define FIBONACCI_64 0x9E3779B97F4A7C15ULL
+
+static uint64_t hash_key(const HashSet *set, const void *key) {
+  uint64_t hash = set->hash64 ? set->hash64(key) : set->hash(key) * FIBONACCI_64;
+
+  // The MurmurHash3 finalizer, so that the low bits used for the slot and the
+  // high bits used for the control byte both depend on every bit of the hash.
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+
+  return hash;
+}
+
+static uint8_t ctrl_of(uint64_t hash) { return FULL | (hash >> 57); }
+
+static void *key_at(const HashSet *set, size_t i) {
+  return (uint8_t *)set->keys + i * set->key_size;
+}
+
+// Finds the slot holding `key`, or else the slot it should be inserted into.
+// Returns 1 if the key was found.
+static int find_slot(const HashSet *set, const void *key, uint64_t hash,
+                     size_t *result) {
+  size_t mask = set->capacity - 1;
+  uint8_t ctrl = ctrl_of(hash);
+  size_t insert_at = SIZE_MAX;
+
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    uint8_t slot = set->ctrl[i];
+
+    if (slot == EMPTY) {
+      *result = insert_at != SIZE_MAX ? insert_at : i;
+      return 0;
+    }
+
+    if (slot == DELETED) {
+      if (insert_at == SIZE_MAX)
+        insert_at = i;
+    } else if (slot == ctrl && set->eql(key, key_at(set, i))) {
+      *result = i;
+      return 1;
+    }
+  }
+}
+
+// Moves every key into `new_capacity` slots, dropping the tombstones.
+static int resize(HashSet *set, size_t new_capacity) {
+  uint8_t *ctrl = alloc_calloc(new_capacity, sizeof(uint8_t));
+  if (!ctrl)
+    return EXIT_FAILURE;
+
+  void *keys = alloc_malloc(new_capacity * set->key_size);
+  if (!keys) {
+    alloc_free(ctrl);
+    return EXIT_FAILURE;
+  }
+
+  size_t mask = new_capacity - 1;
+  for (size_t i = 0; i < set->capacity; i++) {
+    if (!(set->ctrl[i] & FULL))
+      continue;
+
+    uint64_t hash = hash_key(set, key_at(set, i));
+    size_t j = hash & mask;
+    while (ctrl[j] != EMPTY)
+      j = (j + 1) & mask;
+
+    ctrl[j] = ctrl_of(hash);
+    memcpy((uint8_t *)keys + j * set->key_size, key_at(set, i), set->key_size);
+  }
+
+  alloc_free(set->ctrl);
+  alloc_free(set->keys);
+  set->ctrl = ctrl;
+  set->keys = keys;
+  set->capacity = new_capacity;
+  set->tombstones = 0;
+
+  return EXIT_SUCCESS;
+}
+
+// The smallest capacity that holds `count` keys at the maximum load of 7/8.
+static size_t capacity_for(size_t count) {
+  size_t capacity = DEFAULT_INIT_CAPACITY;
+  while (count * 8 > capacity * 7)
+    capacity *= 2;
+  return capacity;
+}
+
+static int ensure_capacity(HashSet *set) {
+  if ((set->size + set->tombstones + 1) * 8 <= set->capacity * 7)
+    return EXIT_SUCCESS;
+
+  // If it's mostly tombstones then rehashing at the same size is enough.
+  size_t new_capacity = set->capacity;
+  if ((set->size + 1) * 2 > new_capacity)
+    new_capacity *= 2;
+
+  return resize(set, new_capacity);
+}
+
+static int init(HashSet *result, HashMapHashFn hash, HashMapHash64Fn hash64,
+                HashMapEqlFn eql, size_t key_size) {
+  assert(result != NULL);
+  assert(eql != NULL);
+  assert(key_size > 0);
+
+  *result = (HashSet){0};
+  result->key_size = key_size;
+  result->hash = hash;
+  result->hash64 = hash64;
+  result->eql = eql;
+
+  return resize(result, DEFAULT_INIT_CAPACITY);
+}
+
+int hash_set_init(HashSet *result, HashMapHashFn hash, HashMapEqlFn eql,
+                  size_t key_size) {
+  assert(hash != NULL);
+
+  return init(result, hash, NULL, eql, key_size);
+}
+
+int hash_set_init64(HashSet *result, HashMapHash64Fn hash, HashMapEqlFn eql,
+                    size_t key_size) {
+  assert(hash != NULL);
+
+  return init(result, NULL, hash, eql, key_size);
+}
+
+int hash_set_clone(const HashSet *src, HashSet *result) {
+  assert(src != NULL);
+  assert(result != NULL);
+
+  *result = *src;
+  result->ctrl = alloc_malloc(src->capacity);
+  result->keys = alloc_malloc(src->capacity * src->key_size);
+  if (!result->ctrl || !result->keys) {
+    hash_set_deinit(result);
+    return EXIT_FAILURE;
+  }
+
+  memcpy(result->ctrl, src->ctrl, src->capacity);
+  memcpy(result->keys, src->keys, src->capacity * src->key_size);
+
+  return EXIT_SUCCESS;
+}
+
+void hash_set_deinit(HashSet *set) {
+  assert(set != NULL);
+
+  alloc_free(set->ctrl);
+  alloc_free(set->keys);
+  set->ctrl = NULL;
+  set->keys = NULL;
+  set->size = set->capacity = set->tombstones = 0;
+}
+
+// Empties the set but keeps its slots allocated.
+void hash_set_clear(HashSet *set) {
+  assert(set != NULL);
+
+  memset(set->ctrl, EMPTY, set->capacity);
+  set->size = 0;
+  set->tombstones = 0;
+}
+
+size_t hash_set_count(const HashSet *set) {
+  assert(set != NULL);
+  return set->size;
+}
+
+int hash_set_reserve(HashSet *set, size_t count) {
+  assert(set != NULL);
+
+  size_t capacity = capacity_for(count);
+  if (capacity <= set->capacity)
+    return EXIT_SUCCESS;
+
+  return resize(set, capacity);
+}
+
+int hash_set_insert(HashSet *set, const void *key, int *has_existing) {
+  assert(set != NULL);
+  assert(key != NULL);
+
+  if (ensure_capacity(set))
+    return EXIT_FAILURE;
+
+  uint64_t hash = hash_key(set, key);
+
+  size_t slot;
+  int found = find_slot(set, key, hash, &slot);
+  if (has_existing)
+    *has_existing = found;
+  if (found)
+    return EXIT_SUCCESS;
+
+  if (set->ctrl[slot] == DELETED)
+    set->tombstones--;
+  set->ctrl[slot] = ctrl_of(hash);
+  memcpy(key_at(set, slot), key, set->key_size);
+  set->size++;
+
+  return EXIT_SUCCESS;
+}
+
+int hash_set_contains(const HashSet *set, const void *key) {
+  assert(set != NULL);
+  assert(key != NULL);
+
+  size_t slot;
+  return find_slot(set, key, hash_key(set, key), &slot);
+}
+
+void hash_set_remove(HashSet *set, const void *key) {
+  assert(set != NULL);
+  assert(key != NULL);
+
+  size_t slot;
+  if (!find_slot(set, key, hash_key(set, key), &slot))
+    return;
+
+  // A probe can stop at an empty slot, so only the last slot of a run can
+  // become empty again. Anything else is left as a tombstone.
+  if (set->ctrl[(slot + 1) & (set->capacity - 1)] == EMPTY) {
+    set->ctrl[slot] = EMPTY;
+  } else {
+    set->ctrl[slot] = DELETED;
+    set->tombstones++;
+  }
+  set->size--;
+}
+
+static int init_like(const HashSet *a, HashSet *result, size_t count) {
+  if (init(result, a->hash, a->hash64, a->eql, a->key_size))
+    return EXIT_FAILURE;
+
+  if (hash_set_reserve(result, count)) {
+    hash_set_deinit(result);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int hash_set_union(const HashSet *a, const HashSet *b, HashSet *result) {
+  assert(a != NULL);
+  assert(b != NULL);
+  assert(result != NULL);
+  assert(a->key_size == b->key_size);
+
+  // Start from a copy of the larger set and add the keys of the smaller one.
+  const HashSet *largest = a->size >= b->size ? a : b;
+  const HashSet *smallest = largest == a ? b : a;
+
+  if (hash_set_clone(largest, result))
+    return EXIT_FAILURE;
+
+  if (hash_set_reserve(result, a->size + b->size))
+    goto err;
+
+  HashSetIterator iter = hash_set_iter(smallest);
+  const void *key;
+  while ((key = hash_set_next(&iter)))
+    if (hash_set_insert(result, key, NULL))
+      goto err;
+
+  return EXIT_SUCCESS;
+
+err:
+  hash_set_deinit(result);
+
+  return EXIT_FAILURE;
+}
+
+int hash_set_intersect(const HashSet *a, const HashSet *b, HashSet *result) {
+  assert(a != NULL);
+  assert(b != NULL);
+  assert(result != NULL);
+  assert(a->key_size == b->key_size);
+
+  // Look up each key of the smaller set in the larger one.
+  const HashSet *smallest = a->size <= b->size ? a : b;
+  const HashSet *largest = smallest == a ? b : a;
+
+  if (init_like(a, result, smallest->size))
+    return EXIT_FAILURE;
+
+  HashSetIterator iter = hash_set_iter(smallest);
+  const void *key;
+  while ((key = hash_set_next(&iter)))
+    if (hash_set_contains(largest, key) && hash_set_insert(result, key, NULL))
+      goto err;
+
+  return EXIT_SUCCESS;
+
+err:
+  hash_set_deinit(result);
+
+  return EXIT_FAILURE;
+}
+
+int hash_set_difference(const HashSet *a, const HashSet *b, HashSet *result) {
+  assert(a != NULL);
+  assert(b != NULL);
+  assert(result != NULL);
+  assert(a->key_size == b->key_size);
+
+  if (init_like(a, result, a->size))
+    return EXIT_FAILURE;
+
+  HashSetIterator iter = hash_set_iter(a);
+  const void *key;
+  while ((key = hash_set_next(&iter)))
+    if (!hash_set_contains(b, key) && hash_set_insert(result, key, NULL))
+      goto err;
+
+  return EXIT_SUCCESS;
+
+err:
+  hash_set_deinit(result);
+
+  return EXIT_FAILURE;
+}
+
+HashSetIterator hash_set_iter(const HashSet *set) {
+  HashSetIterator result = {0};
+  result.set = set;
+
+  return result;
+}
+
+const void *hash_set_next(HashSetIterator *iterator) {
+  assert(iterator != NULL);
+
+  const HashSet *set = iterator->set;
+  while (iterator->idx < set->capacity) {
+    size_t i = iterator->idx++;
+    if (set->ctrl[i] & FULL)
+      return key_at(set, i);
+  }
+
+  return NULL;
+}
+
+size_t hash_set_memory_usage(const HashSet *set) {
+  assert(set != NULL);
+  return set->capacity * (sizeof(uint8_t) + set->key_size);
+}
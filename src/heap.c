@@ -0,0 +1,450 @@
+/**
+ * heap.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/heap.h"
+#include "mylib/alloc.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define DEFAULT_ARITY 4
+
+// Everything the sift functions need, shared by Heap and IndexedHeap.
+typedef struct Sift {
+  uint8_t *data;
+  size_t slot_size;
+  size_t offset; // Where the element starts in a slot.
+  size_t arity;
+  HeapCmpFn cmp;
+  size_t *positions; // Kept up to date when not NULL.
+  const uint8_t *tmp;
+} Sift;
+
+static uint8_t *slot(const Sift *sift, size_t i) {
+  return sift->data + i * sift->slot_size;
+}
+
+static int32_t cmp_slots(const Sift *sift, const uint8_t *a, const uint8_t *b) {
+  return sift->cmp(a + sift->offset, b + sift->offset);
+}
+
+static void set_slot(const Sift *sift, size_t i, const uint8_t *from) {
+  memcpy(slot(sift, i), from, sift->slot_size);
+
+  if (sift->positions) {
+    size_t id;
+    memcpy(&id, from, sizeof(size_t));
+    sift->positions[id] = i;
+  }
+}
+
+// Moves the parents of the hole at `i` down until the element in `tmp` fits
+// there.
+static void hole_up(const Sift *sift, size_t i) {
+  while (i > 0) {
+    size_t parent = (i - 1) / sift->arity;
+    if (cmp_slots(sift, sift->tmp, slot(sift, parent)) >= 0)
+      break;
+
+    set_slot(sift, i, slot(sift, parent));
+    i = parent;
+  }
+
+  set_slot(sift, i, sift->tmp);
+}
+
+// Moves the best child of the hole at `i` up until the element in `tmp` fits
+// there.
+static void hole_down(const Sift *sift, size_t i, size_t size) {
+  for (;;) {
+    size_t first = i * sift->arity + 1;
+    if (first >= size)
+      break;
+
+    size_t last = size - first > sift->arity ? first + sift->arity : size;
+    size_t best = first;
+    for (size_t child = first + 1; child < last; child++)
+      if (cmp_slots(sift, slot(sift, child), slot(sift, best)) < 0)
+        best = child;
+
+    if (cmp_slots(sift, slot(sift, best), sift->tmp) >= 0)
+      break;
+
+    set_slot(sift, i, slot(sift, best));
+    i = best;
+  }
+
+  set_slot(sift, i, sift->tmp);
+}
+
+static Sift heap_sift(const Heap *heap) {
+  Sift result = {0};
+  result.data = heap->vec.data;
+  result.slot_size = heap->vec.element_size;
+  result.arity = heap->arity;
+  result.cmp = heap->cmp;
+  result.tmp = heap->tmp;
+
+  return result;
+}
+
+static int init_common(Heap *result, HeapCmpFn cmp, size_t arity,
+                       size_t element_size) {
+  result->arity = arity ? arity : DEFAULT_ARITY;
+  result->cmp = cmp;
+  result->tmp = alloc_malloc(element_size ? element_size : 1);
+
+  return result->tmp ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int heap_init(Heap *result, size_t element_size, HeapCmpFn cmp, size_t arity) {
+  assert(result != NULL);
+  assert(cmp != NULL);
+
+  *result = (Heap){0};
+
+  if (vector_init(&result->vec, element_size))
+    return EXIT_FAILURE;
+
+  if (init_common(result, cmp, arity, element_size)) {
+    vector_deinit(&result->vec);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int heap_init_from_vector(Heap *result, Vector *vec, HeapCmpFn cmp,
+                          size_t arity) {
+  assert(result != NULL);
+  assert(vec != NULL);
+  assert(cmp != NULL);
+
+  *result = (Heap){0};
+
+  // The heap writes to the elements directly.
+  if (vector_unshare(vec) || init_common(result, cmp, arity, vec->element_size))
+    return EXIT_FAILURE;
+
+  result->vec = *vec;
+  *vec = (Vector){0};
+
+  // Sift down every parent, from the last one up to the root. Most nodes are
+  // near the bottom and move only a level or two, which makes this O(n).
+  Sift sift = heap_sift(result);
+  size_t size = result->vec.size;
+  for (size_t i = size > 1 ? (size - 2) / result->arity + 1 : 0; i-- > 0;) {
+    memcpy(result->tmp, slot(&sift, i), sift.slot_size);
+    hole_down(&sift, i, size);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+void heap_deinit(Heap *heap) {
+  assert(heap != NULL);
+
+  vector_deinit(&heap->vec);
+  alloc_free(heap->tmp);
+  heap->tmp = NULL;
+}
+
+void heap_clear(Heap *heap) {
+  assert(heap != NULL);
+  heap->vec.size = 0;
+}
+
+size_t heap_len(const Heap *heap) {
+  assert(heap != NULL);
+  return heap->vec.size;
+}
+
+size_t heap_memory_usage(const Heap *heap) {
+  assert(heap != NULL);
+  return vector_memory_usage(&heap->vec) + heap->vec.element_size;
+}
+
+int heap_push(Heap *heap, const void *element) {
+  assert(heap != NULL);
+  assert(element != NULL);
+
+  memcpy(heap->tmp, element, heap->vec.element_size);
+  if (vector_append(&heap->vec, heap->tmp))
+    return EXIT_FAILURE;
+
+  Sift sift = heap_sift(heap);
+  hole_up(&sift, heap->vec.size - 1);
+
+  return EXIT_SUCCESS;
+}
+
+const void *heap_peek(const Heap *heap) {
+  assert(heap != NULL);
+  return heap->vec.size ? heap->vec.data : NULL;
+}
+
+int heap_pop(Heap *heap, void *result) {
+  assert(heap != NULL);
+
+  if (!heap->vec.size)
+    return EXIT_FAILURE;
+
+  Sift sift = heap_sift(heap);
+  if (result)
+    memcpy(result, slot(&sift, 0), sift.slot_size);
+
+  // The last element fills the hole left at the root.
+  size_t size = --heap->vec.size;
+  if (size) {
+    memcpy(heap->tmp, slot(&sift, size), sift.slot_size);
+    hole_down(&sift, 0, size);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int heap_replace(Heap *heap, const void *element, void *result) {
+  assert(heap != NULL);
+  assert(element != NULL);
+
+  if (!heap->vec.size)
+    return EXIT_FAILURE;
+
+  Sift sift = heap_sift(heap);
+  if (result)
+    memcpy(result, slot(&sift, 0), sift.slot_size);
+
+  memcpy(heap->tmp, element, sift.slot_size);
+  hole_down(&sift, 0, heap->vec.size);
+
+  return EXIT_SUCCESS;
+}
+
+static Sift indexed_sift(const IndexedHeap *heap) {
+  Sift result = {0};
+  result.data = heap->slots.data;
+  result.slot_size = heap->slots.element_size;
+  result.offset = sizeof(size_t);
+  result.arity = heap->arity;
+  result.cmp = heap->cmp;
+  result.positions = heap->positions.data;
+  result.tmp = heap->tmp;
+
+  return result;
+}
+
+// Where `id` is in the heap, or SIZE_MAX.
+static size_t position_of(const IndexedHeap *heap, size_t id) {
+  if (id >= heap->positions.size)
+    return SIZE_MAX;
+  return ((const size_t *)heap->positions.data)[id];
+}
+
+// Grows the positions to cover `id`, at least doubling them.
+static int reserve_id(IndexedHeap *heap, size_t id) {
+  Vector *positions = &heap->positions;
+  if (id < positions->size)
+    return EXIT_SUCCESS;
+
+  size_t size = positions->size * 2 > id + 1 ? positions->size * 2 : id + 1;
+  if (size > positions->capacity && vector_resize(positions, size))
+    return EXIT_FAILURE;
+
+  for (size_t i = positions->size; i < size; i++)
+    ((size_t *)positions->data)[i] = SIZE_MAX;
+  positions->size = size;
+
+  return EXIT_SUCCESS;
+}
+
+int indexed_heap_init(IndexedHeap *result, size_t element_size, HeapCmpFn cmp,
+                      size_t arity) {
+  assert(result != NULL);
+  assert(cmp != NULL);
+
+  *result = (IndexedHeap){0};
+  result->element_size = element_size;
+  result->arity = arity ? arity : DEFAULT_ARITY;
+  result->cmp = cmp;
+
+  // Pad each slot so the next id stays aligned.
+  size_t slot_size = sizeof(size_t) + element_size;
+  slot_size = (slot_size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+
+  if (vector_init(&result->slots, slot_size))
+    return EXIT_FAILURE;
+
+  if (vector_init(&result->positions, sizeof(size_t)))
+    goto err_slots;
+
+  if (!(result->tmp = alloc_malloc(slot_size)))
+    goto err_positions;
+
+  return EXIT_SUCCESS;
+
+err_positions:
+  vector_deinit(&result->positions);
+err_slots:
+  vector_deinit(&result->slots);
+
+  return EXIT_FAILURE;
+}
+
+void indexed_heap_deinit(IndexedHeap *heap) {
+  assert(heap != NULL);
+
+  vector_deinit(&heap->slots);
+  vector_deinit(&heap->positions);
+  alloc_free(heap->tmp);
+  heap->tmp = NULL;
+}
+
+void indexed_heap_clear(IndexedHeap *heap) {
+  assert(heap != NULL);
+
+  heap->slots.size = 0;
+  heap->positions.size = 0;
+}
+
+size_t indexed_heap_len(const IndexedHeap *heap) {
+  assert(heap != NULL);
+  return heap->slots.size;
+}
+
+size_t indexed_heap_memory_usage(const IndexedHeap *heap) {
+  assert(heap != NULL);
+
+  return vector_memory_usage(&heap->slots) +
+         vector_memory_usage(&heap->positions) + heap->slots.element_size;
+}
+
+int indexed_heap_push(IndexedHeap *heap, size_t id, const void *element) {
+  assert(heap != NULL);
+  assert(element != NULL);
+
+  if (position_of(heap, id) != SIZE_MAX || reserve_id(heap, id))
+    return EXIT_FAILURE;
+
+  uint8_t *tmp = heap->tmp;
+  memcpy(tmp, &id, sizeof(size_t));
+  memcpy(tmp + sizeof(size_t), element, heap->element_size);
+  if (vector_append(&heap->slots, tmp))
+    return EXIT_FAILURE;
+
+  Sift sift = indexed_sift(heap);
+  hole_up(&sift, heap->slots.size - 1);
+
+  return EXIT_SUCCESS;
+}
+
+int indexed_heap_contains(const IndexedHeap *heap, size_t id) {
+  assert(heap != NULL);
+  return position_of(heap, id) != SIZE_MAX;
+}
+
+const void *indexed_heap_get(const IndexedHeap *heap, size_t id) {
+  assert(heap != NULL);
+
+  size_t i = position_of(heap, id);
+  if (i == SIZE_MAX)
+    return NULL;
+
+  Sift sift = indexed_sift(heap);
+  return slot(&sift, i) + sizeof(size_t);
+}
+
+int indexed_heap_update(IndexedHeap *heap, size_t id, const void *element) {
+  assert(heap != NULL);
+  assert(element != NULL);
+
+  size_t i = position_of(heap, id);
+  if (i == SIZE_MAX)
+    return EXIT_FAILURE;
+
+  uint8_t *tmp = heap->tmp;
+  memcpy(tmp, &id, sizeof(size_t));
+  memcpy(tmp + sizeof(size_t), element, heap->element_size);
+
+  Sift sift = indexed_sift(heap);
+  if (cmp_slots(&sift, tmp, slot(&sift, i)) < 0)
+    hole_up(&sift, i);
+  else
+    hole_down(&sift, i, heap->slots.size);
+
+  return EXIT_SUCCESS;
+}
+
+const void *indexed_heap_peek(const IndexedHeap *heap, size_t *id) {
+  assert(heap != NULL);
+
+  if (!heap->slots.size)
+    return NULL;
+
+  if (id)
+    memcpy(id, heap->slots.data, sizeof(size_t));
+  return (const uint8_t *)heap->slots.data + sizeof(size_t);
+}
+
+// Fills the hole at `i` with the last slot.
+static void remove_at(IndexedHeap *heap, size_t i) {
+  Sift sift = indexed_sift(heap);
+
+  size_t id;
+  memcpy(&id, slot(&sift, i), sizeof(size_t));
+  sift.positions[id] = SIZE_MAX;
+
+  size_t size = --heap->slots.size;
+  if (i == size)
+    return;
+
+  // The last slot may belong above or below the hole.
+  memcpy(heap->tmp, slot(&sift, size), sift.slot_size);
+  if (cmp_slots(&sift, sift.tmp, slot(&sift, i)) < 0)
+    hole_up(&sift, i);
+  else
+    hole_down(&sift, i, size);
+}
+
+int indexed_heap_pop(IndexedHeap *heap, size_t *id, void *result) {
+  assert(heap != NULL);
+
+  if (!heap->slots.size)
+    return EXIT_FAILURE;
+
+  if (id)
+    memcpy(id, heap->slots.data, sizeof(size_t));
+  if (result)
+    memcpy(result, (uint8_t *)heap->slots.data + sizeof(size_t),
+           heap->element_size);
+
+  remove_at(heap, 0);
+
+  return EXIT_SUCCESS;
+}
+
+void indexed_heap_remove(IndexedHeap *heap, size_t id) {
+  assert(heap != NULL);
+
+  size_t i = position_of(heap, id);
+  if (i != SIZE_MAX)
+    remove_at(heap, i);
+}
@@ -0,0 +1,376 @@
+/**
+ * hyperloglog.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/hyperloglog.h"
+#include "mylib/alloc.h"
+#include "mylib/hash.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#define MAGIC 0x474F4C4C484C594DULL // "MYLHLLOG"
+#define VERSION 1
+
+typedef struct HyperLogLogHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint8_t precision;
+  uint8_t sparse;
+  uint16_t reserved;
+  uint64_t entries; // Sparse entries, 0 for a dense sketch.
+} HyperLogLogHeader;
+
+static size_t register_count(const HyperLogLog *hll) {
+  return (size_t)1 << hll->precision;
+}
+
+// The highest rank a hash can give, every bit after the index was 0.
+static uint8_t max_rank(uint8_t precision) { return 64 - precision + 1; }
+
+static uint32_t sparse_entry(uint32_t idx, uint8_t rank) {
+  return idx << 8 | rank;
+}
+
+static uint32_t entry_idx(uint32_t entry) { return entry >> 8; }
+
+static uint8_t entry_rank(uint32_t entry) { return entry & 0xFF; }
+
+static uint32_t *sparse_entries(const HyperLogLog *hll) {
+  return hll->sparse.data;
+}
+
+static int to_dense(HyperLogLog *hll) {
+  uint8_t *registers = alloc_calloc(register_count(hll), sizeof(uint8_t));
+  if (!registers)
+    return EXIT_FAILURE;
+
+  const uint32_t *entries = sparse_entries(hll);
+  for (size_t i = 0; i < hll->sparse.size; i++)
+    registers[entry_idx(entries[i])] = entry_rank(entries[i]);
+
+  vector_deinit(&hll->sparse);
+  hll->sparse = (Vector){0};
+  hll->registers = registers;
+
+  return EXIT_SUCCESS;
+}
+
+// Raises the register at `idx` to `rank` if it's lower.
+static int update(HyperLogLog *hll, uint32_t idx, uint8_t rank) {
+  if (hll->registers) {
+    if (hll->registers[idx] < rank)
+      hll->registers[idx] = rank;
+    return EXIT_SUCCESS;
+  }
+
+  // Binary search for the first entry at or after `idx`.
+  const uint32_t *entries = sparse_entries(hll);
+  size_t lo = 0, hi = hll->sparse.size;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (entry_idx(entries[mid]) < idx)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  uint32_t entry = sparse_entry(idx, rank);
+  if (lo < hll->sparse.size && entry_idx(entries[lo]) == idx) {
+    if (entry_rank(entries[lo]) < rank)
+      return vector_assign(&hll->sparse, lo, &entry);
+    return EXIT_SUCCESS;
+  }
+
+  if (vector_insert(&hll->sparse, lo, &entry))
+    return EXIT_FAILURE;
+
+  // Four bytes an entry, past a quarter of the registers the dense form is
+  // smaller and faster to update.
+  if (hll->sparse.size * sizeof(uint32_t) >= register_count(hll))
+    return to_dense(hll);
+
+  return EXIT_SUCCESS;
+}
+
+int hyperloglog_init(HyperLogLog *result, uint8_t precision) {
+  assert(result != NULL);
+
+  *result = (HyperLogLog){0};
+
+  if (precision < HYPERLOGLOG_MIN_PRECISION ||
+      precision > HYPERLOGLOG_MAX_PRECISION)
+    return EXIT_FAILURE;
+
+  result->precision = precision;
+  return vector_init(&result->sparse, sizeof(uint32_t));
+}
+
+void hyperloglog_deinit(HyperLogLog *hll) {
+  assert(hll != NULL);
+
+  if (hll->registers)
+    alloc_free(hll->registers);
+  else
+    vector_deinit(&hll->sparse);
+
+  hll->registers = NULL;
+  hll->sparse = (Vector){0};
+}
+
+int hyperloglog_clear(HyperLogLog *hll) {
+  assert(hll != NULL);
+
+  uint8_t precision = hll->precision;
+  hyperloglog_deinit(hll);
+  return hyperloglog_init(hll, precision);
+}
+
+int hyperloglog_is_sparse(const HyperLogLog *hll) {
+  assert(hll != NULL);
+  return hll->registers == NULL;
+}
+
+int hyperloglog_add_hash(HyperLogLog *hll, uint64_t hash) {
+  assert(hll != NULL);
+
+  uint32_t idx = hash >> (64 - hll->precision);
+
+  // A sentinel bit caps the rank when the rest of the hash is 0.
+  uint64_t rest = hash << hll->precision | (uint64_t)1 << (hll->precision - 1);
+  uint8_t rank = __builtin_clzll(rest) + 1;
+
+  return update(hll, idx, rank);
+}
+
+int hyperloglog_add(HyperLogLog *hll, const void *key, size_t size) {
+  return hyperloglog_add_hash(hll, xxh64_hash(key, size, 0));
+}
+
+int hyperloglog_add_many(HyperLogLog *hll, const void *keys, size_t key_size,
+                         size_t count) {
+  assert(keys != NULL || count == 0);
+
+  const uint8_t *key = keys;
+  for (size_t i = 0; i < count; i++, key += key_size) {
+    if (hyperloglog_add(hll, key, key_size))
+      return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int hyperloglog_add_hashes(HyperLogLog *hll, const uint64_t *hashes,
+                           size_t count) {
+  assert(hashes != NULL || count == 0);
+
+  for (size_t i = 0; i < count; i++) {
+    if (hyperloglog_add_hash(hll, hashes[i]))
+      return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+uint64_t hyperloglog_estimate(const HyperLogLog *hll) {
+  assert(hll != NULL);
+
+  size_t m = register_count(hll);
+  size_t zeros = 0;
+  double sum = 0;
+
+  if (hll->registers) {
+    for (size_t i = 0; i < m; i++) {
+      zeros += hll->registers[i] == 0;
+      sum += ldexp(1.0, -hll->registers[i]);
+    }
+  } else {
+    const uint32_t *entries = sparse_entries(hll);
+    zeros = m - hll->sparse.size;
+    sum = zeros;
+    for (size_t i = 0; i < hll->sparse.size; i++)
+      sum += ldexp(1.0, -entry_rank(entries[i]));
+  }
+
+  double alpha;
+  switch (m) {
+  case 16:
+    alpha = 0.673;
+    break;
+  case 32:
+    alpha = 0.697;
+    break;
+  case 64:
+    alpha = 0.709;
+    break;
+  default:
+    alpha = 0.7213 / (1 + 1.079 / m);
+  }
+
+  double estimate = alpha * m * m / sum;
+
+  // The raw estimate is biased for small counts, linear counting over the
+  // empty registers is better there. A 64-bit hash needs no correction for
+  // large counts.
+  if (estimate <= 2.5 * m && zeros)
+    estimate = m * log((double)m / zeros);
+
+  return (uint64_t)(estimate + 0.5);
+}
+
+int hyperloglog_merge(HyperLogLog *dst, const HyperLogLog *src) {
+  assert(dst != NULL);
+  assert(src != NULL);
+
+  if (dst->precision != src->precision)
+    return EXIT_FAILURE;
+
+  if (!src->registers) {
+    const uint32_t *entries = sparse_entries(src);
+    for (size_t i = 0; i < src->sparse.size; i++) {
+      if (update(dst, entry_idx(entries[i]), entry_rank(entries[i])))
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  if (!dst->registers && to_dense(dst))
+    return EXIT_FAILURE;
+
+  for (size_t i = 0; i < register_count(dst); i++) {
+    if (dst->registers[i] < src->registers[i])
+      dst->registers[i] = src->registers[i];
+  }
+
+  return EXIT_SUCCESS;
+}
+
+size_t hyperloglog_memory_usage(const HyperLogLog *hll) {
+  assert(hll != NULL);
+
+  if (hll->registers)
+    return register_count(hll);
+
+  return vector_memory_usage(&hll->sparse);
+}
+
+static size_t payload_size(const HyperLogLog *hll) {
+  if (hll->registers)
+    return register_count(hll);
+
+  return hll->sparse.size * sizeof(uint32_t);
+}
+
+size_t hyperloglog_serialized_size(const HyperLogLog *hll) {
+  assert(hll != NULL);
+  return sizeof(HyperLogLogHeader) + payload_size(hll);
+}
+
+int hyperloglog_serialize(const HyperLogLog *hll, void *buffer, size_t size) {
+  assert(hll != NULL);
+  assert(buffer != NULL);
+
+  if (size < hyperloglog_serialized_size(hll))
+    return EXIT_FAILURE;
+
+  HyperLogLogHeader header = {0};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.precision = hll->precision;
+  header.sparse = !hll->registers;
+  header.entries = hll->registers ? 0 : hll->sparse.size;
+
+  uint8_t *out = buffer;
+  memcpy(out, &header, sizeof(header));
+  memcpy(out + sizeof(header),
+         hll->registers ? (const void *)hll->registers : hll->sparse.data,
+         payload_size(hll));
+
+  return EXIT_SUCCESS;
+}
+
+// Sparse entries must be in order of index with ranks a hash could give.
+static int valid_sparse(const HyperLogLog *hll) {
+  const uint32_t *entries = sparse_entries(hll);
+
+  for (size_t i = 0; i < hll->sparse.size; i++) {
+    uint8_t rank = entry_rank(entries[i]);
+    if (entry_idx(entries[i]) >= register_count(hll) || !rank ||
+        rank > max_rank(hll->precision) ||
+        (i && entry_idx(entries[i - 1]) >= entry_idx(entries[i])))
+      return 0;
+  }
+
+  return 1;
+}
+
+static int valid_dense(const HyperLogLog *hll) {
+  for (size_t i = 0; i < register_count(hll); i++) {
+    if (hll->registers[i] > max_rank(hll->precision))
+      return 0;
+  }
+
+  return 1;
+}
+
+int hyperloglog_deserialize(HyperLogLog *result, const void *buffer,
+                            size_t size) {
+  assert(result != NULL);
+  assert(buffer != NULL);
+
+  *result = (HyperLogLog){0};
+
+  HyperLogLogHeader header;
+  if (size < sizeof(header))
+    return EXIT_FAILURE;
+  memcpy(&header, buffer, sizeof(header));
+
+  if (header.magic != MAGIC || header.version != VERSION ||
+      hyperloglog_init(result, header.precision))
+    return EXIT_FAILURE;
+
+  const uint8_t *payload = (const uint8_t *)buffer + sizeof(header);
+  size_t payload_bytes = size - sizeof(header);
+
+  if (header.sparse) {
+    // A sparse list that long would have been made dense. Divide so a
+    // corrupt count cannot wrap the byte length.
+    if (header.entries >= register_count(result) / sizeof(uint32_t) ||
+        payload_bytes != header.entries * sizeof(uint32_t) ||
+        vector_append_many(&result->sparse, payload, header.entries) ||
+        !valid_sparse(result))
+      goto err;
+  } else {
+    if (header.entries || payload_bytes != register_count(result) ||
+        to_dense(result))
+      goto err;
+
+    memcpy(result->registers, payload, payload_bytes);
+    if (!valid_dense(result))
+      goto err;
+  }
+
+  return EXIT_SUCCESS;
+
+err:
+  hyperloglog_deinit(result);
+  return EXIT_FAILURE;
+}
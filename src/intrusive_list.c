@@ -0,0 +1,153 @@
+/**
+ * intrusive_list.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/intrusive_list.h"
+#include <assert.h>
+
+// Links `link` between `prev` and `next`.
+static void link_between(IntrusiveListLink *prev, IntrusiveListLink *next,
+                         IntrusiveListLink *link) {
+  link->prev = prev;
+  link->next = next;
+  prev->next = link;
+  next->prev = link;
+}
+
+static void detach(IntrusiveListLink *link) {
+  link->prev->next = link->next;
+  link->next->prev = link->prev;
+  link->prev = NULL;
+  link->next = NULL;
+}
+
+void intrusive_list_init(IntrusiveList *list) {
+  assert(list != NULL);
+
+  list->head.prev = &list->head;
+  list->head.next = &list->head;
+  list->size = 0;
+}
+
+size_t intrusive_list_len(const IntrusiveList *list) {
+  assert(list != NULL);
+  return list->size;
+}
+
+IntrusiveListLink *intrusive_list_first(const IntrusiveList *list) {
+  assert(list != NULL);
+  return list->size ? list->head.next : NULL;
+}
+
+IntrusiveListLink *intrusive_list_last(const IntrusiveList *list) {
+  assert(list != NULL);
+  return list->size ? list->head.prev : NULL;
+}
+
+IntrusiveListLink *intrusive_list_next(const IntrusiveList *list,
+                                       const IntrusiveListLink *link) {
+  assert(list != NULL);
+  assert(link != NULL);
+
+  return link->next == &list->head ? NULL : link->next;
+}
+
+IntrusiveListLink *intrusive_list_prev(const IntrusiveList *list,
+                                       const IntrusiveListLink *link) {
+  assert(list != NULL);
+  assert(link != NULL);
+
+  return link->prev == &list->head ? NULL : link->prev;
+}
+
+void intrusive_list_prepend(IntrusiveList *list, IntrusiveListLink *link) {
+  assert(list != NULL);
+  assert(link != NULL);
+
+  link_between(&list->head, list->head.next, link);
+  list->size++;
+}
+
+void intrusive_list_append(IntrusiveList *list, IntrusiveListLink *link) {
+  assert(list != NULL);
+  assert(link != NULL);
+
+  link_between(list->head.prev, &list->head, link);
+  list->size++;
+}
+
+void intrusive_list_insert_after(IntrusiveList *list, IntrusiveListLink *link,
+                                 IntrusiveListLink *new_link) {
+  assert(list != NULL);
+  assert(link != NULL);
+  assert(new_link != NULL);
+
+  link_between(link, link->next, new_link);
+  list->size++;
+}
+
+void intrusive_list_insert_before(IntrusiveList *list, IntrusiveListLink *link,
+                                  IntrusiveListLink *new_link) {
+  assert(list != NULL);
+  assert(link != NULL);
+  assert(new_link != NULL);
+
+  link_between(link->prev, link, new_link);
+  list->size++;
+}
+
+void intrusive_list_remove(IntrusiveList *list, IntrusiveListLink *link) {
+  assert(list != NULL);
+  assert(link != NULL);
+  assert(link != &list->head);
+
+  detach(link);
+  list->size--;
+}
+
+void intrusive_list_move_to_front(IntrusiveList *list,
+                                  IntrusiveListLink *link) {
+  assert(list != NULL);
+  assert(link != NULL);
+
+  // Already at the front, nothing to do.
+  if (list->head.next == link)
+    return;
+
+  detach(link);
+  link_between(&list->head, list->head.next, link);
+}
+
+IntrusiveListLink *intrusive_list_pop_first(IntrusiveList *list) {
+  IntrusiveListLink *first = intrusive_list_first(list);
+  if (first)
+    intrusive_list_remove(list, first);
+
+  return first;
+}
+
+IntrusiveListLink *intrusive_list_pop_last(IntrusiveList *list) {
+  IntrusiveListLink *last = intrusive_list_last(list);
+  if (last)
+    intrusive_list_remove(list, last);
+
+  return last;
+}
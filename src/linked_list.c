@@ -21,19 +21,20 @@
  * SOFTWARE.
  */
 #include "mylib/linked_list.h"
+#include "mylib/alloc.h"
 #include <assert.h>
 #include <string.h>
 
 LinkedListNode *linked_list_node_init(void *data, size_t element_size) {
   assert(data != NULL);
 
-  LinkedListNode *result = calloc(1, sizeof(LinkedListNode));
+  LinkedListNode *result = alloc_calloc(1, sizeof(LinkedListNode));
   if (!result)
     return NULL;
 
-  result->data = malloc(element_size);
+  result->data = alloc_malloc(element_size);
   if (!result->data) {
-    free(result);
+    alloc_free(result);
     return NULL;
   }
 
@@ -45,8 +46,8 @@ LinkedListNode *linked_list_node_init(void *data, size_t element_size) {
 void linked_list_node_deinit(LinkedListNode *node) {
   assert(node != NULL);
 
-  free(node->data);
-  free(node);
+  alloc_free(node->data);
+  alloc_free(node);
 }
 
 LinkedList linked_list_init() { return (LinkedList){0}; }
@@ -75,6 +76,16 @@ void linked_list_clear(LinkedList *list) {
 
 void linked_list_deinit(LinkedList *list) { linked_list_clear(list); }
 
+size_t linked_list_memory_usage(const LinkedList *list, size_t element_size) {
+  assert(list != NULL);
+
+  size_t result = 0;
+  for (LinkedListNode *node = list->first; node; node = node->next)
+    result += sizeof(LinkedListNode) + element_size;
+
+  return result;
+}
+
 int linked_list_prepend_node(LinkedList *list, LinkedListNode *node) {
   assert(list != NULL);
   assert(node != NULL);
@@ -144,3 +155,18 @@ void linked_list_delete(LinkedList *list, LinkedListNode *node) {
   // TODO Is this one of those situations where I should actually use assert?
   linked_list_node_deinit(curr);
 }
+
+void linked_list_delete_next(LinkedList *list, LinkedListNode *prev) {
+  assert(list != NULL);
+
+  LinkedListNode *node = prev ? prev->next : list->first;
+  if (!node)
+    return;
+
+  if (prev)
+    prev->next = node->next;
+  else
+    list->first = node->next;
+
+  linked_list_node_deinit(node);
+}
@@ -0,0 +1,416 @@
+/**
+ * parallel.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/parallel.h"
+#include "mylib/alloc.h"
+
+#include <assert.h>
+#include <string.h>
+
+// How many pieces a grain of 0 aims to give each worker.
+#define PIECES_PER_WORKER 8
+
+// Bitsets are split into pieces of at least this many bytes.
+#define BITSET_GRAIN 4096
+
+typedef struct ForJob {
+  ThreadPool *pool;
+  ThreadPoolGroup group;
+  size_t grain;
+  ParallelForFn fn;
+  void *ctx;
+} ForJob;
+
+typedef struct ForRange {
+  ForJob *job;
+  size_t begin;
+  size_t end;
+} ForRange;
+
+static size_t pick_grain(const ThreadPool *pool, size_t count, size_t grain) {
+  if (grain)
+    return grain;
+
+  grain = count / (thread_pool_worker_count(pool) * PIECES_PER_WORKER);
+  return grain ? grain : 1;
+}
+
+// Spawns the upper half of the range until it fits in the grain, then runs it.
+static void for_range(void *arg) {
+  ForRange range = *(ForRange *)arg;
+  ForJob *job = range.job;
+
+  while (range.end - range.begin > job->grain) {
+    size_t mid = range.begin + (range.end - range.begin) / 2;
+    ForRange upper = {job, mid, range.end};
+    thread_pool_spawn(job->pool, &job->group, for_range, &upper,
+                      sizeof(ForRange));
+    range.end = mid;
+  }
+
+  job->fn(job->ctx, range.begin, range.end);
+}
+
+void parallel_for(ThreadPool *pool, size_t begin, size_t end, size_t grain,
+                  ParallelForFn fn, void *ctx) {
+  assert(pool != NULL);
+  assert(fn != NULL);
+
+  if (begin >= end)
+    return;
+
+  ForJob job = {0};
+  job.pool = pool;
+  job.grain = pick_grain(pool, end - begin, grain);
+  job.fn = fn;
+  job.ctx = ctx;
+
+  ForRange range = {&job, begin, end};
+  for_range(&range);
+  thread_pool_wait(pool, &job.group);
+}
+
+typedef struct ReduceJob {
+  size_t begin;
+  size_t end;
+  size_t grain;
+  ParallelReduceFn reduce;
+  void *ctx;
+  uint8_t *partials;
+  size_t result_size;
+} ReduceJob;
+
+// Reduces pieces [first, last) each into its own partial.
+static void reduce_pieces(void *arg, size_t first, size_t last) {
+  ReduceJob *job = arg;
+
+  for (size_t i = first; i < last; i++) {
+    size_t begin = job->begin + i * job->grain;
+    size_t end = job->end - begin > job->grain ? begin + job->grain : job->end;
+    job->reduce(job->ctx, begin, end, job->partials + i * job->result_size);
+  }
+}
+
+int parallel_reduce(ThreadPool *pool, size_t begin, size_t end, size_t grain,
+                    ParallelReduceFn reduce, ParallelCombineFn combine,
+                    void *ctx, const void *identity, void *result,
+                    size_t result_size) {
+  assert(pool != NULL);
+  assert(reduce != NULL);
+  assert(combine != NULL);
+  assert(result != NULL);
+
+  memcpy(result, identity, result_size);
+  if (begin >= end)
+    return EXIT_SUCCESS;
+
+  ReduceJob job = {0};
+  job.begin = begin;
+  job.end = end;
+  job.grain = pick_grain(pool, end - begin, grain);
+  job.reduce = reduce;
+  job.ctx = ctx;
+  job.result_size = result_size;
+
+  size_t pieces = (end - begin + job.grain - 1) / job.grain;
+  if (!(job.partials = alloc_malloc(pieces * result_size)))
+    return EXIT_FAILURE;
+  for (size_t i = 0; i < pieces; i++)
+    memcpy(job.partials + i * result_size, identity, result_size);
+
+  parallel_for(pool, 0, pieces, 1, reduce_pieces, &job);
+
+  for (size_t i = 0; i < pieces; i++)
+    combine(ctx, result, job.partials + i * result_size);
+
+  alloc_free(job.partials);
+
+  return EXIT_SUCCESS;
+}
+
+typedef struct MapJob {
+  const Vector *src;
+  Vector *result;
+  ParallelMapFn fn;
+  void *ctx;
+} MapJob;
+
+static void map_range(void *arg, size_t begin, size_t end) {
+  MapJob *job = arg;
+
+  for (size_t i = begin; i < end; i++)
+    job->fn(job->ctx, vector_get_const(job->src, i),
+            vector_get(job->result, i));
+}
+
+int parallel_vector_map(ThreadPool *pool, const Vector *src, Vector *result,
+                        size_t element_size, ParallelMapFn fn, void *ctx) {
+  assert(src != NULL);
+  assert(result != NULL);
+  assert(fn != NULL);
+
+  size_t len = vector_len(src);
+  if (vector_init_with_capacity(result, element_size, len))
+    return EXIT_FAILURE;
+  result->size = len;
+
+  MapJob job = {src, result, fn, ctx};
+  parallel_for(pool, 0, len, 0, map_range, &job);
+
+  return EXIT_SUCCESS;
+}
+
+typedef struct FilterJob {
+  const Vector *src;
+  Vector *result;
+  ParallelPredicateFn fn;
+  void *ctx;
+  size_t grain;
+  uint8_t *keep;   // Whether to keep each element.
+  size_t *offsets; // How many elements each piece keeps, then where they go.
+} FilterJob;
+
+static void filter_test(void *arg, size_t first, size_t last) {
+  FilterJob *job = arg;
+  size_t len = vector_len(job->src);
+
+  for (size_t piece = first; piece < last; piece++) {
+    size_t begin = piece * job->grain;
+    size_t end = len - begin > job->grain ? begin + job->grain : len;
+
+    size_t count = 0;
+    for (size_t i = begin; i < end; i++) {
+      job->keep[i] = job->fn(job->ctx, vector_get_const(job->src, i)) != 0;
+      count += job->keep[i];
+    }
+    job->offsets[piece] = count;
+  }
+}
+
+static void filter_copy(void *arg, size_t first, size_t last) {
+  FilterJob *job = arg;
+  size_t len = vector_len(job->src);
+  size_t element_size = job->src->element_size;
+
+  for (size_t piece = first; piece < last; piece++) {
+    size_t begin = piece * job->grain;
+    size_t end = len - begin > job->grain ? begin + job->grain : len;
+
+    uint8_t *dst = (uint8_t *)job->result->data +
+                   job->offsets[piece] * element_size;
+    for (size_t i = begin; i < end; i++) {
+      if (job->keep[i]) {
+        memcpy(dst, vector_get_const(job->src, i), element_size);
+        dst += element_size;
+      }
+    }
+  }
+}
+
+int parallel_vector_filter(ThreadPool *pool, const Vector *src, Vector *result,
+                           ParallelPredicateFn fn, void *ctx) {
+  assert(src != NULL);
+  assert(result != NULL);
+  assert(fn != NULL);
+
+  size_t len = vector_len(src);
+
+  FilterJob job = {0};
+  job.src = src;
+  job.result = result;
+  job.fn = fn;
+  job.ctx = ctx;
+  job.grain = pick_grain(pool, len, 0);
+
+  // Test every element and count what each piece keeps, then turn the counts
+  // into offsets so each piece can copy into its own part of the result.
+  size_t pieces = (len + job.grain - 1) / job.grain;
+  job.keep = alloc_malloc(len ? len : 1);
+  job.offsets = alloc_malloc((pieces ? pieces : 1) * sizeof(size_t));
+  if (!job.keep || !job.offsets)
+    goto err;
+
+  parallel_for(pool, 0, pieces, 1, filter_test, &job);
+
+  size_t kept = 0;
+  for (size_t i = 0; i < pieces; i++) {
+    size_t count = job.offsets[i];
+    job.offsets[i] = kept;
+    kept += count;
+  }
+
+  if (vector_init_with_capacity(result, src->element_size, kept))
+    goto err;
+  result->size = kept;
+
+  parallel_for(pool, 0, pieces, 1, filter_copy, &job);
+
+  alloc_free(job.keep);
+  alloc_free(job.offsets);
+
+  return EXIT_SUCCESS;
+
+err:
+  alloc_free(job.keep);
+  alloc_free(job.offsets);
+
+  return EXIT_FAILURE;
+}
+
+typedef struct AccumulateJob {
+  const Vector *vec;
+  ParallelAccumulateFn accumulate;
+  ParallelCombineFn combine;
+  void *ctx;
+} AccumulateJob;
+
+static void accumulate_range(void *arg, size_t begin, size_t end,
+                             void *result) {
+  AccumulateJob *job = arg;
+
+  for (size_t i = begin; i < end; i++)
+    job->accumulate(job->ctx, result, vector_get_const(job->vec, i));
+}
+
+static void combine_partial(void *arg, void *result, const void *partial) {
+  AccumulateJob *job = arg;
+  job->combine(job->ctx, result, partial);
+}
+
+int parallel_vector_reduce(ThreadPool *pool, const Vector *vec,
+                           ParallelAccumulateFn accumulate,
+                           ParallelCombineFn combine, void *ctx,
+                           const void *identity, void *result,
+                           size_t result_size) {
+  assert(vec != NULL);
+  assert(accumulate != NULL);
+  assert(combine != NULL);
+
+  AccumulateJob job = {vec, accumulate, combine, ctx};
+
+  return parallel_reduce(pool, 0, vector_len(vec), 0, accumulate_range,
+                         combine_partial, &job, identity, result, result_size);
+}
+
+static void count_range(void *arg, size_t begin, size_t end, void *result) {
+  const Bitset *bs = arg;
+
+  // Eight bytes at a time, then whatever is left over.
+  size_t count = 0, i = begin;
+  for (; i + sizeof(uint64_t) <= end; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bs->bytes + i, sizeof(uint64_t));
+    count += __builtin_popcountll(word);
+  }
+  for (; i < end; i++)
+    count += __builtin_popcount(bs->bytes[i]);
+  *(size_t *)result += count;
+}
+
+static void add_counts(void *arg, void *result, const void *partial) {
+  (void)arg;
+  *(size_t *)result += *(const size_t *)partial;
+}
+
+size_t parallel_bitset_count(ThreadPool *pool, const Bitset *bs) {
+  assert(bs != NULL);
+
+  size_t bytes = bitset_size_in_bytes(bs);
+  size_t zero = 0, result;
+  size_t grain = pick_grain(pool, bytes, 0);
+  if (grain < BITSET_GRAIN)
+    grain = BITSET_GRAIN;
+
+  // Falls back to counting on this thread if the partials can't be allocated.
+  if (parallel_reduce(pool, 0, bytes, grain, count_range, add_counts,
+                      (void *)bs, &zero, &result, sizeof(size_t)))
+    return bitset_count(bs);
+
+  return result;
+}
+
+typedef struct UnionJob {
+  const Bitset *largest;
+  const Bitset *smallest;
+  size_t smallest_bytes;
+  Bitset *result;
+} UnionJob;
+
+static void union_range(void *arg, size_t begin, size_t end) {
+  UnionJob *job = arg;
+
+  for (size_t i = begin; i < end; i++)
+    job->result->bytes[i] =
+        job->largest->bytes[i] |
+        (i < job->smallest_bytes ? job->smallest->bytes[i] : 0);
+}
+
+int parallel_bitset_union(ThreadPool *pool, const Bitset *a, const Bitset *b,
+                          Bitset *result) {
+  assert(a != NULL);
+  assert(b != NULL);
+  assert(result != NULL);
+
+  const Bitset *largest = a->max > b->max ? a : b;
+  const Bitset *smallest = largest == a ? b : a;
+
+  if (bitset_init(result, largest->max))
+    return EXIT_FAILURE;
+
+  size_t bytes = bitset_size_in_bytes(largest);
+  size_t grain = pick_grain(pool, bytes, 0);
+  if (grain < BITSET_GRAIN)
+    grain = BITSET_GRAIN;
+
+  UnionJob job = {largest, smallest, bitset_size_in_bytes(smallest), result};
+  parallel_for(pool, 0, bytes, grain, union_range, &job);
+
+  return EXIT_SUCCESS;
+}
+
+typedef struct ForEachJob {
+  const HashMap *map;
+  ParallelKVFn fn;
+  void *ctx;
+} ForEachJob;
+
+static void for_each_range(void *arg, size_t begin, size_t end) {
+  ForEachJob *job = arg;
+
+  for (size_t i = begin; i < end; i++)
+    for (LinkedListNode *node = job->map->buckets[i].first; node;
+         node = node->next)
+      job->fn(job->ctx, node->data);
+}
+
+void parallel_hash_map_for_each(ThreadPool *pool, const HashMap *map,
+                                ParallelKVFn fn, void *ctx) {
+  assert(map != NULL);
+  assert(fn != NULL);
+
+  // A cleared map has no buckets until the next put.
+  if (!map->buckets)
+    return;
+
+  ForEachJob job = {map, fn, ctx};
+  parallel_for(pool, 0, map->capacity, 0, for_each_range, &job);
+}
@@ -0,0 +1,528 @@
+/**
+ * perfect_map.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include "mylib/perfect_map.h"
+#include "mylib/alloc.h"
+#include "mylib/hash.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIC 0x50414D48504C594DULL // "MYLPHMAP"
+#define VERSION 1
+
+// The average bucket size, bigger buckets need fewer pilots but more tries to
+// place.
+#define KEYS_PER_BUCKET 6
+
+// Each section of the block starts on a cache line.
+#define SECTION_ALIGN 64
+#define ALIGN_UP(n) (((n) + SECTION_ALIGN - 1) & ~(size_t)(SECTION_ALIGN - 1))
+
+// Seeds to try before giving up, a seed only fails if some bucket has no
+// pilot that places it, which is rare.
+#define MAX_SEEDS 16
+
+// 0.6 * 2^32, the share of the keys that go to the dense buckets.
+#define DENSE_KEYS 2576980377U
+
+// 2^64 divided by the golden ratio, spreads a pilot over 64 bits.
+#define FIBONACCI_64 0x9E3779B97F4A7C15ULL
+
+// The first bytes of the block and of the file, padded to a section.
+typedef struct PerfectMapHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t key_size;
+  uint64_t value_size;
+  uint64_t count;
+  uint64_t table_size;
+  uint64_t bucket_count;
+  uint64_t seed;
+} PerfectMapHeader;
+
+// Byte offsets of each section from the start of the block.
+typedef struct Layout {
+  size_t pilots;
+  size_t remap;
+  size_t keys;
+  size_t values;
+  size_t length;
+} Layout;
+
+typedef enum SeedResult {
+  SEED_OK,
+  SEED_RETRY,     // Two keys share a hash or a bucket has no pilot.
+  SEED_DUPLICATE, // A key is in the input twice.
+} SeedResult;
+
+// Scratch space for building, reused between seeds.
+typedef struct Builder {
+  const uint8_t *keys;
+  size_t count;
+  size_t key_size;
+  size_t table_size;
+  size_t bucket_count;
+
+  uint64_t *hashes;
+  uint32_t *buckets;   // Bucket of each key.
+  size_t *starts;      // Where each bucket's keys start in `order`.
+  uint32_t *order;     // Keys grouped by bucket.
+  uint32_t *by_size;   // Buckets, biggest first.
+  size_t *fill;        // Counts for the counting sorts.
+  uint32_t *positions; // Position of each key.
+  uint16_t *pilots;
+  uint64_t *taken; // A bit for each position, checked in the inner loop.
+} Builder;
+
+// See hash_map.c.
+static uint64_t mul_high64(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+  return ((unsigned __int128)a * b) >> 64;
+#else
+  uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+  uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+
+  uint64_t lo_lo = a_lo * b_lo;
+  uint64_t hi_lo = a_hi * b_lo;
+  uint64_t lo_hi = a_lo * b_hi;
+  uint64_t hi_hi = a_hi * b_hi;
+
+  uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+  return hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+// The MurmurHash3 64-bit finalizer.
+static uint64_t finalize(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+
+  return hash;
+}
+
+// As in PTHash, 60% of the keys go to 30% of the buckets. The big buckets are
+// placed first while the table is still mostly empty, the many small ones
+// fill in the rest.
+static size_t bucket_of(uint64_t hash, size_t bucket_count) {
+  uint64_t high = hash >> 32;
+  size_t dense = bucket_count * 3 / 10;
+
+  if (!dense)
+    return (high * bucket_count) >> 32;
+  if ((uint32_t)hash < DENSE_KEYS)
+    return (high * dense) >> 32;
+  return dense + ((high * (bucket_count - dense)) >> 32);
+}
+
+static size_t position(uint64_t hash, uint16_t pilot, size_t table_size) {
+  return mul_high64(finalize(hash ^ (pilot * FIBONACCI_64)), table_size);
+}
+
+static size_t taken_words(size_t table_size) { return table_size / 64 + 1; }
+
+static Layout layout(const PerfectMapHeader *header) {
+  Layout result;
+  result.pilots = ALIGN_UP(sizeof(PerfectMapHeader));
+  result.remap =
+      result.pilots + ALIGN_UP(header->bucket_count * sizeof(uint16_t));
+  result.keys = result.remap +
+                ALIGN_UP((header->table_size - header->count) *
+                         sizeof(uint32_t));
+  result.values = result.keys + ALIGN_UP(header->count * header->key_size);
+  result.length = result.values + header->count * header->value_size;
+
+  return result;
+}
+
+// Points the map's arrays into its block.
+static void attach(PerfectMap *map, void *data, size_t length) {
+  const PerfectMapHeader *header = data;
+  Layout sections = layout(header);
+
+  map->count = header->count;
+  map->key_size = header->key_size;
+  map->value_size = header->value_size;
+  map->table_size = header->table_size;
+  map->bucket_count = header->bucket_count;
+  map->seed = header->seed;
+
+  map->pilots = (const uint16_t *)((uint8_t *)data + sections.pilots);
+  map->remap = (const uint32_t *)((uint8_t *)data + sections.remap);
+  map->keys = (uint8_t *)data + sections.keys;
+  map->values = (uint8_t *)data + sections.values;
+  map->data = data;
+  map->length = length;
+}
+
+// Tries to place every bucket with the hashes from `seed`.
+static SeedResult try_seed(Builder *builder, uint64_t seed) {
+  size_t count = builder->count, bucket_count = builder->bucket_count;
+
+  memset(builder->starts, 0, (bucket_count + 1) * sizeof(size_t));
+  for (size_t i = 0; i < count; i++) {
+    builder->hashes[i] = xxh64_hash(builder->keys + i * builder->key_size,
+                                    builder->key_size, seed);
+    builder->buckets[i] = bucket_of(builder->hashes[i], bucket_count);
+    builder->starts[builder->buckets[i] + 1]++;
+  }
+
+  // Counting sort the keys by bucket, then the buckets by size.
+  size_t max_size = 0;
+  for (size_t b = 0; b < bucket_count; b++) {
+    size_t size = builder->starts[b + 1];
+    if (size > max_size)
+      max_size = size;
+    builder->starts[b + 1] += builder->starts[b];
+  }
+
+  size_t *fill = builder->fill;
+  memset(fill, 0, bucket_count * sizeof(size_t));
+  for (size_t i = 0; i < count; i++) {
+    uint32_t b = builder->buckets[i];
+    builder->order[builder->starts[b] + fill[b]++] = i;
+  }
+
+  memset(fill, 0, (max_size + 2) * sizeof(size_t));
+  for (size_t b = 0; b < bucket_count; b++)
+    fill[max_size - (builder->starts[b + 1] - builder->starts[b]) + 1]++;
+  for (size_t s = 1; s <= max_size + 1; s++)
+    fill[s] += fill[s - 1];
+  for (size_t b = 0; b < bucket_count; b++) {
+    size_t size = builder->starts[b + 1] - builder->starts[b];
+    builder->by_size[fill[max_size - size]++] = b;
+  }
+
+  memset(builder->taken, 0,
+         taken_words(builder->table_size) * sizeof(uint64_t));
+
+  for (size_t i = 0; i < bucket_count; i++) {
+    uint32_t b = builder->by_size[i];
+    const uint32_t *keys = builder->order + builder->starts[b];
+    size_t size = builder->starts[b + 1] - builder->starts[b];
+
+    // Keys with the same hash can never be separated.
+    for (size_t j = 0; j < size; j++) {
+      for (size_t k = 0; k < j; k++) {
+        if (builder->hashes[keys[j]] != builder->hashes[keys[k]])
+          continue;
+        if (!memcmp(builder->keys + keys[j] * builder->key_size,
+                    builder->keys + keys[k] * builder->key_size,
+                    builder->key_size))
+          return SEED_DUPLICATE;
+        return SEED_RETRY;
+      }
+    }
+
+    builder->pilots[b] = 0;
+    if (!size)
+      continue;
+
+    uint32_t pilot = 0;
+    for (; pilot <= UINT16_MAX; pilot++) {
+      size_t placed = 0;
+      for (; placed < size; placed++) {
+        size_t pos = position(builder->hashes[keys[placed]], pilot,
+                              builder->table_size);
+        if (builder->taken[pos / 64] >> (pos % 64) & 1)
+          break;
+
+        size_t k = 0;
+        while (k < placed && builder->positions[keys[k]] != pos)
+          k++;
+        if (k < placed)
+          break;
+
+        builder->positions[keys[placed]] = pos;
+      }
+
+      if (placed == size)
+        break;
+    }
+
+    if (pilot > UINT16_MAX)
+      return SEED_RETRY;
+
+    builder->pilots[b] = pilot;
+    for (size_t j = 0; j < size; j++) {
+      size_t pos = builder->positions[keys[j]];
+      builder->taken[pos / 64] |= (uint64_t)1 << (pos % 64);
+    }
+  }
+
+  return SEED_OK;
+}
+
+static void builder_deinit(Builder *builder) {
+  alloc_free(builder->hashes);
+  alloc_free(builder->buckets);
+  alloc_free(builder->starts);
+  alloc_free(builder->order);
+  alloc_free(builder->by_size);
+  alloc_free(builder->fill);
+  alloc_free(builder->positions);
+  alloc_free(builder->pilots);
+  alloc_free(builder->taken);
+}
+
+int perfect_map_build(PerfectMap *result, const void *keys, const void *values,
+                      size_t count, size_t key_size, size_t value_size) {
+  assert(result != NULL);
+  assert(count == 0 || keys != NULL);
+  assert(key_size > 0);
+
+  *result = (PerfectMap){0};
+
+  if (count > UINT32_MAX)
+    return EXIT_FAILURE;
+
+  // A table 1% bigger than the keys leaves the last buckets free slots to
+  // find, the keys that land past `count` are remapped into the gaps.
+  Builder builder = {0};
+  builder.keys = keys;
+  builder.count = count;
+  builder.key_size = key_size;
+  builder.table_size = count + count / 99;
+  builder.bucket_count = (count + KEYS_PER_BUCKET - 1) / KEYS_PER_BUCKET;
+
+  builder.hashes = alloc_malloc((count ? count : 1) * sizeof(uint64_t));
+  builder.buckets = alloc_malloc((count ? count : 1) * sizeof(uint32_t));
+  builder.starts = alloc_malloc((builder.bucket_count + 1) * sizeof(size_t));
+  builder.order = alloc_malloc((count ? count : 1) * sizeof(uint32_t));
+  builder.by_size =
+      alloc_malloc((builder.bucket_count + 1) * sizeof(uint32_t));
+  builder.positions = alloc_malloc((count ? count : 1) * sizeof(uint32_t));
+  // Bucket sizes are at most `count`.
+  builder.fill = alloc_malloc(
+      ((count > builder.bucket_count ? count : builder.bucket_count) + 2) *
+      sizeof(size_t));
+  builder.pilots = alloc_malloc((builder.bucket_count + 1) * sizeof(uint16_t));
+  builder.taken =
+      alloc_malloc(taken_words(builder.table_size) * sizeof(uint64_t));
+  if (!builder.hashes || !builder.buckets || !builder.starts ||
+      !builder.order || !builder.by_size || !builder.positions ||
+      !builder.fill || !builder.pilots || !builder.taken)
+    goto err;
+
+  uint64_t seed;
+  SeedResult placed = SEED_RETRY;
+  for (seed = 0; seed < MAX_SEEDS; seed++)
+    if ((placed = try_seed(&builder, seed)) != SEED_RETRY)
+      break;
+  if (placed != SEED_OK)
+    goto err;
+
+  PerfectMapHeader header = {0};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.key_size = key_size;
+  header.value_size = value_size;
+  header.count = count;
+  header.table_size = builder.table_size;
+  header.bucket_count = builder.bucket_count;
+  header.seed = seed;
+
+  Layout sections = layout(&header);
+  uint8_t *data = alloc_calloc(sections.length, 1);
+  if (!data)
+    goto err;
+
+  memcpy(data, &header, sizeof(header));
+  memcpy(data + sections.pilots, builder.pilots,
+         builder.bucket_count * sizeof(uint16_t));
+
+  // Move the taken slots past the end into the free slots below it, in order.
+  uint32_t *remap = (uint32_t *)(data + sections.remap);
+  size_t free_slot = 0;
+  for (size_t pos = count; pos < builder.table_size; pos++) {
+    if (!(builder.taken[pos / 64] >> (pos % 64) & 1))
+      continue;
+    while (builder.taken[free_slot / 64] >> (free_slot % 64) & 1)
+      free_slot++;
+    remap[pos - count] = free_slot++;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    size_t slot = builder.positions[i];
+    if (slot >= count)
+      slot = remap[slot - count];
+
+    memcpy(data + sections.keys + slot * key_size,
+           (const uint8_t *)keys + i * key_size, key_size);
+    if (value_size)
+      memcpy(data + sections.values + slot * value_size,
+             (const uint8_t *)values + i * value_size, value_size);
+  }
+
+  builder_deinit(&builder);
+  attach(result, data, sections.length);
+
+  return EXIT_SUCCESS;
+
+err:
+  builder_deinit(&builder);
+
+  return EXIT_FAILURE;
+}
+
+int perfect_map_build_from_hash_map(PerfectMap *result, const HashMap *map) {
+  assert(result != NULL);
+  assert(map != NULL);
+
+  *result = (PerfectMap){0};
+
+  // The sizes of borrowed keys and values are unknown.
+  if (map->options.storage == HASH_MAP_STORE_BORROW)
+    return EXIT_FAILURE;
+
+  size_t count = hash_map_count(map);
+  uint8_t *keys = alloc_malloc((count ? count : 1) * map->key_size);
+  uint8_t *values = alloc_malloc((count ? count : 1) * map->value_size + 1);
+  if (!keys || !values) {
+    alloc_free(keys);
+    alloc_free(values);
+    return EXIT_FAILURE;
+  }
+
+  size_t i = 0;
+  HashMapIterator iter = hash_map_iter(map);
+  const HashMapKV *kv;
+  while ((kv = hash_map_next(&iter))) {
+    memcpy(keys + i * map->key_size, kv->key, map->key_size);
+    memcpy(values + i * map->value_size, kv->value, map->value_size);
+    i++;
+  }
+
+  int failed = perfect_map_build(result, keys, values, count, map->key_size,
+                                 map->value_size);
+  alloc_free(keys);
+  alloc_free(values);
+
+  return failed;
+}
+
+void perfect_map_deinit(PerfectMap *map) {
+  assert(map != NULL);
+
+  if (map->mapped)
+    munmap(map->data, map->length);
+  else
+    alloc_free(map->data);
+
+  *map = (PerfectMap){0};
+}
+
+size_t perfect_map_count(const PerfectMap *map) {
+  assert(map != NULL);
+  return map->count;
+}
+
+const void *perfect_map_get(const PerfectMap *map, const void *key) {
+  assert(map != NULL);
+  assert(key != NULL);
+
+  if (!map->count)
+    return NULL;
+
+  uint64_t hash = xxh64_hash(key, map->key_size, map->seed);
+  size_t slot = position(hash, map->pilots[bucket_of(hash, map->bucket_count)],
+                         map->table_size);
+  if (slot >= map->count)
+    slot = map->remap[slot - map->count];
+
+  if (memcmp(map->keys + slot * map->key_size, key, map->key_size))
+    return NULL;
+
+  return map->values + slot * map->value_size;
+}
+
+int perfect_map_has(const PerfectMap *map, const void *key) {
+  return perfect_map_get(map, key) != NULL;
+}
+
+int perfect_map_write(const PerfectMap *map, const char *path) {
+  assert(map != NULL);
+  assert(path != NULL);
+
+  FILE *file = fopen(path, "wb");
+  if (!file)
+    return EXIT_FAILURE;
+
+  size_t written = fwrite(map->data, 1, map->length, file);
+  if (fclose(file) || written != map->length)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+int perfect_map_open(PerfectMap *result, const char *path) {
+  assert(result != NULL);
+  assert(path != NULL);
+
+  *result = (PerfectMap){0};
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return EXIT_FAILURE;
+
+  struct stat st;
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(PerfectMapHeader)) {
+    close(fd);
+    return EXIT_FAILURE;
+  }
+
+  size_t length = st.st_size;
+  void *data = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return EXIT_FAILURE;
+
+  // The magic reads backwards on a machine with the other byte order.
+  const PerfectMapHeader *header = data;
+  if (header->magic != MAGIC || header->version != VERSION ||
+      header->table_size < header->count || !header->key_size ||
+      layout(header).length != length) {
+    munmap(data, length);
+    return EXIT_FAILURE;
+  }
+
+  attach(result, data, length);
+  result->mapped = 1;
+
+  return EXIT_SUCCESS;
+}
+
+size_t perfect_map_memory_usage(const PerfectMap *map) {
+  assert(map != NULL);
+  return map->length;
+}
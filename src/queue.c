@@ -0,0 +1,269 @@
+/**
+ * queue.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/queue.h"
+#include "mylib/alloc.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+// The GCC atomic builtins are used so that the library can stay on C99.
+#define LOAD_RELAXED(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+// Round up to the next power of two, 0 becomes 1.
+static size_t round_up_pow2(size_t n) {
+  size_t result = 1;
+  while (result < n)
+    result <<= 1;
+  return result;
+}
+
+static void *spsc_get_offset(SpscQueue *queue, size_t idx) {
+  return queue->data + ((idx & (queue->capacity - 1)) * queue->element_size);
+}
+
+int spsc_queue_init(SpscQueue *result, size_t element_size, size_t capacity) {
+  assert(result != NULL);
+
+  *result = (SpscQueue){0};
+
+  capacity = round_up_pow2(capacity);
+
+  result->data = alloc_malloc(capacity * element_size);
+  if (!result->data)
+    return EXIT_FAILURE;
+
+  result->capacity = capacity;
+  result->element_size = element_size;
+
+  return EXIT_SUCCESS;
+}
+
+void spsc_queue_deinit(SpscQueue *queue) {
+  assert(queue != NULL);
+
+  alloc_free(queue->data);
+}
+
+size_t spsc_queue_memory_usage(const SpscQueue *queue) {
+  assert(queue != NULL);
+  return queue->capacity * queue->element_size;
+}
+
+// Returns how many slots the producer can write to, only reloading `head` from
+// the consumer when the cached value says the queue is full.
+static size_t spsc_free_slots(SpscQueue *queue, size_t tail) {
+  size_t free_slots = queue->capacity - (tail - queue->cached_head);
+  if (free_slots == 0) {
+    queue->cached_head = LOAD_ACQUIRE(&queue->head);
+    free_slots = queue->capacity - (tail - queue->cached_head);
+  }
+  return free_slots;
+}
+
+// Same as above for the consumer and `tail`.
+static size_t spsc_used_slots(SpscQueue *queue, size_t head) {
+  size_t used_slots = queue->cached_tail - head;
+  if (used_slots == 0) {
+    queue->cached_tail = LOAD_ACQUIRE(&queue->tail);
+    used_slots = queue->cached_tail - head;
+  }
+  return used_slots;
+}
+
+int spsc_queue_push(SpscQueue *queue, const void *element) {
+  assert(queue != NULL);
+  assert(element != NULL);
+
+  return spsc_queue_push_batch(queue, element, 1) == 1 ? EXIT_SUCCESS
+                                                       : EXIT_FAILURE;
+}
+
+size_t spsc_queue_push_batch(SpscQueue *queue, const void *elements,
+                             size_t count) {
+  assert(queue != NULL);
+  assert(elements != NULL || count == 0);
+
+  size_t tail = LOAD_RELAXED(&queue->tail);
+
+  size_t free_slots = spsc_free_slots(queue, tail);
+  if (count > free_slots)
+    count = free_slots;
+
+  for (size_t i = 0; i < count; i++)
+    memcpy(spsc_get_offset(queue, tail + i),
+           (const uint8_t *)elements + i * queue->element_size,
+           queue->element_size);
+
+  // Publish every element at once.
+  if (count)
+    STORE_RELEASE(&queue->tail, tail + count);
+
+  return count;
+}
+
+int spsc_queue_pop(SpscQueue *queue, void *result) {
+  assert(queue != NULL);
+
+  size_t head = LOAD_RELAXED(&queue->head);
+
+  if (spsc_used_slots(queue, head) == 0)
+    return EXIT_FAILURE;
+
+  if (result)
+    memcpy(result, spsc_get_offset(queue, head), queue->element_size);
+
+  STORE_RELEASE(&queue->head, head + 1);
+
+  return EXIT_SUCCESS;
+}
+
+size_t spsc_queue_pop_batch(SpscQueue *queue, void *result, size_t count) {
+  assert(queue != NULL);
+  assert(result != NULL || count == 0);
+
+  size_t head = LOAD_RELAXED(&queue->head);
+
+  size_t used_slots = spsc_used_slots(queue, head);
+  if (count > used_slots)
+    count = used_slots;
+
+  for (size_t i = 0; i < count; i++)
+    memcpy((uint8_t *)result + i * queue->element_size,
+           spsc_get_offset(queue, head + i), queue->element_size);
+
+  // Hand every slot back to the producer at once.
+  if (count)
+    STORE_RELEASE(&queue->head, head + count);
+
+  return count;
+}
+
+// Each slot is a sequence number followed by the element, padded so that the
+// sequence number of the next slot stays aligned.
+static size_t *mpmc_get_slot(MpmcQueue *queue, size_t pos) {
+  return queue->slots + ((pos & (queue->capacity - 1)) * queue->slot_size);
+}
+
+int mpmc_queue_init(MpmcQueue *result, size_t element_size, size_t capacity) {
+  assert(result != NULL);
+
+  *result = (MpmcQueue){0};
+
+  // The sequence numbers need at least two slots to tell full from empty.
+  capacity = round_up_pow2(capacity < 2 ? 2 : capacity);
+
+  size_t slot_size = sizeof(size_t) + element_size;
+  slot_size = (slot_size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+
+  result->slots = alloc_malloc(capacity * slot_size);
+  if (!result->slots)
+    return EXIT_FAILURE;
+
+  result->capacity = capacity;
+  result->element_size = element_size;
+  result->slot_size = slot_size;
+
+  // A slot is free for the producer at `pos` when its sequence equals `pos`.
+  for (size_t i = 0; i < capacity; i++)
+    *mpmc_get_slot(result, i) = i;
+
+  return EXIT_SUCCESS;
+}
+
+void mpmc_queue_deinit(MpmcQueue *queue) {
+  assert(queue != NULL);
+
+  alloc_free(queue->slots);
+}
+
+size_t mpmc_queue_memory_usage(const MpmcQueue *queue) {
+  assert(queue != NULL);
+  return queue->capacity * queue->slot_size;
+}
+
+int mpmc_queue_push(MpmcQueue *queue, const void *element) {
+  assert(queue != NULL);
+  assert(element != NULL);
+
+  size_t *slot;
+  size_t pos = LOAD_RELAXED(&queue->enqueue_pos);
+
+  for (;;) {
+    slot = mpmc_get_slot(queue, pos);
+    size_t seq = LOAD_ACQUIRE(slot);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+    if (diff == 0) {
+      // The slot is free, try to claim it.
+      if (__atomic_compare_exchange_n(&queue->enqueue_pos, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0) {
+      // The slot still holds an element from the previous lap, we're full.
+      return EXIT_FAILURE;
+    } else {
+      // Another producer claimed the slot, catch up.
+      pos = LOAD_RELAXED(&queue->enqueue_pos);
+    }
+  }
+
+  memcpy(slot + 1, element, queue->element_size);
+  STORE_RELEASE(slot, pos + 1);
+
+  return EXIT_SUCCESS;
+}
+
+int mpmc_queue_pop(MpmcQueue *queue, void *result) {
+  assert(queue != NULL);
+
+  size_t *slot;
+  size_t pos = LOAD_RELAXED(&queue->dequeue_pos);
+
+  for (;;) {
+    slot = mpmc_get_slot(queue, pos);
+    size_t seq = LOAD_ACQUIRE(slot);
+    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+    if (diff == 0) {
+      // The slot has been published, try to claim it.
+      if (__atomic_compare_exchange_n(&queue->dequeue_pos, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0) {
+      // Nothing has been published to this slot yet, we're empty.
+      return EXIT_FAILURE;
+    } else {
+      pos = LOAD_RELAXED(&queue->dequeue_pos);
+    }
+  }
+
+  if (result)
+    memcpy(result, slot + 1, queue->element_size);
+
+  // Free the slot for the producer one lap ahead.
+  STORE_RELEASE(slot, pos + queue->capacity);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,418 @@
+/**
+ * string_map.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/string_map.h"
+#include "mylib/alloc.h"
+#include "mylib/hash.h"
+#include <assert.h>
+#include <string.h>
+
+#define DEFAULT_INIT_CAPACITY 16
+
+// Slots hold the index of an entry plus one, so that 0 can mean empty.
+#define EMPTY 0
+#define TOMBSTONE UINT32_MAX
+#define MAX_ENTRIES (UINT32_MAX - 1)
+
+// The arena is only compacted once it has at least this many deleted bytes.
+#define MIN_GARBAGE 256
+
+static uint64_t hash_key(const char *key, size_t length) {
+  return xxh64_hash((const uint8_t *)key, length, 0);
+}
+
+static const StringMapEntry *get_entry(const StringMap *map, size_t idx) {
+  return vector_get_const(&map->entries, idx);
+}
+
+static const char *get_key(const StringMap *map, const StringMapEntry *entry) {
+  return (const char *)map->arena.data + entry->offset;
+}
+
+// Finds the slot holding `key`, or else the slot it should be inserted into.
+// Returns 1 if the key was found.
+static int find_slot(const StringMap *map, const char *key, size_t length,
+                     uint64_t hash, size_t *result) {
+  size_t mask = map->capacity - 1;
+  size_t insert_at = SIZE_MAX;
+
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    uint32_t slot = map->slots[i];
+
+    if (slot == EMPTY) {
+      *result = insert_at != SIZE_MAX ? insert_at : i;
+      return 0;
+    }
+
+    if (slot == TOMBSTONE) {
+      if (insert_at == SIZE_MAX)
+        insert_at = i;
+      continue;
+    }
+
+    // Only compare the bytes once the hash and length match.
+    const StringMapEntry *entry = get_entry(map, slot - 1);
+    if (entry->hash == hash && entry->length == length &&
+        (length == 0 || memcmp(get_key(map, entry), key, length) == 0)) {
+      *result = i;
+      return 1;
+    }
+  }
+}
+
+// Finds the slot that points at the entry at `idx`.
+static size_t slot_of(const StringMap *map, uint64_t hash, size_t idx) {
+  size_t mask = map->capacity - 1;
+
+  size_t i = hash & mask;
+  while (map->slots[i] != idx + 1)
+    i = (i + 1) & mask;
+
+  return i;
+}
+
+// Rebuilds the slots for `new_capacity`, dropping every tombstone.
+static int resize(StringMap *map, size_t new_capacity) {
+  uint32_t *slots = alloc_calloc(new_capacity, sizeof(uint32_t));
+  if (!slots)
+    return EXIT_FAILURE;
+
+  size_t mask = new_capacity - 1;
+  for (size_t idx = 0; idx < vector_len(&map->entries); idx++) {
+    size_t i = get_entry(map, idx)->hash & mask;
+    while (slots[i] != EMPTY)
+      i = (i + 1) & mask;
+    slots[i] = idx + 1;
+  }
+
+  alloc_free(map->slots);
+  map->slots = slots;
+  map->capacity = new_capacity;
+  map->tombstones = 0;
+
+  return EXIT_SUCCESS;
+}
+
+// Keeps at least a quarter of the slots empty so that probes stay short and
+// always reach an empty slot.
+static int ensure_capacity(StringMap *map) {
+  size_t count = vector_len(&map->entries);
+  if ((count + map->tombstones + 1) * 4 <= map->capacity * 3)
+    return EXIT_SUCCESS;
+
+  // If it's mostly tombstones then rehashing at the same size is enough.
+  size_t new_capacity = map->capacity;
+  if ((count + 1) * 2 > new_capacity)
+    new_capacity *= 2;
+
+  return resize(map, new_capacity);
+}
+
+static int append_value(StringMap *map, const void *value) {
+  Vector *values = &map->values;
+
+  if (values->size == values->capacity &&
+      vector_resize(values, values->capacity ? values->capacity * 2
+                                             : DEFAULT_INIT_CAPACITY))
+    return EXIT_FAILURE;
+
+  void *dest = (uint8_t *)values->data + values->size * map->value_size;
+  if (value)
+    memcpy(dest, value, map->value_size);
+  else
+    memset(dest, 0, map->value_size);
+  values->size++;
+
+  return EXIT_SUCCESS;
+}
+
+static int insert(StringMap *map, size_t slot, const char *key, size_t length,
+                  uint64_t hash, const void *value) {
+  if (vector_len(&map->entries) >= MAX_ENTRIES)
+    return EXIT_FAILURE;
+
+  StringMapEntry entry = {0};
+  entry.hash = hash;
+  entry.offset = vector_len(&map->arena);
+  entry.length = length;
+
+  // Copy the key into the arena, undoing it if anything after fails.
+  char nul = '\0';
+  if (vector_append_many(&map->arena, key, length) ||
+      vector_append(&map->arena, &nul))
+    goto err;
+
+  if (vector_append(&map->entries, &entry))
+    goto err;
+
+  if (map->value_size && append_value(map, value)) {
+    map->entries.size--;
+    goto err;
+  }
+
+  if (map->slots[slot] == TOMBSTONE)
+    map->tombstones--;
+  map->slots[slot] = vector_len(&map->entries);
+
+  return EXIT_SUCCESS;
+
+err:
+  map->arena.size = entry.offset;
+
+  return EXIT_FAILURE;
+}
+
+// Copies the keys that are still in use into a new arena.
+static void compact(StringMap *map) {
+  Vector arena;
+  if (vector_init_with_capacity(&arena, sizeof(char),
+                                vector_len(&map->arena) - map->garbage))
+    return;
+
+  for (size_t idx = 0; idx < vector_len(&map->entries); idx++) {
+    StringMapEntry *entry = vector_get(&map->entries, idx);
+    size_t offset = vector_len(&arena);
+
+    // The capacity is exact so this can't fail.
+    vector_append_many(&arena, get_key(map, entry), entry->length + 1);
+    entry->offset = offset;
+  }
+
+  vector_deinit(&map->arena);
+  map->arena = arena;
+  map->garbage = 0;
+}
+
+int string_map_init(StringMap *result, size_t value_size) {
+  assert(result != NULL);
+
+  *result = (StringMap){0};
+  result->value_size = value_size;
+
+  if (vector_init(&result->entries, sizeof(StringMapEntry)))
+    return EXIT_FAILURE;
+  if (vector_init(&result->arena, sizeof(char)))
+    goto err;
+  if (value_size && vector_init(&result->values, value_size))
+    goto err;
+  if (resize(result, DEFAULT_INIT_CAPACITY))
+    goto err;
+
+  return EXIT_SUCCESS;
+
+err:
+  string_map_deinit(result);
+
+  return EXIT_FAILURE;
+}
+
+void string_map_deinit(StringMap *map) {
+  assert(map != NULL);
+
+  alloc_free(map->slots);
+  vector_deinit(&map->entries);
+  vector_deinit(&map->values);
+  vector_deinit(&map->arena);
+}
+
+// Empties the map but keeps its slots and arena allocated.
+void string_map_clear(StringMap *map) {
+  assert(map != NULL);
+
+  memset(map->slots, 0, map->capacity * sizeof(uint32_t));
+  map->tombstones = 0;
+  map->garbage = 0;
+  map->entries.size = 0;
+  map->values.size = 0;
+  map->arena.size = 0;
+}
+
+size_t string_map_count(const StringMap *map) {
+  assert(map != NULL);
+  return vector_len(&map->entries);
+}
+
+int string_map_put(StringMap *map, const char *key, size_t length,
+                   const void *value) {
+  assert(map != NULL);
+  assert(key != NULL || length == 0);
+
+  if (ensure_capacity(map))
+    return EXIT_FAILURE;
+
+  uint64_t hash = hash_key(key, length);
+
+  size_t slot;
+  if (!find_slot(map, key, length, hash, &slot))
+    return insert(map, slot, key, length, hash, value);
+
+  // The key exists, replace its value.
+  if (value && map->value_size)
+    memcpy(string_map_value(map, map->slots[slot] - 1), value,
+           map->value_size);
+
+  return EXIT_SUCCESS;
+}
+
+void *string_map_get(const StringMap *map, const char *key, size_t length) {
+  assert(map != NULL);
+  assert(key != NULL || length == 0);
+
+  size_t slot;
+  if (!find_slot(map, key, length, hash_key(key, length), &slot))
+    return NULL;
+
+  // Without values the entry stands in, so a present key is never NULL.
+  size_t idx = map->slots[slot] - 1;
+  if (map->value_size == 0)
+    return (uint8_t *)map->entries.data + idx * sizeof(StringMapEntry);
+
+  return string_map_value(map, idx);
+}
+
+int string_map_has(const StringMap *map, const char *key, size_t length) {
+  assert(map != NULL);
+  assert(key != NULL || length == 0);
+
+  size_t slot;
+  return find_slot(map, key, length, hash_key(key, length), &slot);
+}
+
+void string_map_delete(StringMap *map, const char *key, size_t length) {
+  assert(map != NULL);
+  assert(key != NULL || length == 0);
+
+  size_t slot;
+  if (!find_slot(map, key, length, hash_key(key, length), &slot))
+    return;
+
+  size_t idx = map->slots[slot] - 1;
+  size_t last = vector_len(&map->entries) - 1;
+
+  map->slots[slot] = TOMBSTONE;
+  map->tombstones++;
+  map->garbage += get_entry(map, idx)->length + 1;
+
+  // The last entry is moved into the deleted one's place, so its slot has to
+  // point at its new index.
+  if (idx != last)
+    map->slots[slot_of(map, get_entry(map, last)->hash, last)] = idx + 1;
+
+  vector_swap_delete(&map->entries, idx);
+  if (map->value_size)
+    vector_swap_delete(&map->values, idx);
+
+  if (map->garbage >= MIN_GARBAGE && map->garbage * 2 > vector_len(&map->arena))
+    compact(map);
+}
+
+const char *string_map_key(const StringMap *map, size_t idx, size_t *length) {
+  assert(map != NULL);
+
+  if (idx >= vector_len(&map->entries))
+    return NULL;
+
+  const StringMapEntry *entry = get_entry(map, idx);
+  if (length)
+    *length = entry->length;
+
+  return get_key(map, entry);
+}
+
+void *string_map_value(const StringMap *map, size_t idx) {
+  assert(map != NULL);
+
+  if (idx >= vector_len(&map->entries) || map->value_size == 0)
+    return NULL;
+
+  return (uint8_t *)map->values.data + idx * map->value_size;
+}
+
+size_t string_map_memory_usage(const StringMap *map) {
+  assert(map != NULL);
+
+  return map->capacity * sizeof(uint32_t) +
+         vector_memory_usage(&map->entries) +
+         vector_memory_usage(&map->values) + vector_memory_usage(&map->arena);
+}
+
+int string_interner_init(StringInterner *result) {
+  assert(result != NULL);
+  return string_map_init(&result->map, 0);
+}
+
+void string_interner_deinit(StringInterner *interner) {
+  assert(interner != NULL);
+  string_map_deinit(&interner->map);
+}
+
+size_t string_interner_count(const StringInterner *interner) {
+  assert(interner != NULL);
+  return string_map_count(&interner->map);
+}
+
+// Nothing is ever deleted, so the index of an entry is its id.
+int string_interner_intern(StringInterner *interner, const char *str,
+                           size_t length, uint32_t *id) {
+  assert(interner != NULL);
+  assert(str != NULL || length == 0);
+  assert(id != NULL);
+
+  StringMap *map = &interner->map;
+
+  if (ensure_capacity(map))
+    return EXIT_FAILURE;
+
+  uint64_t hash = hash_key(str, length);
+
+  size_t slot;
+  if (!find_slot(map, str, length, hash, &slot) &&
+      insert(map, slot, str, length, hash, NULL))
+    return EXIT_FAILURE;
+
+  *id = map->slots[slot] - 1;
+
+  return EXIT_SUCCESS;
+}
+
+int string_interner_find(const StringInterner *interner, const char *str,
+                         size_t length, uint32_t *id) {
+  assert(interner != NULL);
+  assert(str != NULL || length == 0);
+  assert(id != NULL);
+
+  const StringMap *map = &interner->map;
+
+  size_t slot;
+  if (!find_slot(map, str, length, hash_key(str, length), &slot))
+    return EXIT_FAILURE;
+
+  *id = map->slots[slot] - 1;
+
+  return EXIT_SUCCESS;
+}
+
+const char *string_interner_get(const StringInterner *interner, uint32_t id,
+                                size_t *length) {
+  assert(interner != NULL);
+  return string_map_key(&interner->map, id, length);
+}
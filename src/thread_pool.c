@@ -0,0 +1,379 @@
+/**
+ * thread_pool.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include "mylib/thread_pool.h"
+#include "mylib/alloc.h"
+
+#include <assert.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+
+// How many times an idle worker looks for work before going to sleep.
+#define SPIN_LIMIT 64
+
+#define DEQUE_MASK (THREAD_POOL_DEQUE_CAPACITY - 1)
+
+// The task's argument follows it, aligned for any type.
+#define ARG_ALIGN 16
+#define ALIGN_UP(n) (((n) + ARG_ALIGN - 1) & ~(size_t)(ARG_ALIGN - 1))
+
+struct ThreadPoolTask {
+  ThreadPoolTaskFn fn;
+  ThreadPoolGroup *group;
+};
+
+// The worker running on this thread, if any. GCC's __thread rather than C11's
+// _Thread_local, the same as the __atomic builtins.
+static __thread ThreadPoolWorker *current;
+
+// Picks which worker to steal from first.
+static __thread uint64_t steal_rng;
+
+static void *task_arg(ThreadPoolTask *task) {
+  return (uint8_t *)task + ALIGN_UP(sizeof(ThreadPoolTask));
+}
+
+static ThreadPoolWorker *current_worker(const ThreadPool *pool) {
+  return current && current->pool == pool ? current : NULL;
+}
+
+// The owner pushes to the bottom of its deque. Fails when it is full.
+static int push(ThreadPoolWorker *worker, ThreadPoolTask *task) {
+  int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED);
+  int64_t top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+  if (bottom - top >= THREAD_POOL_DEQUE_CAPACITY)
+    return EXIT_FAILURE;
+
+  // Publishes the task to thieves, who load bottom with acquire.
+  __atomic_store_n(&worker->tasks[bottom & DEQUE_MASK], task,
+                   __ATOMIC_RELAXED);
+  __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELEASE);
+
+  return EXIT_SUCCESS;
+}
+
+// The owner takes from the bottom of its deque, racing thieves for the last
+// task.
+static ThreadPoolTask *take(ThreadPoolWorker *worker) {
+  int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED) - 1;
+  __atomic_store_n(&worker->bottom, bottom, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t top = __atomic_load_n(&worker->top, __ATOMIC_RELAXED);
+
+  if (top > bottom) {
+    __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+
+  ThreadPoolTask *task =
+      __atomic_load_n(&worker->tasks[bottom & DEQUE_MASK], __ATOMIC_RELAXED);
+  if (top == bottom) {
+    if (!__atomic_compare_exchange_n(&worker->top, &top, top + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+      task = NULL;
+    __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+  }
+
+  return task;
+}
+
+// Any thread steals from the top of a deque, NULL if it is empty or another
+// thread got there first.
+static ThreadPoolTask *steal(ThreadPoolWorker *worker) {
+  int64_t top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_ACQUIRE);
+  if (top >= bottom)
+    return NULL;
+
+  ThreadPoolTask *task =
+      __atomic_load_n(&worker->tasks[top & DEQUE_MASK], __ATOMIC_RELAXED);
+  if (!__atomic_compare_exchange_n(&worker->top, &top, top + 1, 0,
+                                   __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    return NULL;
+
+  return task;
+}
+
+static int has_work(ThreadPool *pool) {
+  if (__atomic_load_n(&pool->injected_count, __ATOMIC_RELAXED))
+    return 1;
+
+  for (size_t i = 0; i < pool->worker_count; i++) {
+    ThreadPoolWorker *worker = &pool->workers[i];
+    if (__atomic_load_n(&worker->bottom, __ATOMIC_RELAXED) >
+        __atomic_load_n(&worker->top, __ATOMIC_RELAXED))
+      return 1;
+  }
+
+  return 0;
+}
+
+// Looks for a task in our own deque, then the injected tasks, then the other
+// workers' deques.
+static ThreadPoolTask *find_task(ThreadPool *pool, ThreadPoolWorker *self) {
+  ThreadPoolTask *task = NULL;
+
+  if (self && (task = take(self)))
+    return task;
+
+  if (__atomic_load_n(&pool->injected_count, __ATOMIC_RELAXED)) {
+    pthread_mutex_lock(&pool->lock);
+    if (!deque_pop_front(&pool->injected, &task))
+      __atomic_fetch_sub(&pool->injected_count, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (task)
+      return task;
+  }
+
+  // xorshift64, seeded by the address of the thread-local.
+  if (!steal_rng)
+    steal_rng = (uintptr_t)&steal_rng | 1;
+  steal_rng ^= steal_rng << 13;
+  steal_rng ^= steal_rng >> 7;
+  steal_rng ^= steal_rng << 17;
+
+  size_t start = steal_rng % pool->worker_count;
+  for (size_t i = 0; i < pool->worker_count; i++) {
+    ThreadPoolWorker *victim =
+        &pool->workers[(start + i) % pool->worker_count];
+    if (victim != self && (task = steal(victim)))
+      return task;
+  }
+
+  return NULL;
+}
+
+static void run(ThreadPoolTask *task) {
+  ThreadPoolGroup *group = task->group;
+
+  task->fn(task_arg(task));
+  alloc_free(task);
+
+  __atomic_fetch_sub(&group->pending, 1, __ATOMIC_RELEASE);
+}
+
+static void wake_one(ThreadPool *pool) {
+  // Pairs with the fence in worker_main, either we see the worker sleeping or
+  // it sees the task we just queued.
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (!__atomic_load_n(&pool->sleeping, __ATOMIC_RELAXED))
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  pthread_cond_signal(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static void *worker_main(void *arg) {
+  ThreadPoolWorker *self = arg;
+  ThreadPool *pool = self->pool;
+  current = self;
+
+  size_t idle = 0;
+  for (;;) {
+    ThreadPoolTask *task = find_task(pool, self);
+    if (task) {
+      run(task);
+      idle = 0;
+      continue;
+    }
+
+    if (++idle < SPIN_LIMIT && !__atomic_load_n(&pool->shutdown,
+                                                __ATOMIC_RELAXED)) {
+      sched_yield();
+      continue;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    __atomic_fetch_add(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (!pool->shutdown && !has_work(pool))
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    __atomic_fetch_sub(&pool->sleeping, 1, __ATOMIC_RELAXED);
+    int shutdown = pool->shutdown;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (shutdown)
+      break;
+    idle = 0;
+  }
+
+  return NULL;
+}
+
+// Wakes every worker to see the shutdown and joins the first `count`.
+static void stop_workers(ThreadPool *pool, size_t count) {
+  pthread_mutex_lock(&pool->lock);
+  __atomic_store_n(&pool->shutdown, 1, __ATOMIC_RELAXED);
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (size_t i = 0; i < count; i++)
+    pthread_join(pool->workers[i].thread, NULL);
+}
+
+int thread_pool_init(ThreadPool *result, size_t worker_count) {
+  assert(result != NULL);
+
+  *result = (ThreadPool){0};
+
+  if (!worker_count) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    worker_count = cpus > 0 ? (size_t)cpus : 1;
+  }
+
+  if (deque_init(&result->injected, sizeof(ThreadPoolTask *)))
+    return EXIT_FAILURE;
+
+  if (pthread_mutex_init(&result->lock, NULL))
+    goto err_deque;
+  if (pthread_cond_init(&result->wake, NULL))
+    goto err_lock;
+
+  result->workers = alloc_calloc(worker_count, sizeof(ThreadPoolWorker));
+  if (!result->workers)
+    goto err_cond;
+
+  for (size_t i = 0; i < worker_count; i++) {
+    ThreadPoolWorker *worker = &result->workers[i];
+    worker->pool = result;
+    worker->tasks =
+        alloc_malloc(THREAD_POOL_DEQUE_CAPACITY * sizeof(ThreadPoolTask *));
+    if (!worker->tasks)
+      goto err_workers;
+  }
+
+  // Workers steal from every deque, so they are all set up before starting.
+  result->worker_count = worker_count;
+  for (size_t i = 0; i < worker_count; i++) {
+    if (pthread_create(&result->workers[i].thread, NULL, worker_main,
+                       &result->workers[i])) {
+      stop_workers(result, i);
+      goto err_workers;
+    }
+  }
+
+  return EXIT_SUCCESS;
+
+err_workers:
+  for (size_t i = 0; i < worker_count; i++)
+    alloc_free(result->workers[i].tasks);
+  alloc_free(result->workers);
+err_cond:
+  pthread_cond_destroy(&result->wake);
+err_lock:
+  pthread_mutex_destroy(&result->lock);
+err_deque:
+  deque_deinit(&result->injected);
+
+  return EXIT_FAILURE;
+}
+
+void thread_pool_deinit(ThreadPool *pool) {
+  assert(pool != NULL);
+
+  stop_workers(pool, pool->worker_count);
+
+  // Drop the tasks that never ran.
+  ThreadPoolTask *task;
+  while (!deque_pop_front(&pool->injected, &task))
+    alloc_free(task);
+
+  for (size_t i = 0; i < pool->worker_count; i++) {
+    ThreadPoolWorker *worker = &pool->workers[i];
+    for (int64_t j = worker->top; j < worker->bottom; j++)
+      alloc_free(worker->tasks[j & DEQUE_MASK]);
+    alloc_free(worker->tasks);
+  }
+
+  alloc_free(pool->workers);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+  deque_deinit(&pool->injected);
+
+  *pool = (ThreadPool){0};
+}
+
+size_t thread_pool_worker_count(const ThreadPool *pool) {
+  assert(pool != NULL);
+  return pool->worker_count;
+}
+
+void thread_pool_spawn(ThreadPool *pool, ThreadPoolGroup *group,
+                       ThreadPoolTaskFn fn, const void *arg, size_t arg_size) {
+  assert(pool != NULL);
+  assert(group != NULL);
+  assert(fn != NULL);
+
+  ThreadPoolTask *task =
+      alloc_malloc(ALIGN_UP(sizeof(ThreadPoolTask)) + arg_size);
+  if (!task) {
+    fn((void *)arg);
+    return;
+  }
+
+  task->fn = fn;
+  task->group = group;
+  if (arg_size)
+    memcpy(task_arg(task), arg, arg_size);
+  __atomic_fetch_add(&group->pending, 1, __ATOMIC_RELAXED);
+
+  ThreadPoolWorker *self = current_worker(pool);
+  if (self) {
+    if (push(self, task)) {
+      run(task);
+      return;
+    }
+  } else {
+    pthread_mutex_lock(&pool->lock);
+    int failed = deque_push_back(&pool->injected, &task);
+    if (!failed)
+      __atomic_fetch_add(&pool->injected_count, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (failed) {
+      run(task);
+      return;
+    }
+  }
+
+  wake_one(pool);
+}
+
+void thread_pool_wait(ThreadPool *pool, ThreadPoolGroup *group) {
+  assert(pool != NULL);
+  assert(group != NULL);
+
+  ThreadPoolWorker *self = current_worker(pool);
+  while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE)) {
+    ThreadPoolTask *task = find_task(pool, self);
+    if (task)
+      run(task);
+    else
+      sched_yield();
+  }
+}
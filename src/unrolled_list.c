@@ -0,0 +1,296 @@
+/**
+ * unrolled_list.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/unrolled_list.h"
+#include "mylib/alloc.h"
+#include <assert.h>
+#include <string.h>
+
+#define DEFAULT_BLOCK_BYTES 512
+#define MIN_BLOCK_CAPACITY 4
+
+static void *get_offset(const UnrolledList *list, UnrolledListBlock *block,
+                        size_t idx) {
+  return block->data + idx * list->element_size;
+}
+
+static UnrolledListBlock *block_init(const UnrolledList *list) {
+  UnrolledListBlock *block = alloc_malloc(
+      sizeof(UnrolledListBlock) + list->block_capacity * list->element_size);
+  if (!block)
+    return NULL;
+
+  block->prev = NULL;
+  block->next = NULL;
+  block->count = 0;
+
+  return block;
+}
+
+// Links `block` after `prev`, or at the front of the list if `prev` is NULL.
+static void link_block(UnrolledList *list, UnrolledListBlock *prev,
+                       UnrolledListBlock *block) {
+  block->prev = prev;
+  block->next = prev ? prev->next : list->first;
+
+  if (block->next)
+    block->next->prev = block;
+  else
+    list->last = block;
+
+  if (prev)
+    prev->next = block;
+  else
+    list->first = block;
+}
+
+static void unlink_block(UnrolledList *list, UnrolledListBlock *block) {
+  if (block->prev)
+    block->prev->next = block->next;
+  else
+    list->first = block->next;
+
+  if (block->next)
+    block->next->prev = block->prev;
+  else
+    list->last = block->prev;
+
+  alloc_free(block);
+}
+
+// Inserts `element` at `idx` in a block that isn't full.
+static void block_insert(UnrolledList *list, UnrolledListBlock *block,
+                         size_t idx, void *element) {
+  void *offset = get_offset(list, block, idx);
+  memmove(offset + list->element_size, offset,
+          (block->count - idx) * list->element_size);
+  memcpy(offset, element, list->element_size);
+
+  block->count++;
+  list->size++;
+}
+
+int unrolled_list_init(UnrolledList *result, size_t element_size,
+                       size_t block_capacity) {
+  assert(result != NULL);
+  assert(element_size > 0);
+
+  *result = (UnrolledList){0};
+
+  if (block_capacity == 0) {
+    block_capacity = DEFAULT_BLOCK_BYTES / element_size;
+    if (block_capacity < MIN_BLOCK_CAPACITY)
+      block_capacity = MIN_BLOCK_CAPACITY;
+  }
+
+  result->element_size = element_size;
+  result->block_capacity = block_capacity;
+
+  return EXIT_SUCCESS;
+}
+
+void unrolled_list_deinit(UnrolledList *list) { unrolled_list_clear(list); }
+
+void unrolled_list_clear(UnrolledList *list) {
+  assert(list != NULL);
+
+  UnrolledListBlock *block = list->first;
+  while (block) {
+    UnrolledListBlock *next = block->next;
+    alloc_free(block);
+    block = next;
+  }
+
+  list->first = NULL;
+  list->last = NULL;
+  list->size = 0;
+}
+
+size_t unrolled_list_len(const UnrolledList *list) {
+  assert(list != NULL);
+  return list->size;
+}
+
+size_t unrolled_list_memory_usage(const UnrolledList *list) {
+  assert(list != NULL);
+
+  size_t block_size =
+      sizeof(UnrolledListBlock) + list->block_capacity * list->element_size;
+
+  size_t result = 0;
+  for (UnrolledListBlock *block = list->first; block; block = block->next)
+    result += block_size;
+
+  return result;
+}
+
+int unrolled_list_append(UnrolledList *list, void *element) {
+  assert(list != NULL);
+  assert(element != NULL);
+
+  // Start a new block when the last one is full rather than splitting it, so
+  // a list that is only appended to keeps its blocks full.
+  UnrolledListBlock *block = list->last;
+  if (!block || block->count == list->block_capacity) {
+    if (!(block = block_init(list)))
+      return EXIT_FAILURE;
+    link_block(list, list->last, block);
+  }
+
+  block_insert(list, block, block->count, element);
+
+  return EXIT_SUCCESS;
+}
+
+void *unrolled_list_get(const UnrolledList *list, size_t idx) {
+  assert(list != NULL);
+
+  for (UnrolledListBlock *block = list->first; block; block = block->next) {
+    if (idx < block->count)
+      return get_offset(list, block, idx);
+    idx -= block->count;
+  }
+
+  return NULL;
+}
+
+UnrolledListIterator unrolled_list_iter(UnrolledList *list) {
+  UnrolledListIterator result = {0};
+  result.list = list;
+
+  return result;
+}
+
+void *unrolled_list_next(UnrolledListIterator *iterator) {
+  assert(iterator != NULL);
+
+  if (iterator->block) {
+    iterator->idx++;
+  } else {
+    if (!(iterator->block = iterator->list->first))
+      return NULL;
+    iterator->idx = 0;
+  }
+
+  // Step over to the next block, staying on the last one at the end.
+  while (iterator->idx >= iterator->block->count) {
+    if (!iterator->block->next)
+      return NULL;
+    iterator->block = iterator->block->next;
+    iterator->idx = 0;
+  }
+
+  return get_offset(iterator->list, iterator->block, iterator->idx);
+}
+
+int unrolled_list_insert_after(UnrolledListIterator *iterator, void *element) {
+  assert(iterator != NULL);
+  assert(element != NULL);
+
+  UnrolledList *list = iterator->list;
+  UnrolledListBlock *block = iterator->block;
+  size_t idx = iterator->idx + 1;
+
+  // Nothing has been iterated yet, insert at the front of the first block.
+  if (!block) {
+    if (!(block = list->first)) {
+      if (unrolled_list_append(list, element))
+        return EXIT_FAILURE;
+      iterator->block = list->first;
+      iterator->idx = 0;
+      return EXIT_SUCCESS;
+    }
+    idx = 0;
+  }
+
+  // Once next has run off the end the iterator is one past the last element
+  // of the last block, so this appends.
+  if (idx > block->count)
+    idx = block->count;
+
+  // The block is full, move the upper half of it into a new block.
+  if (block->count == list->block_capacity) {
+    UnrolledListBlock *split = block_init(list);
+    if (!split)
+      return EXIT_FAILURE;
+
+    size_t keep = block->count / 2;
+    split->count = block->count - keep;
+    memcpy(split->data, get_offset(list, block, keep),
+           split->count * list->element_size);
+    block->count = keep;
+
+    link_block(list, block, split);
+
+    if (idx > keep) {
+      block = split;
+      idx -= keep;
+    }
+  }
+
+  block_insert(list, block, idx, element);
+
+  iterator->block = block;
+  iterator->idx = idx;
+
+  return EXIT_SUCCESS;
+}
+
+void unrolled_list_delete(UnrolledListIterator *iterator) {
+  assert(iterator != NULL);
+
+  UnrolledList *list = iterator->list;
+  UnrolledListBlock *block = iterator->block;
+
+  if (!block || iterator->idx >= block->count)
+    return;
+
+  void *offset = get_offset(list, block, iterator->idx);
+  memmove(offset, offset + list->element_size,
+          (block->count - iterator->idx - 1) * list->element_size);
+  block->count--;
+  list->size--;
+
+  // Step back so that next returns the element after the deleted one, this
+  // wraps to SIZE_MAX when deleting the first element of a block which next
+  // wraps back to 0.
+  iterator->idx--;
+
+  if (block->count == 0) {
+    // Move to the end of the previous block, or before the first element.
+    iterator->block = block->prev;
+    iterator->idx = block->prev ? block->prev->count - 1 : 0;
+    unlink_block(list, block);
+    return;
+  }
+
+  // Merge the next block into this one when they both fit in one block, the
+  // elements before the current one don't move.
+  UnrolledListBlock *next = block->next;
+  if (block->count < list->block_capacity / 2 && next &&
+      block->count + next->count <= list->block_capacity) {
+    memcpy(get_offset(list, block, block->count), next->data,
+           next->count * list->element_size);
+    block->count += next->count;
+    unlink_block(list, next);
+  }
+}
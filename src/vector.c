@@ -20,12 +20,42 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  */
+// Needed for mremap.
+#define _GNU_SOURCE
+
 #include "mylib/vector.h"
+#include "mylib/alloc.h"
 #include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define DEFAULT_INIT_CAPACITY 4
 
+#define MAPPED_MAGIC 0x52544345564c594dULL // "MYLVECTR"
+#define MAPPED_VERSION 1
+
+// The header at the start of a file-backed vector, padded to a cache line so
+// that the elements after it stay aligned.
+typedef struct VectorFileHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t element_size;
+  uint64_t size;
+  uint8_t pad[32];
+} VectorFileHeader;
+
+struct VectorMapping {
+  int fd;
+  int read_only;
+  VectorFileHeader *header; // Start of the mapping.
+  size_t length;            // Byte length of the mapping.
+};
+
 static void *get_offset(Vector *vec, size_t idx) {
   return vec->data + (idx * vec->element_size);
 }
@@ -35,8 +65,130 @@ static const void *get_offset_const(const Vector *vec, size_t idx) {
 }
 
 static int try_grow(Vector *vec) {
-  return vec->size >= vec->capacity ? vector_resize(vec, vec->size * 2)
-                                    : EXIT_SUCCESS;
+  if (vec->size < vec->capacity)
+    return EXIT_SUCCESS;
+
+  // A cleared or empty file-backed vector can have no capacity at all.
+  return vector_resize(vec, vec->capacity ? vec->capacity * 2
+                                          : DEFAULT_INIT_CAPACITY);
+}
+
+static int is_read_only(const Vector *vec) {
+  return vec->mapping && vec->mapping->read_only;
+}
+
+// Drops this vector's reference to shared elements, the last one frees them.
+static void release_shared(Vector *vec) {
+  if (__atomic_sub_fetch(vec->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    alloc_free(vec->refs);
+    alloc_policy_free(vec->policy, vec->data);
+  }
+  vec->refs = NULL;
+}
+
+// Swaps shared elements for a private copy with room for `capacity` of them.
+static int unshare(Vector *vec, size_t capacity) {
+  if (!vec->refs)
+    return EXIT_SUCCESS;
+
+  // Every clone has since been modified or freed, so the elements are ours.
+  if (__atomic_load_n(vec->refs, __ATOMIC_ACQUIRE) == 1) {
+    alloc_free(vec->refs);
+    vec->refs = NULL;
+    return EXIT_SUCCESS;
+  }
+
+  void *data = NULL;
+  if (capacity) {
+    if (!(data = alloc_policy_malloc(vec->policy,
+                                     capacity * vec->element_size)))
+      return EXIT_FAILURE;
+
+    size_t count = vec->size < capacity ? vec->size : capacity;
+    memcpy(data, vec->data, count * vec->element_size);
+  }
+
+  release_shared(vec);
+  vec->data = data;
+  vec->capacity = capacity;
+
+  return EXIT_SUCCESS;
+}
+
+static int prepare_write(Vector *vec) {
+  return is_read_only(vec) || unshare(vec, vec->capacity);
+}
+
+static size_t mapped_length(size_t element_size, size_t capacity) {
+  return sizeof(VectorFileHeader) + element_size * capacity;
+}
+
+// Grows or shrinks the file then the mapping to fit `new_capacity` elements.
+static int mapped_resize(Vector *vec, size_t new_capacity) {
+  struct VectorMapping *mapping = vec->mapping;
+
+  if (mapping->read_only)
+    return EXIT_FAILURE;
+
+  size_t length = mapped_length(vec->element_size, new_capacity);
+  if (ftruncate(mapping->fd, length))
+    return EXIT_FAILURE;
+
+#ifdef MREMAP_MAYMOVE
+  void *header = mremap(mapping->header, mapping->length, length,
+                        MREMAP_MAYMOVE);
+#else
+  munmap(mapping->header, mapping->length);
+  void *header =
+      mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, mapping->fd, 0);
+#endif
+  if (header == MAP_FAILED)
+    return EXIT_FAILURE;
+
+  mapping->header = header;
+  mapping->length = length;
+  vec->data = mapping->header + 1;
+
+  return EXIT_SUCCESS;
+}
+
+static void mapped_deinit(Vector *vec) {
+  struct VectorMapping *mapping = vec->mapping;
+
+  if (!mapping->read_only)
+    mapping->header->size = vec->size;
+
+  munmap(mapping->header, mapping->length);
+  close(mapping->fd);
+  alloc_free(mapping);
+}
+
+// Maps `length` bytes of the open file `fd` and takes ownership of `fd`.
+static int mapped_init(Vector *result, int fd, size_t length, int read_only) {
+  struct VectorMapping *mapping = alloc_calloc(1, sizeof(struct VectorMapping));
+  if (!mapping)
+    goto err;
+
+  int prot = read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+  void *header = mmap(NULL, length, prot, MAP_SHARED, fd, 0);
+  if (header == MAP_FAILED)
+    goto err;
+
+  mapping->fd = fd;
+  mapping->read_only = read_only;
+  mapping->header = header;
+  mapping->length = length;
+
+  result->mapping = mapping;
+  result->data = mapping->header + 1;
+
+  return EXIT_SUCCESS;
+
+err:
+  alloc_free(mapping);
+  close(fd);
+
+  return EXIT_FAILURE;
 }
 
 static void assign(Vector *vec, size_t idx, void *element) {
@@ -46,17 +198,24 @@ static void assign(Vector *vec, size_t idx, void *element) {
 
 int vector_init_with_capacity(Vector *result, size_t element_size,
                               size_t capacity) {
+  return vector_init_with_policy(result, element_size, capacity,
+                                 ALLOC_POLICY_DEFAULT);
+}
+
+int vector_init_with_policy(Vector *result, size_t element_size,
+                            size_t capacity, AllocPolicy policy) {
   assert(result != NULL);
 
   *result = (Vector){0};
 
-  result->data = malloc(capacity * element_size);
+  result->data = alloc_policy_malloc(policy, capacity * element_size);
   if (!result->data)
     return EXIT_FAILURE;
 
   result->size = 0;
   result->capacity = capacity;
   result->element_size = element_size;
+  result->policy = policy;
 
   return EXIT_SUCCESS;
 }
@@ -69,7 +228,8 @@ int vector_clone(const Vector *src, Vector *result) {
   assert(src != NULL);
   assert(result != NULL);
 
-  if (vector_init_with_capacity(result, src->element_size, src->size * 2))
+  if (vector_init_with_policy(result, src->element_size, src->size * 2,
+                              src->policy))
     return EXIT_FAILURE;
 
   memcpy(result->data, src->data, src->size * src->element_size);
@@ -79,19 +239,60 @@ int vector_clone(const Vector *src, Vector *result) {
   return EXIT_SUCCESS;
 }
 
+int vector_clone_cow(Vector *src, Vector *result) {
+  assert(src != NULL);
+  assert(result != NULL);
+
+  if (src->mapping)
+    return vector_clone(src, result);
+
+  if (!src->refs) {
+    if (!(src->refs = alloc_malloc(sizeof(size_t))))
+      return EXIT_FAILURE;
+    *src->refs = 1;
+  }
+
+  __atomic_add_fetch(src->refs, 1, __ATOMIC_RELAXED);
+  *result = *src;
+
+  return EXIT_SUCCESS;
+}
+
+int vector_unshare(Vector *vec) {
+  assert(vec != NULL);
+  return unshare(vec, vec->capacity);
+}
+
 void vector_deinit(Vector *vec) {
   assert(vec != NULL);
 
-  free(vec->data);
+  if (vec->mapping)
+    mapped_deinit(vec);
+  else if (vec->refs)
+    release_shared(vec);
+  else
+    alloc_policy_free(vec->policy, vec->data);
 }
 
 int vector_resize(Vector *vec, size_t new_capacity) {
   assert(vec != NULL);
 
-  void *data = realloc(vec->data, vec->element_size * new_capacity);
-  if (!data)
+  if (vec->mapping) {
+    if (mapped_resize(vec, new_capacity))
+      return EXIT_FAILURE;
+  } else if (unshare(vec, new_capacity)) {
     return EXIT_FAILURE;
-  vec->data = data;
+  } else if (new_capacity == 0) {
+    // realloc may free the data and return NULL for a size of 0.
+    alloc_policy_free(vec->policy, vec->data);
+    vec->data = NULL;
+  } else {
+    void *data = alloc_policy_realloc(vec->policy, vec->data,
+                                      vec->element_size * new_capacity);
+    if (!data)
+      return EXIT_FAILURE;
+    vec->data = data;
+  }
 
   vec->capacity = new_capacity;
   if (vec->size > new_capacity)
@@ -110,11 +311,20 @@ size_t vector_size_in_bytes(const Vector *vec) {
   return vec->size * vec->element_size;
 }
 
+size_t vector_memory_usage(const Vector *vec) {
+  assert(vec != NULL);
+
+  if (vec->mapping)
+    return sizeof(struct VectorMapping) + vec->mapping->length;
+
+  return vec->capacity * vec->element_size;
+}
+
 int vector_assign(Vector *vec, size_t idx, void *element) {
   assert(vec != NULL);
   assert(element != NULL);
 
-  if (idx >= vec->size)
+  if (idx >= vec->size || prepare_write(vec))
     return EXIT_FAILURE;
 
   assign(vec, idx, element);
@@ -126,7 +336,7 @@ int vector_append(Vector *vec, void *element) {
   assert(vec != NULL);
   assert(element != NULL);
 
-  if (try_grow(vec))
+  if (prepare_write(vec) || try_grow(vec))
     return EXIT_FAILURE;
 
   assign(vec, vec->size, element);
@@ -135,11 +345,36 @@ int vector_append(Vector *vec, void *element) {
   return EXIT_SUCCESS;
 }
 
+int vector_append_many(Vector *vec, const void *elements, size_t count) {
+  assert(vec != NULL);
+  assert(elements != NULL || count == 0);
+
+  if (prepare_write(vec))
+    return EXIT_FAILURE;
+
+  if (count == 0)
+    return EXIT_SUCCESS;
+
+  if (vec->size + count > vec->capacity) {
+    size_t new_capacity = vec->capacity ? vec->capacity : DEFAULT_INIT_CAPACITY;
+    while (new_capacity < vec->size + count)
+      new_capacity *= 2;
+
+    if (vector_resize(vec, new_capacity))
+      return EXIT_FAILURE;
+  }
+
+  memcpy(get_offset(vec, vec->size), elements, count * vec->element_size);
+  vec->size += count;
+
+  return EXIT_SUCCESS;
+}
+
 int vector_insert(Vector *vec, size_t idx, void *element) {
   assert(vec != NULL);
   assert(element != NULL);
 
-  if (idx > vec->size)
+  if (idx > vec->size || prepare_write(vec))
     return EXIT_FAILURE;
 
   if (try_grow(vec))
@@ -165,7 +400,8 @@ int vector_insert(Vector *vec, size_t idx, void *element) {
 void *vector_get(Vector *vec, size_t idx) {
   assert(vec != NULL);
 
-  if (idx >= vec->size)
+  // The caller may write through the pointer.
+  if (idx >= vec->size || unshare(vec, vec->capacity))
     return NULL;
 
   return get_offset(vec, idx);
@@ -183,7 +419,7 @@ const void *vector_get_const(const Vector *vec, size_t idx) {
 void vector_delete(Vector *vec, size_t idx) {
   assert(vec != NULL);
 
-  if (idx >= vec->size)
+  if (idx >= vec->size || prepare_write(vec))
     return;
 
   // Move elements to the left overwriting the element at idx.
@@ -193,15 +429,16 @@ void vector_delete(Vector *vec, size_t idx) {
   memmove(offset, offset + vec->element_size, bytes_to_move);
   vec->size--;
 
-  // Shrink the vector size is <= 25% capacity.
-  if (vec->size <= vec->capacity / 4)
-    vector_resize(vec, vec->size / 2);
+  // Halve the capacity when the size is <= 25% of it, which still leaves room
+  // for twice the remaining elements.
+  if (vec->size <= vec->capacity / 4 && vec->capacity > DEFAULT_INIT_CAPACITY)
+    vector_resize(vec, vec->capacity / 2);
 }
 
 void vector_swap_delete(Vector *vec, size_t idx) {
   assert(vec != NULL);
 
-  if (idx >= vec->size)
+  if (idx >= vec->size || prepare_write(vec))
     return;
 
   void *dest = get_offset(vec, idx);
@@ -216,3 +453,94 @@ void vector_swap_delete(Vector *vec, size_t idx) {
 void vector_clear(Vector *vec) { vector_resize(vec, 0); }
 
 void vector_shrink_to_fit(Vector *vec) { vector_resize(vec, vec->size); }
+
+int vector_init_mapped(Vector *result, size_t element_size, size_t capacity,
+                       const char *path) {
+  assert(result != NULL);
+  assert(path != NULL);
+
+  *result = (Vector){0};
+
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return EXIT_FAILURE;
+
+  size_t length = mapped_length(element_size, capacity);
+  if (ftruncate(fd, length)) {
+    close(fd);
+    return EXIT_FAILURE;
+  }
+
+  if (mapped_init(result, fd, length, 0))
+    return EXIT_FAILURE;
+
+  VectorFileHeader *header = result->mapping->header;
+  header->magic = MAPPED_MAGIC;
+  header->version = MAPPED_VERSION;
+  header->element_size = element_size;
+  header->size = 0;
+
+  result->size = 0;
+  result->capacity = capacity;
+  result->element_size = element_size;
+
+  return EXIT_SUCCESS;
+}
+
+int vector_open_mapped(Vector *result, const char *path, int read_only) {
+  assert(result != NULL);
+  assert(path != NULL);
+
+  *result = (Vector){0};
+
+  int fd = open(path, read_only ? O_RDONLY : O_RDWR);
+  if (fd < 0)
+    return EXIT_FAILURE;
+
+  struct stat st;
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(VectorFileHeader)) {
+    close(fd);
+    return EXIT_FAILURE;
+  }
+
+  if (mapped_init(result, fd, st.st_size, read_only))
+    return EXIT_FAILURE;
+
+  // Make sure the file is a vector we know how to read.
+  const VectorFileHeader *header = result->mapping->header;
+  if (header->magic != MAPPED_MAGIC || header->version != MAPPED_VERSION ||
+      header->element_size == 0 ||
+      header->size > (SIZE_MAX - sizeof(VectorFileHeader)) /
+                         header->element_size ||
+      mapped_length(header->element_size, header->size) > (size_t)st.st_size)
+    goto err;
+
+  result->size = header->size;
+  result->element_size = header->element_size;
+  result->capacity =
+      ((size_t)st.st_size - sizeof(VectorFileHeader)) / header->element_size;
+
+  return EXIT_SUCCESS;
+
+err:
+  // Don't write the (zero) size back into a file we didn't understand.
+  result->mapping->read_only = 1;
+  mapped_deinit(result);
+  *result = (Vector){0};
+
+  return EXIT_FAILURE;
+}
+
+int vector_flush(Vector *vec) {
+  assert(vec != NULL);
+
+  if (!vec->mapping || vec->mapping->read_only)
+    return EXIT_SUCCESS;
+
+  vec->mapping->header->size = vec->size;
+
+  if (msync(vec->mapping->header, vec->mapping->length, MS_SYNC))
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+/**
+ * xxhash.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/hash.h"
+#include <assert.h>
+#include <string.h>
+
+// See https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+#define STRIPE_SIZE 32
+
+static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// Little-endian reads, compilers turn these into a single load.
+static uint64_t read64(const uint8_t *p) {
+  uint64_t result = 0;
+  for (size_t i = 0; i < 8; i++)
+    result |= (uint64_t)p[i] << (i * 8);
+  return result;
+}
+
+static uint32_t read32(const uint8_t *p) {
+  uint32_t result = 0;
+  for (size_t i = 0; i < 4; i++)
+    result |= (uint32_t)p[i] << (i * 8);
+  return result;
+}
+
+static uint64_t round64(uint64_t acc, uint64_t lane) {
+  acc += lane * PRIME64_2;
+  acc = rotl(acc, 31);
+  return acc * PRIME64_1;
+}
+
+static uint64_t merge_round(uint64_t acc, uint64_t val) {
+  acc ^= round64(0, val);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+static void consume_stripe(uint64_t acc[4], const uint8_t *stripe) {
+  acc[0] = round64(acc[0], read64(stripe));
+  acc[1] = round64(acc[1], read64(stripe + 8));
+  acc[2] = round64(acc[2], read64(stripe + 16));
+  acc[3] = round64(acc[3], read64(stripe + 24));
+}
+
+Xxh64State xxh64_init(uint64_t seed) {
+  Xxh64State result = {0};
+
+  result.seed = seed;
+  result.acc[0] = seed + PRIME64_1 + PRIME64_2;
+  result.acc[1] = seed + PRIME64_2;
+  result.acc[2] = seed;
+  result.acc[3] = seed - PRIME64_1;
+
+  return result;
+}
+
+void xxh64_update(Xxh64State *state, const uint8_t *arr, size_t size) {
+  assert(state != NULL);
+  assert(arr != NULL || size == 0);
+
+  state->total_size += size;
+
+  // Top up a partially filled stripe first.
+  if (state->buffer_size) {
+    size_t fill = STRIPE_SIZE - state->buffer_size;
+    if (fill > size)
+      fill = size;
+
+    memcpy(state->buffer + state->buffer_size, arr, fill);
+    state->buffer_size += fill;
+    arr += fill;
+    size -= fill;
+
+    if (state->buffer_size < STRIPE_SIZE)
+      return;
+
+    consume_stripe(state->acc, state->buffer);
+    state->buffer_size = 0;
+  }
+
+  for (; size >= STRIPE_SIZE; arr += STRIPE_SIZE, size -= STRIPE_SIZE)
+    consume_stripe(state->acc, arr);
+
+  memcpy(state->buffer, arr, size);
+  state->buffer_size = size;
+}
+
+// Folds the four accumulators into one, only used once a stripe was consumed.
+static uint64_t converge(const uint64_t acc[4]) {
+  uint64_t result =
+      rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+  for (size_t i = 0; i < 4; i++)
+    result = merge_round(result, acc[i]);
+  return result;
+}
+
+// Consumes the last `size` bytes, less than a stripe, then avalanches.
+static uint64_t finish(uint64_t result, const uint8_t *p, size_t size) {
+  // Consume the remaining bytes, 8 then 4 then 1 at a time.
+  for (; size >= 8; p += 8, size -= 8) {
+    result ^= round64(0, read64(p));
+    result = rotl(result, 27) * PRIME64_1 + PRIME64_4;
+  }
+
+  if (size >= 4) {
+    result ^= (uint64_t)read32(p) * PRIME64_1;
+    result = rotl(result, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+    size -= 4;
+  }
+
+  for (; size > 0; p++, size--) {
+    result ^= *p * PRIME64_5;
+    result = rotl(result, 11) * PRIME64_1;
+  }
+
+  // Avalanche.
+  result ^= result >> 33;
+  result *= PRIME64_2;
+  result ^= result >> 29;
+  result *= PRIME64_3;
+  result ^= result >> 32;
+
+  return result;
+}
+
+uint64_t xxh64_final(const Xxh64State *state) {
+  assert(state != NULL);
+
+  uint64_t result = state->total_size >= STRIPE_SIZE
+                        ? converge(state->acc)
+                        : state->seed + PRIME64_5;
+  result += state->total_size;
+
+  return finish(result, state->buffer, state->buffer_size);
+}
+
+// Reads the input in place rather than going through the state's buffer,
+// which matters for short keys.
+uint64_t xxh64_hash(const uint8_t *arr, size_t size, uint64_t seed) {
+  assert(arr != NULL || size == 0);
+
+  uint64_t acc[4] = {seed + PRIME64_1 + PRIME64_2, seed + PRIME64_2, seed,
+                     seed - PRIME64_1};
+
+  const uint8_t *p = arr;
+  size_t remaining = size;
+  for (; remaining >= STRIPE_SIZE; p += STRIPE_SIZE, remaining -= STRIPE_SIZE)
+    consume_stripe(acc, p);
+
+  uint64_t result = size >= STRIPE_SIZE ? converge(acc) : seed + PRIME64_5;
+  result += size;
+
+  return finish(result, p, remaining);
+}
@@ -0,0 +1,147 @@
+/**
+ * alloc.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/alloc.h"
+#include "mylib/hash.h"
+#include "mylib/hash_map.h"
+#include "mylib/vector.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+int main() {
+  // The allocation functions behave like the standard ones.
+  {
+    uint8_t *bytes = alloc_calloc(8, 4);
+    assert(bytes != NULL);
+    for (size_t i = 0; i < 32; i++)
+      assert(bytes[i] == 0);
+
+    memset(bytes, 7, 32);
+    assert((bytes = alloc_realloc(bytes, 64)));
+    assert(bytes[31] == 7);
+
+    assert(alloc_realloc(bytes, 0) == NULL);
+    alloc_free(NULL);
+  }
+
+  // Without the counters alloc_stats fails and every counter stays at 0.
+  AllocStats stats;
+  alloc_stats_reset();
+  int enabled = alloc_stats(&stats) == EXIT_SUCCESS;
+#ifdef MYLIB_ALLOC_STATS
+  assert(enabled);
+#else
+  assert(!enabled);
+#endif
+  size_t start = stats.bytes;
+  assert(stats.allocs == 0 && stats.peak == start);
+
+  // Every allocation of the containers is counted and released again.
+  Vector vec;
+  assert(!vector_init_with_capacity(&vec, sizeof(uint64_t), 4));
+  for (uint64_t i = 0; i < 100; i++)
+    assert(!vector_append(&vec, &i));
+
+  alloc_stats(&stats);
+  assert(!enabled || stats.bytes - start == vector_memory_usage(&vec));
+  assert(!enabled || stats.allocs > 1);
+
+  HashMap map;
+  assert(!hash_map_init64(&map, hash_u64, eql_u64, sizeof(uint64_t),
+                          sizeof(uint64_t)));
+  for (uint64_t i = 0; i < 100; i++)
+    assert(!hash_map_put(&map, &i, &i));
+
+  alloc_stats(&stats);
+  assert(!enabled ||
+         stats.bytes - start ==
+             vector_memory_usage(&vec) + hash_map_memory_usage(&map));
+
+  size_t peak = stats.peak;
+  vector_deinit(&vec);
+  hash_map_deinit(&map);
+
+  alloc_stats(&stats);
+  assert(stats.bytes == start);
+  assert(stats.peak == peak);
+  assert(!enabled || (stats.frees > 0 && stats.total >= peak - start));
+
+  // Each policy aligns its memory, keeps it on realloc and zeroes it on
+  // calloc, whether it's small or large enough to be mapped.
+  AllocPolicy policies[] = {ALLOC_POLICY_ALIGNED, ALLOC_POLICY_HUGE,
+                            ALLOC_POLICY_HUGETLB};
+  size_t sizes[] = {100, ALLOC_HUGE_THRESHOLD + 1};
+  for (size_t p = 0; p < 3; p++) {
+    for (size_t i = 0; i < 2; i++) {
+      uint8_t *bytes = alloc_policy_calloc(policies[p], sizes[i], 1);
+      assert(bytes && (uintptr_t)bytes % ALLOC_ALIGNMENT == 0);
+      for (size_t j = 0; j < sizes[i]; j += 97)
+        assert(bytes[j] == 0);
+
+      memset(bytes, 3, sizes[i]);
+      assert((bytes = alloc_policy_realloc(policies[p], bytes, sizes[i] * 3)));
+      assert((uintptr_t)bytes % ALLOC_ALIGNMENT == 0);
+      assert(bytes[0] == 3 && bytes[sizes[i] - 1] == 3);
+
+      assert((bytes = alloc_policy_realloc(policies[p], bytes, 10)));
+      assert(bytes[9] == 3);
+      assert(alloc_policy_realloc(policies[p], bytes, 0) == NULL);
+    }
+  }
+
+  // Large enough containers are mapped and start a cache line into a huge
+  // page, after the header.
+  assert(!vector_init_with_policy(&vec, sizeof(uint64_t), 1 << 20,
+                                  ALLOC_POLICY_HUGE));
+  assert((uintptr_t)vec.data % ALLOC_HUGE_THRESHOLD == ALLOC_ALIGNMENT);
+  for (uint64_t i = 0; i < (1 << 21); i++)
+    assert(!vector_append(&vec, &i));
+
+  HashMapOptions options = {.bucket_policy = ALLOC_POLICY_ALIGNED};
+  assert(!hash_map_init_with_options(&map, hash_u64, eql_u64, sizeof(uint64_t),
+                                     sizeof(uint64_t), &options));
+  for (uint64_t i = 0; i < 1000; i++)
+    assert(!hash_map_put(&map, &i, &i));
+  assert((uintptr_t)map.buckets % ALLOC_ALIGNMENT == 0);
+
+  Vector clone;
+  assert(!vector_clone(&vec, &clone));
+  assert(clone.policy == ALLOC_POLICY_HUGE);
+  assert(*(const uint64_t *)vector_get_const(&clone, 12345) == 12345);
+
+  vector_deinit(&clone);
+  vector_deinit(&vec);
+  hash_map_deinit(&map);
+
+  alloc_stats(&stats);
+  assert(stats.bytes == start);
+}
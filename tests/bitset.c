@@ -89,6 +89,53 @@ int main() {
     }
   }
 
+  // Equal sets hash the same.
+  {
+    Bitset clone;
+    assert(!bitset_clone(&other, &clone));
+    assert(bitset_hash64(&clone) == bitset_hash64(&other));
+    assert(bitset_hash64(&clone) != bitset_hash64(&bs));
+    bitset_deinit(&clone);
+  }
+
+  // A copy-on-write clone shares the bytes until one of the sets changes.
+  {
+    Bitset clone, second;
+    assert(!bitset_clone_cow(&other, &clone));
+    assert(!bitset_clone_cow(&other, &second));
+    assert(clone.bytes == other.bytes && *other.refs == 3);
+
+    assert(!bitset_incl(&clone, 1));
+    assert(clone.bytes != other.bytes && clone.refs == NULL);
+    assert(bitset_has(&clone, 1) && !bitset_has(&other, 1));
+    assert(bitset_count(&clone) == 2 && bitset_count(&other) == 1);
+
+    // Once the only other holder is gone, changes don't need a copy.
+    bitset_deinit(&second);
+    uint8_t *bytes = other.bytes;
+    bitset_excl(&other, 5);
+    assert(other.bytes == bytes && other.refs == NULL);
+    assert(bitset_has(&clone, 5) && !bitset_has(&other, 5));
+
+    bitset_deinit(&clone);
+  }
+
+  // Any policy holds the same bits, and clones keep it.
+  {
+    Bitset aligned, clone;
+    assert(!bitset_init_with_policy(&aligned, 1000, ALLOC_POLICY_ALIGNED));
+    assert((uintptr_t)aligned.bytes % ALLOC_ALIGNMENT == 0);
+    assert(bitset_count(&aligned) == 0);
+    assert(!bitset_incl(&aligned, 999));
+
+    assert(!bitset_clone(&aligned, &clone));
+    assert(clone.policy == ALLOC_POLICY_ALIGNED && bitset_has(&clone, 999));
+    bitset_deinit(&clone);
+    bitset_deinit(&aligned);
+  }
+
+  assert(bitset_memory_usage(&bs) == bitset_size_in_bytes(&bs));
+
   bitset_deinit(&bs);
   bitset_deinit(&other);
 
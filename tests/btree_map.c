@@ -0,0 +1,191 @@
+/**
+ * btree_map.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/btree_map.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#define N 2000
+
+// Orders the keys from largest to smallest.
+static int32_t cmp_desc_i32(const void *a, const void *b) {
+  int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+  return (y > x) - (y < x);
+}
+
+static uint64_t next_rand(uint64_t *state) {
+  *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return *state >> 33;
+}
+
+// Iterating should see exactly the keys marked in `present`, in order.
+static void check_contents(const BTreeMap *map, const int *present) {
+  size_t count = 0;
+  uint64_t prev = 0;
+
+  BTreeMapIterator iter = btree_map_iter(map);
+  const BTreeMapEntry *entry;
+  while ((entry = btree_map_next(&iter))) {
+    uint64_t key = *(const uint64_t *)entry->key;
+    assert(count == 0 || key > prev);
+    assert(present[key]);
+    assert(*(uint64_t *)entry->value == key * 10);
+    prev = key;
+    count++;
+  }
+
+  assert(count == btree_map_count(map));
+}
+
+int main() {
+  BTreeMap map;
+  static int present[N];
+
+  // Random puts and deletes with a small order, so that nodes split, borrow
+  // and merge all the time.
+  assert(!btree_map_init(&map, NULL, sizeof(uint64_t), sizeof(uint64_t), 4));
+  uint64_t state = 1;
+  for (size_t i = 0; i < 20000; i++) {
+    uint64_t key = next_rand(&state) % N;
+    uint64_t value = key * 10;
+
+    if (next_rand(&state) % 3 == 0) {
+      btree_map_delete(&map, &key);
+      present[key] = 0;
+    } else {
+      assert(!btree_map_put(&map, &key, &value));
+      present[key] = 1;
+    }
+
+    assert(btree_map_has(&map, &key) == present[key]);
+  }
+  check_contents(&map, present);
+
+  for (uint64_t key = 0; key < N; key++) {
+    uint64_t *value = btree_map_get(&map, &key);
+    assert((value != NULL) == present[key]);
+    assert(!value || *value == key * 10);
+  }
+
+  // Delete everything, the tree should shrink back to nothing.
+  for (uint64_t key = 0; key < N; key++) {
+    btree_map_delete(&map, &key);
+    present[key] = 0;
+  }
+  assert(btree_map_count(&map) == 0);
+  assert(map.root == NULL && map.height == 0);
+  assert(btree_map_memory_usage(&map) == 0);
+  check_contents(&map, present);
+
+  btree_map_deinit(&map);
+
+  // Bulk load the even keys, then check range scans and nearest keys.
+  assert(!btree_map_init(&map, NULL, sizeof(uint64_t), sizeof(uint64_t), 0));
+  {
+    static uint64_t keys[N / 2], values[N / 2];
+    for (uint64_t i = 0; i < N / 2; i++) {
+      keys[i] = i * 2;
+      values[i] = i * 20;
+      present[i * 2] = 1;
+    }
+
+    // Unsorted input and loading into a map that isn't empty both fail.
+    uint64_t unsorted[] = {1, 3, 2};
+    assert(btree_map_bulk_load(&map, unsorted, NULL, 3));
+    assert(btree_map_count(&map) == 0);
+
+    assert(!btree_map_bulk_load(&map, keys, values, N / 2));
+    assert(btree_map_bulk_load(&map, keys, values, N / 2));
+  }
+  assert(btree_map_count(&map) == N / 2);
+  assert(map.height > 0);
+  check_contents(&map, present);
+
+  {
+    // [101, 201) holds the even keys 102 to 200.
+    uint64_t start = 101, end = 201;
+    BTreeMapIterator iter = btree_map_range(&map, &start, &end);
+    const BTreeMapEntry *entry;
+    uint64_t expect = 102;
+    while ((entry = btree_map_next(&iter))) {
+      assert(*(const uint64_t *)entry->key == expect);
+      expect += 2;
+    }
+    assert(expect == 202);
+
+    // Seeking past the last key finds nothing.
+    uint64_t past = N;
+    iter = btree_map_seek(&map, &past);
+    assert(btree_map_next(&iter) == NULL);
+
+    BTreeMapEntry floor;
+    uint64_t key = 101;
+    assert(!btree_map_floor(&map, &key, &floor));
+    assert(*(const uint64_t *)floor.key == 100);
+    key = 100;
+    assert(!btree_map_floor(&map, &key, &floor));
+    assert(*(const uint64_t *)floor.key == 100);
+    assert(*(uint64_t *)floor.value == 1000);
+  }
+
+  // The bulk loaded tree takes inserts and deletes like any other.
+  for (uint64_t key = 1; key < N; key += 2) {
+    uint64_t value = key * 10;
+    assert(!btree_map_put(&map, &key, &value));
+    present[key] = 1;
+  }
+  for (uint64_t key = 0; key < N; key += 3) {
+    btree_map_delete(&map, &key);
+    present[key] = 0;
+  }
+  check_contents(&map, present);
+  assert(btree_map_memory_usage(&map) > btree_map_count(&map) * 16);
+
+  btree_map_deinit(&map);
+
+  // A comparator orders the keys, here from largest to smallest.
+  assert(!btree_map_init(&map, cmp_desc_i32, sizeof(int32_t), 0, 5));
+  for (int32_t key = -50; key <= 50; key++)
+    assert(!btree_map_put(&map, &key, NULL));
+  assert(btree_map_count(&map) == 101);
+
+  {
+    BTreeMapIterator iter = btree_map_iter(&map);
+    const BTreeMapEntry *entry;
+    int32_t expect = 50;
+    while ((entry = btree_map_next(&iter)))
+      assert(*(const int32_t *)entry->key == expect--);
+    assert(expect == -51);
+
+    // The floor is the closest key that sorts before, so the next larger one.
+    int32_t key = 100;
+    BTreeMapEntry floor;
+    assert(btree_map_floor(&map, &key, &floor));
+    key = -100;
+    assert(!btree_map_floor(&map, &key, &floor));
+    assert(*(const int32_t *)floor.key == -50);
+  }
+
+  btree_map_deinit(&map);
+}
@@ -0,0 +1,290 @@
+/**
+ * cache.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/cache.h"
+#include "mylib/hash.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+// A clock the test moves by hand.
+static uint64_t fake_time;
+static uint64_t fake_now(void) { return fake_time; }
+
+// Records the first 64 evicted keys.
+typedef struct Evictions {
+  uint64_t keys[64];
+  CacheEvictReason reasons[64];
+  size_t count;
+} Evictions;
+
+static void on_evict(const void *key, void *value, CacheEvictReason reason,
+                     void *ctx) {
+  Evictions *evictions = ctx;
+  assert(*(const uint64_t *)value == *(const uint64_t *)key * 10);
+  if (evictions->count < 64) {
+    evictions->keys[evictions->count] = *(const uint64_t *)key;
+    evictions->reasons[evictions->count] = reason;
+  }
+  evictions->count++;
+}
+
+static void put(Cache *cache, uint64_t key) {
+  uint64_t value = key * 10;
+  assert(!cache_put(cache, &key, &value));
+}
+
+static int has(Cache *cache, uint64_t key) {
+  uint64_t *value = cache_get(cache, &key);
+  assert(!value || *value == key * 10);
+  return value != NULL;
+}
+
+#define THREADS 4
+#define OPS 20000
+
+static void *worker(void *arg) {
+  ShardedCache *cache = arg;
+  for (uint64_t i = 0; i < OPS; i++) {
+    uint64_t key = i % 500, value = key * 10, found;
+    if (sharded_cache_get(cache, &key, &found))
+      assert(found == value);
+    else
+      assert(!sharded_cache_put(cache, &key, &value));
+  }
+  return NULL;
+}
+
+int main() {
+  Cache cache;
+  Evictions evictions = {0};
+  CacheStats stats;
+
+  // LRU evicts the least recently used entry, a get counts as a use.
+  {
+    CacheOptions options = {.max_entries = 3,
+                            .on_evict = on_evict,
+                            .ctx = &evictions};
+    assert(!cache_init(&cache, hash_u64, eql_u64, sizeof(uint64_t),
+                       sizeof(uint64_t), &options));
+
+    put(&cache, 1);
+    put(&cache, 2);
+    put(&cache, 3);
+    assert(has(&cache, 1));
+    put(&cache, 4);
+
+    assert(cache_count(&cache) == 3);
+    assert(!has(&cache, 2));
+    assert(has(&cache, 1) && has(&cache, 3) && has(&cache, 4));
+    assert(evictions.count == 1 && evictions.keys[0] == 2);
+    assert(evictions.reasons[0] == CACHE_EVICT_CAPACITY);
+
+    // Replacing a value doesn't add an entry but does count as a use.
+    put(&cache, 3);
+    put(&cache, 5);
+    assert(evictions.count == 2 && evictions.keys[1] == 1);
+
+    // Deleting doesn't call on_evict.
+    uint64_t key = 5;
+    cache_delete(&cache, &key);
+    assert(cache_count(&cache) == 2 && evictions.count == 2);
+
+    assert(!cache_stats(&cache, &stats));
+    assert(stats.size == 2);
+    assert(stats.hits == 4 && stats.misses == 1);
+    assert(stats.inserts == 5 && stats.evictions == 2);
+    assert(stats.get_ns == 0);
+
+    cache_stats_reset(&cache);
+    assert(!cache_stats(&cache, &stats));
+    assert(stats.hits == 0 && stats.size == 2);
+
+    cache_deinit(&cache);
+  }
+
+  // CLOCK gives referenced entries a second chance.
+  {
+    evictions.count = 0;
+    CacheOptions options = {.policy = CACHE_POLICY_CLOCK,
+                            .max_entries = 3,
+                            .on_evict = on_evict,
+                            .ctx = &evictions};
+    assert(!cache_init(&cache, hash_u64, eql_u64, sizeof(uint64_t),
+                       sizeof(uint64_t), &options));
+
+    put(&cache, 1);
+    put(&cache, 2);
+    put(&cache, 3);
+    assert(has(&cache, 1) && has(&cache, 3));
+    put(&cache, 4);
+    assert(evictions.count == 1 && evictions.keys[0] == 2);
+    assert(has(&cache, 1) && has(&cache, 3) && has(&cache, 4));
+
+    // Many more puts than entries keeps the count at the limit.
+    for (uint64_t key = 10; key < 1000; key++)
+      put(&cache, key);
+    assert(cache_count(&cache) == 3);
+    assert(has(&cache, 999));
+
+    cache_deinit(&cache);
+
+    // A put when every other entry is referenced evicts one of them, not the
+    // entry it just added.
+    evictions.count = 0;
+    options.max_entries = 4;
+    assert(!cache_init(&cache, hash_u64, eql_u64, sizeof(uint64_t),
+                       sizeof(uint64_t), &options));
+    for (uint64_t key = 0; key < 4; key++)
+      put(&cache, key);
+    for (uint64_t key = 0; key < 4; key++)
+      assert(has(&cache, key));
+    put(&cache, 100);
+    assert(cache_count(&cache) == 4);
+    assert(evictions.count == 1 && evictions.keys[0] == 0);
+    assert(has(&cache, 100));
+    assert(has(&cache, 1) && has(&cache, 2) && has(&cache, 3));
+
+    cache_deinit(&cache);
+  }
+
+  // A byte budget counts the charge of every entry.
+  {
+    CacheOptions options = {.max_bytes = 100};
+    assert(!cache_init(&cache, hash_u64, eql_u64, sizeof(uint64_t),
+                       sizeof(uint64_t), &options));
+
+    // The default charge is the key and value size.
+    for (uint64_t key = 0; key < 10; key++)
+      put(&cache, key);
+    assert(cache_count(&cache) == 100 / 16);
+
+    uint64_t key = 100, value = 1000;
+    assert(!cache_put_with(&cache, &key, &value, 0, 90));
+    assert(cache_count(&cache) == 1);
+    assert(!cache_stats(&cache, &stats));
+    assert(stats.bytes == 90);
+
+    // Too big to fit at all, it's rejected and everything else stays.
+    for (key = 0; key < 10; key++)
+      put(&cache, key);
+    assert(cache_count(&cache) == 100 / 16);
+    key = 101;
+    assert(cache_put_with(&cache, &key, &value, 0, 101));
+    assert(cache_count(&cache) == 100 / 16);
+    assert(!cache_get(&cache, &key));
+    for (key = 10 - 100 / 16; key < 10; key++)
+      assert(has(&cache, key));
+
+    // Replacing a value with one too big keeps the old value.
+    key = 9;
+    assert(cache_put_with(&cache, &key, &value, 0, 101));
+    assert(*(const uint64_t *)cache_get(&cache, &key) == 90);
+
+    cache_deinit(&cache);
+  }
+
+  // Entries expire lazily once their TTL has passed.
+  {
+    evictions.count = 0;
+    fake_time = 1000;
+    CacheOptions options = {.ttl_ns = 100,
+                            .now = fake_now,
+                            .on_evict = on_evict,
+                            .ctx = &evictions,
+                            .measure_latency = 1};
+    assert(!cache_init(&cache, hash_u64, eql_u64, sizeof(uint64_t),
+                       sizeof(uint64_t), &options));
+
+    put(&cache, 1);
+    uint64_t key = 2, value = 20;
+    assert(!cache_put_with(&cache, &key, &value, 500, 0));
+    key = 3, value = 30;
+    assert(!cache_put_with(&cache, &key, &value, CACHE_NO_TTL, 0));
+
+    fake_time = 1099;
+    assert(has(&cache, 1));
+    fake_time = 1100;
+    assert(!has(&cache, 1));
+    assert(evictions.count == 1 && evictions.keys[0] == 1);
+    assert(evictions.reasons[0] == CACHE_EVICT_EXPIRED);
+    assert(has(&cache, 2) && has(&cache, 3));
+
+    fake_time = 1000000;
+    assert(!has(&cache, 2) && has(&cache, 3));
+    assert(cache_count(&cache) == 1);
+
+    // Putting an expired key again starts its TTL over.
+    put(&cache, 1);
+    assert(has(&cache, 1));
+
+    assert(!cache_stats(&cache, &stats));
+    assert(stats.expirations == 2);
+    assert(stats.get_ns > 0 && stats.put_ns > 0);
+    assert(cache_memory_usage(&cache) > 2 * 2 * sizeof(uint64_t));
+
+    cache_clear(&cache);
+    assert(cache_count(&cache) == 0 && !has(&cache, 3));
+
+    cache_deinit(&cache);
+  }
+
+  // The sharded cache splits its limit between the shards and is safe to use
+  // from several threads.
+  {
+    ShardedCache sharded;
+    CacheOptions options = {.max_entries = 1000};
+    assert(!sharded_cache_init(&sharded, hash_u64, eql_u64, sizeof(uint64_t),
+                               sizeof(uint64_t), 5, &options));
+    assert(sharded.shard_count == 8);
+    assert(sharded.shards[0].cache.options.max_entries == 125);
+
+    pthread_t threads[THREADS];
+    for (size_t i = 0; i < THREADS; i++)
+      assert(!pthread_create(&threads[i], NULL, worker, &sharded));
+    for (size_t i = 0; i < THREADS; i++)
+      assert(!pthread_join(threads[i], NULL));
+
+    assert(sharded_cache_count(&sharded) == 500);
+    assert(!sharded_cache_stats(&sharded, &stats));
+    assert(stats.size == 500);
+    assert(stats.hits + stats.misses == THREADS * OPS);
+    assert(stats.inserts == 500 && stats.inserts <= stats.misses);
+
+    uint64_t key = 7, value;
+    assert(sharded_cache_get(&sharded, &key, &value) && value == 70);
+    sharded_cache_delete(&sharded, &key);
+    assert(!sharded_cache_get(&sharded, &key, &value));
+
+    sharded_cache_deinit(&sharded);
+  }
+}
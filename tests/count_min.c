@@ -0,0 +1,141 @@
+/**
+ * count_min.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/count_min.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#define KEYS 10000
+
+int main() {
+  CountMin cm;
+
+  assert(count_min_init(&cm, 100, COUNT_MIN_MAX_DEPTH + 1, COUNT_MIN_SKETCH));
+  assert(count_min_init_with_error(&cm, 0, 0.01, COUNT_MIN_SKETCH));
+
+  // A width of e / 0.001 and a depth of ln(1 / 0.01).
+  assert(!count_min_init_with_error(&cm, 0.001, 0.01, COUNT_MIN_SKETCH));
+  assert(cm.width == 2719 && cm.depth == 5);
+  assert(count_min_memory_usage(&cm) == 2719 * 5 * sizeof(int64_t));
+
+  // Key k is added k % 100 times, with a few heavy hitters on top.
+  for (uint64_t key = 0; key < KEYS; key++)
+    count_min_add(&cm, &key, sizeof(key), key % 100);
+  for (uint64_t key = 0; key < 5; key++)
+    count_min_add(&cm, &key, sizeof(key), 100000);
+  int64_t total = cm.total;
+
+  // Never below the true count and rarely much above it.
+  size_t bad = 0;
+  for (uint64_t key = 0; key < KEYS; key++) {
+    int64_t actual = key % 100 + (key < 5 ? 100000 : 0);
+    int64_t estimate = count_min_estimate(&cm, &key, sizeof(key));
+    assert(estimate >= actual);
+    bad += estimate - actual > 0.001 * total;
+  }
+  assert(bad < KEYS / 100);
+
+  // Batches count the same as adding one key at a time.
+  {
+    CountMin one, many;
+    assert(!count_min_init(&one, 1000, 4, COUNT_MIN_COUNT_SKETCH));
+    assert(!count_min_init(&many, 1000, 4, COUNT_MIN_COUNT_SKETCH));
+
+    uint64_t keys[1000];
+    for (uint64_t i = 0; i < 1000; i++) {
+      keys[i] = i % 37;
+      count_min_add(&one, &keys[i], sizeof(uint64_t), 1);
+    }
+    count_min_add_many(&many, keys, sizeof(uint64_t), 1000);
+    assert(many.total == 1000 && one.total == 1000);
+    for (size_t i = 0; i < 4000; i++)
+      assert(one.counters[i] == many.counters[i]);
+
+    count_min_deinit(&one);
+    count_min_deinit(&many);
+  }
+
+  // The Count sketch allows negative counts and is close for heavy keys.
+  {
+    CountMin cs;
+    assert(!count_min_init(&cs, 2000, 7, COUNT_MIN_COUNT_SKETCH));
+    for (uint64_t key = 0; key < KEYS; key++)
+      count_min_add(&cs, &key, sizeof(key), 1);
+
+    uint64_t heavy = 7, negative = 8;
+    count_min_add(&cs, &heavy, sizeof(heavy), 50000);
+    count_min_add(&cs, &negative, sizeof(negative), -1000);
+
+    int64_t estimate = count_min_estimate(&cs, &heavy, sizeof(heavy));
+    assert(estimate > 49900 && estimate < 50100);
+    estimate = count_min_estimate(&cs, &negative, sizeof(negative));
+    assert(estimate < -900 && estimate > -1100);
+
+    // Only sketches of the same shape and kind merge.
+    assert(count_min_merge(&cs, &cm));
+    count_min_deinit(&cs);
+  }
+
+  // Merging sums the counts, as if every key went into one sketch.
+  {
+    CountMin half;
+    assert(!count_min_init(&half, cm.width, cm.depth, COUNT_MIN_SKETCH));
+    uint64_t key = 123;
+    count_min_add(&half, &key, sizeof(key), 1000);
+    int64_t before = count_min_estimate(&cm, &key, sizeof(key));
+    assert(!count_min_merge(&cm, &half));
+    assert(count_min_estimate(&cm, &key, sizeof(key)) == before + 1000);
+    assert(cm.total == total + 1000);
+    count_min_deinit(&half);
+  }
+
+  // A round trip keeps every counter, a damaged buffer is rejected.
+  {
+    CountMin copy;
+    size_t size = count_min_serialized_size(&cm);
+    uint8_t *buffer = malloc(size);
+    assert(buffer);
+    assert(count_min_serialize(&cm, buffer, size - 1));
+    assert(!count_min_serialize(&cm, buffer, size));
+
+    assert(!count_min_deserialize(&copy, buffer, size));
+    assert(copy.width == cm.width && copy.depth == cm.depth);
+    assert(copy.total == cm.total);
+    for (uint64_t key = 0; key < 100; key++)
+      assert(count_min_estimate(&copy, &key, sizeof(key)) ==
+             count_min_estimate(&cm, &key, sizeof(key)));
+    count_min_deinit(&copy);
+
+    assert(count_min_deserialize(&copy, buffer, size - 8));
+    buffer[0] ^= 1;
+    assert(count_min_deserialize(&copy, buffer, size));
+    free(buffer);
+  }
+
+  count_min_clear(&cm);
+  assert(cm.total == 0);
+  uint64_t key = 1;
+  assert(count_min_estimate(&cm, &key, sizeof(key)) == 0);
+
+  count_min_deinit(&cm);
+}
@@ -0,0 +1,86 @@
+/**
+ * deque.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/deque.h"
+#include <assert.h>
+
+int main() {
+  Deque deque;
+  assert(!deque_init(&deque, sizeof(int)));
+
+  // Popping from an empty deque should fail.
+  assert(deque_pop_front(&deque, NULL));
+  assert(deque_pop_back(&deque, NULL));
+
+  // Use the deque as a FIFO queue, pushing enough values to grow it a few
+  // times while the elements wrap around the end of the buffer.
+  for (int i = 0; i < 3; i++)
+    assert(!deque_push_back(&deque, &i));
+
+  {
+    int val;
+    assert(!deque_pop_front(&deque, &val));
+    assert(val == 0);
+  }
+
+  for (int i = 3; i < 40; i++)
+    assert(!deque_push_back(&deque, &i));
+
+  assert(deque_len(&deque) == 39);
+
+  // Indexed access starts from the front.
+  for (size_t i = 0; i < deque_len(&deque); i++)
+    assert(*((const int *)deque_get_const(&deque, i)) == (int)i + 1);
+  assert(deque_get(&deque, deque_len(&deque)) == NULL);
+
+  for (int i = 1; i < 40; i++) {
+    int val;
+    assert(!deque_pop_front(&deque, &val));
+    assert(val == i);
+  }
+
+  assert(deque_len(&deque) == 0);
+
+  // Push to the front then pop from the back, the order should be the same.
+  for (int i = 0; i < 20; i++)
+    assert(!deque_push_front(&deque, &i));
+
+  assert(*((int *)deque_get(&deque, 0)) == 19);
+
+  {
+    int val = 100;
+    assert(!deque_assign(&deque, 0, &val));
+    assert(*((int *)deque_get(&deque, 0)) == val);
+  }
+
+  for (int i = 0; i < 19; i++) {
+    int val;
+    assert(!deque_pop_back(&deque, &val));
+    assert(val == i);
+  }
+
+  deque_clear(&deque);
+  assert(deque_len(&deque) == 0);
+  assert(deque_memory_usage(&deque) == deque.capacity * sizeof(int));
+
+  deque_deinit(&deque);
+}
@@ -0,0 +1,98 @@
+/**
+ * doubly_linked_list.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/doubly_linked_list.h"
+#include <assert.h>
+
+int main() {
+  DoublyLinkedList list = doubly_linked_list_init();
+
+  const size_t i_size = sizeof(int);
+
+  assert(doubly_linked_list_pop_last(&list) == NULL);
+
+  // Append and prepend, the list should be 0 to 9.
+  for (int i = 5; i < 10; i++)
+    assert(!doubly_linked_list_append(&list, &i, i_size));
+  for (int i = 4; i >= 0; i--)
+    assert(!doubly_linked_list_prepend(&list, &i, i_size));
+
+  assert(doubly_linked_list_len(&list) == 10);
+  assert(*((int *)list.first->data) == 0);
+  assert(*((int *)list.last->data) == 9);
+
+  // Delete a node from the middle, its neighbours should be relinked.
+  DoublyLinkedListNode *node = list.first->next->next;
+  assert(*((int *)node->data) == 2);
+  doubly_linked_list_delete(&list, node);
+
+  assert(doubly_linked_list_len(&list) == 9);
+  assert(*((int *)list.first->next->next->data) == 3);
+  assert(*((int *)list.first->next->next->prev->data) == 1);
+
+  // Delete both ends.
+  doubly_linked_list_delete(&list, list.first);
+  doubly_linked_list_delete(&list, list.last);
+  assert(*((int *)list.first->data) == 1);
+  assert(*((int *)list.last->data) == 8);
+  assert(list.first->prev == NULL && list.last->next == NULL);
+
+  node = doubly_linked_list_pop_last(&list);
+  assert(*((int *)node->data) == 8);
+  doubly_linked_list_node_deinit(node);
+
+  // Insert after the last node, the tail should move.
+  int val = 52;
+  assert(!doubly_linked_list_insert_after(&list, list.last, &val, i_size));
+  assert(*((int *)list.last->data) == val);
+
+  // Splice another list onto the end.
+  DoublyLinkedList other = doubly_linked_list_init();
+  for (int i = 100; i < 105; i++)
+    assert(!doubly_linked_list_append(&other, &i, i_size));
+
+  size_t len = doubly_linked_list_len(&list);
+  doubly_linked_list_splice(&list, &other);
+  assert(doubly_linked_list_len(&list) == len + 5);
+  assert(doubly_linked_list_len(&other) == 0 && other.first == NULL);
+  assert(*((int *)list.last->data) == 104);
+
+  // Iterate backwards.
+  {
+    int i = 104;
+    for (node = list.last; i >= 100; node = node->prev, i--)
+      assert(*((int *)node->data) == i);
+    assert(*((int *)node->data) == val);
+  }
+
+  // Splicing into an empty list moves everything.
+  doubly_linked_list_splice(&other, &list);
+  assert(doubly_linked_list_len(&other) == len + 5);
+  assert(list.first == NULL && list.last == NULL);
+  assert(doubly_linked_list_memory_usage(&other, i_size) ==
+         (len + 5) * (sizeof(DoublyLinkedListNode) + i_size));
+
+  doubly_linked_list_clear(&other);
+  assert(other.first == NULL && doubly_linked_list_len(&other) == 0);
+
+  doubly_linked_list_deinit(&list);
+}
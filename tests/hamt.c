@@ -0,0 +1,198 @@
+/**
+ * hamt.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/hamt.h"
+#include "mylib/hash.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+// Every key has the same hash so they all end up in one collision node.
+static unsigned int hash_constant(const void *key) { return 42; }
+
+static uint64_t get(const Hamt *map, uint64_t key) {
+  const uint64_t *value = hamt_get(map, &key);
+  return value ? *value : UINT64_MAX;
+}
+
+typedef struct Reader {
+  Hamt snapshot;
+  uint64_t sum;
+} Reader;
+
+// Reads a snapshot while the map it was taken from keeps changing.
+static void *read_snapshot(void *arg) {
+  Reader *reader = arg;
+  for (int pass = 0; pass < 20; pass++) {
+    for (uint64_t key = 0; key < 1000; key++)
+      reader->sum += get(&reader->snapshot, key);
+  }
+  hamt_deinit(&reader->snapshot);
+  return NULL;
+}
+
+int main() {
+  Hamt map, snapshot;
+
+  assert(!hamt_init64(&map, hash_u64, eql_u64, sizeof(uint64_t),
+                      sizeof(uint64_t)));
+  assert(hamt_count(&map) == 0);
+  assert(hamt_get(&map, &(uint64_t){1}) == NULL);
+
+  for (uint64_t key = 0; key < 10000; key++) {
+    uint64_t value = key * 2;
+    assert(!hamt_put(&map, &key, &value));
+  }
+  assert(hamt_count(&map) == 10000);
+  for (uint64_t key = 0; key < 10000; key++)
+    assert(get(&map, key) == key * 2);
+  assert(!hamt_has(&map, &(uint64_t){10000}));
+
+  // A second put replaces the value.
+  assert(!hamt_put(&map, &(uint64_t){5}, &(uint64_t){1}));
+  assert(hamt_count(&map) == 10000 && get(&map, 5) == 1);
+
+  // Every entry is visited once.
+  {
+    size_t count = 0;
+    uint64_t sum = 0;
+    HamtIterator iter = hamt_iter(&map);
+    const HamtEntry *entry;
+    while ((entry = hamt_next(&iter))) {
+      sum += *(const uint64_t *)entry->key;
+      count++;
+    }
+    assert(count == 10000);
+    assert(sum == 10000 * 9999 / 2);
+  }
+
+  // Changes after a snapshot aren't seen by it, and changes to it aren't seen
+  // by the map.
+  size_t before = hamt_memory_usage(&map);
+  hamt_snapshot(&map, &snapshot);
+  assert(hamt_count(&snapshot) == 10000);
+  assert(hamt_memory_usage(&snapshot) == before);
+
+  for (uint64_t key = 0; key < 10000; key += 2)
+    assert(!hamt_delete(&map, &key));
+  assert(!hamt_put(&map, &(uint64_t){20000}, &(uint64_t){7}));
+  assert(!hamt_put(&snapshot, &(uint64_t){7}, &(uint64_t){0}));
+  assert(!hamt_delete(&map, &(uint64_t){30000}));
+
+  assert(hamt_count(&map) == 5001 && hamt_count(&snapshot) == 10000);
+  for (uint64_t key = 0; key < 10000; key++) {
+    assert(hamt_has(&map, &key) == (key % 2 == 1));
+    assert(get(&snapshot, key) == (key == 5 ? 1 : key == 7 ? 0 : key * 2));
+  }
+  assert(get(&map, 7) == 14);
+  assert(get(&map, 20000) == 7 && !hamt_has(&snapshot, &(uint64_t){20000}));
+
+  hamt_deinit(&snapshot);
+  assert(get(&map, 9999) == 9999 * 2);
+
+  // Deleting everything leaves an empty map, which can be filled again.
+  for (uint64_t key = 0; key < 20001; key++)
+    assert(!hamt_delete(&map, &key));
+  assert(hamt_count(&map) == 0 && map.root == NULL);
+  assert(hamt_memory_usage(&map) == sizeof(Hamt));
+  assert(!hamt_put(&map, &(uint64_t){3}, &(uint64_t){4}));
+  assert(get(&map, 3) == 4);
+  hamt_deinit(&map);
+
+  // Removing keys in any order leaves the same shape as never adding them, so
+  // a map built then shrunk uses no more memory than one built directly.
+  {
+    Hamt grown, direct;
+    assert(!hamt_init64(&grown, hash_u64, eql_u64, sizeof(uint64_t),
+                        sizeof(uint64_t)));
+    assert(!hamt_init64(&direct, hash_u64, eql_u64, sizeof(uint64_t),
+                        sizeof(uint64_t)));
+    for (uint64_t key = 0; key < 2000; key++) {
+      assert(!hamt_put(&grown, &key, &key));
+      if (key % 3 == 0)
+        assert(!hamt_put(&direct, &key, &key));
+    }
+    for (uint64_t key = 1999; key < 2000; key--) {
+      if (key % 3)
+        assert(!hamt_delete(&grown, &key));
+    }
+    assert(hamt_count(&grown) == hamt_count(&direct));
+    assert(hamt_memory_usage(&grown) == hamt_memory_usage(&direct));
+    hamt_deinit(&grown);
+    hamt_deinit(&direct);
+  }
+
+  // Keys with the same full hash share a collision node.
+  assert(!hamt_init(&map, hash_constant, eql_u64, sizeof(uint64_t),
+                    sizeof(uint64_t)));
+  for (uint64_t key = 0; key < 50; key++)
+    assert(!hamt_put(&map, &key, &key));
+  hamt_snapshot(&map, &snapshot);
+  for (uint64_t key = 0; key < 50; key += 2)
+    assert(!hamt_delete(&map, &key));
+  assert(!hamt_put(&map, &(uint64_t){1}, &(uint64_t){100}));
+  for (uint64_t key = 0; key < 50; key++) {
+    assert(get(&map, key) == (key % 2 ? key == 1 ? 100 : key : UINT64_MAX));
+    assert(get(&snapshot, key) == key);
+  }
+  for (uint64_t key = 0; key < 50; key++)
+    assert(!hamt_delete(&snapshot, &key));
+  assert(hamt_count(&snapshot) == 0 && hamt_count(&map) == 25);
+  hamt_deinit(&snapshot);
+  hamt_deinit(&map);
+
+  // Readers on other threads see their snapshot unchanged while the writer
+  // keeps going, and whichever drops the last reference frees the nodes.
+  assert(!hamt_init64(&map, hash_u64, eql_u64, sizeof(uint64_t),
+                      sizeof(uint64_t)));
+  for (uint64_t key = 0; key < 1000; key++)
+    assert(!hamt_put(&map, &key, &key));
+
+  Reader readers[4];
+  pthread_t threads[4];
+  for (size_t i = 0; i < 4; i++) {
+    readers[i] = (Reader){0};
+    hamt_snapshot(&map, &readers[i].snapshot);
+    assert(!pthread_create(&threads[i], NULL, read_snapshot, &readers[i]));
+
+    for (uint64_t key = 0; key < 1000; key++) {
+      uint64_t value = key + i + 1;
+      assert(!hamt_put(&map, &key, &value));
+    }
+  }
+
+  for (size_t i = 0; i < 4; i++) {
+    assert(!pthread_join(threads[i], NULL));
+    assert(readers[i].sum == 20 * (999 * 1000 / 2 + 1000 * i));
+  }
+  assert(get(&map, 10) == 14);
+  hamt_deinit(&map);
+}
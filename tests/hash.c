@@ -0,0 +1,100 @@
+/**
+ * hash.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/hash.h"
+#include <assert.h>
+
+int main() {
+  const uint8_t *a = (const uint8_t *)"a";
+
+  // Reference values for FNV-1a.
+  assert(fnv1a_32_hash(a, 0) == 0x811c9dc5);
+  assert(fnv1a_32_hash(a, 1) == 0xe40c292c);
+  assert(fnv1a_64_hash(a, 0) == 0xcbf29ce484222325ULL);
+  assert(fnv1a_64_hash(a, 1) == 0xaf63dc4c8601ec8cULL);
+
+  // Different seeds give different hashes.
+  {
+    uint64_t val = fnv1a_64_init_seeded(1);
+    fnv1a_64_update(&val, a, 1);
+
+    uint64_t other = fnv1a_64_init_seeded(2);
+    fnv1a_64_update(&other, a, 1);
+
+    assert(val != other && val != fnv1a_64_hash(a, 1));
+    assert(fnv1a_32_init_seeded(1) != fnv1a_32_init_seeded(2));
+  }
+
+  // Batches must give the same results as hashing each key, whatever the key
+  // size and however many keys are left over after the groups of 8.
+  {
+    uint8_t keys[40 * 17];
+    for (size_t i = 0; i < sizeof(keys); i++)
+      keys[i] = i * 31 + 7;
+
+    uint32_t hashes[40];
+    for (size_t key_size = 1; key_size <= 17; key_size++) {
+      for (size_t count = 0; count <= 40; count += 3) {
+        fnv1a_32_hash_batch(keys, key_size, count, hashes);
+        for (size_t i = 0; i < count; i++)
+          assert(hashes[i] == fnv1a_32_hash(keys + i * key_size, key_size));
+      }
+    }
+
+    Vector vec;
+    assert(!vector_init(&vec, sizeof(uint64_t)));
+    for (uint64_t i = 0; i < 40; i++)
+      assert(!vector_append(&vec, &i));
+
+    fnv1a_32_hash_vector(&vec, hashes);
+    for (size_t i = 0; i < 40; i++)
+      assert(hashes[i] ==
+             fnv1a_32_hash(vector_get_const(&vec, i), sizeof(uint64_t)));
+
+    vector_deinit(&vec);
+  }
+
+  // Reference values for xxHash64.
+  uint8_t bytes[100];
+  for (size_t i = 0; i < sizeof(bytes); i++)
+    bytes[i] = i;
+
+  assert(xxh64_hash(a, 0, 0) == 0xef46db3751d8e999ULL);
+  assert(xxh64_hash(a, 1, 0) == 0xd24ec4f1a98c6e5bULL);
+  assert(xxh64_hash((const uint8_t *)"abc", 3, 1) == 0xbea9ca8199328908ULL);
+  assert(xxh64_hash(bytes, 33, 7) == 0x0c43e57754c778d9ULL);
+  assert(xxh64_hash(bytes, sizeof(bytes), 0) == 0x6ac1e58032166597ULL);
+
+  // Streaming in uneven pieces should give the same result as a single call.
+  {
+    Xxh64State state = xxh64_init(0x9E3779B97F4A7C15ULL);
+    size_t sizes[] = {1, 7, 30, 2, 40, 20};
+    size_t offset = 0;
+    for (size_t i = 0; i < 6; i++) {
+      xxh64_update(&state, bytes + offset, sizes[i]);
+      offset += sizes[i];
+    }
+
+    assert(offset == sizeof(bytes));
+    assert(xxh64_final(&state) == 0x3b97d91eba03e785ULL);
+  }
+}
@@ -35,6 +35,17 @@ static int eql_str(const void *a, const void *b) {
   return strcmp((const char *)a, (const char *)b) == 0;
 }
 
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+// A weak hash, only the low bits vary for small keys.
+static uint64_t hash_identity(const void *key) { return *(const uint64_t *)key; }
+
 int main() {
   HashMap map;
   assert(!hash_map_init(&map, hash_str, eql_str, sizeof(char *), sizeof(int)));
@@ -69,6 +80,17 @@ int main() {
     assert(*((int *)hash_map_get_value(&map, &buf)) == i);
   }
 
+  // Delete a key, the rest of the keys should still be in the map.
+  {
+    const char key[] = "7";
+    hash_map_delete(&map, &key);
+    assert(hash_map_count(&map) == 14);
+    assert(!hash_map_has(&map, &key));
+
+    const char other[] = "8";
+    assert(hash_map_has(&map, &other));
+  }
+
   // Iterate the map, each value should be under 15 like the above loop
   HashMapIterator iter = hash_map_iter(&map);
   const HashMapKV *kv;
@@ -90,4 +112,189 @@ int main() {
   }
 
   hash_map_deinit(&map);
+
+  // Use a 64-bit hash and put enough keys in the map for it to resize a few
+  // times, every key should still be found afterwards.
+  assert(!hash_map_init64(&map, hash_u64, eql_u64, sizeof(uint64_t),
+                          sizeof(uint64_t)));
+
+  for (uint64_t i = 0; i < 1000; i++) {
+    uint64_t val = i * 2;
+    assert(!hash_map_put(&map, &i, &val));
+  }
+
+  assert(hash_map_count(&map) == 1000);
+  assert(map.capacity >= 1000);
+
+  for (uint64_t i = 0; i < 1000; i++)
+    assert(*((uint64_t *)hash_map_get_value(&map, &i)) == i * 2);
+
+  // Every kv should be visited by the iterator.
+  {
+    size_t count = 0;
+    HashMapIterator iter = hash_map_iter(&map);
+    while ((kv = hash_map_next(&iter))) {
+      assert(*(uint64_t *)kv->value == *(uint64_t *)kv->key * 2);
+      count++;
+    }
+    assert(count == 1000);
+  }
+
+  for (uint64_t i = 0; i < 1000; i += 2)
+    hash_map_delete(&map, &i);
+
+  assert(hash_map_count(&map) == 500);
+  for (uint64_t i = 0; i < 1000; i++)
+    assert(hash_map_has(&map, &i) == (i % 2 == 1));
+
+  hash_map_deinit(&map);
+
+  // Both ways of indexing should find every key, masking should still spread
+  // the keys over the buckets with a hash that only varies in its low bits.
+  HashMapIndexing indexings[] = {HASH_MAP_INDEX_FASTRANGE, HASH_MAP_INDEX_MASK};
+  for (size_t i = 0; i < 2; i++) {
+    HashMapOptions options = {.indexing = indexings[i], .initial_capacity = 3};
+    assert(!hash_map_init_with_options(&map, hash_identity, eql_u64,
+                                       sizeof(uint64_t), sizeof(uint64_t),
+                                       &options));
+
+    for (uint64_t key = 0; key < 100; key++)
+      assert(!hash_map_put(&map, &key, &key));
+
+    for (uint64_t key = 0; key < 100; key++)
+      assert(*((uint64_t *)hash_map_get_value(&map, &key)) == key);
+
+    if (indexings[i] == HASH_MAP_INDEX_MASK) {
+      assert((map.capacity & (map.capacity - 1)) == 0);
+
+      size_t used = 0;
+      for (size_t j = 0; j < map.capacity; j++)
+        used += map.buckets[j].first != NULL;
+      assert(used > map.capacity / 4);
+    } else {
+      // Fastrange keeps the capacity it was given, doubling it when it grows.
+      assert(map.capacity % 3 == 0);
+    }
+
+    hash_map_deinit(&map);
+  }
+
+  // Every storage mode should find its keys, replace values on a second put
+  // and honour who owns the memory.
+  HashMapStorage storages[] = {HASH_MAP_STORE_COPY, HASH_MAP_STORE_BORROW,
+                               HASH_MAP_STORE_INLINE};
+  size_t usage[3];
+  for (size_t i = 0; i < 3; i++) {
+    HashMapOptions options = {.storage = storages[i]};
+    assert(!hash_map_init_with_options(&map, hash_u64, eql_u64,
+                                       sizeof(uint64_t), sizeof(uint64_t),
+                                       &options));
+
+    uint64_t keys[64], values[64];
+    for (uint64_t key = 0; key < 64; key++) {
+      keys[key] = key;
+      values[key] = key * 3;
+      assert(!hash_map_put(&map, &keys[key], &values[key]));
+    }
+
+    // A second put replaces the value without adding an entry.
+    uint64_t replacement = 1000;
+    assert(!hash_map_put(&map, &keys[5], &replacement));
+    assert(hash_map_count(&map) == 64);
+    assert(*(uint64_t *)hash_map_get_value(&map, &keys[5]) == 1000);
+
+    uint64_t *value = hash_map_get_value(&map, &keys[6]);
+    if (storages[i] == HASH_MAP_STORE_BORROW) {
+      // Borrowed values are the caller's own memory.
+      assert(value == &values[6]);
+      assert(hash_map_get(&map, &keys[6])->key == &keys[6]);
+      assert(hash_map_get_value(&map, &keys[5]) == &replacement);
+    } else {
+      // Owned values are copies, changing the originals has no effect.
+      assert(value != &values[6] && *value == 18);
+      values[6] = 0;
+      replacement = 0;
+      assert(*value == 18);
+      assert(*(uint64_t *)hash_map_get_value(&map, &keys[5]) == 1000);
+    }
+
+    // get_or_put then kv_assign works the same in each mode.
+    uint64_t key = 100, val = 7;
+    int has_existing;
+    const HashMapKV *kv = hash_map_get_or_put(&map, &key, &has_existing);
+    assert(kv && !has_existing);
+    hash_map_kv_assign(&map, kv, &val);
+    assert(*(uint64_t *)hash_map_get_value(&map, &key) == 7);
+
+    hash_map_delete(&map, &key);
+    for (uint64_t j = 0; j < 64; j += 2)
+      hash_map_delete(&map, &keys[j]);
+    assert(hash_map_count(&map) == 32);
+    for (uint64_t j = 0; j < 64; j++)
+      assert(hash_map_has(&map, &keys[j]) == (j % 2 == 1));
+
+    usage[i] = hash_map_memory_usage(&map);
+    hash_map_deinit(&map);
+  }
+
+  // Borrowing allocates the fewest bytes, inlining pads the key and value to
+  // keep them aligned so it may use a few more bytes than copying, but in
+  // half as many allocations.
+  assert(usage[1] < usage[0] && usage[1] < usage[2]);
+
+  // The shape of the map is always available, the counters only when the
+  // library records them.
+  assert(!hash_map_init64(&map, hash_u64, eql_u64, sizeof(uint64_t),
+                          sizeof(uint64_t)));
+  for (uint64_t key = 0; key < 100; key++)
+    assert(!hash_map_put(&map, &key, &key));
+  for (uint64_t key = 0; key < 200; key++)
+    hash_map_has(&map, &key);
+
+  HashMapStats stats;
+  assert(!hash_map_stats(&map, &stats));
+  assert(stats.size == 100);
+  assert(stats.capacity == map.capacity);
+
+  size_t buckets = 0, nodes = 0;
+  for (size_t i = 0; i < HASH_MAP_STATS_HISTOGRAM_SIZE; i++) {
+    buckets += stats.chain_histogram[i];
+    nodes += i * stats.chain_histogram[i];
+  }
+  assert(buckets == map.capacity);
+  assert(nodes == 100);
+  assert(stats.max_chain > 0);
+
+#ifdef MYLIB_HASH_MAP_STATS
+  // 100 puts and 200 lookups, half of which hit.
+  assert(stats.lookups == 300);
+  assert(stats.eql_calls >= 100);
+  assert(stats.resizes > 0);
+  assert(stats.bytes_in_use > 0);
+  assert(stats.bytes_allocated >= stats.bytes_in_use);
+
+  size_t lookups = 0;
+  for (size_t i = 0; i < HASH_MAP_STATS_HISTOGRAM_SIZE; i++)
+    lookups += stats.probe_histogram[i];
+  assert(lookups == 300);
+
+  hash_map_stats_reset(&map);
+  assert(!hash_map_stats(&map, &stats));
+  assert(stats.lookups == 0 && stats.resizes == 0);
+  assert(stats.bytes_in_use > 0);
+
+  // Deleting everything leaves only the buckets array.
+  for (uint64_t key = 0; key < 100; key++)
+    hash_map_delete(&map, &key);
+  assert(!hash_map_stats(&map, &stats));
+  assert(stats.bytes_in_use == map.capacity * sizeof(LinkedList));
+
+  hash_map_clear(&map);
+  assert(!hash_map_stats(&map, &stats));
+  assert(stats.bytes_in_use == 0);
+#else
+  assert(stats.lookups == 0 && stats.bytes_allocated == 0);
+#endif
+
+  hash_map_deinit(&map);
 }
@@ -0,0 +1,168 @@
+/**
+ * hash_set.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/hash_set.h"
+#include "mylib/hash.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static uint32_t hash_u64_32(const void *key) {
+  return fnv1a_32_hash(key, sizeof(uint64_t));
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+static HashSet range(uint64_t start, uint64_t end) {
+  HashSet set;
+  assert(!hash_set_init64(&set, hash_u64, eql_u64, sizeof(uint64_t)));
+  for (uint64_t key = start; key < end; key++)
+    assert(!hash_set_insert(&set, &key, NULL));
+  return set;
+}
+
+int main() {
+  HashSet set;
+
+  // Both kinds of hash find every key after the set has grown a few times.
+  for (int i = 0; i < 2; i++) {
+    if (i == 0)
+      assert(!hash_set_init64(&set, hash_u64, eql_u64, sizeof(uint64_t)));
+    else
+      assert(!hash_set_init(&set, hash_u64_32, eql_u64, sizeof(uint64_t)));
+
+    int has_existing;
+    for (uint64_t key = 0; key < 1000; key++) {
+      assert(!hash_set_insert(&set, &key, &has_existing));
+      assert(!has_existing);
+    }
+    uint64_t key = 5;
+    assert(!hash_set_insert(&set, &key, &has_existing));
+    assert(has_existing);
+
+    assert(hash_set_count(&set) == 1000);
+    assert((set.capacity & (set.capacity - 1)) == 0);
+    for (uint64_t key = 0; key < 2000; key++)
+      assert(hash_set_contains(&set, &key) == (key < 1000));
+
+    for (uint64_t key = 0; key < 1000; key += 2)
+      hash_set_remove(&set, &key);
+    key = 5000;
+    hash_set_remove(&set, &key); // Removing a missing key does nothing.
+    assert(hash_set_count(&set) == 500);
+    for (uint64_t key = 0; key < 1000; key++)
+      assert(hash_set_contains(&set, &key) == (key % 2 == 1));
+
+    hash_set_deinit(&set);
+  }
+
+  // Inserting and removing over and over reuses tombstones and rehashes in
+  // place rather than growing forever.
+  assert(!hash_set_init64(&set, hash_u64, eql_u64, sizeof(uint64_t)));
+  for (uint64_t key = 0; key < 100000; key++) {
+    assert(!hash_set_insert(&set, &key, NULL));
+    if (key >= 8) {
+      uint64_t old = key - 8;
+      hash_set_remove(&set, &old);
+    }
+  }
+  assert(hash_set_count(&set) == 8);
+  assert(set.capacity <= 64);
+  for (uint64_t key = 100000 - 8; key < 100000; key++)
+    assert(hash_set_contains(&set, &key));
+
+  // The iterator visits every key once.
+  {
+    uint64_t sum = 0;
+    size_t count = 0;
+    HashSetIterator iter = hash_set_iter(&set);
+    const uint64_t *key;
+    while ((key = hash_set_next(&iter))) {
+      sum += *key;
+      count++;
+    }
+    assert(count == 8);
+    assert(sum == 8 * (100000 - 8) + 28);
+  }
+
+  // Clearing keeps the slots.
+  size_t capacity = set.capacity;
+  hash_set_clear(&set);
+  assert(hash_set_count(&set) == 0 && set.capacity == capacity);
+  uint64_t key = 99999;
+  assert(!hash_set_contains(&set, &key));
+
+  // Reserving up front means inserting doesn't grow the set.
+  assert(!hash_set_reserve(&set, 10000));
+  capacity = set.capacity;
+  for (uint64_t key = 0; key < 10000; key++)
+    assert(!hash_set_insert(&set, &key, NULL));
+  assert(set.capacity == capacity);
+  assert(hash_set_memory_usage(&set) ==
+         set.capacity * (1 + sizeof(uint64_t)));
+  hash_set_deinit(&set);
+
+  // Set operations between [0, 100) and [50, 300).
+  {
+    HashSet a = range(0, 100), b = range(50, 300), result;
+
+    assert(!hash_set_union(&a, &b, &result));
+    assert(hash_set_count(&result) == 300);
+    for (uint64_t key = 0; key < 400; key++)
+      assert(hash_set_contains(&result, &key) == (key < 300));
+    hash_set_deinit(&result);
+
+    assert(!hash_set_intersect(&a, &b, &result));
+    assert(hash_set_count(&result) == 50);
+    for (uint64_t key = 0; key < 400; key++)
+      assert(hash_set_contains(&result, &key) == (key >= 50 && key < 100));
+    hash_set_deinit(&result);
+
+    assert(!hash_set_difference(&a, &b, &result));
+    assert(hash_set_count(&result) == 50);
+    for (uint64_t key = 0; key < 400; key++)
+      assert(hash_set_contains(&result, &key) == (key < 50));
+    hash_set_deinit(&result);
+
+    assert(!hash_set_difference(&b, &a, &result));
+    assert(hash_set_count(&result) == 200);
+    hash_set_deinit(&result);
+
+    // A clone is independent of its source.
+    assert(!hash_set_clone(&a, &result));
+    key = 1000;
+    assert(!hash_set_insert(&result, &key, NULL));
+    assert(!hash_set_contains(&a, &key));
+    assert(hash_set_count(&result) == 101 && hash_set_count(&a) == 100);
+    hash_set_deinit(&result);
+
+    hash_set_deinit(&a);
+    hash_set_deinit(&b);
+  }
+}
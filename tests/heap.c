@@ -0,0 +1,204 @@
+/**
+ * heap.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/heap.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static int32_t cmp_int(const void *a, const void *b) {
+  int x = *(const int *)a, y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+static int32_t cmp_int_desc(const void *a, const void *b) {
+  return cmp_int(b, a);
+}
+
+// A large odd multiplier spreads 0..n over a scrambled order.
+static int scrambled(int i, int n) { return (int)((i * 7919L) % n); }
+
+int main() {
+  Heap heap;
+
+  // Pops come out in order for each arity.
+  size_t arities[] = {0, 2, 3, 8};
+  for (size_t a = 0; a < 4; a++) {
+    assert(!heap_init(&heap, sizeof(int), cmp_int, arities[a]));
+    assert(heap_peek(&heap) == NULL);
+
+    for (int i = 0; i < 1000; i++) {
+      int value = scrambled(i, 1000);
+      assert(!heap_push(&heap, &value));
+    }
+    assert(heap_len(&heap) == 1000);
+    assert(*(const int *)heap_peek(&heap) == 0);
+
+    for (int i = 0; i < 1000; i++) {
+      int value;
+      assert(!heap_pop(&heap, &value));
+      assert(value == i);
+    }
+    int value;
+    assert(heap_pop(&heap, &value));
+    assert(heap_replace(&heap, &value, &value));
+
+    heap_deinit(&heap);
+  }
+
+  // Heapify takes over a vector, duplicates included.
+  {
+    Vector vec;
+    assert(!vector_init(&vec, sizeof(int)));
+    for (int i = 0; i < 999; i++) {
+      int value = scrambled(i, 999) / 3;
+      assert(!vector_append(&vec, &value));
+    }
+
+    assert(!heap_init_from_vector(&heap, &vec, cmp_int_desc, 0));
+    assert(vec.data == NULL);
+    assert(heap_len(&heap) == 999);
+
+    int prev = 1000, value;
+    while (!heap_pop(&heap, &value)) {
+      assert(value <= prev);
+      prev = value;
+    }
+    assert(heap_len(&heap) == 0);
+    heap_deinit(&heap);
+
+    // An empty vector and one with a single element.
+    assert(!vector_init(&vec, sizeof(int)));
+    assert(!heap_init_from_vector(&heap, &vec, cmp_int, 0));
+    assert(heap_len(&heap) == 0);
+    value = 5;
+    assert(!heap_push(&heap, &value));
+    assert(*(const int *)heap_peek(&heap) == 5);
+    heap_deinit(&heap);
+  }
+
+  // Top-K, the 10 largest values kept in a min-heap of 10.
+  {
+    assert(!heap_init(&heap, sizeof(int), cmp_int, 0));
+    for (int i = 0; i < 10000; i++) {
+      int value = scrambled(i, 10000);
+      if (heap_len(&heap) < 10)
+        assert(!heap_push(&heap, &value));
+      else if (value > *(const int *)heap_peek(&heap))
+        assert(!heap_replace(&heap, &value, NULL));
+    }
+
+    for (int i = 9990; i < 10000; i++) {
+      int value;
+      assert(!heap_pop(&heap, &value));
+      assert(value == i);
+    }
+
+    heap_clear(&heap);
+    assert(heap_len(&heap) == 0);
+    assert(heap_memory_usage(&heap) >= sizeof(int));
+    heap_deinit(&heap);
+  }
+
+  // Ids keep track of where their element is, so it can be changed.
+  {
+    IndexedHeap indexed;
+    assert(!indexed_heap_init(&indexed, sizeof(int), cmp_int, 0));
+
+    for (int id = 0; id < 100; id++) {
+      int value = 1000 + scrambled(id, 100);
+      assert(!indexed_heap_push(&indexed, id, &value));
+    }
+    int value = 0;
+    assert(indexed_heap_push(&indexed, 5, &value));
+    assert(indexed_heap_len(&indexed) == 100);
+    assert(indexed_heap_contains(&indexed, 99));
+    assert(!indexed_heap_contains(&indexed, 100));
+    assert(!indexed_heap_contains(&indexed, 1000000));
+    assert(indexed_heap_get(&indexed, 1000000) == NULL);
+
+    // Decrease one key to the top and increase another to the bottom.
+    value = 1;
+    assert(!indexed_heap_update(&indexed, 42, &value));
+    value = 5000;
+    assert(!indexed_heap_update(&indexed, 0, &value));
+    assert(indexed_heap_update(&indexed, 100, &value));
+    assert(*(const int *)indexed_heap_get(&indexed, 42) == 1);
+
+    size_t id;
+    assert(*(const int *)indexed_heap_peek(&indexed, &id) == 1 && id == 42);
+
+    indexed_heap_remove(&indexed, 7);
+    indexed_heap_remove(&indexed, 7);
+    assert(!indexed_heap_contains(&indexed, 7));
+    assert(indexed_heap_len(&indexed) == 99);
+
+    int prev = 0;
+    size_t count = 0;
+    while (!indexed_heap_pop(&indexed, &id, &value)) {
+      assert(value >= prev);
+      assert(!indexed_heap_contains(&indexed, id));
+      assert(id != 7);
+      prev = value;
+      count++;
+    }
+    assert(count == 99 && id == 0 && value == 5000);
+
+    // An id can be pushed again once it has left.
+    value = 3;
+    assert(!indexed_heap_push(&indexed, 7, &value));
+    indexed_heap_clear(&indexed);
+    assert(indexed_heap_len(&indexed) == 0);
+    assert(!indexed_heap_contains(&indexed, 7));
+
+    indexed_heap_deinit(&indexed);
+  }
+
+  // Random updates keep every position pointing at its own id.
+  {
+    IndexedHeap indexed;
+    assert(!indexed_heap_init(&indexed, sizeof(int), cmp_int, 3));
+    for (int id = 0; id < 500; id++)
+      assert(!indexed_heap_push(&indexed, id, &id));
+
+    for (int i = 0; i < 5000; i++) {
+      size_t id = scrambled(i, 500);
+      int value = scrambled(i * 31 + 7, 100000);
+      if (i % 7 == 0) {
+        indexed_heap_remove(&indexed, id);
+        assert(!indexed_heap_push(&indexed, id, &value));
+      } else {
+        assert(!indexed_heap_update(&indexed, id, &value));
+      }
+      assert(*(const int *)indexed_heap_get(&indexed, id) == value);
+    }
+
+    int prev = -1, value;
+    while (!indexed_heap_pop(&indexed, NULL, &value)) {
+      assert(value >= prev);
+      prev = value;
+    }
+
+    indexed_heap_deinit(&indexed);
+  }
+}
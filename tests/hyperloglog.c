@@ -0,0 +1,149 @@
+/**
+ * hyperloglog.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/hyperloglog.h"
+#include "mylib/hash.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// Whether `estimate` is within `error` of `actual`, relative to `actual`.
+static int close_to(uint64_t estimate, uint64_t actual, double error) {
+  return fabs((double)estimate - (double)actual) <= error * actual;
+}
+
+int main() {
+  HyperLogLog hll, other;
+
+  assert(hyperloglog_init(&hll, 3));
+  assert(hyperloglog_init(&hll, 19));
+  assert(!hyperloglog_init(&hll, 14));
+  assert(hyperloglog_is_sparse(&hll));
+  assert(hyperloglog_estimate(&hll) == 0);
+
+  // Small counts are all but exact while the sketch is sparse, adding a key
+  // again changes nothing.
+  for (uint64_t key = 0; key < 1000; key++) {
+    assert(!hyperloglog_add(&hll, &key, sizeof(key)));
+    assert(!hyperloglog_add(&hll, &key, sizeof(key)));
+  }
+  assert(hyperloglog_is_sparse(&hll));
+  assert(close_to(hyperloglog_estimate(&hll), 1000, 0.02));
+  assert(hyperloglog_memory_usage(&hll) < 16384);
+
+  // It turns dense as it fills, staying within a few standard errors (0.8%).
+  uint64_t keys[100000];
+  for (uint64_t i = 0; i < 100000; i++)
+    keys[i] = i;
+  assert(!hyperloglog_add_many(&hll, keys, sizeof(uint64_t), 100000));
+  assert(!hyperloglog_is_sparse(&hll));
+  assert(hyperloglog_memory_usage(&hll) == 16384);
+  assert(close_to(hyperloglog_estimate(&hll), 100000, 0.03));
+
+  // A merge counts the keys in either sketch once, whatever their forms.
+  assert(!hyperloglog_init(&other, 14));
+  for (uint64_t key = 50000; key < 150000; key++)
+    assert(!hyperloglog_add(&other, &key, sizeof(key)));
+  assert(!hyperloglog_merge(&hll, &other));
+  assert(close_to(hyperloglog_estimate(&hll), 150000, 0.03));
+  hyperloglog_deinit(&other);
+
+  {
+    HyperLogLog sparse, dense;
+    assert(!hyperloglog_init(&sparse, 14));
+    assert(!hyperloglog_init(&dense, 14));
+    for (uint64_t key = 0; key < 100; key++)
+      assert(!hyperloglog_add(&sparse, &key, sizeof(key)));
+    assert(!hyperloglog_add_many(&dense, keys, sizeof(uint64_t), 50000));
+
+    // Sparse into dense, and dense into sparse which makes it dense.
+    uint64_t before = hyperloglog_estimate(&dense);
+    assert(!hyperloglog_merge(&dense, &sparse));
+    assert(hyperloglog_estimate(&dense) == before);
+    assert(!hyperloglog_merge(&sparse, &dense));
+    assert(!hyperloglog_is_sparse(&sparse));
+    assert(hyperloglog_estimate(&sparse) == before);
+
+    // Sketches of different precisions can't be merged.
+    HyperLogLog coarse;
+    assert(!hyperloglog_init(&coarse, 10));
+    assert(hyperloglog_merge(&coarse, &dense));
+    hyperloglog_deinit(&coarse);
+
+    hyperloglog_deinit(&sparse);
+    hyperloglog_deinit(&dense);
+  }
+
+  // Hashes can be added directly, here from a different seed.
+  {
+    HyperLogLog hashes;
+    assert(!hyperloglog_init(&hashes, 12));
+    uint64_t batch[1000];
+    for (uint64_t i = 0; i < 1000; i++)
+      batch[i] = xxh64_hash((const uint8_t *)&i, sizeof(i), 1);
+    assert(!hyperloglog_add_hashes(&hashes, batch, 1000));
+    assert(close_to(hyperloglog_estimate(&hashes), 1000, 0.05));
+    hyperloglog_deinit(&hashes);
+  }
+
+  // Both forms survive a round trip, a damaged buffer is rejected.
+  for (int sparse = 0; sparse < 2; sparse++) {
+    HyperLogLog copy;
+    if (sparse) {
+      assert(!hyperloglog_clear(&hll));
+      for (uint64_t key = 0; key < 500; key++)
+        assert(!hyperloglog_add(&hll, &key, sizeof(key)));
+    }
+
+    size_t size = hyperloglog_serialized_size(&hll);
+    uint8_t *buffer = malloc(size);
+    assert(buffer);
+    assert(hyperloglog_serialize(&hll, buffer, size - 1));
+    assert(!hyperloglog_serialize(&hll, buffer, size));
+
+    assert(!hyperloglog_deserialize(&copy, buffer, size));
+    assert(hyperloglog_is_sparse(&copy) == sparse);
+    assert(hyperloglog_estimate(&copy) == hyperloglog_estimate(&hll));
+    hyperloglog_deinit(&copy);
+
+    assert(hyperloglog_deserialize(&copy, buffer, size - 1));
+    buffer[0] ^= 1;
+    assert(hyperloglog_deserialize(&copy, buffer, size));
+    buffer[0] ^= 1;
+    buffer[size - 1] = 0xFF;
+    assert(hyperloglog_deserialize(&copy, buffer, size));
+
+    // A sparse count whose byte length wraps to the empty payload. The count
+    // is the last field of the 24 byte header.
+    if (sparse) {
+      uint64_t entries = 1ULL << 62;
+      memcpy(buffer + 16, &entries, sizeof(entries));
+      assert(hyperloglog_deserialize(&copy, buffer, 24));
+    }
+
+    free(buffer);
+  }
+
+  hyperloglog_deinit(&hll);
+}
@@ -0,0 +1,88 @@
+/**
+ * intrusive_list.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/intrusive_list.h"
+#include <assert.h>
+
+typedef struct Item {
+  int value;
+  IntrusiveListLink link;
+} Item;
+
+static int value_of(IntrusiveListLink *link) {
+  return intrusive_list_entry(link, Item, link)->value;
+}
+
+int main() {
+  IntrusiveList list;
+  intrusive_list_init(&list);
+
+  assert(intrusive_list_len(&list) == 0);
+  assert(intrusive_list_first(&list) == NULL);
+  assert(intrusive_list_pop_last(&list) == NULL);
+
+  Item items[10];
+  for (int i = 0; i < 10; i++) {
+    items[i].value = i;
+    intrusive_list_append(&list, &items[i].link);
+  }
+
+  assert(intrusive_list_len(&list) == 10);
+  assert(value_of(intrusive_list_first(&list)) == 0);
+  assert(value_of(intrusive_list_last(&list)) == 9);
+
+  // Remove a link from the middle without walking the list.
+  intrusive_list_remove(&list, &items[5].link);
+  assert(intrusive_list_len(&list) == 9);
+  assert(value_of(intrusive_list_next(&list, &items[4].link)) == 6);
+  assert(value_of(intrusive_list_prev(&list, &items[6].link)) == 4);
+
+  // Put it back where it was.
+  intrusive_list_insert_after(&list, &items[4].link, &items[5].link);
+  assert(value_of(intrusive_list_prev(&list, &items[6].link)) == 5);
+
+  // Move the last item to the front, as an LRU list would on access.
+  intrusive_list_move_to_front(&list, &items[9].link);
+  assert(value_of(intrusive_list_first(&list)) == 9);
+  assert(value_of(intrusive_list_last(&list)) == 8);
+
+  {
+    // Iterate forwards, 9 then 0 to 8.
+    int expected[] = {9, 0, 1, 2, 3, 4, 5, 6, 7, 8};
+    int i = 0;
+    for (IntrusiveListLink *link = intrusive_list_first(&list); link;
+         link = intrusive_list_next(&list, link))
+      assert(value_of(link) == expected[i++]);
+    assert(i == 10);
+  }
+
+  // Pop 8 from the back and insert it before 0.
+  IntrusiveListLink *last = intrusive_list_pop_last(&list);
+  assert(value_of(last) == 8);
+  intrusive_list_insert_before(&list, &items[0].link, last);
+  assert(value_of(intrusive_list_next(&list, &items[9].link)) == 8);
+
+  // Empty the list from the front.
+  for (size_t len = intrusive_list_len(&list); len > 0; len--)
+    assert(intrusive_list_pop_first(&list));
+  assert(intrusive_list_first(&list) == NULL);
+}
@@ -73,6 +73,13 @@ int main() {
   assert(*((unsigned char *)first->next->data) != 18);
   assert(*((unsigned char *)list.first->data) == 19);
 
+  // Delete the node after the first and then the first node itself.
+  linked_list_delete_next(&list, list.first);
+  assert(*((unsigned char *)list.first->next->data) == 16);
+
+  linked_list_delete_next(&list, NULL);
+  assert(*((unsigned char *)list.first->data) == 16);
+
   // Clear the list
   linked_list_clear(&list);
   assert(list.first == NULL);
@@ -91,5 +98,13 @@ int main() {
     } while ((next = next->next));
   }
 
+  {
+    size_t len = 0;
+    for (LinkedListNode *node = list.first; node; node = node->next)
+      len++;
+    assert(linked_list_memory_usage(&list, sizeof(int)) ==
+           len * (sizeof(LinkedListNode) + sizeof(int)));
+  }
+
   linked_list_deinit(&list);
 }
@@ -0,0 +1,224 @@
+/**
+ * parallel.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/parallel.h"
+#include "mylib/hash.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define N 100000
+
+static void mark(void *ctx, size_t begin, size_t end) {
+  uint8_t *seen = ctx;
+  for (size_t i = begin; i < end; i++)
+    seen[i]++;
+}
+
+// The span of indices reduced so far, combining only works for neighbouring
+// spans so this checks that partials are combined in order.
+typedef struct Span {
+  size_t begin;
+  size_t end;
+  size_t sum;
+} Span;
+
+static void reduce_span(void *ctx, size_t begin, size_t end, void *result) {
+  Span *span = result;
+  assert(span->begin == span->end);
+  span->begin = begin;
+  span->end = end;
+  for (size_t i = begin; i < end; i++)
+    span->sum += i;
+}
+
+static void combine_span(void *ctx, void *result, const void *partial) {
+  Span *span = result;
+  const Span *next = partial;
+  if (span->begin == span->end) {
+    *span = *next;
+    return;
+  }
+  assert(span->end == next->begin);
+  span->end = next->end;
+  span->sum += next->sum;
+}
+
+static void square(void *ctx, const void *element, void *result) {
+  uint32_t value = *(const uint32_t *)element;
+  *(uint64_t *)result = (uint64_t)value * value;
+}
+
+static int is_even(void *ctx, const void *element) {
+  return *(const uint32_t *)element % 2 == 0;
+}
+
+static void add(void *ctx, void *result, const void *element) {
+  *(uint64_t *)result += *(const uint32_t *)element;
+}
+
+static void add_partial(void *ctx, void *result, const void *partial) {
+  *(uint64_t *)result += *(const uint64_t *)partial;
+}
+
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+static void double_value(void *ctx, HashMapKV *kv) {
+  *(uint64_t *)kv->value *= 2;
+  __atomic_fetch_add((size_t *)ctx, 1, __ATOMIC_RELAXED);
+}
+
+int main() {
+  ThreadPool pool;
+  assert(!thread_pool_init(&pool, 4));
+
+  // Every index is visited exactly once, whatever the grain.
+  {
+    static uint8_t seen[N];
+    size_t grains[] = {0, 1, 7, N, N * 2};
+    for (size_t g = 0; g < 5; g++) {
+      memset(seen, 0, sizeof(seen));
+      parallel_for(&pool, 0, N, grains[g], mark, seen);
+      for (size_t i = 0; i < N; i++)
+        assert(seen[i] == 1);
+    }
+
+    // An empty range does nothing.
+    parallel_for(&pool, 5, 5, 0, mark, seen);
+    assert(seen[5] == 1);
+  }
+
+  {
+    Span identity = {0}, result;
+    assert(!parallel_reduce(&pool, 10, N, 333, reduce_span, combine_span, NULL,
+                            &identity, &result, sizeof(Span)));
+    assert(result.begin == 10 && result.end == N);
+    assert(result.sum == (uint64_t)N * (N - 1) / 2 - 45);
+
+    assert(!parallel_reduce(&pool, 0, 0, 0, reduce_span, combine_span, NULL,
+                            &identity, &result, sizeof(Span)));
+    assert(result.begin == 0 && result.end == 0);
+  }
+
+  Vector vec;
+  assert(!vector_init(&vec, sizeof(uint32_t)));
+  for (uint32_t i = 0; i < N; i++)
+    assert(!vector_append(&vec, &i));
+
+  {
+    Vector squares;
+    assert(!parallel_vector_map(&pool, &vec, &squares, sizeof(uint64_t),
+                                square, NULL));
+    assert(vector_len(&squares) == N);
+    for (size_t i = 0; i < N; i++)
+      assert(*(const uint64_t *)vector_get_const(&squares, i) ==
+             (uint64_t)i * i);
+    vector_deinit(&squares);
+  }
+
+  {
+    Vector evens;
+    assert(!parallel_vector_filter(&pool, &vec, &evens, is_even, NULL));
+    assert(vector_len(&evens) == N / 2);
+    for (size_t i = 0; i < N / 2; i++)
+      assert(*(const uint32_t *)vector_get_const(&evens, i) == i * 2);
+    vector_deinit(&evens);
+  }
+
+  {
+    uint64_t zero = 0, sum;
+    assert(!parallel_vector_reduce(&pool, &vec, add, add_partial, NULL, &zero,
+                                   &sum, sizeof(uint64_t)));
+    assert(sum == (uint64_t)N * (N - 1) / 2);
+  }
+
+  // An empty vector maps and filters to an empty vector.
+  {
+    Vector empty, result;
+    assert(!vector_init(&empty, sizeof(uint32_t)));
+    assert(!parallel_vector_filter(&pool, &empty, &result, is_even, NULL));
+    assert(vector_len(&result) == 0);
+    vector_deinit(&result);
+    assert(!parallel_vector_map(&pool, &empty, &result, sizeof(uint64_t),
+                                square, NULL));
+    assert(vector_len(&result) == 0);
+    vector_deinit(&result);
+    vector_deinit(&empty);
+  }
+
+  vector_deinit(&vec);
+
+  {
+    Bitset a, b, result;
+    assert(!bitset_init(&a, 1 << 20));
+    assert(!bitset_init(&b, 1 << 16));
+    for (size_t i = 0; i < 1 << 20; i += 3)
+      bitset_incl(&a, i);
+    for (size_t i = 0; i < 1 << 16; i += 2)
+      bitset_incl(&b, i);
+
+    assert(parallel_bitset_count(&pool, &a) == bitset_count(&a));
+
+    Bitset expected;
+    assert(!bitset_union(&a, &b, &expected));
+    assert(!parallel_bitset_union(&pool, &b, &a, &result));
+    assert(result.max == expected.max);
+    assert(bitset_eql(&result, &expected));
+    assert(parallel_bitset_count(&pool, &result) == bitset_count(&expected));
+
+    bitset_deinit(&expected);
+    bitset_deinit(&result);
+    bitset_deinit(&a);
+    bitset_deinit(&b);
+  }
+
+  {
+    HashMap map;
+    assert(!hash_map_init64(&map, hash_u64, eql_u64, sizeof(uint64_t),
+                            sizeof(uint64_t)));
+    for (uint64_t key = 0; key < 10000; key++)
+      assert(!hash_map_put(&map, &key, &key));
+
+    size_t visited = 0;
+    parallel_hash_map_for_each(&pool, &map, double_value, &visited);
+    assert(visited == 10000);
+    for (uint64_t key = 0; key < 10000; key++)
+      assert(*(uint64_t *)hash_map_get_value(&map, &key) == key * 2);
+
+    // A cleared map has nothing to visit.
+    hash_map_clear(&map);
+    visited = 0;
+    parallel_hash_map_for_each(&pool, &map, double_value, &visited);
+    assert(visited == 0);
+
+    hash_map_deinit(&map);
+  }
+
+  thread_pool_deinit(&pool);
+}
@@ -0,0 +1,139 @@
+/**
+ * perfect_map.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/perfect_map.h"
+#include "mylib/hash.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define N 100000
+
+static uint64_t hash_u64(const void *key) {
+  return xxh64_hash(key, sizeof(uint64_t), 0);
+}
+
+static int eql_u64(const void *a, const void *b) {
+  return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+// Keys spread out so they aren't just 0..N.
+static uint64_t key_of(uint64_t i) { return i * 0x9E3779B97F4A7C15ULL + 7; }
+
+static void check(const PerfectMap *map, size_t count) {
+  assert(perfect_map_count(map) == count);
+  for (uint64_t i = 0; i < count; i++) {
+    uint64_t key = key_of(i);
+    const uint32_t *value = perfect_map_get(map, &key);
+    assert(value && *value == (uint32_t)i);
+  }
+
+  // Keys that were never added aren't found.
+  for (uint64_t i = count; i < count + 1000; i++) {
+    uint64_t key = key_of(i);
+    assert(!perfect_map_has(map, &key));
+  }
+}
+
+int main() {
+  static uint64_t keys[N];
+  static uint32_t values[N];
+  for (uint64_t i = 0; i < N; i++) {
+    keys[i] = key_of(i);
+    values[i] = i;
+  }
+
+  PerfectMap map;
+
+  // Every size from empty up, small tables have few buckets.
+  size_t sizes[] = {0, 1, 2, 5, 17, 1000, N};
+  for (size_t i = 0; i < 7; i++) {
+    assert(!perfect_map_build(&map, keys, values, sizes[i], sizeof(uint64_t),
+                              sizeof(uint32_t)));
+    check(&map, sizes[i]);
+    perfect_map_deinit(&map);
+  }
+
+  // The index is about 3 bits per key, the rest is the keys and values.
+  assert(!perfect_map_build(&map, keys, values, N, sizeof(uint64_t),
+                            sizeof(uint32_t)));
+  size_t index_bytes = map.bucket_count * sizeof(uint16_t) +
+                       (map.table_size - map.count) * sizeof(uint32_t);
+  assert(index_bytes * 8 < N * 4);
+  assert(perfect_map_memory_usage(&map) <
+         N * (sizeof(uint64_t) + sizeof(uint32_t)) + index_bytes + 1024);
+
+  // A written map opens with mmap and finds the same keys.
+  const char *path = "perfect_map.bin";
+  assert(!perfect_map_write(&map, path));
+  perfect_map_deinit(&map);
+
+  assert(!perfect_map_open(&map, path));
+  assert(map.mapped);
+  check(&map, N);
+  perfect_map_deinit(&map);
+
+  // A file that isn't a map is rejected.
+  FILE *file = fopen(path, "wb");
+  assert(file);
+  fputs("not a perfect map, just some text that is long enough for a header",
+        file);
+  fclose(file);
+  assert(perfect_map_open(&map, path));
+  remove(path);
+  assert(perfect_map_open(&map, path));
+
+  // Repeated keys can't be given a slot each.
+  keys[10] = keys[20];
+  assert(perfect_map_build(&map, keys, values, 100, sizeof(uint64_t),
+                           sizeof(uint32_t)));
+  keys[10] = key_of(10);
+
+  // From a HashMap, with no values at all.
+  {
+    HashMap hash_map;
+    assert(!hash_map_init64(&hash_map, hash_u64, eql_u64, sizeof(uint64_t),
+                            sizeof(uint32_t)));
+    for (uint64_t i = 0; i < 5000; i++)
+      assert(!hash_map_put(&hash_map, &keys[i], &values[i]));
+
+    assert(!perfect_map_build_from_hash_map(&map, &hash_map));
+    check(&map, 5000);
+    perfect_map_deinit(&map);
+
+    hash_map_deinit(&hash_map);
+
+    // Borrowed entries can be of any size, so they are refused.
+    HashMapOptions options = {.storage = HASH_MAP_STORE_BORROW};
+    assert(!hash_map_init_with_options(&hash_map, hash_u64, eql_u64,
+                                       sizeof(uint64_t), sizeof(uint32_t),
+                                       &options));
+    assert(!hash_map_put(&hash_map, &keys[0], &values[0]));
+    assert(perfect_map_build_from_hash_map(&map, &hash_map));
+    hash_map_deinit(&hash_map);
+
+    assert(!perfect_map_build(&map, keys, NULL, 10, sizeof(uint64_t), 0));
+    assert(perfect_map_has(&map, &keys[3]));
+    perfect_map_deinit(&map);
+  }
+}
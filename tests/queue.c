@@ -0,0 +1,174 @@
+/**
+ * queue.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "mylib/queue.h"
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define MESSAGES 200000
+#define THREADS 4
+
+static void *spsc_producer(void *arg) {
+  SpscQueue *queue = arg;
+
+  // Alternate between single and batched pushes.
+  size_t i = 0;
+  while (i < MESSAGES) {
+    if (i % 2) {
+      size_t batch[8];
+      size_t count = 0;
+      for (; count < 8 && i + count < MESSAGES; count++)
+        batch[count] = i + count;
+
+      size_t pushed;
+      while (!(pushed = spsc_queue_push_batch(queue, batch, count)))
+        sched_yield();
+      i += pushed;
+    } else {
+      while (spsc_queue_push(queue, &i))
+        sched_yield();
+      i++;
+    }
+  }
+
+  return NULL;
+}
+
+static void *mpmc_producer(void *arg) {
+  MpmcQueue *queue = arg;
+
+  for (size_t i = 1; i <= MESSAGES; i++)
+    while (mpmc_queue_push(queue, &i))
+      sched_yield();
+
+  return NULL;
+}
+
+static void *mpmc_consumer(void *arg) {
+  MpmcQueue *queue = arg;
+
+  // Each consumer pops the same amount as a producer pushes and returns the
+  // sum of the values that it saw.
+  size_t *sum = calloc(1, sizeof(size_t));
+  for (size_t i = 0; i < MESSAGES; i++) {
+    size_t val;
+    while (mpmc_queue_pop(queue, &val))
+      sched_yield();
+    *sum += val;
+  }
+
+  return sum;
+}
+
+int main() {
+  {
+    SpscQueue queue;
+    assert(!spsc_queue_init(&queue, sizeof(size_t), 3));
+
+    // The capacity is rounded up to 4.
+    assert(queue.capacity == 4);
+    assert(spsc_queue_memory_usage(&queue) == 4 * sizeof(size_t));
+
+    size_t val = 0;
+    assert(spsc_queue_pop(&queue, &val));
+
+    size_t values[] = {1, 2, 3, 4, 5};
+    assert(spsc_queue_push_batch(&queue, values, 5) == 4);
+    assert(spsc_queue_push(&queue, &val));
+
+    assert(!spsc_queue_pop(&queue, &val));
+    assert(val == 1);
+
+    size_t popped[4];
+    assert(spsc_queue_pop_batch(&queue, popped, 4) == 3);
+    assert(popped[0] == 2 && popped[2] == 4);
+
+    spsc_queue_deinit(&queue);
+  }
+
+  // Pass values between two threads and check they arrive in order.
+  {
+    SpscQueue queue;
+    assert(!spsc_queue_init(&queue, sizeof(size_t), 64));
+
+    pthread_t producer;
+    assert(!pthread_create(&producer, NULL, spsc_producer, &queue));
+
+    for (size_t i = 0; i < MESSAGES;) {
+      size_t batch[16];
+      size_t count = spsc_queue_pop_batch(&queue, batch, 16);
+      if (!count)
+        sched_yield();
+      for (size_t j = 0; j < count; j++, i++)
+        assert(batch[j] == i);
+    }
+
+    assert(!pthread_join(producer, NULL));
+    spsc_queue_deinit(&queue);
+  }
+
+  {
+    MpmcQueue queue;
+    assert(!mpmc_queue_init(&queue, sizeof(size_t), 2));
+
+    size_t val = 1;
+    assert(!mpmc_queue_push(&queue, &val));
+    assert(!mpmc_queue_push(&queue, &val));
+    assert(mpmc_queue_push(&queue, &val));
+
+    assert(!mpmc_queue_pop(&queue, &val));
+    assert(!mpmc_queue_pop(&queue, &val));
+    assert(mpmc_queue_pop(&queue, &val));
+
+    mpmc_queue_deinit(&queue);
+  }
+
+  // Several producers and consumers, every value should be popped exactly once
+  // so the sums must match.
+  {
+    MpmcQueue queue;
+    assert(!mpmc_queue_init(&queue, sizeof(size_t), 128));
+
+    pthread_t producers[THREADS];
+    pthread_t consumers[THREADS];
+    for (size_t i = 0; i < THREADS; i++) {
+      assert(!pthread_create(&producers[i], NULL, mpmc_producer, &queue));
+      assert(!pthread_create(&consumers[i], NULL, mpmc_consumer, &queue));
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < THREADS; i++) {
+      void *sum;
+      assert(!pthread_join(producers[i], NULL));
+      assert(!pthread_join(consumers[i], &sum));
+      total += *(size_t *)sum;
+      free(sum);
+    }
+
+    assert(total == THREADS * ((size_t)MESSAGES * (MESSAGES + 1) / 2));
+
+    mpmc_queue_deinit(&queue);
+  }
+}
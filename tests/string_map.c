@@ -0,0 +1,160 @@
+/**
+ * string_map.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/string_map.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+int main() {
+  StringMap map;
+  assert(!string_map_init(&map, sizeof(int)));
+
+  // Keys are compared by length and bytes, they don't need a NUL.
+  {
+    const char *text = "abcdef";
+    int val = 1;
+    assert(!string_map_put(&map, text, 3, &val));
+    val = 2;
+    assert(!string_map_put(&map, text, 6, &val));
+    val = 3;
+    assert(!string_map_put(&map, "", 0, &val));
+
+    assert(string_map_count(&map) == 3);
+    assert(*(int *)string_map_get(&map, "abc", 3) == 1);
+    assert(*(int *)string_map_get(&map, "abcdef", 6) == 2);
+    assert(*(int *)string_map_get(&map, "", 0) == 3);
+    assert(!string_map_has(&map, "ab", 2));
+
+    // Keys are copied into the map and NUL terminated.
+    size_t length;
+    const char *key = string_map_key(&map, 0, &length);
+    assert(length == 3 && strcmp(key, "abc") == 0);
+
+    // Putting an existing key replaces its value.
+    val = 4;
+    assert(!string_map_put(&map, "abc", 3, &val));
+    assert(string_map_count(&map) == 3);
+    assert(*(int *)string_map_get(&map, "abc", 3) == 4);
+  }
+
+  string_map_clear(&map);
+  assert(string_map_count(&map) == 0);
+  assert(!string_map_has(&map, "abc", 3));
+
+  // Enough keys to grow the slots a few times, then delete most of them so
+  // that entries are moved and the arena is compacted.
+  char buf[32];
+  for (int i = 0; i < 1000; i++) {
+    int n = snprintf(buf, sizeof(buf), "key-%d", i);
+    assert(!string_map_put(&map, buf, n, &i));
+  }
+  assert(string_map_count(&map) == 1000);
+  assert(map.capacity >= 1000 * 4 / 3);
+
+  for (int i = 0; i < 1000; i++) {
+    int n = snprintf(buf, sizeof(buf), "key-%d", i);
+    assert(*(int *)string_map_get(&map, buf, n) == i);
+  }
+
+  size_t arena_before = vector_len(&map.arena);
+  for (int i = 0; i < 1000; i++) {
+    if (i % 10 == 0)
+      continue;
+    int n = snprintf(buf, sizeof(buf), "key-%d", i);
+    string_map_delete(&map, buf, n);
+  }
+  assert(string_map_count(&map) == 100);
+  assert(vector_len(&map.arena) < arena_before / 2);
+
+  for (int i = 0; i < 1000; i++) {
+    int n = snprintf(buf, sizeof(buf), "key-%d", i);
+    int *val = string_map_get(&map, buf, n);
+    assert((val != NULL) == (i % 10 == 0));
+    assert(!val || *val == i);
+  }
+
+  // Visiting by index sees every remaining entry once.
+  {
+    int sum = 0;
+    for (size_t idx = 0; idx < string_map_count(&map); idx++) {
+      size_t length;
+      const char *key = string_map_key(&map, idx, &length);
+      assert(strlen(key) == length);
+      sum += *(int *)string_map_value(&map, idx);
+    }
+    assert(sum == 49500);
+    assert(string_map_key(&map, string_map_count(&map), NULL) == NULL);
+  }
+
+  // Re-inserting reuses the tombstones without growing the slots.
+  size_t capacity = map.capacity;
+  for (int i = 0; i < 1000; i++) {
+    int n = snprintf(buf, sizeof(buf), "key-%d", i);
+    assert(!string_map_put(&map, buf, n, &i));
+  }
+  assert(string_map_count(&map) == 1000);
+  assert(map.capacity == capacity);
+  assert(string_map_memory_usage(&map) > vector_len(&map.arena));
+
+  string_map_deinit(&map);
+
+  // Without values a present key still gives a non-NULL pointer.
+  assert(!string_map_init(&map, 0));
+  assert(!string_map_put(&map, "abc", 3, NULL));
+  assert(string_map_get(&map, "abc", 3) != NULL);
+  assert(string_map_get(&map, "abd", 3) == NULL);
+  string_map_delete(&map, "abc", 3);
+  assert(string_map_get(&map, "abc", 3) == NULL);
+  string_map_deinit(&map);
+
+  // Interned strings keep their id.
+  StringInterner interner;
+  assert(!string_interner_init(&interner));
+
+  uint32_t ids[100];
+  for (int i = 0; i < 100; i++) {
+    int n = snprintf(buf, sizeof(buf), "label-%d", i);
+    assert(!string_interner_intern(&interner, buf, n, &ids[i]));
+    assert(ids[i] == (uint32_t)i);
+  }
+
+  for (int i = 0; i < 100; i++) {
+    int n = snprintf(buf, sizeof(buf), "label-%d", i);
+    uint32_t id;
+    assert(!string_interner_intern(&interner, buf, n, &id));
+    assert(id == ids[i]);
+    assert(!string_interner_find(&interner, buf, n, &id));
+    assert(id == ids[i]);
+
+    size_t length;
+    assert(strcmp(string_interner_get(&interner, id, &length), buf) == 0);
+    assert(length == (size_t)n);
+  }
+
+  uint32_t id;
+  assert(string_interner_find(&interner, "missing", 7, &id));
+  assert(string_interner_count(&interner) == 100);
+
+  string_interner_deinit(&interner);
+}
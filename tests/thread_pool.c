@@ -0,0 +1,138 @@
+/**
+ * thread_pool.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/thread_pool.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+
+static size_t counter;
+
+static void increment(void *arg) {
+  __atomic_fetch_add(&counter, *(size_t *)arg, __ATOMIC_RELAXED);
+}
+
+typedef struct Fib {
+  ThreadPool *pool;
+  unsigned n;
+  size_t *result;
+} Fib;
+
+// Spawns both halves of the recursion and joins them, exercising nested waits
+// and steals.
+static void fib(void *arg) {
+  Fib *task = arg;
+  if (task->n < 2) {
+    *task->result = task->n;
+    return;
+  }
+
+  size_t a, b;
+  ThreadPoolGroup group = {0};
+  Fib left = {task->pool, task->n - 1, &a};
+  Fib right = {task->pool, task->n - 2, &b};
+  thread_pool_spawn(task->pool, &group, fib, &left, sizeof(Fib));
+  thread_pool_spawn(task->pool, &group, fib, &right, sizeof(Fib));
+  thread_pool_wait(task->pool, &group);
+
+  *task->result = a + b;
+}
+
+// Spawns far more tasks than a deque holds from inside a worker.
+static void flood(void *arg) {
+  ThreadPool *pool = *(ThreadPool **)arg;
+  ThreadPoolGroup group = {0};
+  size_t one = 1;
+  for (size_t i = 0; i < THREAD_POOL_DEQUE_CAPACITY * 3; i++)
+    thread_pool_spawn(pool, &group, increment, &one, sizeof(size_t));
+  thread_pool_wait(pool, &group);
+}
+
+static void *external(void *arg) {
+  ThreadPool *pool = arg;
+  ThreadPoolGroup group = {0};
+  size_t one = 1;
+  for (size_t i = 0; i < 1000; i++)
+    thread_pool_spawn(pool, &group, increment, &one, sizeof(size_t));
+  thread_pool_wait(pool, &group);
+  return NULL;
+}
+
+int main() {
+  ThreadPool pool;
+
+  // 0 starts a worker per CPU.
+  assert(!thread_pool_init(&pool, 0));
+  assert(thread_pool_worker_count(&pool) >= 1);
+  thread_pool_deinit(&pool);
+
+  assert(!thread_pool_init(&pool, 4));
+  assert(thread_pool_worker_count(&pool) == 4);
+
+  // Tasks get their own copy of the argument.
+  {
+    ThreadPoolGroup group = {0};
+    for (size_t i = 1; i <= 100; i++)
+      thread_pool_spawn(&pool, &group, increment, &i, sizeof(size_t));
+    thread_pool_wait(&pool, &group);
+    assert(counter == 5050);
+    assert(group.pending == 0);
+  }
+
+  {
+    size_t result;
+    Fib task = {&pool, 20, &result};
+    ThreadPoolGroup group = {0};
+    thread_pool_spawn(&pool, &group, fib, &task, sizeof(Fib));
+    thread_pool_wait(&pool, &group);
+    assert(result == 6765);
+  }
+
+  {
+    counter = 0;
+    ThreadPool *arg = &pool;
+    ThreadPoolGroup group = {0};
+    thread_pool_spawn(&pool, &group, flood, &arg, sizeof(ThreadPool *));
+    thread_pool_wait(&pool, &group);
+    assert(counter == THREAD_POOL_DEQUE_CAPACITY * 3);
+  }
+
+  // Several threads outside the pool spawning and waiting at once.
+  {
+    counter = 0;
+    pthread_t threads[4];
+    for (size_t i = 0; i < 4; i++)
+      assert(!pthread_create(&threads[i], NULL, external, &pool));
+    for (size_t i = 0; i < 4; i++)
+      assert(!pthread_join(threads[i], NULL));
+    assert(counter == 4000);
+  }
+
+  // Waiting on a group with nothing in it returns straight away.
+  {
+    ThreadPoolGroup group = {0};
+    thread_pool_wait(&pool, &group);
+  }
+
+  thread_pool_deinit(&pool);
+}
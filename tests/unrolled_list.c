@@ -0,0 +1,146 @@
+/**
+ * unrolled_list.c
+ * Copyright (c) 2020 Matthew Murray <matt@compti.me>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mylib/unrolled_list.h"
+#include <assert.h>
+
+// Every block should hold at least one element and the counts should add up to
+// the size of the list.
+static void check_blocks(const UnrolledList *list) {
+  size_t size = 0;
+  const UnrolledListBlock *prev = NULL;
+  for (const UnrolledListBlock *block = list->first; block;
+       prev = block, block = block->next) {
+    assert(block->count > 0 && block->count <= list->block_capacity);
+    assert(block->prev == prev);
+    size += block->count;
+  }
+  assert(list->last == prev);
+  assert(size == unrolled_list_len(list));
+}
+
+int main() {
+  UnrolledList list;
+  assert(!unrolled_list_init(&list, sizeof(int), 4));
+
+  {
+    UnrolledListIterator iter = unrolled_list_iter(&list);
+    assert(unrolled_list_next(&iter) == NULL);
+  }
+
+  for (int i = 0; i < 20; i++)
+    assert(!unrolled_list_append(&list, &i));
+
+  check_blocks(&list);
+  assert(unrolled_list_len(&list) == 20);
+  assert(*((int *)unrolled_list_get(&list, 13)) == 13);
+  assert(unrolled_list_get(&list, 20) == NULL);
+
+  // Insert 100 + i after every even element, splitting the full blocks.
+  {
+    UnrolledListIterator iter = unrolled_list_iter(&list);
+    int *val;
+    while ((val = unrolled_list_next(&iter))) {
+      if (*val % 2 == 0 && *val < 100) {
+        int inserted = 100 + *val;
+        assert(!unrolled_list_insert_after(&iter, &inserted));
+      }
+    }
+  }
+
+  check_blocks(&list);
+  assert(unrolled_list_len(&list) == 30);
+  assert(*((int *)unrolled_list_get(&list, 0)) == 0);
+  assert(*((int *)unrolled_list_get(&list, 1)) == 100);
+  assert(*((int *)unrolled_list_get(&list, 2)) == 1);
+  assert(*((int *)unrolled_list_get(&list, 28)) == 118);
+  assert(*((int *)unrolled_list_get(&list, 29)) == 19);
+
+  // Whole blocks are counted, each holds 4 ints.
+  {
+    size_t block_size = sizeof(UnrolledListBlock) + 4 * sizeof(int);
+    size_t usage = unrolled_list_memory_usage(&list);
+    assert(usage % block_size == 0);
+    assert(usage >= 30 / 4 * block_size);
+  }
+
+  // Delete the inserted values again, merging the sparse blocks.
+  {
+    UnrolledListIterator iter = unrolled_list_iter(&list);
+    int *val;
+    while ((val = unrolled_list_next(&iter)))
+      if (*val >= 100)
+        unrolled_list_delete(&iter);
+  }
+
+  check_blocks(&list);
+  assert(unrolled_list_len(&list) == 20);
+
+  {
+    UnrolledListIterator iter = unrolled_list_iter(&list);
+    int *val;
+    for (int i = 0; (val = unrolled_list_next(&iter)); i++)
+      assert(*val == i);
+  }
+
+  // Insert at the front before iterating.
+  {
+    UnrolledListIterator iter = unrolled_list_iter(&list);
+    int val = -1;
+    assert(!unrolled_list_insert_after(&iter, &val));
+    assert(*((int *)unrolled_list_get(&list, 0)) == -1);
+    check_blocks(&list);
+  }
+
+  // Inserting once iteration has run off the end appends, into a full last
+  // block as well as one with room.
+  for (int round = 0; round < 2; round++) {
+    UnrolledListIterator iter = unrolled_list_iter(&list);
+    while (unrolled_list_next(&iter))
+      ;
+
+    size_t len = unrolled_list_len(&list);
+    int val = 1000 + round;
+    assert(!unrolled_list_insert_after(&iter, &val));
+    assert(unrolled_list_len(&list) == len + 1);
+    assert(*((int *)unrolled_list_get(&list, len)) == val);
+    assert(unrolled_list_next(&iter) == NULL);
+    check_blocks(&list);
+
+    // Fill the last block so that the next round splits it.
+    while (list.last->count < list.block_capacity)
+      assert(!unrolled_list_append(&list, &val));
+  }
+
+  // Delete everything, the blocks should all be freed.
+  {
+    UnrolledListIterator iter = unrolled_list_iter(&list);
+    while (unrolled_list_next(&iter))
+      unrolled_list_delete(&iter);
+  }
+
+  assert(unrolled_list_len(&list) == 0);
+  assert(list.first == NULL && list.last == NULL);
+  assert(unrolled_list_memory_usage(&list) == 0);
+
+  unrolled_list_deinit(&list);
+}
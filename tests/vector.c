@@ -22,6 +22,8 @@
  */
 #include "mylib/vector.h"
 #include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
 
 int main() {
   Vector vec;
@@ -50,6 +52,52 @@ int main() {
     vector_deinit(&clone);
   }
 
+  // A copy-on-write clone shares the elements until one of the vectors
+  // changes, every kind of change takes a copy first.
+  {
+    Vector clone, second;
+    assert(!vector_clone_cow(&vec, &clone));
+    assert(!vector_clone_cow(&clone, &second));
+    assert(clone.data == vec.data && *vec.refs == 3);
+    assert(*(const int *)vector_get_const(&second, 0) == 49);
+
+    // Reads leave the elements shared.
+    assert(*(const int *)vector_get_const(&clone, 0) == 49);
+    assert(clone.data == vec.data && *vec.refs == 3);
+
+    int a = 100;
+    assert(!vector_assign(&clone, 0, &a));
+    assert(clone.data != vec.data && clone.refs == NULL);
+    assert(*(const int *)vector_get_const(&clone, 0) == 100);
+    assert(*(const int *)vector_get_const(&vec, 0) == 49);
+
+    assert(!vector_append(&second, &a));
+    vector_delete(&second, 0);
+    assert(vector_len(&second) == 51 && vector_len(&vec) == 51);
+    assert(*(const int *)vector_get_const(&second, 0) == 48);
+    assert(*(const int *)vector_get_const(&vec, 0) == 49);
+
+    // Writing through vector_get doesn't reach the other holders.
+    Vector third;
+    assert(!vector_clone_cow(&vec, &third));
+    *(int *)vector_get(&third, 0) = 100;
+    assert(third.data != vec.data && third.refs == NULL);
+    assert(*(const int *)vector_get_const(&vec, 0) == 49);
+    vector_deinit(&third);
+
+    // Vectors sharing their elements can be freed in any order.
+    vector_deinit(&clone);
+    assert(!vector_clone_cow(&vec, &clone));
+    vector_deinit(&second);
+    vector_deinit(&vec);
+    vec = clone;
+
+    // The last holder changes them in place.
+    void *data = vec.data;
+    assert(*(int *)vector_get(&vec, 0) == 49);
+    assert(vec.data == data && vec.refs == NULL);
+  }
+
   // Delete the value in the 50th index which is the back of the vector.
   vector_delete(&vec, vector_len(&vec) - 1);
 
@@ -64,5 +112,109 @@ int main() {
   vector_swap_delete(&vec, 20);
   assert(*((const int *)vector_get_const(&vec, 20)) == 0);
 
+  // Deleting from the front until the vector is nearly empty shrinks the
+  // capacity but keeps the remaining elements.
+  while (vector_len(&vec) > 2)
+    vector_delete(&vec, 0);
+  assert(vec.capacity >= 2);
+  assert(*((const int *)vector_get_const(&vec, 1)) == 1);
+
+  // Every delete keeps the remaining elements and enough room for them, and
+  // the capacity shrinks but not below the initial capacity.
+  {
+    Vector shrink;
+    assert(!vector_init(&shrink, sizeof(int)));
+    for (int i = 0; i < 1000; i++)
+      assert(!vector_append(&shrink, &i));
+    size_t full = shrink.capacity;
+
+    for (int removed = 1; removed < 1000; removed++) {
+      vector_delete(&shrink, 0);
+      assert(vector_len(&shrink) == 1000 - removed);
+      assert(shrink.capacity >= vector_len(&shrink));
+      assert(shrink.capacity >= 4);
+      for (size_t i = 0; i < vector_len(&shrink); i++)
+        assert(*((const int *)vector_get_const(&shrink, i)) == removed + i);
+    }
+    assert(shrink.capacity < full);
+
+    vector_delete(&shrink, 0);
+    assert(vector_len(&shrink) == 0 && shrink.capacity >= 4);
+    vector_deinit(&shrink);
+  }
+
+  // A cleared vector can be appended to again.
+  vector_clear(&vec);
+  assert(vector_len(&vec) == 0);
+  {
+    int a = 7;
+    assert(!vector_append(&vec, &a));
+    assert(*((int *)vector_get(&vec, 0)) == a);
+  }
+
+  // Appending many elements grows the vector in one go.
+  {
+    int many[100];
+    for (int i = 0; i < 100; i++)
+      many[i] = i;
+
+    assert(!vector_append_many(&vec, many, 100));
+    assert(!vector_append_many(&vec, NULL, 0));
+    assert(vector_len(&vec) == 101);
+    assert(*((int *)vector_get(&vec, 1)) == 0);
+    assert(*((int *)vector_get(&vec, 100)) == 99);
+  }
+
+  // The memory usage counts the spare capacity too.
+  assert(vector_memory_usage(&vec) == vec.capacity * sizeof(int));
+  assert(vector_memory_usage(&vec) >= vector_size_in_bytes(&vec));
+
   vector_deinit(&vec);
+
+  // Fill a file-backed vector, then reopen the file and check the contents.
+  {
+    const char *path = "vector_mapped.bin";
+
+    Vector mapped;
+    assert(!vector_init_mapped(&mapped, sizeof(int), 0, path));
+    for (int i = 0; i < 100; i++)
+      assert(!vector_append(&mapped, &i));
+    assert(!vector_flush(&mapped));
+    vector_deinit(&mapped);
+
+    assert(!vector_open_mapped(&mapped, path, 1));
+    assert(vector_len(&mapped) == 100);
+    for (size_t i = 0; i < vector_len(&mapped); i++)
+      assert(*((const int *)vector_get_const(&mapped, i)) == i);
+
+    // A read-only vector can't be modified.
+    int val = 100;
+    assert(vector_append(&mapped, &val));
+    assert(vector_assign(&mapped, 0, &val));
+    vector_deinit(&mapped);
+
+    // The count is written back when a writable vector is deinitialized.
+    assert(!vector_open_mapped(&mapped, path, 0));
+    assert(!vector_append(&mapped, &val));
+    vector_delete(&mapped, 0);
+    vector_deinit(&mapped);
+
+    assert(!vector_open_mapped(&mapped, path, 1));
+    assert(vector_len(&mapped) == 100);
+    assert(*((const int *)vector_get_const(&mapped, 0)) == 1);
+    assert(*((const int *)vector_get_const(&mapped, 99)) == val);
+    vector_deinit(&mapped);
+
+    // A count whose byte length wraps around is rejected. The count is the
+    // last field of the first 32 bytes of the header.
+    FILE *file = fopen(path, "r+b");
+    assert(file);
+    uint64_t size = 1ULL << 62;
+    assert(!fseek(file, 24, SEEK_SET));
+    assert(fwrite(&size, sizeof(size), 1, file) == 1);
+    fclose(file);
+    assert(vector_open_mapped(&mapped, path, 1));
+
+    remove(path);
+  }
 }